@@ -8,24 +8,34 @@
 #include <nanovg_gl.h>
 #undef NANOVG_GLES3_IMPLEMENTATION
 #include <stb_ds.h>
-#include <cJSON.h>
 #include "event.h"
 #include "scenes/intro.h"
 #include "scenes/menu.h"
 #include "scenes/battle.h"
 #include "scenes/brickbreaker.h"
+#include "scenes/planes.h"
 #include "gl/shader.h"
+#include "gl/renderstats.h"
 #include "gui/console.h"
 #include "net/message.h"
 #include "util/util.h"
+#include "util/profiler.h"
 
 static Uint32 USR_EVENT_RELOAD = ((Uint32)-1);
 static Uint32 USR_EVENT_NOTIFY = ((Uint32)-1);
 static Uint32 USR_EVENT_GOBACK = ((Uint32)-1);
 
+#define ENGINE_GAMESERVER_READS_MAX 64 // per frame, so a flooding server can't stall us
+
 static void on_window_resized(struct engine *engine, int w, int h);
 static void engine_poll_events(struct engine *engine);
+static void engine_enter_mainloop_headless(struct engine *engine);
+static int  engine_load_input_script(struct engine *engine, const char *filename);
+static void engine_push_scripted_input(struct engine *engine);
 static void engine_gameserver_receive(struct engine *engine);
+static void engine_gameserver_receive_io(struct engine *engine);
+static void engine_gameserver_flush(struct engine *engine);
+static void engine_gameserver_hand_over(struct engine *engine);
 
 #ifdef __unix__
 #include <signal.h>
@@ -69,6 +79,15 @@ void on_siggoback(void) {
 
 
 struct engine *engine_new(int argc, char **argv) {
+	// headless runs need no display or audio device. SDL picks an offscreen (EGL)
+	// video driver, so scenes still get a GL context, and a dummy audio driver.
+	// Both can still be overwritten through the environment.
+	const int headless = is_argv_set(argc, argv, "--headless");
+	if (headless) {
+		SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+		SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+	}
+
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER | SDL_INIT_EVENTS) < 0) {
 		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "failed initializing SDL: %s.\n", SDL_GetError());
 		return NULL;
@@ -98,22 +117,51 @@ struct engine *engine_new(int argc, char **argv) {
 	engine->window_height = 834;
 	engine->time_elapsed = 0.0f;
 	engine->dt = 0.0f;
+	engine_set_tick_rate(engine, 60.0f);
 	engine->window = SDL_CreateWindow("Demo - c-engine",
 			SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 			engine->window_width, engine->window_height,
-			SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN | SDL_WINDOW_ALLOW_HIGHDPI);
+			SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | (headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN));
 	assert(engine->window != NULL && "Failed creating SDL window");
 	engine->window_id = SDL_GetWindowID(engine->window);
 	engine->on_notify_callbacks = NULL;
 	engine->scene = NULL;
 	engine->console = malloc(sizeof(struct console_s));
-	engine->gameserver_ip.host = engine->gameserver_ip.port = 0;
-	engine->gameserver_tcp = NULL;
-	engine->gameserver_socketset = NULL;
+	engine->gameserver_socket.is_open = 0;
+	engine->gameserver_io = NULL;
 	engine->console_visible = 1;
 	engine->freetype = NULL;
 	console_init(engine->console);
 
+	profiler_set_enabled(is_argv_set(argc, argv, "--profile"));
+	if (is_argv_set(argc, argv, "--net-json")) {
+		// human-readable traffic for debugging, both ends decode either encoding
+		message_set_encoding(MESSAGE_ENCODING_JSON);
+	}
+	// socket i/o and decoding off the main thread, native builds only
+	engine->gameserver_io_enabled = is_argv_set(argc, argv, "--net-thread");
+
+	engine->headless.enabled = headless;
+	engine->headless.frame = 0;
+	engine->headless.frames_max = 600;
+	engine->headless.script = NULL;
+	engine->headless.script_next = 0;
+	engine->headless.trace_file = NULL;
+	if (headless) {
+		const char *frames = argv_value(argc, argv, "--frames");
+		if (frames != NULL) {
+			engine->headless.frames_max = atoi(frames);
+		}
+
+		engine->headless.trace_file = argv_value(argc, argv, "--profile");
+
+		const char *input_script = argv_value(argc, argv, "--input");
+		if (input_script != NULL && engine_load_input_script(engine, input_script) != 0) {
+			SDL_LogError(SDL_LOG_CATEGORY_ERROR, "failed loading input script %s.\n", input_script);
+			return NULL;
+		}
+	}
+
 	if (SDLNet_Init() < 0) {
 		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "failed initializing SDL_net.\n");
 		return NULL;
@@ -121,11 +169,16 @@ struct engine *engine_new(int argc, char **argv) {
 
 	// OpenGL
 	engine->gl_ctx = SDL_GL_CreateContext(engine->window);
+	if (headless && engine->gl_ctx == NULL) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "failed creating an offscreen GL context (driver: %s): %s.\n",
+				SDL_GetCurrentVideoDriver(), SDL_GetError());
+		return NULL;
+	}
 	if (SDL_GL_MakeCurrent(engine->window, engine->gl_ctx) != 0) {
 		console_log_ex(engine, CONSOLE_MSG_ERROR, 4.0f, "Failed making context current: %s", SDL_GetError());
 	}
 
-	if (SDL_GL_SetSwapInterval(1) != 0) {
+	if (!headless && SDL_GL_SetSwapInterval(1) != 0) {
 		console_log_ex(engine, CONSOLE_MSG_ERROR, 4.0f, "Failed enabling v-sync: %s", SDL_GetError());
 	}
 
@@ -141,6 +194,16 @@ struct engine *engine_new(int argc, char **argv) {
 		console_log_ex(engine, CONSOLE_MSG_ERROR, 8.0f, "Not enough UBO components: %d", max_ubo_components);
 	}
 
+	// render statistics, shown with the profiler or written per frame with --render-stats=file.csv
+	renderstats_init();
+	renderstats_set_enabled(profiler_is_enabled());
+	const char *render_stats_csv = argv_value(argc, argv, "--render-stats");
+	if (render_stats_csv != NULL) {
+		if (renderstats_set_csv(render_stats_csv) != 0) {
+			console_log_ex(engine, CONSOLE_MSG_ERROR, 4.0f, "Failed opening %s", render_stats_csv);
+		}
+	}
+
 	// libs
 	engine->vg = nvgCreateGLES3(NVG_ANTIALIAS | NVG_STENCIL_STROKES);
 	engine->font_default_bold = nvgCreateFont(engine->vg, "Inter Regular", "res/font/Inter-Bold.ttf");
@@ -184,6 +247,10 @@ struct engine *engine_new(int argc, char **argv) {
 		struct scene_brickbreaker_s *brickbreaker = malloc(sizeof(struct scene_brickbreaker_s));
 		scene_brickbreaker_init(brickbreaker, engine);
 		engine_setscene(engine, (struct scene_s *)brickbreaker);
+	} else if (is_argv_set(argc, argv, "--scene=planes")) {
+		struct scene_planes_s *planes = malloc(sizeof(struct scene_planes_s));
+		scene_planes_init(planes, engine);
+		engine_setscene(engine, (struct scene_s *)planes);
 	} else {
 		struct scene_intro_s *intro = malloc(sizeof(struct scene_intro_s));
 		scene_intro_init(intro, engine);
@@ -200,6 +267,7 @@ int engine_destroy(struct engine *engine) {
 	// other
 	nvgDeleteGLES3(engine->vg);
 	stbds_arrfree(engine->on_notify_callbacks);
+	stbds_arrfree(engine->headless.script);
 	console_destroy(engine->console);
 	free(engine->console);
 
@@ -207,6 +275,8 @@ int engine_destroy(struct engine *engine) {
 	FT_Done_FreeType(engine->freetype);
 	engine->freetype = NULL;
 
+	renderstats_destroy();
+
 	// windowing
 	SDL_DestroyWindow(engine->window);
 	SDL_GL_DeleteContext(engine->gl_ctx);
@@ -234,6 +304,14 @@ void engine_set_clear_color(float r, float g, float b) {
 // system stuff
 //
 
+void engine_set_tick_rate(struct engine *engine, float ticks_per_second) {
+	assert(ticks_per_second > 0.0f);
+	engine->tick_dt = 1.0 / ticks_per_second;
+	engine->tick_accumulator = 0.0;
+	engine->tick_max_steps = 8;
+	engine->tick_alpha = 0.0f;
+}
+
 static void on_window_resized(struct engine *engine, int w, int h) {
 	engine->window_width = w;
 	engine->window_height = h;
@@ -280,6 +358,10 @@ void engine_setscene(struct engine *engine, struct scene_s *new_scene) {
 		free(old_scene);
 	}
 	
+	// don't carry simulation time over into the new scene
+	engine->tick_accumulator = 0.0;
+	engine->tick_alpha = 0.0f;
+
 	if (new_scene != NULL) {
 		engine->scene = new_scene;
 		scene_load(new_scene, engine);
@@ -320,84 +402,105 @@ void engine_setscene_dll(struct engine *engine, const char *filename) {
 //
 
 int engine_gameserver_connect(struct engine *engine, const char *address) {
-	assert(engine->gameserver_ip.host == 0);
-	assert(engine->gameserver_ip.port == 0);
-
-	if (engine->gameserver_tcp != NULL) {
+	if (engine->gameserver_socket.is_open) {
 		fprintf(stderr, "Already connected to gameserver.");
 		return 1;
 	}
 
-	const int port = 9124;
-	if (SDLNet_ResolveHost(&engine->gameserver_ip, address, port) < 0) {
-		engine->gameserver_ip.host = engine->gameserver_ip.port = 0;
-		fprintf(stderr, "Could not resolve host: \"%s\"...", address);
+	const uint16_t port = 9124;
+	if (net_socket_connect(&engine->gameserver_socket, address, port) != 0) {
+		fprintf(stderr, "Failed connecting to gameserver at \"%s\"...", address);
 		return 1;
 	}
 
-	engine->gameserver_tcp = SDLNet_TCP_Open(&engine->gameserver_ip);
-	if (engine->gameserver_tcp == NULL) {
-		engine->gameserver_ip.host = engine->gameserver_ip.port = 0;
-		fprintf(stderr, "Failed connecting to gameserver...");
-		return 1;
-	}
+	// with the network thread, `gameserver_tx` only holds frames its queue had no room for
+	net_stream_init(&engine->gameserver_rx, 4096);
+	net_stream_init(&engine->gameserver_tx, 4096);
 
-	engine->gameserver_socketset = SDLNet_AllocSocketSet(1); // we just connect to the server
-	if (SDLNet_TCP_AddSocket(engine->gameserver_socketset, engine->gameserver_tcp) < 0) {
-		assert("SocketSet is already full...");
-		fprintf(stderr, "Socketset already full?");
-		return 1;
+	// the thread owns the socket from here on
+	if (engine->gameserver_io_enabled) {
+		engine->gameserver_io = malloc(sizeof(struct net_io_thread));
+		if (net_io_thread_start(engine->gameserver_io, &engine->gameserver_socket) == 0) {
+			return 0;
+		}
+		fprintf(stderr, "No network thread, the main thread does the i/o...\n");
+		free(engine->gameserver_io);
+		engine->gameserver_io = NULL;
 	}
 
 	return 0;
 }
 
 void engine_gameserver_disconnect(struct engine *engine) {
-	engine->gameserver_ip.host = engine->gameserver_ip.port = 0;
-
-	if (engine->gameserver_tcp != NULL) {
+	if (engine->gameserver_socket.is_open) {
 		if (engine->scene != NULL) {
 			scene_on_message(engine->scene, engine, &(struct message_header){ .type = MSG_DISCONNECTED });
 		}
 
-		// socketset
-		SDLNet_TCP_DelSocket(engine->gameserver_socketset, engine->gameserver_tcp);
-		SDLNet_FreeSocketSet(engine->gameserver_socketset);
-		engine->gameserver_socketset = NULL;
-		// actual socket
-		SDLNet_TCP_Close(engine->gameserver_tcp);
-		engine->gameserver_tcp = NULL;
+		if (engine->gameserver_io != NULL) {
+			net_io_thread_stop(engine->gameserver_io);
+			free(engine->gameserver_io);
+			engine->gameserver_io = NULL;
+		}
+		net_socket_close(&engine->gameserver_socket);
+		// buffered data, unsent messages are lost
+		net_stream_free(&engine->gameserver_rx);
+		net_stream_free(&engine->gameserver_tx);
 	}
 }
 
 void engine_gameserver_send(struct engine *engine, struct message_header *msg) {
 	assert(engine != NULL);
 	assert(msg != NULL);
-	if (engine->gameserver_tcp == NULL) {
+	if (!engine->gameserver_socket.is_open) {
 		return;
 	}
 
-	// serialize
-	cJSON *json = pack_message(msg);
-	char *data = cJSON_PrintUnformatted(json);
-	const size_t data_len = strlen(data);
-	cJSON_Delete(json);
-
-	// send data
-	const int result = SDLNet_TCP_Send(engine->gameserver_tcp, data, data_len);
-	if (result != (int)data_len) {
-		// TODO: Retry?
-		fprintf(stderr, "Only sent %d of %zu bytes, that means we disconnect...\n", result, data_len);
+	// serialize straight into the send queue, the network thread's or our own.
+	// when the thread's is full, frames wait in ours until it catches up.
+	struct net_io_outgoing *out = NULL;
+	uint8_t *data = NULL;
+	if (engine->gameserver_io != NULL) {
+		engine_gameserver_hand_over(engine);
+		if (engine->gameserver_tx.len == 0) {
+			out = spsc_write_begin(&engine->gameserver_io->outgoing);
+			data = (out != NULL) ? out->data : NULL;
+		}
+		if (out == NULL) {
+			net_io_thread_wake(engine->gameserver_io);
+		}
+	}
+	if (data == NULL) {
+		size_t available = 0;
+		data = net_stream_write_begin(&engine->gameserver_tx, MESSAGE_FRAME_MAX, &available);
+	}
+	if (data == NULL) {
+		fprintf(stderr, "Gameserver doesn't take our messages anymore, disconnecting...\n");
 		engine_gameserver_disconnect(engine);
+		return;
 	}
 
-	free(data);
+	const size_t data_len = message_encode(msg, data, MESSAGE_FRAME_MAX);
+	if (data_len == 0) {
+		fprintf(stderr, "Could not encode a %s, not sending it\n", message_type_to_name(msg->type));
+		return;
+	}
+	if (out != NULL) {
+		out->len = data_len;
+		spsc_write_end(&engine->gameserver_io->outgoing);
+	} else {
+		net_stream_write_end(&engine->gameserver_tx, data_len);
+	}
 }
 
 // main loop
 void engine_update(struct engine *engine, double dt) {
+	profiler_scope_begin("engine_update");
+
 	// poll server
-	if (engine->gameserver_tcp != NULL) {
+	if (engine->gameserver_io != NULL) {
+		engine_gameserver_receive_io(engine);
+	} else if (engine->gameserver_socket.is_open) {
 		engine_gameserver_receive(engine);
 	}
 	
@@ -415,16 +518,51 @@ void engine_update(struct engine *engine, double dt) {
 
 	// update
 	console_update(engine->console, engine, dt);
+	profiler_scope_begin("scene_update");
 	scene_update(engine->scene, engine, dt);
+	profiler_scope_end();
+
+	// fixed timestep simulation
+	engine->tick_accumulator += dt;
+	int steps = 0;
+	while (engine->tick_accumulator >= engine->tick_dt && steps < engine->tick_max_steps) {
+		profiler_scope_begin("scene_tick");
+		scene_tick(engine->scene, engine, engine->tick_dt);
+		profiler_scope_end();
+		engine->tick_accumulator -= engine->tick_dt;
+		++steps;
+	}
+
+	// fell too far behind (e.g. breakpoint, window drag), drop the backlog
+	if (engine->tick_accumulator >= engine->tick_dt) {
+		engine->tick_accumulator = fmod(engine->tick_accumulator, engine->tick_dt);
+	}
+	engine->tick_alpha = engine->tick_accumulator / engine->tick_dt;
+
+	// everything sent this frame, in one write
+	if (engine->gameserver_io != NULL) {
+		engine_gameserver_hand_over(engine);
+		if (spsc_len(&engine->gameserver_io->outgoing) > 0) {
+			net_io_thread_wake(engine->gameserver_io);
+		}
+	} else if (engine->gameserver_socket.is_open) {
+		engine_gameserver_flush(engine);
+	}
+
+	profiler_scope_end();
 }
 
 void engine_draw(struct engine *engine) {
+	profiler_scope_begin("engine_draw");
+	renderstats_frame_begin();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 	
 	nvgBeginFrame(engine->vg, engine->window_width, engine->window_height, engine->window_pixel_ratio);
 
 	// run scene
-	scene_draw(engine->scene, engine);
+	profiler_scope_begin("scene_draw");
+	scene_draw(engine->scene, engine, engine->tick_alpha);
+	profiler_scope_end();
 
 	if (engine->console_visible != 0) {
 		console_draw(engine->console, engine);
@@ -473,12 +611,27 @@ void engine_draw(struct engine *engine) {
 	}
 #endif
 
+	profiler_draw(engine);
+	renderstats_draw(engine);
+
+	profiler_scope_begin("nvgEndFrame");
+	renderstats_pass_begin(RENDERSTATS_PASS_NANOVG);
 	nvgEndFrame(engine->vg);
+	renderstats_pass_end();
+	profiler_scope_end();
+
+	renderstats_frame_end();
+	profiler_scope_end();
 
 	SDL_GL_SwapWindow(engine->window);
 }
 
 void engine_enter_mainloop(struct engine *engine) {
+	if (engine->headless.enabled) {
+		engine_enter_mainloop_headless(engine);
+		return;
+	}
+
 	Uint64 current_time = SDL_GetPerformanceCounter();
 	while (engine->scene != NULL) {
 		const Uint64 new_time = SDL_GetPerformanceCounter();
@@ -487,10 +640,12 @@ void engine_enter_mainloop(struct engine *engine) {
 		engine->dt = elapsed_time / (double)SDL_GetPerformanceFrequency();
 		current_time = new_time;
 		
+		profiler_frame_begin();
 		engine_update(engine, engine->dt);
 		engine->time_elapsed += engine->dt;
 
 		engine_draw(engine);
+		profiler_frame_end();
 	}
 }
 
@@ -508,10 +663,119 @@ void engine_mainloop_emcc(void *engine_ptr) {
 	engine->dt = elapsed_time / (double)SDL_GetPerformanceFrequency();
 	current_time = new_time;
 
+	profiler_frame_begin();
 	engine_update(engine, engine->dt);
 	engine->time_elapsed += engine->dt;
 
 	engine_draw(engine);
+	profiler_frame_end();
+}
+
+// headless
+static void engine_enter_mainloop_headless(struct engine *engine) {
+	// synthetic clock, every frame advances exactly one tick. nothing is drawn,
+	// so the measured time is the cost of the simulation alone.
+	const double dt = engine->tick_dt;
+	const Uint64 begin = SDL_GetPerformanceCounter();
+
+	while (engine->scene != NULL && engine->headless.frame < engine->headless.frames_max) {
+		engine_push_scripted_input(engine);
+
+		profiler_frame_begin();
+		engine->dt = dt;
+		engine_update(engine, dt);
+		engine->time_elapsed += dt;
+		profiler_frame_end();
+
+		++engine->headless.frame;
+	}
+
+	const double total_ms = (SDL_GetPerformanceCounter() - begin) * 1000.0 / SDL_GetPerformanceFrequency();
+	const int frames = engine->headless.frame;
+	printf("headless: %d frames (%.2fs simulated) in %.1fms, %.3fms/frame\n",
+			frames, frames * dt, total_ms, frames > 0 ? total_ms / frames : 0.0);
+
+	// --profile=trace.json writes the last recorded frames
+	const char *trace_file = engine->headless.trace_file;
+	if (trace_file != NULL && profiler_export_chrome_trace(trace_file) != 0) {
+		fprintf(stderr, "failed writing profiler trace to %s\n", trace_file);
+	}
+}
+
+static int engine_load_input_script(struct engine *engine, const char *filename) {
+	FILE *f = fopen(filename, "r");
+	if (f == NULL) {
+		return 1;
+	}
+
+	char line[128];
+	int line_nr = 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		++line_nr;
+		if (line[0] == '#' || line[0] == '\n') {
+			continue;
+		}
+
+		struct engine_scripted_input input;
+		char type[16];
+		if (sscanf(line, "%d %15s %d %d", &input.frame, type, &input.x, &input.y) != 4) {
+			fprintf(stderr, "%s:%d: expected `<frame> <down|move|up> <x> <y>`\n", filename, line_nr);
+			fclose(f);
+			return 1;
+		}
+
+		if (strcmp(type, "down") == 0) {
+			input.type = SDL_MOUSEBUTTONDOWN;
+		} else if (strcmp(type, "up") == 0) {
+			input.type = SDL_MOUSEBUTTONUP;
+		} else if (strcmp(type, "move") == 0) {
+			input.type = SDL_MOUSEMOTION;
+		} else {
+			fprintf(stderr, "%s:%d: unknown input `%s`\n", filename, line_nr, type);
+			fclose(f);
+			return 1;
+		}
+
+		// keep sorted by frame
+		const int len = stbds_arrlen(engine->headless.script);
+		if (len > 0 && engine->headless.script[len - 1].frame > input.frame) {
+			fprintf(stderr, "%s:%d: frames have to be ascending\n", filename, line_nr);
+			fclose(f);
+			return 1;
+		}
+		stbds_arrpush(engine->headless.script, input);
+	}
+
+	fclose(f);
+	return 0;
+}
+
+// injects the scripted inputs of the current frame, they are handled by the regular event polling.
+static void engine_push_scripted_input(struct engine *engine) {
+	while (engine->headless.script_next < stbds_arrlen(engine->headless.script)) {
+		const struct engine_scripted_input *input = &engine->headless.script[engine->headless.script_next];
+		if (input->frame > engine->headless.frame) {
+			break;
+		}
+
+		SDL_Event event;
+		SDL_zero(event);
+		event.type = input->type;
+		if (input->type == SDL_MOUSEMOTION) {
+			event.motion.windowID = engine->window_id;
+			event.motion.x = input->x;
+			event.motion.y = input->y;
+		} else {
+			event.button.windowID = engine->window_id;
+			event.button.button = SDL_BUTTON_LEFT;
+			event.button.state = (input->type == SDL_MOUSEBUTTONDOWN) ? SDL_PRESSED : SDL_RELEASED;
+			event.button.x = input->x;
+			event.button.y = input->y;
+		}
+		SDL_PushEvent(&event);
+
+		++engine->headless.script_next;
+	}
 }
 
 // event polling
@@ -548,6 +812,18 @@ static void engine_poll_events(struct engine *engine) {
 				if (key_event.type == SDL_KEYUP && key_event.keysym.sym == SDLK_ESCAPE) {
 					on_siggoback();
 				}
+
+				// profiler: F3 toggles the overlay, F4 writes a trace of the recorded frames
+				if (key_event.type == SDL_KEYUP && key_event.keysym.sym == SDLK_F3) {
+					profiler_set_enabled(!profiler_is_enabled());
+					renderstats_set_enabled(profiler_is_enabled());
+				} else if (key_event.type == SDL_KEYUP && key_event.keysym.sym == SDLK_F4 && profiler_is_enabled()) {
+					if (profiler_export_chrome_trace("profile_trace.json") == 0) {
+						console_log(engine, "Wrote profile_trace.json");
+					} else {
+						console_log_ex(engine, CONSOLE_MSG_ERROR, 4.0f, "Failed writing profile_trace.json");
+					}
+				}
 				break;
 			}
 			case SDL_MOUSEBUTTONDOWN:
@@ -604,53 +880,110 @@ static void engine_poll_events(struct engine *engine) {
 }
 
 // receive & parse messages
-static void propagate_received_message(struct engine *engine, const char *data, size_t data_len) {
-	// we received something, but maybe it is no json/valid message?
-	cJSON *json = cJSON_ParseWithLength(data, data_len);
-	if (json != NULL) {
-		// it may be valid json, but a valid message?
-		struct message_header *header = unpack_message(json);
-		if (header != NULL) {
-			printf("Received a %s\n", message_type_to_name(header->type));
-			scene_on_message(engine->scene, engine, header);
-			free_message(json, header);
-		} else {
-			cJSON_Delete(json);
-		}
+static void propagate_received_message(struct engine *engine, struct message_header *header) {
+	// the frame was fine, but its payload did not match the schema
+	if (header->type == MSG_TYPE_UNKNOWN) {
+		return;
 	}
+
+	printf("Received a %s\n", message_type_to_name(header->type));
+	scene_on_message(engine->scene, engine, header);
 }
 
 static void engine_gameserver_receive(struct engine *engine) {
 	assert(engine != NULL);
 
-	const int readable_sockets = 1;
-	// Check if sockets are readable.
-	if (SDLNet_CheckSockets(engine->gameserver_socketset, 0) == readable_sockets) {
-		static char data[512] = {0};
+	// read everything that arrived since the last frame.
+	// frames may be split across reads, the stream keeps the incomplete rest.
+	for (int reads = 0; reads < ENGINE_GAMESERVER_READS_MAX; ++reads) {
+		size_t available = 0;
+		uint8_t *data = net_stream_write_begin(&engine->gameserver_rx, 512, &available);
+		if (data == NULL) {
+			fprintf(stderr, "Gameserver sent more than we can buffer, disconnecting...\n");
+			engine_gameserver_disconnect(engine);
+			return;
+		}
 
-		// TODO: we handle reading multiple objects in a single recv, but not partial objects.
-		const int data_len = SDLNet_TCP_Recv(engine->gameserver_tcp, &data, 511);
-		if (data_len > 0) {
-			// handle multiple json objects in a single message
-			const char *begin = data;
-			while (begin != NULL && begin < data + data_len) {
-				// TODO: this is garbage. find the end of this object
-				const char *end = str_match_bracket(begin, data_len, '{', '}');
-				if (end == NULL) break;
+		const ptrdiff_t data_len = net_socket_recv(&engine->gameserver_socket, data, available);
+		if (data_len < 0) {
+			printf("Lost the connection to the gameserver...\n");
+			engine_gameserver_disconnect(engine);
+			return;
+		}
+		if (data_len == 0) {
+			break;
+		}
+		net_stream_write_end(&engine->gameserver_rx, data_len);
+	}
 
-				const int len = end - begin + 1;
+	// handle all complete messages, a scene may disconnect while doing so
+	union message_any message;
+	int result = 0;
+	while (engine->gameserver_socket.is_open
+	       && (result = net_stream_next_message(&engine->gameserver_rx, &message)) > 0) {
+		propagate_received_message(engine, &message.header);
+	}
 
-				propagate_received_message(engine, begin, len);
+	if (result < 0) {
+		fprintf(stderr, "Received garbage from the gameserver, disconnecting...\n");
+		engine_gameserver_disconnect(engine);
+	}
+}
 
-				begin += len;
-			}
-			assert(begin == data + data_len);
+// handles what the network thread decoded since the last frame.
+static void engine_gameserver_receive_io(struct engine *engine) {
+	struct net_io_thread *io = engine->gameserver_io;
+	// it stops after its last message, those are still delivered
+	const int failed = __atomic_load_n(&io->failed, __ATOMIC_ACQUIRE);
+
+	// a scene may disconnect while handling, which stops the thread
+	struct net_io_incoming *in;
+	while (engine->gameserver_io != NULL && (in = spsc_read_begin(&io->incoming)) != NULL) {
+		if (!in->is_decoded) {
+			message_decode(in->data, in->len, &in->message);
+		}
+		propagate_received_message(engine, &in->message.header);
+		if (engine->gameserver_io != NULL) {
+			spsc_read_end(&io->incoming);
+		}
+	}
 
-		} else {
-			// TODO: why did we recieve nothing?
-			printf("TCP_Recv failure, got 0 bytes...\n");
-			// TODO: if we dont disconnect this will trigger continously in browser
+	if (failed && engine->gameserver_io != NULL) {
+		printf("Lost the connection to the gameserver...\n");
+		engine_gameserver_disconnect(engine);
+	}
+}
+
+// moves frames waiting in `gameserver_tx` into the network thread's queue, as far as it has room.
+static void engine_gameserver_hand_over(struct engine *engine) {
+	struct net_io_outgoing *out;
+	while (engine->gameserver_tx.len > 0 && (out = spsc_write_begin(&engine->gameserver_io->outgoing)) != NULL) {
+		int is_json = 0;
+		// only whole frames were written
+		if (net_stream_next_frame(&engine->gameserver_tx, out->data, &out->len, &is_json) <= 0) {
+			break;
+		}
+		spsc_write_end(&engine->gameserver_io->outgoing);
+	}
+}
+
+// writes the queued frames, as far as the socket takes them without blocking.
+static void engine_gameserver_flush(struct engine *engine) {
+	struct net_stream *tx = &engine->gameserver_tx;
+	size_t len = 0;
+	const uint8_t *data;
+	while ((data = net_stream_read_begin(tx, &len)) != NULL) {
+		const ptrdiff_t sent = net_socket_send(&engine->gameserver_socket, data, len);
+		if (sent < 0) {
+			fprintf(stderr, "Failed sending to the gameserver, disconnecting...\n");
 			engine_gameserver_disconnect(engine);
+			return;
+		}
+		net_stream_read_end(tx, sent);
+
+		// the socket is full, the rest goes out with the next frame
+		if ((size_t)sent < len) {
+			break;
 		}
 	}
 }
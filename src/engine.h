@@ -11,6 +11,9 @@
 #include "scenes/scene.h"
 #include "gl/shader.h"
 #include "input.h"
+#include "net/io_thread.h"
+#include "net/socket.h"
+#include "net/stream.h"
 
 //
 // forward decls & typedefs
@@ -25,6 +28,14 @@ typedef void(*engine_callback_fn)(struct engine*);
 // structs & enums
 //
 
+// a mouse event injected at a given frame, used to drive headless runs.
+// script lines: `<frame> <down|move|up> <x> <y>`
+struct engine_scripted_input {
+	int frame;
+	Uint32 type; // SDL_MOUSEBUTTONDOWN, SDL_MOUSEBUTTONUP or SDL_MOUSEMOTION
+	int x, y;
+};
+
 struct engine {
 	// windowing
 	SDL_Window *window;
@@ -43,9 +54,25 @@ struct engine {
 	double time_elapsed;
 	double dt;
 
+	// fixed timestep, see engine_set_tick_rate()
+	double tick_dt;
+	double tick_accumulator;
+	int tick_max_steps;  // per frame, drops time instead of spiraling when the simulation can't keep up
+	float tick_alpha;    // progress between the last and next tick [0, 1), used to interpolate rendering
+
 	// scene management
 	struct scene_s *scene;
 
+	// headless mode (--headless): hidden offscreen window, no drawing, synthetic clock.
+	struct {
+		int enabled;
+		int frame;
+		int frames_max;                         // --frames=N
+		struct engine_scripted_input *script;   // --input=file, stb_ds array sorted by frame
+		int script_next;
+		const char *trace_file;                 // --profile=file, chrome trace written on exit
+	} headless;
+
 	// hooks
 	engine_callback_fn *on_notify_callbacks;
 
@@ -54,9 +81,11 @@ struct engine {
 	struct input_drag_s input_drag;
 
 	// server connection
-	IPaddress gameserver_ip;
-	TCPsocket gameserver_tcp;
-	SDLNet_SocketSet gameserver_socketset;
+	struct net_socket gameserver_socket;
+	struct net_stream gameserver_rx;
+	struct net_stream gameserver_tx; // encoded frames, written once per frame. with --net-thread, those its queue had no room for
+	struct net_io_thread *gameserver_io; // does the socket i/o with --net-thread, NULL otherwise
+	int gameserver_io_enabled;
 
 	// rendering globals
 	mat4 u_projection;
@@ -79,6 +108,7 @@ int engine_destroy(struct engine *engine);
 
 // settings
 void engine_set_clear_color(float r, float g, float b);
+void engine_set_tick_rate(struct engine *, float ticks_per_second);
 
 // scene handling
 void engine_setscene(struct engine *engine, struct scene_s *scene);
@@ -87,6 +117,7 @@ void engine_setscene_dll(struct engine *engine, const char *filename);
 // networking
 int engine_gameserver_connect(struct engine *, const char *address);
 void engine_gameserver_disconnect(struct engine *);
+// queued, everything sent during a frame goes out in one write at the end of engine_update().
 void engine_gameserver_send(struct engine *, struct message_header *msg);
 
 // main loop
@@ -7,6 +7,7 @@
 #include "gl/texture.h"
 #include "gl/shader.h"
 #include "gl/vbuffer.h"
+#include "gl/renderstats.h"
 
 //
 // structs & enums
@@ -83,6 +84,7 @@ void background_destroy(void) {
 
 void background_draw(struct engine *engine) {
 	if (g_shader.program == 0) return;
+	renderstats_pass_begin(RENDERSTATS_PASS_BACKGROUND);
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -102,6 +104,7 @@ void background_draw(struct engine *engine) {
 	}
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glUseProgram(0);
+	renderstats_pass_end();
 }
 
 
@@ -0,0 +1,470 @@
+#include "game/battle_replay.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_ds.h>
+
+//
+// log layout, all integers little endian:
+//
+//     header:     "BRPL" u8 version, u64 seed, u32 cards_len, u32 checkpoint_turns
+//     update:     u8 REPLAY_RECORD_UPDATE
+//     event:      u8 REPLAY_RECORD_EVENT, u8 game_event_type, fields of the event
+//     checkpoint: u8 REPLAY_RECORD_CHECKPOINT, u32 turn, u64 hash, u32 state_len, state
+//
+
+#define REPLAY_MAGIC   "BRPL"
+#define REPLAY_VERSION 1
+
+enum replay_record {
+	REPLAY_RECORD_UPDATE = 1,
+	REPLAY_RECORD_EVENT,
+	REPLAY_RECORD_CHECKPOINT,
+};
+
+struct reader {
+	const uint8_t *data;
+	usize len;
+	usize offset;
+	int error; // set once a read went past the end
+};
+
+static void put_u8 (uint8_t **out, uint8_t value);
+static void put_u32(uint8_t **out, uint32_t value);
+static void put_u64(uint8_t **out, uint64_t value);
+static uint8_t  get_u8 (struct reader *);
+static uint32_t get_u32(struct reader *);
+static uint64_t get_u64(struct reader *);
+
+static void     write_state(uint8_t **out, const struct battle *);
+static int      read_state(struct reader *, struct battle *);
+static uint64_t hash_bytes(const uint8_t *data, usize len);
+static void     write_checkpoint(struct battle_replay *, const struct battle *);
+static enum battle_replay_result play(struct battle *, struct reader *, usize turn, int verify);
+
+void battle_replay_begin(struct battle_replay *replay, struct battle *battle, usize checkpoint_turns) {
+	assert(replay != NULL);
+	assert(battle != NULL);
+	assert(battle->state == GS_BATTLE_BEGIN && "has to record from the start");
+	assert(checkpoint_turns > 0);
+
+	memset(replay, 0, sizeof(*replay));
+	replay->checkpoint_turns = checkpoint_turns;
+	replay->seed = battle->seed;
+	replay->cards_len = battle->cards_len;
+
+	for (usize i = 0; i < strlen(REPLAY_MAGIC); ++i) {
+		put_u8(&replay->log, REPLAY_MAGIC[i]);
+	}
+	put_u8(&replay->log, REPLAY_VERSION);
+	put_u64(&replay->log, replay->seed);
+	put_u32(&replay->log, replay->cards_len);
+	put_u32(&replay->log, replay->checkpoint_turns);
+
+	battle->replay = replay;
+}
+
+void battle_replay_free(struct battle_replay *replay) {
+	assert(replay != NULL);
+	arrfree(replay->log);
+	arrfree(replay->checkpoints);
+	replay->flushed = 0;
+}
+
+void battle_replay_record_event(struct battle_replay *replay, struct game_event event) {
+	put_u8(&replay->log, REPLAY_RECORD_EVENT);
+	put_u8(&replay->log, event.type);
+	switch (event.type) {
+	case EVENT_PLAY_CARD:
+		put_u32(&replay->log, event.play_card.card);
+		put_u32(&replay->log, event.play_card.caused_by);
+		break;
+	case EVENT_MOVE_ENTITY:
+		put_u32(&replay->log, event.move_entity.entity);
+		put_u32(&replay->log, (uint32_t)event.move_entity.goal.x);
+		put_u32(&replay->log, (uint32_t)event.move_entity.goal.y);
+		break;
+	case EVENT_ATTACK_ENTITY:
+		put_u32(&replay->log, event.attack_entity.attacker);
+		put_u32(&replay->log, event.attack_entity.victim);
+		put_u32(&replay->log, event.attack_entity.initiated_by_card);
+		break;
+	case EVENT_END_TURN:
+	case EVENT_TYPE_MAX:
+		break;
+	}
+}
+
+void battle_replay_record_update(struct battle_replay *replay, const struct battle *battle) {
+	put_u8(&replay->log, REPLAY_RECORD_UPDATE);
+	// a new round starts, after the turn counter moved on.
+	if (battle->state == GS_ROUND_BEGIN && battle->turn_count % replay->checkpoint_turns == 0) {
+		write_checkpoint(replay, battle);
+	}
+}
+
+enum battle_replay_result battle_replay_seek(const struct battle_replay *replay, struct battle *battle, usize turn) {
+	assert(replay != NULL);
+	assert(battle != NULL);
+	assert(battle->replay == NULL && "would record the replay into itself");
+	if (battle->seed != replay->seed || battle->cards_len != replay->cards_len) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+
+	const usize checkpoints_len = arrlenu(replay->checkpoints);
+	if (checkpoints_len == 0) {
+		return BATTLE_REPLAY_END;
+	}
+	usize i = turn / replay->checkpoint_turns;
+	if (i >= checkpoints_len) {
+		i = checkpoints_len - 1;
+	}
+
+	struct reader reader = { .data=replay->log, .len=arrlenu(replay->log), .offset=replay->checkpoints[i].offset };
+	if (get_u8(&reader) != REPLAY_RECORD_CHECKPOINT) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+	(void)get_u32(&reader); // turn
+	const uint64_t hash = get_u64(&reader);
+	const uint32_t state_len = get_u32(&reader);
+	if (reader.error || state_len > reader.len - reader.offset || hash != hash_bytes(&reader.data[reader.offset], state_len)) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+	if (read_state(&reader, battle) != 0) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+
+	return play(battle, &reader, turn, 0);
+}
+
+enum battle_replay_result battle_replay_verify(const struct battle_replay *replay, struct battle *battle) {
+	assert(replay != NULL);
+	assert(battle != NULL);
+	assert(battle->replay == NULL && "would record the replay into itself");
+	assert(battle->state == GS_BATTLE_BEGIN);
+	if (battle->seed != replay->seed || battle->cards_len != replay->cards_len) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+
+	struct reader reader = { .data=replay->log, .len=arrlenu(replay->log), .offset=strlen(REPLAY_MAGIC) + 1 + 8 + 4 + 4 };
+	const enum battle_replay_result result = play(battle, &reader, (usize)-1, 1);
+	return (result == BATTLE_REPLAY_END) ? BATTLE_REPLAY_OK : result;
+}
+
+uint64_t battle_replay_hash(const struct battle *battle) {
+	uint8_t *state = NULL;
+	write_state(&state, battle);
+	const uint64_t hash = hash_bytes(state, arrlenu(state));
+	arrfree(state);
+	return hash;
+}
+
+int battle_replay_flush(struct battle_replay *replay, FILE *file) {
+	assert(replay != NULL);
+	assert(file != NULL);
+	const usize len = arrlenu(replay->log) - replay->flushed;
+	if (len > 0 && fwrite(&replay->log[replay->flushed], 1, len, file) != len) {
+		return 1;
+	}
+	replay->flushed += len;
+	return 0;
+}
+
+enum battle_replay_result battle_replay_load(struct battle_replay *replay, const char *path) {
+	assert(replay != NULL);
+	assert(path != NULL);
+	memset(replay, 0, sizeof(*replay));
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+	uint8_t buffer[4096];
+	usize read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		memcpy(arraddnptr(replay->log, read), buffer, read);
+	}
+	fclose(file);
+	replay->flushed = arrlenu(replay->log);
+
+	struct reader reader = { .data=replay->log, .len=arrlenu(replay->log), .offset=0 };
+	for (usize i = 0; i < strlen(REPLAY_MAGIC); ++i) {
+		if (get_u8(&reader) != (uint8_t)REPLAY_MAGIC[i]) {
+			return BATTLE_REPLAY_CORRUPT;
+		}
+	}
+	if (get_u8(&reader) != REPLAY_VERSION) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+	replay->seed = get_u64(&reader);
+	replay->cards_len = get_u32(&reader);
+	replay->checkpoint_turns = get_u32(&reader);
+	if (reader.error || replay->checkpoint_turns == 0) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+
+	// rebuild the checkpoint index
+	while (!reader.error && reader.offset < reader.len) {
+		const usize offset = reader.offset;
+		switch (get_u8(&reader)) {
+		case REPLAY_RECORD_UPDATE:
+			break;
+		case REPLAY_RECORD_EVENT: {
+			const uint8_t type = get_u8(&reader);
+			reader.offset += (type == EVENT_PLAY_CARD) ? 8 : (type == EVENT_END_TURN) ? 0 : 12;
+			break;
+		}
+		case REPLAY_RECORD_CHECKPOINT: {
+			const struct battle_replay_checkpoint checkpoint = { .turn=get_u32(&reader), .offset=offset };
+			(void)get_u64(&reader); // hash
+			reader.offset += get_u32(&reader);
+			if (checkpoint.turn != arrlenu(replay->checkpoints) * replay->checkpoint_turns) {
+				return BATTLE_REPLAY_CORRUPT;
+			}
+			arrput(replay->checkpoints, checkpoint);
+			break;
+		}
+		default:
+			return BATTLE_REPLAY_CORRUPT;
+		}
+	}
+	return (reader.offset == reader.len) ? BATTLE_REPLAY_OK : BATTLE_REPLAY_CORRUPT;
+}
+
+//
+// private implementations
+//
+
+static void put_u8(uint8_t **out, uint8_t value) {
+	arrput(*out, value);
+}
+
+static void put_u32(uint8_t **out, uint32_t value) {
+	uint8_t *dst = arraddnptr(*out, 4);
+	for (int i = 0; i < 4; ++i) {
+		dst[i] = (value >> (i * 8)) & 0xFF;
+	}
+}
+
+static void put_u64(uint8_t **out, uint64_t value) {
+	uint8_t *dst = arraddnptr(*out, 8);
+	for (int i = 0; i < 8; ++i) {
+		dst[i] = (value >> (i * 8)) & 0xFF;
+	}
+}
+
+static uint8_t get_u8(struct reader *reader) {
+	if (reader->offset + 1 > reader->len) {
+		reader->error = 1;
+		return 0;
+	}
+	return reader->data[reader->offset++];
+}
+
+static uint32_t get_u32(struct reader *reader) {
+	if (reader->offset + 4 > reader->len) {
+		reader->error = 1;
+		return 0;
+	}
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i) {
+		value |= (uint32_t)reader->data[reader->offset++] << (i * 8);
+	}
+	return value;
+}
+
+static uint64_t get_u64(struct reader *reader) {
+	if (reader->offset + 8 > reader->len) {
+		reader->error = 1;
+		return 0;
+	}
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i) {
+		value |= (uint64_t)reader->data[reader->offset++] << (i * 8);
+	}
+	return value;
+}
+
+// tile highlights are left out, only the client draws them.
+static void write_state(uint8_t **out, const struct battle *battle) {
+	put_u8(out, battle->state);
+	put_u8(out, battle->next_state);
+	put_u32(out, battle->turn_count);
+	put_u32(out, battle->player_movement_this_turn);
+	put_u64(out, battle->rng.s0);
+	put_u64(out, battle->rng.s1);
+
+	put_u32(out, battle->player);
+	put_u32(out, battle->units_len);
+	for (usize i = 0; i < battle->units_len; ++i) {
+		const struct battle_unit *unit = &battle->units[i];
+		put_u32(out, unit->id);
+		put_u32(out, (uint32_t)unit->pos.x);
+		put_u32(out, (uint32_t)unit->pos.y);
+		put_u32(out, unit->hp);
+		put_u32(out, unit->max_hp);
+		put_u8(out, unit->is_npc);
+	}
+
+	put_u32(out, battle->next_handcard_id);
+	put_u32(out, battle->hand_len);
+	for (usize i = 0; i < battle->hand_len; ++i) {
+		put_u32(out, battle->hand[i].id);
+		put_u32(out, battle->hand[i].card);
+	}
+
+	const usize tiles_len = (usize)battle->map.w * battle->map.h;
+	put_u32(out, tiles_len);
+	for (usize i = 0; i < tiles_len; ++i) {
+		put_u8(out, battle->map.tiles[i].movement_cost);
+		put_u32(out, battle->map.tiles[i].occupied_by);
+	}
+}
+
+static int read_state(struct reader *reader, struct battle *battle) {
+	battle->state = get_u8(reader);
+	battle->next_state = get_u8(reader);
+	battle->turn_count = get_u32(reader);
+	battle->player_movement_this_turn = get_u32(reader);
+	battle->rng.s0 = get_u64(reader);
+	battle->rng.s1 = get_u64(reader);
+
+	battle->player = get_u32(reader);
+	const usize units_len = get_u32(reader);
+	if (units_len > BATTLE_UNITS_MAX) {
+		return 1;
+	}
+	battle->units_len = units_len;
+	for (usize i = 0; i < battle->units_len; ++i) {
+		struct battle_unit *unit = &battle->units[i];
+		unit->id = get_u32(reader);
+		unit->pos.x = (int32_t)get_u32(reader);
+		unit->pos.y = (int32_t)get_u32(reader);
+		unit->hp = get_u32(reader);
+		unit->max_hp = get_u32(reader);
+		unit->is_npc = get_u8(reader);
+	}
+
+	battle->next_handcard_id = get_u32(reader);
+	const usize hand_len = get_u32(reader);
+	if (hand_len > BATTLE_HAND_MAX) {
+		return 1;
+	}
+	battle->hand_len = hand_len;
+	for (usize i = 0; i < battle->hand_len; ++i) {
+		battle->hand[i].id = get_u32(reader);
+		battle->hand[i].card = get_u32(reader);
+		if (battle->hand[i].card >= battle->cards_len) {
+			return 1;
+		}
+	}
+
+	const usize tiles_len = get_u32(reader);
+	if (tiles_len != (usize)battle->map.w * battle->map.h) {
+		return 1;
+	}
+	for (usize i = 0; i < tiles_len; ++i) {
+		battle->map.tiles[i].movement_cost = get_u8(reader);
+		battle->map.tiles[i].occupied_by = get_u32(reader);
+	}
+	return reader->error;
+}
+
+// FNV-1a
+static uint64_t hash_bytes(const uint8_t *data, usize len) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (usize i = 0; i < len; ++i) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static void write_checkpoint(struct battle_replay *replay, const struct battle *battle) {
+	const struct battle_replay_checkpoint checkpoint = { .turn=battle->turn_count, .offset=arrlenu(replay->log) };
+	assert(checkpoint.turn == arrlenu(replay->checkpoints) * replay->checkpoint_turns);
+	arrput(replay->checkpoints, checkpoint);
+
+	put_u8(&replay->log, REPLAY_RECORD_CHECKPOINT);
+	put_u32(&replay->log, battle->turn_count);
+	// hash and length go in front of the state, filled in once it is known
+	const usize header = arrlenu(replay->log);
+	put_u64(&replay->log, 0);
+	put_u32(&replay->log, 0);
+	write_state(&replay->log, battle);
+	const usize state_len = arrlenu(replay->log) - header - 12;
+	const uint64_t hash = hash_bytes(&replay->log[header + 12], state_len);
+	for (int i = 0; i < 8; ++i) {
+		replay->log[header + i] = (hash >> (i * 8)) & 0xFF;
+	}
+	for (int i = 0; i < 4; ++i) {
+		replay->log[header + 8 + i] = (state_len >> (i * 8)) & 0xFF;
+	}
+}
+
+static enum battle_replay_result play(struct battle *battle, struct reader *reader, usize turn, int verify) {
+	while (reader->offset < reader->len) {
+		if (battle->state == GS_ROUND_BEGIN && battle->turn_count >= turn) {
+			return BATTLE_REPLAY_OK;
+		}
+
+		switch (get_u8(reader)) {
+		case REPLAY_RECORD_UPDATE:
+			battle_update(battle);
+			break;
+		case REPLAY_RECORD_EVENT: {
+			struct game_event event = { .type=get_u8(reader) };
+			switch (event.type) {
+			case EVENT_PLAY_CARD:
+				event.play_card.card = get_u32(reader);
+				event.play_card.caused_by = get_u32(reader);
+				break;
+			case EVENT_MOVE_ENTITY:
+				event.move_entity.entity = get_u32(reader);
+				event.move_entity.goal.x = (int32_t)get_u32(reader);
+				event.move_entity.goal.y = (int32_t)get_u32(reader);
+				break;
+			case EVENT_ATTACK_ENTITY:
+				event.attack_entity.attacker = get_u32(reader);
+				event.attack_entity.victim = get_u32(reader);
+				event.attack_entity.initiated_by_card = get_u32(reader);
+				break;
+			case EVENT_END_TURN:
+				break;
+			case EVENT_TYPE_MAX:
+			default:
+				return BATTLE_REPLAY_CORRUPT;
+			}
+			if (reader->error) {
+				return BATTLE_REPLAY_CORRUPT;
+			}
+			// only applied events are recorded
+			if (battle_on_game_event(battle, event) != 0) {
+				return BATTLE_REPLAY_DESYNC;
+			}
+			break;
+		}
+		case REPLAY_RECORD_CHECKPOINT: {
+			const usize checkpoint_turn = get_u32(reader);
+			const uint64_t hash = get_u64(reader);
+			const uint32_t state_len = get_u32(reader);
+			if (reader->error || state_len > reader->len - reader->offset) {
+				return BATTLE_REPLAY_CORRUPT;
+			}
+			reader->offset += state_len;
+			if (verify && (checkpoint_turn != battle->turn_count || hash != battle_replay_hash(battle))) {
+				return BATTLE_REPLAY_DESYNC;
+			}
+			break;
+		}
+		default:
+			return BATTLE_REPLAY_CORRUPT;
+		}
+	}
+
+	if (reader->error) {
+		return BATTLE_REPLAY_CORRUPT;
+	}
+	return (battle->state == GS_ROUND_BEGIN && battle->turn_count >= turn) ? BATTLE_REPLAY_OK : BATTLE_REPLAY_END;
+}
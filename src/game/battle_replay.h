@@ -0,0 +1,71 @@
+#ifndef BATTLE_REPLAY_H
+#define BATTLE_REPLAY_H
+
+//
+// Append-only log of everything that changed a battle.
+//
+// Battles are deterministic: same seed, same cards and the same inputs give
+// the same battle. So the log only holds the inputs (applied game events and
+// state machine steps), plus a checkpoint of the full state every few turns.
+// Seeking restores the closest checkpoint and replays at most
+// `checkpoint_turns` turns from there. Checkpoints also carry a hash of the
+// state, replaying over them detects desyncs.
+//
+//     battle_init(&battle, cards, cards_len, seed, callbacks);
+//     battle_replay_begin(&replay, &battle, BATTLE_REPLAY_CHECKPOINT_TURNS);
+//     ... play ...
+//     battle_init(&copy, cards, cards_len, replay.seed, (struct battle_callbacks){0});
+//     battle_replay_seek(&replay, &copy, 42); // start of turn 42
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include "game/battle_rules.h"
+#include "util/base.h"
+
+#define BATTLE_REPLAY_CHECKPOINT_TURNS 16
+
+enum battle_replay_result {
+	BATTLE_REPLAY_OK = 0,
+	BATTLE_REPLAY_END,     // the log ends before the requested turn
+	BATTLE_REPLAY_DESYNC,  // the battle diverged from the recording
+	BATTLE_REPLAY_CORRUPT, // not a replay, or made with other cards
+};
+
+struct battle_replay_checkpoint {
+	usize turn;
+	usize offset; // of the checkpoint record in `log`
+};
+
+struct battle_replay {
+	uint8_t *log; // stb_ds array
+	usize flushed; // bytes of `log` already written by battle_replay_flush()
+	struct battle_replay_checkpoint *checkpoints; // stb_ds array, by turn / checkpoint_turns
+	usize checkpoint_turns;
+	uint64_t seed;
+	usize cards_len;
+};
+
+// starts recording `battle`, which must not have been updated yet.
+void battle_replay_begin(struct battle_replay *, struct battle *, usize checkpoint_turns);
+void battle_replay_free(struct battle_replay *);
+
+// called by the rules while recording.
+void battle_replay_record_event (struct battle_replay *, struct game_event);
+void battle_replay_record_update(struct battle_replay *, const struct battle *);
+
+// `battle` has to be initialized with the seed and cards of the recording and
+// must not be recording itself. seeking to turn N stops at the start of its round.
+// callbacks only see what is replayed, not what is restored from a checkpoint.
+enum battle_replay_result battle_replay_seek  (const struct battle_replay *, struct battle *, usize turn);
+// replays the whole log from the start and checks every checkpoint on the way.
+enum battle_replay_result battle_replay_verify(const struct battle_replay *, struct battle *);
+
+// hash of everything the rules care about, equal hashes mean equal battles.
+uint64_t battle_replay_hash(const struct battle *);
+
+// appends what was recorded since the last flush.
+int                       battle_replay_flush(struct battle_replay *, FILE *);
+enum battle_replay_result battle_replay_load (struct battle_replay *, const char *path);
+
+#endif
@@ -0,0 +1,466 @@
+#include "game/battle_rules.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include "game/battle_replay.h"
+#include "util/fs.h"
+#include "util/str.h"
+
+static void battle_message(struct battle *, enum battle_message, const char *fmt, ...);
+static void enter_state(struct battle *, enum gamestate_battle);
+static u32  add_unit(struct battle *, struct hexcoord, u16 hp, u16 max_hp, int is_npc);
+static u32  draw_card(struct battle *);
+static void remove_handcard(struct battle *, u32 handcard_id);
+static void trigger_card_effect(struct battle *, const struct battle_card *, u32 caused_by, enum effect_trigger);
+static int  is_neighbor(struct battle *, struct hexcoord a, struct hexcoord b);
+static void enemy_turn(struct battle *);
+
+static int on_play_card(struct battle *, struct game_event);
+static int on_move_entity(struct battle *, struct game_event);
+static int on_attack_entity(struct battle *, struct game_event);
+
+void battle_init(struct battle *battle, const struct battle_card *cards, usize cards_len, uint64_t seed, struct battle_callbacks callbacks) {
+	assert(battle != NULL);
+	assert(cards != NULL && cards_len > 0);
+
+	memset(battle, 0, sizeof(*battle));
+	battle->state = battle->next_state = GS_BATTLE_BEGIN;
+	battle->cards = cards;
+	battle->cards_len = cards_len;
+	battle->callbacks = callbacks;
+	battle->next_handcard_id = 1;
+	battle->seed = seed;
+	rng_state_seed(&battle->rng, seed);
+
+	hexmap_init(&battle->map);
+
+	// TODO: battles should come from data, this is the only one there is for now.
+	struct hexcoord campfire_pos = { .x=3, .y=4 };
+	hexmap_tile_at(&battle->map, campfire_pos)->movement_cost = HEXMAP_MOVEMENT_COST_MAX;
+	add_unit(battle, (struct hexcoord){ .x=3, .y=3 }, 8, 8, 1);
+	battle->player = add_unit(battle, (struct hexcoord){ .x=2, .y=5 }, 7, 10, 0);
+}
+
+void battle_destroy(struct battle *battle) {
+	assert(battle != NULL);
+	hexmap_destroy(&battle->map);
+	battle->units_len = 0;
+	battle->hand_len = 0;
+}
+
+void battle_update(struct battle *battle) {
+	assert(battle != NULL);
+	switch (battle->state) {
+	case GS_BATTLE_BEGIN:
+		battle->next_state = GS_ROUND_BEGIN;
+		break;
+	case GS_ROUND_BEGIN:
+		for (usize i = battle->hand_len; i < BATTLE_HAND_DRAW; ++i) {
+			draw_card(battle);
+		}
+		battle->next_state = GS_TURN_PLAYER_BEGIN;
+		break;
+	case GS_TURN_PLAYER_BEGIN:
+		battle->next_state = GS_TURN_PLAYER_IN_PROGRESS;
+		break;
+	case GS_TURN_PLAYER_IN_PROGRESS:
+		// waits for EVENT_END_TURN
+		break;
+	case GS_TURN_PLAYER_END:
+		battle->next_state = GS_TURN_ENTITY_BEGIN;
+		break;
+	case GS_TURN_ENTITY_BEGIN:
+		battle->next_state = GS_TURN_ENTITY_IN_PROGRESS;
+		break;
+	case GS_TURN_ENTITY_IN_PROGRESS:
+		battle->next_state = GS_TURN_ENTITY_END;
+		break;
+	case GS_TURN_ENTITY_END:
+		battle->next_state = GS_ROUND_END;
+		break;
+	case GS_ROUND_END:
+		battle->next_state = GS_ROUND_BEGIN;
+		break;
+	case GS_BATTLE_END:
+		break;
+	};
+
+	if (battle->next_state != battle->state) {
+		const enum gamestate_battle old_state = battle->state;
+		battle->state = battle->next_state;
+		enter_state(battle, battle->state);
+		if (battle->replay) {
+			battle_replay_record_update(battle->replay, battle);
+		}
+		if (battle->callbacks.on_state_changed) {
+			battle->callbacks.on_state_changed(battle, old_state, battle->state);
+		}
+	}
+}
+
+int battle_on_game_event(struct battle *battle, struct game_event event) {
+	assert(battle != NULL);
+	// everything so far is the players doing, until the turn is ended
+	if (battle->state != GS_TURN_PLAYER_IN_PROGRESS || battle->next_state != battle->state) {
+		return 1;
+	}
+
+	int result = 1;
+	switch (event.type) {
+	case EVENT_PLAY_CARD:
+		result = on_play_card(battle, event);
+		break;
+	case EVENT_MOVE_ENTITY:
+		result = on_move_entity(battle, event);
+		break;
+	case EVENT_ATTACK_ENTITY:
+		result = on_attack_entity(battle, event);
+		break;
+	case EVENT_END_TURN:
+		battle->next_state = GS_TURN_PLAYER_END;
+		result = 0;
+		break;
+	case EVENT_TYPE_MAX:
+		break;
+	};
+
+	// rejected events changed nothing, the replay doesn't need them
+	if (result == 0 && battle->replay) {
+		battle_replay_record_event(battle->replay, event);
+	}
+	return result;
+}
+
+struct battle_unit *battle_unit(struct battle *battle, u32 unit_id) {
+	assert(battle != NULL);
+	if (unit_id == 0 || unit_id > battle->units_len) {
+		return NULL;
+	}
+	return &battle->units[unit_id - 1];
+}
+
+const struct battle_handcard *battle_handcard(struct battle *battle, u32 handcard_id) {
+	assert(battle != NULL);
+	for (usize i = 0; i < battle->hand_len; ++i) {
+		if (battle->hand[i].id == handcard_id) {
+			return &battle->hand[i];
+		}
+	}
+	return NULL;
+}
+
+const struct battle_card *battle_handcard_card(struct battle *battle, u32 handcard_id) {
+	const struct battle_handcard *handcard = battle_handcard(battle, handcard_id);
+	return (handcard == NULL) ? NULL : &battle->cards[handcard->card];
+}
+
+int battle_count_handcards_of_kind(struct battle *battle, enum card_kind kind) {
+	assert(battle != NULL);
+	int count = 0;
+	for (usize i = 0; i < battle->hand_len; ++i) {
+		if (battle->cards[battle->hand[i].card].kind == kind) {
+			++count;
+		}
+	}
+	return count;
+}
+
+u32 battle_find_handcard_of_kind(struct battle *battle, enum card_kind kind) {
+	assert(battle != NULL);
+	for (usize i = 0; i < battle->hand_len; ++i) {
+		if (battle->cards[battle->hand[i].card].kind == kind) {
+			return battle->hand[i].id;
+		}
+	}
+	return 0;
+}
+
+struct battle_card *battle_cards_load(const char *path, usize *cards_len) {
+	assert(path != NULL);
+	assert(cards_len != NULL);
+
+	char *output;
+	long output_len;
+	if (fs_readfile(path, &output, &output_len) != FS_OK) {
+		*cards_len = 0;
+		return NULL;
+	}
+	cJSON *json = cJSON_ParseWithLength(output, output_len);
+	free(output);
+
+	assert(cJSON_IsArray(json));
+	const usize number_of_cards = cJSON_GetArraySize(json);
+	struct battle_card *cards = malloc(number_of_cards * sizeof(*cards));
+	for (usize i = 0; i < number_of_cards; ++i) {
+		const cJSON *card             = cJSON_GetArrayItem(json, i);
+		const cJSON *card_name        = cJSON_GetObjectItem(card, "name");
+		const cJSON *card_description = cJSON_GetObjectItem(card, "description");
+		const cJSON *card_face_id     = cJSON_GetObjectItem(card, "face_id");
+		const cJSON *card_kind        = cJSON_GetObjectItem(card, "kind");
+		const cJSON *card_damage      = cJSON_GetObjectItem(card, "damage");
+
+		assert(cJSON_IsObject(card));
+		assert(cJSON_IsString(card_name));
+		assert(cJSON_IsString(card_description));
+		assert(cJSON_IsNumber(card_face_id));
+		assert(cJSON_IsString(card_kind));
+		assert(strcmp(card_kind->valuestring, "basic_attack") == 0 || strcmp(card_kind->valuestring, "action") == 0);
+		assert(cJSON_IsObject(card_damage) || cJSON_IsNull(card_damage));
+		cards[i].name           = str_copy(card_name->valuestring);
+		cards[i].description    = str_copy(card_description->valuestring);
+		cards[i].image_id       = card_face_id->valueint;
+		cards[i].icon_ids_count = 0;
+		if (strcmp(card_kind->valuestring, "basic_attack") == 0) {
+			cards[i].kind = CARD_KIND_BASIC_ATTACK;
+		} else if (strcmp(card_kind->valuestring, "action") == 0) {
+			cards[i].kind = CARD_KIND_ACTION;
+		} else {
+			assert(0 && "unknown card kind encountered!");
+		}
+		cards[i].damage.basic = 0;
+		if (cJSON_IsObject(card_damage)) {
+			const cJSON *damage_basic = cJSON_GetObjectItem(card_damage, "basic");
+			assert(cJSON_IsNumber(damage_basic));
+			cards[i].damage.basic = cJSON_GetNumberValue(damage_basic);
+		}
+	}
+
+	cJSON_Delete(json);
+	*cards_len = number_of_cards;
+	return cards;
+}
+
+void battle_cards_free(struct battle_card *cards, usize cards_len) {
+	for (usize i = 0; i < cards_len; ++i) {
+		str_free(cards[i].name);
+		str_free(cards[i].description);
+	}
+	free(cards);
+}
+
+//
+// private implementations
+//
+
+static void battle_message(struct battle *battle, enum battle_message level, const char *fmt, ...) {
+	if (battle->callbacks.on_message == NULL) {
+		return;
+	}
+	char text[128];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(text, sizeof(text), fmt, args);
+	va_end(args);
+	battle->callbacks.on_message(battle, level, text);
+}
+
+static void enter_state(struct battle *battle, enum gamestate_battle state) {
+	switch (state) {
+	case GS_TURN_PLAYER_BEGIN:
+		battle->player_movement_this_turn = BATTLE_MOVEMENT;
+		break;
+	case GS_TURN_ENTITY_BEGIN:
+		enemy_turn(battle);
+		break;
+	case GS_ROUND_END:
+		++battle->turn_count;
+		break;
+	case GS_BATTLE_BEGIN:
+	case GS_ROUND_BEGIN:
+	case GS_TURN_PLAYER_IN_PROGRESS:
+	case GS_TURN_PLAYER_END:
+	case GS_TURN_ENTITY_IN_PROGRESS:
+	case GS_TURN_ENTITY_END:
+	case GS_BATTLE_END:
+		break;
+	}
+}
+
+static u32 add_unit(struct battle *battle, struct hexcoord pos, u16 hp, u16 max_hp, int is_npc) {
+	assert(battle->units_len < BATTLE_UNITS_MAX);
+	assert(hexmap_tile_at(&battle->map, pos)->occupied_by == 0);
+
+	struct battle_unit *unit = &battle->units[battle->units_len++];
+	unit->id = battle->units_len;
+	unit->pos = pos;
+	unit->hp = hp;
+	unit->max_hp = max_hp;
+	unit->is_npc = is_npc;
+	hexmap_tile_at(&battle->map, pos)->occupied_by = unit->id;
+	return unit->id;
+}
+
+static u32 draw_card(struct battle *battle) {
+	if (battle->hand_len >= BATTLE_HAND_MAX) {
+		battle_message(battle, BATTLE_MSG_ERROR, "Hand is full");
+		return 0;
+	}
+
+	struct battle_handcard *handcard = &battle->hand[battle->hand_len++];
+	handcard->id = battle->next_handcard_id++;
+	handcard->card = rng_state_i(&battle->rng) % battle->cards_len;
+	trigger_card_effect(battle, &battle->cards[handcard->card], battle->player, TRIGGER_DRAW_CARD);
+	if (battle->callbacks.on_card_drawn) {
+		battle->callbacks.on_card_drawn(battle, handcard);
+	}
+	return handcard->id;
+}
+
+static void remove_handcard(struct battle *battle, u32 handcard_id) {
+	for (usize i = 0; i < battle->hand_len; ++i) {
+		if (battle->hand[i].id == handcard_id) {
+			// keeps the order, cards are looked up first drawn first
+			memmove(&battle->hand[i], &battle->hand[i + 1], (battle->hand_len - i - 1) * sizeof(*battle->hand));
+			--battle->hand_len;
+			if (battle->callbacks.on_card_removed) {
+				battle->callbacks.on_card_removed(battle, handcard_id);
+			}
+			return;
+		}
+	}
+	assert(0 && "card is not in hand");
+}
+
+static void trigger_card_effect(struct battle *battle, const struct battle_card *card, u32 caused_by, enum effect_trigger trigger) {
+	switch (trigger) {
+		case TRIGGER_DRAW_CARD:
+			break;
+		case TRIGGER_PLAY_CARD: {
+			// TODO: Find a better way to identify cards, image_id is obviously not the answer...
+			if (card->image_id == 1) {
+				struct battle_unit *unit = battle_unit(battle, caused_by);
+				assert(unit != NULL);
+				int heal_until_max = unit->max_hp - unit->hp;
+				int heal_for = (heal_until_max > 2 ? 2 : heal_until_max);
+				if (heal_for <= 0) {
+					battle_message(battle, BATTLE_MSG_ERROR, "Already at full HP");
+				}
+				unit->hp += heal_for;
+				battle_message(battle, BATTLE_MSG_SUCCESS, "Healed for %d HP", heal_for);
+			} else if (card->image_id == 5) {
+				draw_card(battle);
+				draw_card(battle);
+			}
+			break;
+		}
+		case TRIGGER_DISCARD_CARD:
+			battle_message(battle, BATTLE_MSG_INFO, "Discarded Card %s", card->name);
+			break;
+	};
+}
+
+static int is_neighbor(struct battle *battle, struct hexcoord a, struct hexcoord b) {
+	for (enum hexmap_neighbor n = HEXMAP_N_FIRST; n <= HEXMAP_N_LAST; ++n) {
+		if (hexcoord_equal(hexmap_get_neighbor_coord(&battle->map, a, n), b)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int on_play_card(struct battle *battle, struct game_event event) {
+	assert(event.type == EVENT_PLAY_CARD);
+	const struct battle_card *card = battle_handcard_card(battle, event.play_card.card);
+	if (card == NULL || battle_unit(battle, event.play_card.caused_by) == NULL) {
+		return 1;
+	}
+
+	// TODO: Do something with card
+	trigger_card_effect(battle, card, event.play_card.caused_by, TRIGGER_PLAY_CARD);
+	remove_handcard(battle, event.play_card.card);
+	return 0;
+}
+
+static int on_move_entity(struct battle *battle, struct game_event event) {
+	assert(event.type == EVENT_MOVE_ENTITY);
+	if (event.move_entity.entity != battle->player) {
+		return 1;
+	}
+	struct battle_unit *unit = battle_unit(battle, event.move_entity.entity);
+	const struct hexcoord start = unit->pos;
+
+	struct hexmap_path path;
+	if (HEXMAP_PATH_OK != hexmap_path_find(&battle->map, start, event.move_entity.goal, &path)) {
+		hexmap_path_destroy(&path);
+		return 1;
+	}
+	if (path.distance_in_tiles < 1 || path.distance_in_tiles > battle->player_movement_this_turn) {
+		hexmap_path_destroy(&path);
+		return 1;
+	}
+
+	hexmap_tile_at(&battle->map, event.move_entity.goal)->occupied_by = unit->id;
+	hexmap_tile_at(&battle->map, start)->occupied_by = 0;
+	battle->player_movement_this_turn -= path.distance_in_tiles;
+	unit->pos = event.move_entity.goal;
+	if (battle->callbacks.on_unit_moved) {
+		battle->callbacks.on_unit_moved(battle, unit, &path);
+	}
+	hexmap_path_destroy(&path);
+	return 0;
+}
+
+static int on_attack_entity(struct battle *battle, struct game_event event) {
+	assert(event.type == EVENT_ATTACK_ENTITY);
+	const struct battle_card *card = battle_handcard_card(battle, event.attack_entity.initiated_by_card);
+	struct battle_unit *attacker = battle_unit(battle, event.attack_entity.attacker);
+	struct battle_unit *victim = battle_unit(battle, event.attack_entity.victim);
+	if (card == NULL || attacker == NULL || victim == NULL || attacker->id != battle->player) {
+		return 1;
+	}
+	if (card->kind != CARD_KIND_BASIC_ATTACK || !is_neighbor(battle, attacker->pos, victim->pos)) {
+		return 1;
+	}
+
+	const int deals_damage = card->damage.basic;
+	on_play_card(battle, (struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=attacker->id, .card=event.attack_entity.initiated_by_card } });
+	card = NULL; // gets removed by on_play_card()
+
+	// Determine attack damage
+	const int victim_hp = (int)victim->hp;
+	const int damage_dealt = (victim_hp < deals_damage) ? victim_hp : deals_damage;
+	victim->hp -= damage_dealt;
+	battle_message(battle, BATTLE_MSG_ERROR, "Dealt %d damage.", damage_dealt);
+	return 0;
+}
+
+static void enemy_turn(struct battle *battle) {
+	for (usize i = 0; i < battle->units_len; ++i) {
+		struct battle_unit *unit = &battle->units[i];
+		if (!unit->is_npc) {
+			continue;
+		}
+
+		// Move to a random neighbor
+		struct hexcoord random_neighbor;
+		uint iterations = HEXMAP_MAX_NEIGHBORS;
+		int start = rng_state_i(&battle->rng) % (HEXMAP_N_LAST - HEXMAP_N_FIRST + 1);
+		do {
+			random_neighbor = hexmap_get_neighbor_coord(&battle->map, unit->pos, (start + iterations) % (HEXMAP_N_LAST + 1));
+			if (iterations - 1 == 0) {
+				battle_message(battle, BATTLE_MSG_ERROR, "Enemy has 0 valid neighbors?!");
+			}
+		} while (iterations-- > 0 && (!hexmap_is_valid_coord(&battle->map, random_neighbor) || hexmap_is_tile_obstacle(&battle->map, random_neighbor)));
+
+		if (hexmap_is_valid_coord(&battle->map, random_neighbor) && !hexmap_is_tile_obstacle(&battle->map, random_neighbor)) {
+			struct hexmap_path path;
+			enum hexmap_path_result result = hexmap_path_find(&battle->map, unit->pos, random_neighbor, &path);
+			assert(result == HEXMAP_PATH_OK);
+			(void)result;
+
+			hexmap_tile_at(&battle->map, random_neighbor)->occupied_by = unit->id;
+			hexmap_tile_at(&battle->map, unit->pos)->occupied_by = 0;
+			unit->pos = random_neighbor;
+			if (battle->callbacks.on_unit_moved) {
+				battle->callbacks.on_unit_moved(battle, unit, &path);
+			}
+			hexmap_path_destroy(&path);
+		} else {
+			battle_message(battle, BATTLE_MSG_ERROR, "Did not move?");
+		}
+	}
+}
@@ -0,0 +1,171 @@
+#ifndef BATTLE_RULES_H
+#define BATTLE_RULES_H
+
+//
+// Battle rules, shared by the client and the server.
+//
+// Holds the authoritative state of one battle: map, units, the players hand
+// and the turn state machine. Nothing in here draws or reads input, the owner
+// feeds game events in and hears about the outcome through callbacks.
+// Battles share no mutable state, so each one may run on its own thread.
+//
+//     battle_init(&battle, cards, cards_len, seed, callbacks);
+//     battle_on_game_event(&battle, (struct game_event){ .type=EVENT_END_TURN });
+//     battle_update(&battle); // once per tick
+//
+
+#include <stdint.h>
+#include "game/hexmap.h"
+#include "util/base.h"
+#include "util/rng.h"
+
+#define BATTLE_UNITS_MAX   16
+#define BATTLE_HAND_MAX    32
+#define BATTLE_HAND_DRAW   5 // cards on hand at the start of each round
+#define BATTLE_MOVEMENT    2 // tiles a player may move each turn
+
+enum gamestate_battle {
+	GS_BATTLE_BEGIN           ,
+	GS_ROUND_BEGIN            ,
+	GS_TURN_ENTITY_BEGIN      , GS_TURN_PLAYER_BEGIN,
+	GS_TURN_ENTITY_IN_PROGRESS, GS_TURN_PLAYER_IN_PROGRESS,
+	GS_TURN_ENTITY_END        , GS_TURN_PLAYER_END,
+	GS_ROUND_END              ,
+	GS_BATTLE_END             ,
+};
+
+// ids in here are battle ids: `battle_unit.id` and `battle_handcard.id`.
+enum game_event_type {
+	EVENT_PLAY_CARD,
+	EVENT_MOVE_ENTITY,
+	EVENT_ATTACK_ENTITY,
+	EVENT_END_TURN,
+	EVENT_TYPE_MAX,
+};
+
+struct game_event {
+	enum game_event_type type;
+	union {
+		struct {
+			u32 card;
+			u32 caused_by;
+		} play_card;
+		struct {
+			u32 entity;
+			struct hexcoord goal;
+		} move_entity;
+		struct {
+			u32 attacker;
+			u32 victim;
+			u32 initiated_by_card;
+		} attack_entity;
+	};
+};
+
+enum effect_trigger {
+	TRIGGER_DRAW_CARD,
+	TRIGGER_PLAY_CARD,
+	TRIGGER_DISCARD_CARD,
+};
+
+// general information about a card
+enum card_kind {
+	CARD_KIND_BASIC_ATTACK,
+	CARD_KIND_ACTION,
+};
+
+struct battle_card {
+	char          *name;
+	char          *description;
+	int            image_id;
+	int            icon_ids[8];
+	int            icon_ids_count;
+	enum card_kind kind;
+	struct {
+		int basic;
+	} damage;
+};
+
+struct battle_handcard {
+	u32 id;
+	u32 card; // index into `battle.cards`
+};
+
+struct battle_unit {
+	u32 id; // 1-based, 0 is used for free tiles
+	struct hexcoord pos;
+	u16 hp;
+	u16 max_hp;
+	u8 is_npc;
+};
+
+enum battle_message {
+	BATTLE_MSG_INFO,
+	BATTLE_MSG_SUCCESS,
+	BATTLE_MSG_ERROR,
+};
+
+struct battle;
+struct battle_replay;
+
+// all callbacks are optional.
+struct battle_callbacks {
+	void (*on_state_changed)(struct battle *, enum gamestate_battle old_state, enum gamestate_battle new_state);
+	void (*on_card_drawn)   (struct battle *, const struct battle_handcard *);
+	void (*on_card_removed) (struct battle *, u32 handcard_id);
+	// the unit is already on its new tile. `path` is destroyed afterwards,
+	// unless the callback takes `path->tiles` and sets it to NULL.
+	void (*on_unit_moved)   (struct battle *, const struct battle_unit *, struct hexmap_path *path);
+	void (*on_message)      (struct battle *, enum battle_message, const char *text);
+};
+
+struct battle {
+	enum gamestate_battle state;
+	enum gamestate_battle next_state;
+	usize turn_count;
+	usize player_movement_this_turn;
+
+	struct hexmap map;
+	uint64_t seed;
+	struct rng_state rng;
+
+	u32 player;
+	struct battle_unit units[BATTLE_UNITS_MAX];
+	usize units_len;
+
+	struct battle_handcard hand[BATTLE_HAND_MAX];
+	usize hand_len;
+	u32 next_handcard_id;
+
+	// card definitions, not owned, may be shared between battles.
+	const struct battle_card *cards;
+	usize cards_len;
+
+	struct battle_callbacks callbacks;
+	void *userdata;
+	// set by battle_replay_begin(), every applied event and step goes in there.
+	struct battle_replay *replay;
+};
+
+void battle_init(struct battle *, const struct battle_card *cards, usize cards_len, uint64_t seed, struct battle_callbacks);
+void battle_destroy(struct battle *);
+
+// advances the turn state machine by at most one state.
+void battle_update(struct battle *);
+// returns 0 if the event was applied, 1 if the rules don't allow it right now.
+int  battle_on_game_event(struct battle *, struct game_event);
+
+// NULL for unknown ids.
+struct battle_unit           *battle_unit(struct battle *, u32 unit_id);
+const struct battle_handcard *battle_handcard(struct battle *, u32 handcard_id);
+const struct battle_card     *battle_handcard_card(struct battle *, u32 handcard_id);
+
+int battle_count_handcards_of_kind(struct battle *, enum card_kind);
+// returns the handcard id, 0 if there is none.
+u32 battle_find_handcard_of_kind(struct battle *, enum card_kind);
+
+// card definitions
+struct battle_card *battle_cards_load(const char *path, usize *cards_len);
+void                battle_cards_free(struct battle_card *, usize cards_len);
+
+#endif
@@ -0,0 +1,267 @@
+#include "game/battle_snapshot.h"
+
+#include <assert.h>
+#include <string.h>
+
+//
+// delta layout, bit-packed, least significant bit first:
+//
+//     for each of state, turn_count, player_movement, player, units_len:
+//         1 bit changed, the new value if set
+//     for each unit below units_len:
+//         1 bit changed, if set for each unit field: 1 bit changed, the new value if set
+//
+// everything is compared against the baseline, or against zeros without one.
+//
+
+#define BITS_STATE      4
+#define BITS_TURN_COUNT 32
+#define BITS_MOVEMENT   4
+#define BITS_UNIT_ID    8
+#define BITS_UNITS_LEN  5
+#define BITS_COORD      8
+#define BITS_HP         16
+
+struct bit_writer {
+	uint8_t *data;
+	usize capacity; // bytes
+	usize bits;
+	int overflow;
+};
+
+struct bit_reader {
+	const uint8_t *data;
+	usize len; // bytes
+	usize bits;
+	int error;
+};
+
+static void     write_bits(struct bit_writer *, uint32_t value, int bits);
+static uint32_t read_bits(struct bit_reader *, int bits);
+static void     write_field(struct bit_writer *, uint32_t baseline, uint32_t value, int bits);
+static uint32_t read_field(struct bit_reader *, uint32_t baseline, int bits);
+
+static const struct battle_snapshot g_empty_snapshot = { 0 };
+
+void battle_snapshot_capture(const struct battle *battle, struct battle_snapshot *snapshot) {
+	assert(battle != NULL);
+	assert(snapshot != NULL);
+	assert(battle->map.w <= (1 << BITS_COORD) && battle->map.h <= (1 << BITS_COORD));
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->state = battle->state;
+	snapshot->turn_count = battle->turn_count;
+	snapshot->player_movement = battle->player_movement_this_turn;
+	snapshot->player = battle->player;
+	snapshot->units_len = battle->units_len;
+	for (usize i = 0; i < battle->units_len; ++i) {
+		const struct battle_unit *unit = &battle->units[i];
+		snapshot->units[i] = (struct battle_snapshot_unit){
+			.id = unit->id,
+			.x = unit->pos.x,
+			.y = unit->pos.y,
+			.hp = unit->hp,
+			.max_hp = unit->max_hp,
+		};
+	}
+}
+
+void battle_snapshot_apply(const struct battle_snapshot *snapshot, struct battle *battle) {
+	assert(snapshot != NULL);
+	assert(battle != NULL);
+
+	battle->state = battle->next_state = snapshot->state;
+	battle->turn_count = snapshot->turn_count;
+	battle->player_movement_this_turn = snapshot->player_movement;
+	battle->player = snapshot->player;
+
+	// units only ever get added, the ones the client doesn't know yet are new.
+	for (usize i = 0; i < battle->units_len; ++i) {
+		hexmap_tile_at(&battle->map, battle->units[i].pos)->occupied_by = 0;
+	}
+	battle->units_len = snapshot->units_len;
+	for (usize i = 0; i < battle->units_len; ++i) {
+		const struct battle_snapshot_unit *from = &snapshot->units[i];
+		struct battle_unit *unit = &battle->units[i];
+		unit->id = from->id;
+		unit->pos = (struct hexcoord){ .x=from->x, .y=from->y };
+		unit->hp = from->hp;
+		unit->max_hp = from->max_hp;
+		if (hexmap_is_valid_coord(&battle->map, unit->pos)) {
+			hexmap_tile_at(&battle->map, unit->pos)->occupied_by = unit->id;
+		}
+	}
+}
+
+usize battle_snapshot_write_delta(const struct battle_snapshot *baseline, const struct battle_snapshot *snapshot, uint8_t *out, usize capacity) {
+	assert(snapshot != NULL);
+	assert(snapshot->units_len <= BATTLE_UNITS_MAX);
+	if (baseline == NULL) {
+		baseline = &g_empty_snapshot;
+	}
+
+	struct bit_writer w = { .data=out, .capacity=capacity };
+	write_field(&w, baseline->state, snapshot->state, BITS_STATE);
+	write_field(&w, baseline->turn_count, snapshot->turn_count, BITS_TURN_COUNT);
+	write_field(&w, baseline->player_movement, snapshot->player_movement, BITS_MOVEMENT);
+	write_field(&w, baseline->player, snapshot->player, BITS_UNIT_ID);
+	write_field(&w, baseline->units_len, snapshot->units_len, BITS_UNITS_LEN);
+
+	for (usize i = 0; i < snapshot->units_len; ++i) {
+		const struct battle_snapshot_unit *old = (i < baseline->units_len) ? &baseline->units[i] : &g_empty_snapshot.units[0];
+		const struct battle_snapshot_unit *unit = &snapshot->units[i];
+		const int changed = old->id != unit->id || old->x != unit->x || old->y != unit->y
+			|| old->hp != unit->hp || old->max_hp != unit->max_hp;
+		write_bits(&w, changed, 1);
+		if (changed) {
+			write_field(&w, old->id, unit->id, BITS_UNIT_ID);
+			write_field(&w, old->x, unit->x, BITS_COORD);
+			write_field(&w, old->y, unit->y, BITS_COORD);
+			write_field(&w, old->hp, unit->hp, BITS_HP);
+			write_field(&w, old->max_hp, unit->max_hp, BITS_HP);
+		}
+	}
+
+	return w.overflow ? 0 : (w.bits + 7) / 8;
+}
+
+int battle_snapshot_read_delta(const struct battle_snapshot *baseline, const uint8_t *data, usize len, struct battle_snapshot *out) {
+	assert(out != NULL);
+	if (baseline == NULL) {
+		baseline = &g_empty_snapshot;
+	}
+
+	struct bit_reader r = { .data=data, .len=len };
+	struct battle_snapshot snapshot = *baseline;
+	snapshot.state = read_field(&r, baseline->state, BITS_STATE);
+	snapshot.turn_count = read_field(&r, baseline->turn_count, BITS_TURN_COUNT);
+	snapshot.player_movement = read_field(&r, baseline->player_movement, BITS_MOVEMENT);
+	snapshot.player = read_field(&r, baseline->player, BITS_UNIT_ID);
+	snapshot.units_len = read_field(&r, baseline->units_len, BITS_UNITS_LEN);
+	if (r.error || snapshot.units_len > BATTLE_UNITS_MAX || snapshot.state > GS_BATTLE_END) {
+		return 1;
+	}
+
+	for (usize i = 0; i < snapshot.units_len; ++i) {
+		const struct battle_snapshot_unit *old = (i < baseline->units_len) ? &baseline->units[i] : &g_empty_snapshot.units[0];
+		struct battle_snapshot_unit *unit = &snapshot.units[i];
+		*unit = *old;
+		if (read_bits(&r, 1)) {
+			unit->id = read_field(&r, old->id, BITS_UNIT_ID);
+			unit->x = read_field(&r, old->x, BITS_COORD);
+			unit->y = read_field(&r, old->y, BITS_COORD);
+			unit->hp = read_field(&r, old->hp, BITS_HP);
+			unit->max_hp = read_field(&r, old->max_hp, BITS_HP);
+		}
+	}
+	for (usize i = snapshot.units_len; i < BATTLE_UNITS_MAX; ++i) {
+		snapshot.units[i] = g_empty_snapshot.units[0];
+	}
+
+	// the writer pads the last byte, anything past it is garbage
+	if (r.error || (r.bits + 7) / 8 != len) {
+		return 1;
+	}
+	*out = snapshot;
+	return 0;
+}
+
+void battle_sync_init(struct battle_sync *sync) {
+	assert(sync != NULL);
+	memset(sync, 0, sizeof(*sync));
+}
+
+usize battle_sync_write(struct battle_sync *sync, const struct battle *battle, uint32_t *sequence, uint32_t *baseline, uint8_t *out, usize capacity) {
+	assert(sync != NULL);
+	assert(battle != NULL);
+
+	struct battle_snapshot *snapshot = &sync->history[(sync->sequence + 1) % BATTLE_SNAPSHOT_HISTORY];
+	// the slot of the acknowledged snapshot is about to be reused
+	const struct battle_snapshot *acked = NULL;
+	if (sync->acked != 0 && sync->sequence + 1 - sync->acked < BATTLE_SNAPSHOT_HISTORY) {
+		acked = &sync->history[sync->acked % BATTLE_SNAPSHOT_HISTORY];
+		assert(acked->sequence == sync->acked);
+	}
+
+	battle_snapshot_capture(battle, snapshot);
+	snapshot->sequence = ++sync->sequence;
+	*sequence = snapshot->sequence;
+	*baseline = (acked != NULL) ? acked->sequence : 0;
+	return battle_snapshot_write_delta(acked, snapshot, out, capacity);
+}
+
+void battle_sync_ack(struct battle_sync *sync, uint32_t sequence) {
+	assert(sync != NULL);
+	// late or made up acks don't move the baseline
+	if (sequence > sync->acked && sequence <= sync->sequence) {
+		sync->acked = sequence;
+	}
+}
+
+int battle_sync_read(struct battle_sync *sync, uint32_t sequence, uint32_t baseline, const uint8_t *data, usize len, struct battle_snapshot *out) {
+	assert(sync != NULL);
+	assert(out != NULL);
+	if (sequence <= sync->sequence || (baseline != 0 && baseline >= sequence)) {
+		return 1;
+	}
+
+	const struct battle_snapshot *base = NULL;
+	if (baseline != 0) {
+		base = &sync->history[baseline % BATTLE_SNAPSHOT_HISTORY];
+		if (base->sequence != baseline) {
+			return 1;
+		}
+	}
+	struct battle_snapshot snapshot;
+	if (battle_snapshot_read_delta(base, data, len, &snapshot) != 0) {
+		return 1;
+	}
+
+	snapshot.sequence = sequence;
+	sync->sequence = sequence;
+	sync->history[sequence % BATTLE_SNAPSHOT_HISTORY] = snapshot;
+	*out = snapshot;
+	return 0;
+}
+
+//
+// private implementations
+//
+
+static void write_bits(struct bit_writer *w, uint32_t value, int bits) {
+	assert(bits > 0 && bits <= 32);
+	assert(bits == 32 || value < (1u << bits));
+	if ((w->bits + bits + 7) / 8 > w->capacity) {
+		w->overflow = 1;
+		return;
+	}
+	for (int i = 0; i < bits; ++i, ++w->bits) {
+		uint8_t *byte = &w->data[w->bits / 8];
+		const uint8_t mask = 1 << (w->bits % 8);
+		*byte = ((value >> i) & 1) ? (*byte | mask) : (*byte & ~mask);
+	}
+}
+
+static uint32_t read_bits(struct bit_reader *r, int bits) {
+	assert(bits > 0 && bits <= 32);
+	if ((r->bits + bits + 7) / 8 > r->len) {
+		r->error = 1;
+		return 0;
+	}
+	uint32_t value = 0;
+	for (int i = 0; i < bits; ++i, ++r->bits) {
+		value |= (uint32_t)((r->data[r->bits / 8] >> (r->bits % 8)) & 1) << i;
+	}
+	return value;
+}
+
+static void write_field(struct bit_writer *w, uint32_t baseline, uint32_t value, int bits) {
+	write_bits(w, baseline != value, 1);
+	if (baseline != value) {
+		write_bits(w, value, bits);
+	}
+}
+
+static uint32_t read_field(struct bit_reader *r, uint32_t baseline, int bits) {
+	return read_bits(r, 1) ? read_bits(r, bits) : baseline;
+}
@@ -0,0 +1,74 @@
+#ifndef BATTLE_SNAPSHOT_H
+#define BATTLE_SNAPSHOT_H
+
+//
+// Battle state for clients, sent as deltas.
+//
+// A snapshot holds what a client shows of a battle: the turn and every units
+// position and health. The server keeps the last snapshots it sent to each
+// client and writes the next one relative to the newest that client
+// acknowledged. Unchanged units cost one bit, so a quiet battle stays a few
+// bytes no matter how many units are in it.
+//
+//     // server, per client and tick
+//     n = battle_sync_write(&sync, &battle, &msg.sequence, &msg.baseline, msg.delta, sizeof(msg.delta));
+//     // client
+//     if (battle_sync_read(&sync, msg.sequence, msg.baseline, msg.delta, msg.delta_len, &snapshot) == 0) {
+//         battle_snapshot_apply(&snapshot, &battle);
+//         ... send BATTLE_SNAPSHOT_ACK with msg.sequence ...
+//     }
+//     // server, on BATTLE_SNAPSHOT_ACK
+//     battle_sync_ack(&sync, ack.sequence);
+//
+
+#include <stdint.h>
+#include "game/battle_rules.h"
+#include "util/base.h"
+
+#define BATTLE_SNAPSHOT_HISTORY   32  // snapshots kept per client, older acks fall back to a full snapshot
+#define BATTLE_SNAPSHOT_BYTES_MAX 160 // largest delta, a full snapshot of BATTLE_UNITS_MAX units
+
+struct battle_snapshot_unit {
+	uint8_t id; // 0 for none
+	uint8_t x;
+	uint8_t y;
+	uint16_t hp;
+	uint16_t max_hp;
+};
+
+struct battle_snapshot {
+	uint32_t sequence; // 1-based, 0 is no snapshot
+	uint8_t state;
+	uint32_t turn_count;
+	uint8_t player_movement;
+	uint8_t player;
+	uint8_t units_len;
+	struct battle_snapshot_unit units[BATTLE_UNITS_MAX];
+};
+
+void battle_snapshot_capture(const struct battle *, struct battle_snapshot *);
+// moves the units of `battle` to where the snapshot has them, without any callbacks.
+void battle_snapshot_apply(const struct battle_snapshot *, struct battle *);
+
+// `baseline` may be NULL to write everything.
+// returns the number of bytes written, 0 if `capacity` is too small.
+usize battle_snapshot_write_delta(const struct battle_snapshot *baseline, const struct battle_snapshot *, uint8_t *out, usize capacity);
+// returns 0 on success, 1 if `data` is no valid delta.
+int   battle_snapshot_read_delta(const struct battle_snapshot *baseline, const uint8_t *data, usize len, struct battle_snapshot *out);
+
+// one per client, on both ends of the connection.
+struct battle_sync {
+	struct battle_snapshot history[BATTLE_SNAPSHOT_HISTORY]; // by sequence % BATTLE_SNAPSHOT_HISTORY
+	uint32_t sequence; // newest snapshot sent (server) or received (client)
+	uint32_t acked;    // newest snapshot the client acknowledged, server only
+};
+
+void  battle_sync_init(struct battle_sync *);
+// server: captures `battle` as the next snapshot and writes it relative to the
+// last acknowledged one. returns the number of bytes written, 0 if `capacity` is too small.
+usize battle_sync_write(struct battle_sync *, const struct battle *, uint32_t *sequence, uint32_t *baseline, uint8_t *out, usize capacity);
+void  battle_sync_ack(struct battle_sync *, uint32_t sequence);
+// client: returns 0 on success, 1 if the delta is invalid, stale or its baseline is gone.
+int   battle_sync_read(struct battle_sync *, uint32_t sequence, uint32_t baseline, const uint8_t *data, usize len, struct battle_snapshot *out);
+
+#endif
@@ -1,11 +1,8 @@
 #include "game/hexmap.h"
 
 #include <assert.h>
-#include <cglm/cglm.h>
-#include "gl/camera.h"
-#include "gl/shader.h"
-#include "engine.h"
-#include "util/util.h"
+#include <math.h>
+#include <stdlib.h>
 
 /////////////
 // PRIVATE //
@@ -15,8 +12,6 @@ static const usize NO_EDGE = (usize)-1;
 static const usize NODE_NONE = (usize)-2;
 static const usize NODE_NOT_VISITED = (usize)-1;
 
-static void load_hextile_models(struct hexmap *);
-
 ////////////
 // PUBLIC //
 ////////////
@@ -35,7 +30,7 @@ int hexmap_is_valid_index(struct hexmap *map, usize index) {
 	return (index < (usize)map->w * map->h);
 }
 
-void hexmap_init(struct hexmap *map, struct engine *engine) {
+void hexmap_init(struct hexmap *map) {
 	map->w = 7;
 	map->h = 11;
 	map->tilesize = 2.0f;
@@ -45,8 +40,6 @@ void hexmap_init(struct hexmap *map, struct engine *engine) {
 		map->tiles[i].movement_cost = 1;
 		map->tiles[i].occupied_by = 0;
 	}
-	shader_init_from_dir(&map->tile_shader, "res/shader/model/hexmap_tile/");
-	shader_set_uniform_buffer(&map->tile_shader, "Global", &engine->shader_global_ubo);
 
 	// Make some map
 #define M(x, y, T, R, M) \
@@ -87,19 +80,14 @@ void hexmap_init(struct hexmap *map, struct engine *engine) {
 		.y = (3.f / 2.f) * map->tilesize,
 	};
 
-	load_hextile_models(map);
-
 	// Generate pathfinding data
 	hexmap_generate_edges(map);
 }
 
 void hexmap_destroy(struct hexmap *map) {
 	assert(map != NULL);
-	// TODO: Store this...
-	for (usize i = 0; i < count_of(map->models); ++i) {
-		model_destroy(&map->models[i]);
-	}
 	free(map->tiles);
+	free(map->edges);
 }
 
 vec2s hexmap_coord_to_world_position(struct hexmap *map, struct hexcoord coord) {
@@ -181,52 +169,6 @@ struct hextile *hexmap_tile_at(struct hexmap *map, struct hexcoord at) {
 	return &map->tiles[i];
 }
 
-void hexmap_draw(struct hexmap *map, struct camera *camera, vec3 player_pos) {
-	usize n_tiles = map->w * map->h;
-
-	// Highlight tile.
-	//usize index = map->highlight_tile_index;
-	//if (index < (usize)map->w * map->h) {
-	//	vec2s wp = hexmap_index_to_world_position(map, index);
-	//	{
-	//		mat4 model = GLM_MAT4_IDENTITY_INIT;
-	//		glm_translate(model, (vec3){ wp.x, 40.0f, wp.y });
-	//		glm_scale(model, (vec3){ 100.0f, 100.0f, 100.0f});
-	//		model_draw(&map->models[1], &map->tile_shader, camera, model);
-	//	}
-	//}
-	
-	shader_use(&map->tile_shader);
-	for (usize i = 0; i < n_tiles; ++i) {
-		vec2s pos = hexmap_index_to_world_position(map, i);
-		
-		// TODO: model matrices wont change often: lets cache them...
-		mat4 model = GLM_MAT4_IDENTITY_INIT;
-		//glm_translate(model, (vec3){ -map->tile_offsets.x * 3.f, 0.0f, map->tile_offsets.y * -2.0f });
-		glm_translate(model, (vec3){ pos.x, 0.0f, pos.y });
-		glm_rotate_y(model, map->tiles[i].rotation * glm_rad(60.0f), model);
-		glm_scale_uni(model, 1.733f);
-
-		mat4 modelView = GLM_MAT4_IDENTITY_INIT;
-		glm_mat4_mul(camera->view, model, modelView);
-		mat3 normalMatrix = GLM_MAT3_IDENTITY_INIT;
-		glm_mat4_pick3(modelView, normalMatrix);
-		glm_mat3_inv(normalMatrix, normalMatrix);
-		glm_mat3_transpose(normalMatrix);
-		// Set uniforms
-		shader_set_uniform_mat3(&map->tile_shader, "u_normalMatrix", (float*)normalMatrix);
-		shader_set_uniform_float(&map->tile_shader, "u_highlight", map->tiles[i].highlight);
-		shader_set_uniform_vec3(&map->tile_shader, "u_player_world_pos", player_pos);
-
-		usize model_index = map->tiles[i].tile;
-		model_draw(&map->models[model_index], &map->tile_shader, camera, model);
-		// Draw water for waterless coast tiles
-		if (model_index >= 2 && model_index <= 6) {
-			model_draw(&map->models[1], &map->tile_shader, camera, model);
-		}
-	}
-}
-
 void hexmap_set_tile_effect(struct hexmap *map, struct hexcoord coord, enum hexmap_tile_effect effect) {
 	assert(map != NULL);
 	assert(hexmap_is_valid_coord(map, coord) && "Invalid coord");
@@ -304,7 +246,7 @@ void hexmap_generate_flowfield(struct hexmap *map, struct hexcoord start_coord,
 		usize current_node_i = RINGBUFFER_CONSUME(frontier);
 		// Check all neighboring nodes.
 		usize edge_i = 0;
-		while (map->edges[current_node_i + edge_i * map_size] < map_size && edge_i < HEXMAP_MAX_EDGES) {
+		while (edge_i < HEXMAP_MAX_EDGES && map->edges[current_node_i + edge_i * map_size] < map_size) {
 			usize next_i = map->edges[current_node_i + edge_i * map_size];
 			++edge_i;
 			if (hexmap_is_tile_obstacle(map, hexmap_index_to_coord(map, next_i))) {
@@ -369,7 +311,7 @@ enum hexmap_path_result hexmap_path_find_ex(struct hexmap *map, struct hexcoord
 			}
 			// Check all neighboring nodes.
 			usize edge_i = 0;
-			while (map->edges[current_node_i + edge_i * map_size] < map_size && edge_i < HEXMAP_MAX_EDGES) {
+			while (edge_i < HEXMAP_MAX_EDGES && map->edges[current_node_i + edge_i * map_size] < map_size) {
 				usize next_i = map->edges[current_node_i + edge_i * map_size];
 				++edge_i;
 				// If goal is a neighbor of the current tile, we update
@@ -500,29 +442,3 @@ int hexmap_is_tile_obstacle(struct hexmap *map, struct hexcoord coord) {
 	return map->tiles[i].movement_cost >= HEXMAP_MOVEMENT_COST_MAX
 		|| map->tiles[i].occupied_by != 0;
 }
-
-////////////
-// STATIC //
-////////////
-
-static void load_hextile_models(struct hexmap *map) {
-	assert(map != NULL);
-	const char *models[] = {
-		"res/models/tiles/base/hex_grass.gltf",
-		"res/models/tiles/base/hex_water.gltf",
-		"res/models/tiles/coast/waterless/hex_coast_A_waterless.gltf",
-		"res/models/tiles/coast/waterless/hex_coast_B_waterless.gltf",
-		"res/models/tiles/coast/waterless/hex_coast_C_waterless.gltf",
-		"res/models/tiles/coast/waterless/hex_coast_D_waterless.gltf",
-		"res/models/tiles/coast/waterless/hex_coast_E_waterless.gltf",
-		"res/models/tiles/roads/hex_road_A.gltf",
-		"res/models/tiles/roads/hex_road_B.gltf",
-		"res/models/tiles/roads/hex_road_E.gltf",
-	};
-
-	for (uint i = 0; i < count_of(models); ++i) {
-		int err = model_init_from_file(&map->models[i], models[i]);
-		assert(err == 0);
-	}
-}
-
@@ -1,15 +1,11 @@
 #ifndef HEXMAP_H
 #define HEXMAP_H
 
-#include <flecs.h>
-#include <cglm/vec2.h>
-#include <cglm/vec3.h>
-#include "util/util.h"
-#include "gl/camera.h"
-#include "gl/model.h"
-#include "gl/shader.h"
+// Hex grid, coordinates and pathfinding.
+// No rendering in here (see hexmap_renderer.h), the server uses it too.
 
-struct engine;
+#include <cglm/types-struct.h>
+#include "util/base.h"
 
 #define HEXMAP_MAX_EDGES     6
 #define HEXMAP_MAX_NEIGHBORS 6
@@ -52,7 +48,7 @@ struct hextile {
 	i16 rotation;
 	u8 highlight;
 	u8 movement_cost;
-	ecs_entity_t occupied_by;
+	u32 occupied_by; // battle unit id, 0 if free
 };
 
 struct hexcoord {
@@ -69,10 +65,8 @@ struct hexmap {
 	struct hextile *tiles;
 	usize *edges;
 
-	// Rendering
-	shader_t tile_shader;
+	// precomputed distance between tile centers
 	vec2s tile_offsets;
-	model_t models[10];
 
 	// Special tiles
 	usize highlight_tile_index;
@@ -92,9 +86,8 @@ int hexmap_is_valid_coord(struct hexmap *, struct hexcoord);
 int hexmap_is_valid_index(struct hexmap *, usize index);
 
 //
-void hexmap_init(struct hexmap *, struct engine *);
+void hexmap_init(struct hexmap *);
 void hexmap_destroy(struct hexmap *);
-void hexmap_draw(struct hexmap *, struct camera *, vec3 player_pos);
 
 // coordinate systems
 vec2s           hexmap_index_to_world_position(struct hexmap *, usize index);
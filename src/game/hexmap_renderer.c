@@ -0,0 +1,77 @@
+#include "game/hexmap_renderer.h"
+
+#include <assert.h>
+#include <cglm/cglm.h>
+#include "engine.h"
+#include "util/util.h"
+
+static void load_hextile_models(struct hexmap_renderer *);
+
+void hexmap_renderer_init(struct hexmap_renderer *renderer, struct engine *engine) {
+	assert(renderer != NULL);
+	shader_init_from_dir(&renderer->tile_shader, "res/shader/model/hexmap_tile/");
+	shader_set_uniform_buffer(&renderer->tile_shader, "Global", &engine->shader_global_ubo);
+	load_hextile_models(renderer);
+}
+
+void hexmap_renderer_destroy(struct hexmap_renderer *renderer) {
+	assert(renderer != NULL);
+	for (usize i = 0; i < count_of(renderer->models); ++i) {
+		model_destroy(&renderer->models[i]);
+	}
+	shader_destroy(&renderer->tile_shader);
+}
+
+void hexmap_renderer_draw(struct hexmap_renderer *renderer, struct hexmap *map, struct camera *camera, vec3 player_pos) {
+	usize n_tiles = map->w * map->h;
+
+	shader_use(&renderer->tile_shader);
+	for (usize i = 0; i < n_tiles; ++i) {
+		vec2s pos = hexmap_index_to_world_position(map, i);
+		
+		// TODO: model matrices wont change often: lets cache them...
+		mat4 model = GLM_MAT4_IDENTITY_INIT;
+		glm_translate(model, (vec3){ pos.x, 0.0f, pos.y });
+		glm_rotate_y(model, map->tiles[i].rotation * glm_rad(60.0f), model);
+		glm_scale_uni(model, 1.733f);
+
+		mat4 modelView = GLM_MAT4_IDENTITY_INIT;
+		glm_mat4_mul(camera->view, model, modelView);
+		mat3 normalMatrix = GLM_MAT3_IDENTITY_INIT;
+		glm_mat4_pick3(modelView, normalMatrix);
+		glm_mat3_inv(normalMatrix, normalMatrix);
+		glm_mat3_transpose(normalMatrix);
+		// Set uniforms
+		shader_set_uniform_mat3(&renderer->tile_shader, "u_normalMatrix", (float*)normalMatrix);
+		shader_set_uniform_float(&renderer->tile_shader, "u_highlight", map->tiles[i].highlight);
+		shader_set_uniform_vec3(&renderer->tile_shader, "u_player_world_pos", player_pos);
+
+		usize model_index = map->tiles[i].tile;
+		model_draw(&renderer->models[model_index], &renderer->tile_shader, camera, model);
+		// Draw water for waterless coast tiles
+		if (model_index >= 2 && model_index <= 6) {
+			model_draw(&renderer->models[1], &renderer->tile_shader, camera, model);
+		}
+	}
+}
+
+static void load_hextile_models(struct hexmap_renderer *renderer) {
+	assert(renderer != NULL);
+	const char *models[] = {
+		"res/models/tiles/base/hex_grass.gltf",
+		"res/models/tiles/base/hex_water.gltf",
+		"res/models/tiles/coast/waterless/hex_coast_A_waterless.gltf",
+		"res/models/tiles/coast/waterless/hex_coast_B_waterless.gltf",
+		"res/models/tiles/coast/waterless/hex_coast_C_waterless.gltf",
+		"res/models/tiles/coast/waterless/hex_coast_D_waterless.gltf",
+		"res/models/tiles/coast/waterless/hex_coast_E_waterless.gltf",
+		"res/models/tiles/roads/hex_road_A.gltf",
+		"res/models/tiles/roads/hex_road_B.gltf",
+		"res/models/tiles/roads/hex_road_E.gltf",
+	};
+
+	for (uint i = 0; i < count_of(models); ++i) {
+		int err = model_init_from_file(&renderer->models[i], models[i]);
+		assert(err == 0);
+	}
+}
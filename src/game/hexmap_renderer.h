@@ -0,0 +1,21 @@
+#ifndef HEXMAP_RENDERER_H
+#define HEXMAP_RENDERER_H
+
+#include <cglm/vec3.h>
+#include "game/hexmap.h"
+#include "gl/camera.h"
+#include "gl/model.h"
+#include "gl/shader.h"
+
+struct engine;
+
+struct hexmap_renderer {
+	shader_t tile_shader;
+	model_t models[10];
+};
+
+void hexmap_renderer_init(struct hexmap_renderer *, struct engine *);
+void hexmap_renderer_destroy(struct hexmap_renderer *);
+void hexmap_renderer_draw(struct hexmap_renderer *, struct hexmap *, struct camera *, vec3 player_pos);
+
+#endif
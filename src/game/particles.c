@@ -0,0 +1,177 @@
+#include "particles.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cglm/cglm.h>
+#include "gl/graphics2d.h"
+
+//
+// private functions
+//
+
+static void particles_swap_remove(struct particle_pool *, int index);
+
+//
+// public api
+//
+
+void particles_init(struct particle_pool *pool, int capacity) {
+	assert(pool != NULL);
+	assert(capacity > 0);
+
+	pool->count = 0;
+	pool->capacity = capacity;
+
+	pool->x               = malloc(capacity * sizeof(*pool->x));
+	pool->y               = malloc(capacity * sizeof(*pool->y));
+	pool->prev_x          = malloc(capacity * sizeof(*pool->prev_x));
+	pool->prev_y          = malloc(capacity * sizeof(*pool->prev_y));
+	pool->vel_x           = malloc(capacity * sizeof(*pool->vel_x));
+	pool->vel_y           = malloc(capacity * sizeof(*pool->vel_y));
+	pool->angle           = malloc(capacity * sizeof(*pool->angle));
+	pool->rotation        = malloc(capacity * sizeof(*pool->rotation));
+	pool->scale           = malloc(capacity * sizeof(*pool->scale));
+	pool->scale_factor    = malloc(capacity * sizeof(*pool->scale_factor));
+	pool->lifetime        = malloc(capacity * sizeof(*pool->lifetime));
+	pool->texture_subrect = malloc(capacity * sizeof(*pool->texture_subrect));
+	pool->size            = malloc(capacity * sizeof(*pool->size));
+	pool->z               = malloc(capacity * sizeof(*pool->z));
+}
+
+void particles_destroy(struct particle_pool *pool) {
+	free(pool->x);
+	free(pool->y);
+	free(pool->prev_x);
+	free(pool->prev_y);
+	free(pool->vel_x);
+	free(pool->vel_y);
+	free(pool->angle);
+	free(pool->rotation);
+	free(pool->scale);
+	free(pool->scale_factor);
+	free(pool->lifetime);
+	free(pool->texture_subrect);
+	free(pool->size);
+	free(pool->z);
+	memset(pool, 0, sizeof(*pool));
+}
+
+void particles_clear(struct particle_pool *pool) {
+	pool->count = 0;
+}
+
+int particles_spawn(struct particle_pool *pool, const struct particle_desc *desc) {
+	assert(desc != NULL);
+	if (pool->count >= pool->capacity) {
+		return 0;
+	}
+
+	const int i = pool->count++;
+	pool->x[i]            = desc->position[0];
+	pool->y[i]            = desc->position[1];
+	pool->prev_x[i]       = desc->position[0];
+	pool->prev_y[i]       = desc->position[1];
+	pool->vel_x[i]        = desc->velocity[0];
+	pool->vel_y[i]        = desc->velocity[1];
+	pool->angle[i]        = desc->angle;
+	pool->rotation[i]     = desc->rotation;
+	pool->scale[i]        = desc->scale;
+	pool->scale_factor[i] = desc->scale_factor;
+	pool->lifetime[i]     = desc->lifetime;
+	memcpy(pool->texture_subrect[i], desc->texture_subrect, sizeof(vec4));
+	memcpy(pool->size[i], desc->size, sizeof(vec2));
+	pool->z[i]            = desc->z;
+
+	return 1;
+}
+
+void particles_update(struct particle_pool *pool, float dt) {
+	const int count = pool->count;
+	const float step = 60.0f * dt;
+
+	// where the last update left them, to interpolate from
+	memcpy(pool->prev_x, pool->x, count * sizeof(*pool->x));
+	memcpy(pool->prev_y, pool->y, count * sizeof(*pool->y));
+
+	// integrate, each loop only touches a few arrays and has no branches.
+	float *restrict x = pool->x, *restrict y = pool->y;
+	const float *restrict vel_x = pool->vel_x, *restrict vel_y = pool->vel_y;
+	for (int i = 0; i < count; ++i) {
+		x[i] += vel_x[i] * step;
+		y[i] += vel_y[i] * step;
+	}
+
+	float *restrict angle = pool->angle;
+	const float *restrict rotation = pool->rotation;
+	for (int i = 0; i < count; ++i) {
+		angle[i] += rotation[i] * step;
+	}
+
+	float *restrict scale = pool->scale;
+	const float *restrict scale_factor = pool->scale_factor;
+	for (int i = 0; i < count; ++i) {
+		scale[i] *= powf(scale_factor[i], step);
+	}
+
+	float *restrict lifetime = pool->lifetime;
+	for (int i = 0; i < count; ++i) {
+		lifetime[i] -= dt;
+	}
+
+	// despawn, back to front so swapped in particles were already checked.
+	for (int i = count - 1; i >= 0; --i) {
+		if (lifetime[i] <= 0.0f) {
+			particles_swap_remove(pool, i);
+		}
+	}
+}
+
+void particles_draw(struct particle_pool *pool, pipeline_t *pipeline, float alpha) {
+	// emit as many as fit into the pipeline
+	int count = pool->count;
+	const int commands_free = pipeline->commands_max - pipeline->commands_count;
+	if (count > commands_free) {
+		count = commands_free;
+	}
+
+	drawcmd_t cmd = DRAWCMD_INIT;
+	for (int i = 0; i < count; ++i) {
+		const float w = pool->size[i][0] * pool->scale[i];
+		const float h = pool->size[i][1] * pool->scale[i];
+
+		cmd.position.x = glm_lerp(pool->prev_x[i], pool->x[i], alpha) - w * 0.5f;
+		cmd.position.y = glm_lerp(pool->prev_y[i], pool->y[i], alpha) - h * 0.5f;
+		cmd.position.z = pool->z[i];
+		cmd.size.x = w;
+		cmd.size.y = h;
+		cmd.angle = pool->angle[i];
+		glm_vec4_copy(pool->texture_subrect[i], cmd.texture_subrect);
+		pipeline_emit(pipeline, &cmd);
+	}
+}
+
+//
+// private implementations
+//
+
+static void particles_swap_remove(struct particle_pool *pool, int index) {
+	assert(index >= 0 && index < pool->count);
+
+	const int last = --pool->count;
+	pool->x[index]            = pool->x[last];
+	pool->y[index]            = pool->y[last];
+	pool->prev_x[index]       = pool->prev_x[last];
+	pool->prev_y[index]       = pool->prev_y[last];
+	pool->vel_x[index]        = pool->vel_x[last];
+	pool->vel_y[index]        = pool->vel_y[last];
+	pool->angle[index]        = pool->angle[last];
+	pool->rotation[index]     = pool->rotation[last];
+	pool->scale[index]        = pool->scale[last];
+	pool->scale_factor[index] = pool->scale_factor[last];
+	pool->lifetime[index]     = pool->lifetime[last];
+	glm_vec4_copy(pool->texture_subrect[last], pool->texture_subrect[index]);
+	glm_vec2_copy(pool->size[last], pool->size[index]);
+	pool->z[index]            = pool->z[last];
+}
+
@@ -0,0 +1,61 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <cglm/cglm.h>
+#include "gl/graphics2d.h"
+
+//
+// A fixed-capacity pool of cosmetic 2d particles.
+// Particles are stored as structure-of-arrays, so integrating them is a
+// handful of tight loops the compiler can vectorize. Dead particles are
+// swap-removed, keeping the pool dense.
+//
+// Velocity & rotation are given per 1/60s, like in the rest of the 2d scenes.
+//
+
+struct particle_desc {
+	vec2 position;
+	vec2 velocity;
+	float angle;
+	float rotation;
+	float scale;
+	float scale_factor; // per 1/60s
+	float lifetime;     // seconds
+
+	// appearance
+	vec4 texture_subrect;
+	vec2 size;
+	float z;
+};
+
+struct particle_pool {
+	int count;
+	int capacity;
+
+	// simulation
+	float *x, *y;
+	float *prev_x, *prev_y; // before the last update
+	float *vel_x, *vel_y;
+	float *angle, *rotation;
+	float *scale, *scale_factor;
+	float *lifetime;
+
+	// appearance
+	vec4 *texture_subrect;
+	vec2 *size;
+	float *z;
+};
+
+void particles_init   (struct particle_pool *, int capacity);
+void particles_destroy(struct particle_pool *);
+void particles_clear  (struct particle_pool *);
+
+// returns 0 if the pool is full and the particle was dropped.
+int  particles_spawn  (struct particle_pool *, const struct particle_desc *);
+
+void particles_update (struct particle_pool *, float dt);
+// `alpha` interpolates positions between the last two updates, see scene_draw_fn.
+void particles_draw   (struct particle_pool *, pipeline_t *, float alpha);
+
+#endif
+
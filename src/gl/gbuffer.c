@@ -6,6 +6,8 @@
 #include "engine.h"
 #include "gl/shader.h"
 #include "gl/camera.h"
+#include "util/profiler.h"
+#include "gl/renderstats.h"
 
 static void init_gbuffer_texture(
 	struct gbuffer *gbuffer,
@@ -110,6 +112,8 @@ void gbuffer_clear(struct gbuffer gbuffer) {
 }
 
 void gbuffer_display(struct gbuffer gbuffer, struct camera *camera, struct engine *engine) {
+	profiler_scope_begin("gbuffer_display");
+	renderstats_pass_begin(RENDERSTATS_PASS_GBUFFER);
 	shader_use(&gbuffer.shader);
 	// gbuffer inputs
 	shader_set_uniform_int(&gbuffer.shader, "u_albedo", 0);
@@ -145,6 +149,8 @@ void gbuffer_display(struct gbuffer gbuffer, struct camera *camera, struct engin
 			0, 0, engine->window_highdpi_width, engine->window_highdpi_height,
 			GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	renderstats_pass_end();
+	profiler_scope_end();
 }
 
 ////////////
@@ -188,6 +194,7 @@ static void draw_fullscreen_triangle(struct gbuffer gbuffer, struct engine *engi
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), NULL);
 	glDrawArrays(GL_TRIANGLES, 0, 3);
+	renderstats_draw_call(1);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -6,11 +6,13 @@
 #include "gl/texture.h"
 #include "gl/vbuffer.h"
 #include "gl/shader.h"
+#include "gl/renderstats.h"
+#include "util/profiler.h"
 #include <SDL_opengles2.h>
 
 // calculate vertices for a draw command and write them into a buffer.
 // returns the number of bytes written.
-static unsigned int write_drawcmd_vertices(drawcmd_t *cmd, float *vertices) {
+unsigned int drawcmd_write_vertices(drawcmd_t *cmd, float *vertices) {
 	float px = cmd->position.x;
 	float py = cmd->position.y;
 	float pz = cmd->position.z;
@@ -62,6 +64,8 @@ static unsigned int write_drawcmd_vertices(drawcmd_t *cmd, float *vertices) {
 }
 
 static void draw_pipeline(pipeline_t *pl, mat4 u_projection, mat4 u_view) {
+	profiler_scope_begin("pipeline_draw");
+	renderstats_pass_begin(RENDERSTATS_PASS_SPRITES);
 	shader_use(pl->shader);
 
 	shader_set_uniform_mat4(pl->shader, "u_projection", (float *)u_projection);
@@ -72,14 +76,28 @@ static void draw_pipeline(pipeline_t *pl, mat4 u_projection, mat4 u_view) {
 
 	glBindBuffer(GL_ARRAY_BUFFER, pl->vertex_buffer);
 	
-	// setup vertex data
-	// TODO: upload buffer once (or mmap?) instead of many single subdata calls
-	const float sizeof_each_primitive = pl->components_per_vertex * pl->vertices_per_primitive * sizeof(GLfloat);
-	static float primitive_vertices[128];
-	for (int i = 0; i < pl->commands_count; ++i) {
-		unsigned int sizeof_primitive_vertices = write_drawcmd_vertices(&pl->cmd_buffer[i], primitive_vertices);
-		glBufferSubData(GL_ARRAY_BUFFER, i * sizeof_each_primitive, sizeof_primitive_vertices, primitive_vertices);
+	// setup vertex data, only if the commands changed since the last draw.
+	// pipelines which are emitted once (e.g. static tile maps) skip this entirely.
+	// all commands are written into one shared scratch buffer and uploaded at once.
+	if (pl->vertices_dirty && pl->commands_count > 0) {
+		static float *vertices = NULL;
+		static size_t vertices_capacity = 0;
+
+		const size_t floats_per_primitive = pl->components_per_vertex * pl->vertices_per_primitive;
+		const size_t floats_needed = floats_per_primitive * pl->commands_count;
+		if (floats_needed > vertices_capacity) {
+			vertices = realloc(vertices, floats_needed * sizeof(*vertices));
+			vertices_capacity = floats_needed;
+		}
+
+		unsigned int vertices_size = 0;
+		for (int i = 0; i < pl->commands_count; ++i) {
+			vertices_size += drawcmd_write_vertices(&pl->cmd_buffer[i], vertices + i * floats_per_primitive);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, vertices_size, vertices);
+		renderstats_upload(vertices_size);
 	}
+	pl->vertices_dirty = 0;
 
 	// setup attribs
 	glEnableVertexAttribArray(pl->attribs.a_pos);
@@ -97,6 +115,9 @@ static void draw_pipeline(pipeline_t *pl, mat4 u_projection, mat4 u_view) {
 
 	// draw
 	glDrawArrays(GL_TRIANGLES, 0, pl->vertices_per_primitive * pl->commands_count);
+	renderstats_draw_call(pl->commands_count * 2);
+	renderstats_pass_end();
+	profiler_scope_end();
 }
 
 
@@ -150,6 +171,7 @@ void pipeline_init(pipeline_t *pl, shader_t *shader, int commands_max) {
 	pl->z_sorting_enabled = 0;
 
 	// state
+	pl->vertices_dirty = 1;
 	pl->commands_count = 0;
 	pl->commands_max = commands_max;
 	pl->texture = NULL;
@@ -183,6 +205,7 @@ void pipeline_destroy(pipeline_t *pl) {
 
 void pipeline_reset(pipeline_t *pl) {
 	pl->commands_count = 0;
+	pl->vertices_dirty = 1;
 }
 
 void pipeline_emit(pipeline_t *pl, drawcmd_t *cmd) {
@@ -206,6 +229,7 @@ void pipeline_emit(pipeline_t *pl, drawcmd_t *cmd) {
 	// write into buffer
 	pl->cmd_buffer[insert_at] = *cmd;
 	++pl->commands_count;
+	pl->vertices_dirty = 1;
 }
 
 void pipeline_set_transform(pipeline_t *pl, mat4 model) {
@@ -31,6 +31,8 @@ typedef struct {
 void drawcmd_set_texture_subrect(drawcmd_t *, texture_t *, int x, int y, int width, int height);
 void drawcmd_set_texture_subrect_tile(drawcmd_t *, texture_t *, int tile_width, int tile_height, int tile_x, int tile_y);
 void drawcmd_flip_texture_subrect(drawcmd_t *, int flip_x, int flip_y);
+// writes the vertices of a single quad, returns the number of bytes written.
+unsigned int drawcmd_write_vertices(drawcmd_t *, float *vertices);
 
 typedef struct {
 	// config
@@ -40,6 +42,7 @@ typedef struct {
 
 	// state
 	unsigned int vertex_buffer;
+	int vertices_dirty; // cmd_buffer changed since the last upload
 	int commands_count;
 	int commands_max;
 	texture_t *texture;
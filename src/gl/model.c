@@ -8,6 +8,8 @@
 #include <cglm/mat4.h>
 #include "util/util.h"
 #include "util/str.h"
+#include "util/profiler.h"
+#include "gl/renderstats.h"
 #include "gl/camera.h"
 #include "gl/shader.h"
 
@@ -195,6 +197,8 @@ void model_update_animation(model_t *model, float time) {
 
 void model_draw(model_t *model, shader_t *shader, struct camera *camera, mat4 modelmatrix) {
 	assert(model != NULL);
+	profiler_scope_begin("model_draw");
+	renderstats_pass_begin(RENDERSTATS_PASS_MODELS);
 
 	glBindVertexArray(model->vao);
 	shader_use(shader);
@@ -217,6 +221,8 @@ void model_draw(model_t *model, shader_t *shader, struct camera *camera, mat4 mo
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	renderstats_pass_end();
+	profiler_scope_end();
 }
 
 
@@ -398,6 +404,7 @@ static void draw_node(model_t *model, shader_t *shader, cgltf_node *node, mat4 p
 			assert(primitive->indices != NULL && "only indexed drawing is supported, implement glDrawArrays!");
 			assert(primitive->indices->offset == 0 && "need to consider this offset");
 			glDrawElements(GL_TRIANGLES, primitive->indices->count, accessor_to_component_type(primitive->indices), (void*)primitive->indices->buffer_view->offset);
+			renderstats_draw_call(primitive->indices->count / 3);
 			// cleanup
 			for (cgltf_size attrib_index = 0; attrib_index < primitive->attributes_count; ++attrib_index) {
 				char *attrib_name = primitive->attributes[attrib_index].name;
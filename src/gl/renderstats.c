@@ -0,0 +1,348 @@
+#include "renderstats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <SDL.h>
+#include <nanovg.h>
+#include "gl/opengles3.h"
+#include "engine.h"
+
+// EXT_disjoint_timer_query, accepted by the core ES3 query functions
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+#define RENDERSTATS_FRAMES_IN_FLIGHT 4
+#define RENDERSTATS_QUERIES_MAX      64 // per frame
+#define RENDERSTATS_DEPTH_MAX        8
+
+//
+// private functions
+//
+
+static int  renderstats_is_wanted(void);
+static void renderstats_resolve(int slot);
+static struct renderstats_counters *renderstats_current(void);
+
+//
+// vars
+//
+
+struct renderstats_slot {
+	struct renderstats_frame stats;
+	GLuint queries[RENDERSTATS_QUERIES_MAX];
+	enum renderstats_pass queries_pass[RENDERSTATS_QUERIES_MAX];
+	int queries_count;
+	int is_disjoint;
+	int is_pending; // recorded, results not read yet
+};
+
+static struct {
+	int enabled; // the overlay
+	int has_timer_query;
+
+	struct renderstats_slot slots[RENDERSTATS_FRAMES_IN_FLIGHT];
+	unsigned int frame;
+	int is_recording;
+
+	enum renderstats_pass passes[RENDERSTATS_DEPTH_MAX];
+	int passes_len;
+	int query_active;
+
+	struct renderstats_frame resolved;
+	int has_resolved;
+
+	FILE *csv;
+} g_renderstats;
+
+//
+// public api
+//
+
+void renderstats_init(void) {
+	memset(&g_renderstats, 0, sizeof(g_renderstats));
+	g_renderstats.has_timer_query = SDL_GL_ExtensionSupported("GL_EXT_disjoint_timer_query");
+
+	if (g_renderstats.has_timer_query) {
+		for (int i = 0; i < RENDERSTATS_FRAMES_IN_FLIGHT; ++i) {
+			glGenQueries(RENDERSTATS_QUERIES_MAX, g_renderstats.slots[i].queries);
+		}
+	}
+}
+
+void renderstats_destroy(void) {
+	if (g_renderstats.has_timer_query) {
+		for (int i = 0; i < RENDERSTATS_FRAMES_IN_FLIGHT; ++i) {
+			glDeleteQueries(RENDERSTATS_QUERIES_MAX, g_renderstats.slots[i].queries);
+		}
+	}
+	if (g_renderstats.csv != NULL) {
+		fclose(g_renderstats.csv);
+	}
+	memset(&g_renderstats, 0, sizeof(g_renderstats));
+}
+
+void renderstats_set_enabled(int enabled) {
+	g_renderstats.enabled = enabled;
+}
+
+int renderstats_is_enabled(void) {
+	return g_renderstats.enabled;
+}
+
+int renderstats_set_csv(const char *filename) {
+	if (g_renderstats.csv != NULL) {
+		fclose(g_renderstats.csv);
+	}
+
+	g_renderstats.csv = fopen(filename, "w");
+	if (g_renderstats.csv == NULL) {
+		return 1;
+	}
+	fprintf(g_renderstats.csv, "frame,pass,draw_calls,triangles,state_changes,bytes_uploaded,gpu_ms\n");
+	return 0;
+}
+
+void renderstats_frame_begin(void) {
+	if (!renderstats_is_wanted()) {
+		return;
+	}
+
+	// the slot we are about to reuse was recorded a few frames ago, its queries should be done by now
+	const int slot_index = g_renderstats.frame % RENDERSTATS_FRAMES_IN_FLIGHT;
+	struct renderstats_slot *slot = &g_renderstats.slots[slot_index];
+	if (slot->is_pending) {
+		renderstats_resolve(slot_index);
+	}
+
+	memset(&slot->stats, 0, sizeof(slot->stats));
+	slot->stats.frame = g_renderstats.frame;
+	slot->queries_count = 0;
+	slot->is_disjoint = 0;
+	g_renderstats.passes_len = 0;
+	g_renderstats.query_active = 0;
+	g_renderstats.is_recording = 1;
+
+	// clears the disjoint flag
+	if (g_renderstats.has_timer_query) {
+		GLint disjoint;
+		glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+	}
+}
+
+void renderstats_frame_end(void) {
+	if (!renderstats_is_wanted() || !g_renderstats.is_recording) {
+		return;
+	}
+
+	while (g_renderstats.passes_len > 0) {
+		renderstats_pass_end();
+	}
+
+	struct renderstats_slot *slot = &g_renderstats.slots[g_renderstats.frame % RENDERSTATS_FRAMES_IN_FLIGHT];
+	if (g_renderstats.has_timer_query) {
+		// timings are garbage if the gpu was e.g. throttled
+		GLint disjoint = 0;
+		glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+		slot->is_disjoint = disjoint;
+	}
+	slot->is_pending = 1;
+
+	++g_renderstats.frame;
+	g_renderstats.is_recording = 0;
+}
+
+void renderstats_pass_begin(enum renderstats_pass pass) {
+	if (!renderstats_is_wanted() || !g_renderstats.is_recording) {
+		return;
+	}
+	assert(g_renderstats.passes_len < RENDERSTATS_DEPTH_MAX && "missing renderstats_pass_end()?");
+	if (g_renderstats.passes_len >= RENDERSTATS_DEPTH_MAX) {
+		return;
+	}
+
+	struct renderstats_slot *slot = &g_renderstats.slots[g_renderstats.frame % RENDERSTATS_FRAMES_IN_FLIGHT];
+	if (g_renderstats.passes_len == 0 && g_renderstats.has_timer_query && slot->queries_count < RENDERSTATS_QUERIES_MAX) {
+		slot->queries_pass[slot->queries_count] = pass;
+		glBeginQuery(GL_TIME_ELAPSED_EXT, slot->queries[slot->queries_count]);
+		g_renderstats.query_active = 1;
+	}
+
+	g_renderstats.passes[g_renderstats.passes_len++] = pass;
+}
+
+void renderstats_pass_end(void) {
+	if (!renderstats_is_wanted() || !g_renderstats.is_recording || g_renderstats.passes_len == 0) {
+		return;
+	}
+
+	--g_renderstats.passes_len;
+	if (g_renderstats.passes_len == 0 && g_renderstats.query_active) {
+		struct renderstats_slot *slot = &g_renderstats.slots[g_renderstats.frame % RENDERSTATS_FRAMES_IN_FLIGHT];
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+		++slot->queries_count;
+		g_renderstats.query_active = 0;
+	}
+}
+
+void renderstats_draw_call(int triangles) {
+	struct renderstats_counters *c = renderstats_current();
+	if (c != NULL) {
+		c->draw_calls += 1;
+		c->triangles += triangles;
+	}
+}
+
+void renderstats_state_change(void) {
+	struct renderstats_counters *c = renderstats_current();
+	if (c != NULL) {
+		c->state_changes += 1;
+	}
+}
+
+void renderstats_upload(size_t bytes) {
+	struct renderstats_counters *c = renderstats_current();
+	if (c != NULL) {
+		c->bytes_uploaded += bytes;
+	}
+}
+
+const struct renderstats_frame *renderstats_last_frame(void) {
+	return g_renderstats.has_resolved ? &g_renderstats.resolved : NULL;
+}
+
+const char *renderstats_pass_name(enum renderstats_pass pass) {
+	switch (pass) {
+	case RENDERSTATS_PASS_OTHER:      return "other";
+	case RENDERSTATS_PASS_BACKGROUND: return "background";
+	case RENDERSTATS_PASS_MODELS:     return "models";
+	case RENDERSTATS_PASS_SPRITES:    return "sprites";
+	case RENDERSTATS_PASS_GBUFFER:    return "gbuffer";
+	case RENDERSTATS_PASS_NANOVG:     return "nanovg";
+	case RENDERSTATS_PASS_MAX:        break;
+	}
+	return "?";
+}
+
+void renderstats_draw(struct engine *engine) {
+	const struct renderstats_frame *frame = renderstats_last_frame();
+	if (!g_renderstats.enabled || frame == NULL) {
+		return;
+	}
+
+	NVGcontext *vg = engine->vg;
+	const float pad = 6.0f;
+	const float line_h = 12.0f;
+	const float h = (RENDERSTATS_PASS_MAX + 2) * line_h + pad * 2.0f;
+	float y = engine->window_height - h;
+
+	nvgSave(vg);
+	nvgFontFaceId(vg, engine->font_monospace);
+	nvgFontBlur(vg, 0.0f);
+	nvgFontSize(vg, 10.0f);
+	nvgTextLetterSpacing(vg, 0.0f);
+	nvgTextAlign(vg, NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+
+	nvgBeginPath(vg);
+	nvgRect(vg, 0.0f, y, engine->window_width, h);
+	nvgFillColor(vg, nvgRGBAf(0.0f, 0.0f, 0.0f, 0.75f));
+	nvgFill(vg);
+
+	char line[128];
+	y += pad;
+	nvgFillColor(vg, nvgRGBf(1.0f, 1.0f, 0.0f));
+	snprintf(line, sizeof(line), "%-10s %6s %8s %6s %9s %8s", "pass", "draws", "tris", "state", "upload kb", "gpu ms");
+	nvgText(vg, pad, y, line, NULL);
+
+	nvgFillColor(vg, nvgRGBf(1.0f, 1.0f, 1.0f));
+	for (int i = 0; i <= RENDERSTATS_PASS_MAX; ++i) {
+		const int is_total = (i == RENDERSTATS_PASS_MAX);
+		const struct renderstats_counters *c = is_total ? &frame->total : &frame->passes[i];
+		const char *name = is_total ? "total" : renderstats_pass_name(i);
+
+		y += line_h;
+		if (c->gpu_ms >= 0.0f) {
+			snprintf(line, sizeof(line), "%-10s %6d %8d %6d %9.1f %8.3f", name, c->draw_calls, c->triangles, c->state_changes, c->bytes_uploaded / 1024.0, c->gpu_ms);
+		} else {
+			snprintf(line, sizeof(line), "%-10s %6d %8d %6d %9.1f %8s", name, c->draw_calls, c->triangles, c->state_changes, c->bytes_uploaded / 1024.0, "-");
+		}
+		nvgText(vg, pad, y, line, NULL);
+	}
+
+	nvgRestore(vg);
+}
+
+//
+// private implementations
+//
+
+// the overlay and the csv are independent, either needs the frames recorded.
+static int renderstats_is_wanted(void) {
+	return g_renderstats.enabled || g_renderstats.csv != NULL;
+}
+
+static struct renderstats_counters *renderstats_current(void) {
+	if (!renderstats_is_wanted() || !g_renderstats.is_recording) {
+		return NULL;
+	}
+
+	const enum renderstats_pass pass = (g_renderstats.passes_len > 0)
+		? g_renderstats.passes[g_renderstats.passes_len - 1]
+		: RENDERSTATS_PASS_OTHER;
+	return &g_renderstats.slots[g_renderstats.frame % RENDERSTATS_FRAMES_IN_FLIGHT].stats.passes[pass];
+}
+
+static void renderstats_resolve(int slot_index) {
+	struct renderstats_slot *slot = &g_renderstats.slots[slot_index];
+	struct renderstats_frame *stats = &slot->stats;
+
+	// gpu timings, only if all queries of the frame are done
+	int has_timings = g_renderstats.has_timer_query && !slot->is_disjoint;
+	for (int i = 0; has_timings && i < slot->queries_count; ++i) {
+		GLuint available = 0;
+		glGetQueryObjectuiv(slot->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		has_timings = (available != 0);
+	}
+
+	for (int p = 0; p < RENDERSTATS_PASS_MAX; ++p) {
+		stats->passes[p].gpu_ms = has_timings ? 0.0f : -1.0f;
+	}
+	for (int i = 0; has_timings && i < slot->queries_count; ++i) {
+		GLuint ns = 0;
+		glGetQueryObjectuiv(slot->queries[i], GL_QUERY_RESULT, &ns);
+		stats->passes[slot->queries_pass[i]].gpu_ms += ns / 1000000.0f;
+	}
+
+	// totals
+	memset(&stats->total, 0, sizeof(stats->total));
+	stats->total.gpu_ms = has_timings ? 0.0f : -1.0f;
+	for (int p = 0; p < RENDERSTATS_PASS_MAX; ++p) {
+		const struct renderstats_counters *c = &stats->passes[p];
+		stats->total.draw_calls     += c->draw_calls;
+		stats->total.triangles      += c->triangles;
+		stats->total.state_changes  += c->state_changes;
+		stats->total.bytes_uploaded += c->bytes_uploaded;
+		if (has_timings) {
+			stats->total.gpu_ms += c->gpu_ms;
+		}
+	}
+
+	if (g_renderstats.csv != NULL) {
+		for (int p = 0; p <= RENDERSTATS_PASS_MAX; ++p) {
+			const int is_total = (p == RENDERSTATS_PASS_MAX);
+			const struct renderstats_counters *c = is_total ? &stats->total : &stats->passes[p];
+			fprintf(g_renderstats.csv, "%u,%s,%d,%d,%d,%zu,%.4f\n", stats->frame,
+					is_total ? "total" : renderstats_pass_name(p),
+					c->draw_calls, c->triangles, c->state_changes, c->bytes_uploaded, c->gpu_ms);
+		}
+	}
+
+	g_renderstats.resolved = *stats;
+	g_renderstats.has_resolved = 1;
+	slot->is_pending = 0;
+}
+
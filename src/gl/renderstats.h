@@ -0,0 +1,70 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <stddef.h>
+
+//
+// Per pass render statistics: draw calls, triangles, state changes
+// (program & texture binds) and bytes uploaded to buffers.
+// If EXT_disjoint_timer_query is available, each pass is also timed on the
+// GPU. Query results are read a few frames later, so the latest frame with
+// timings lags behind the frame being recorded.
+//
+// Passes may be nested, counters go to the innermost pass and GPU time to
+// the outermost one (timer queries can't overlap).
+//
+
+struct engine;
+
+enum renderstats_pass {
+	RENDERSTATS_PASS_OTHER,
+	RENDERSTATS_PASS_BACKGROUND,
+	RENDERSTATS_PASS_MODELS,
+	RENDERSTATS_PASS_SPRITES,
+	RENDERSTATS_PASS_GBUFFER,
+	RENDERSTATS_PASS_NANOVG,
+	RENDERSTATS_PASS_MAX
+};
+
+struct renderstats_counters {
+	int draw_calls;
+	int triangles;
+	int state_changes;
+	size_t bytes_uploaded;
+	float gpu_ms; // negative if not available
+};
+
+struct renderstats_frame {
+	unsigned int frame;
+	struct renderstats_counters passes[RENDERSTATS_PASS_MAX];
+	struct renderstats_counters total;
+};
+
+// requires a current GL context
+void renderstats_init(void);
+void renderstats_destroy(void);
+
+// shows the overlay. frames are recorded while it is shown or a csv is written.
+void renderstats_set_enabled(int enabled);
+int  renderstats_is_enabled(void);
+// write one row per pass & frame, regardless of the overlay. 0 on success.
+int  renderstats_set_csv(const char *filename);
+
+void renderstats_frame_begin(void);
+void renderstats_frame_end(void);
+
+void renderstats_pass_begin(enum renderstats_pass);
+void renderstats_pass_end(void);
+
+void renderstats_draw_call(int triangles);
+void renderstats_state_change(void);
+void renderstats_upload(size_t bytes);
+
+// latest frame with resolved GPU timings, NULL if there is none yet.
+const struct renderstats_frame *renderstats_last_frame(void);
+const char *renderstats_pass_name(enum renderstats_pass);
+
+void renderstats_draw(struct engine *);
+
+#endif
+
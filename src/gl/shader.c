@@ -6,6 +6,7 @@
 #include <SDL.h>
 #include "gl/opengles3.h"
 #include "gl/texture.h"
+#include "gl/renderstats.h"
 #include "util/str.h"
 #include "util/fs.h"
 #include "util/util.h"
@@ -64,6 +65,7 @@ void shader_ubo_update(struct shader_ubo *ubo, usize data_len, const void *data)
 	assert(data_len == ubo->buffer_size);
 	glBindBuffer(GL_UNIFORM_BUFFER, ubo->buffer);
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, data_len, data);
+	renderstats_upload(data_len);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
@@ -122,6 +124,7 @@ void shader_reload_source(shader_t *shader) {
 
 // use
 void shader_use(shader_t *shader) {
+	renderstats_state_change();
 	glUseProgram(shader == NULL ? 0 : shader->program);
 }
 
@@ -149,6 +152,7 @@ void shader_set_uniform_texture(shader_t *shader, const char *uniform_name, GLen
 		glUniform1i(u_location, texture_unit - GL_TEXTURE0);
 	}
 
+	renderstats_state_change();
 	glActiveTexture(texture_unit);
 	glBindTexture(GL_TEXTURE_2D, texture->texture);
 	
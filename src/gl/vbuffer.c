@@ -2,6 +2,7 @@
 
 #include <stb_ds.h>
 #include <assert.h>
+#include "gl/renderstats.h"
 
 struct vbuffer_attrib_s {
 	GLint location;
@@ -62,6 +63,7 @@ void vbuffer_draw(struct vbuffer_s *vbo, size_t n_vertices) {
 	}
 
 	glDrawArrays(GL_TRIANGLES, 0, n_vertices);
+	renderstats_draw_call(n_vertices / 3);
 	// TODO: restore previously bound ARRAY_BUFFER, or dont even unset?
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
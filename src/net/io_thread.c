@@ -0,0 +1,198 @@
+#include "io_thread.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __EMSCRIPTEN__
+
+// no threads without SharedArrayBuffer, the websocket doesn't block anyway
+int  net_io_thread_start(struct net_io_thread *io, struct net_socket *socket) { return 1; }
+void net_io_thread_stop (struct net_io_thread *io) { }
+void net_io_thread_wake (struct net_io_thread *io) { }
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define NET_IO_READS_MAX  64 // per wakeup, so a flooding server can't hold back our frames
+#define NET_IO_BACKOFF_MS 10 // retry interval while the incoming queue is full
+
+static void *net_io_run(void *data);
+static void  net_io_free(struct net_io_thread *);
+static int   net_io_receive(struct net_io_thread *);
+static int   net_io_deliver(struct net_io_thread *);
+static int   net_io_send(struct net_io_thread *);
+
+int net_io_thread_start(struct net_io_thread *io, struct net_socket *socket) {
+	assert(io != NULL);
+	assert(socket != NULL && socket->is_open);
+	memset(io, 0, sizeof(*io));
+	io->socket = socket;
+
+	// wakes the poll, without blocking the main thread once it is full
+	if (pipe(io->wake_pipe) != 0) {
+		return 1;
+	}
+	fcntl(io->wake_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(io->wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+	spsc_init(&io->incoming, sizeof(struct net_io_incoming), NET_IO_QUEUE_ENTRIES);
+	spsc_init(&io->outgoing, sizeof(struct net_io_outgoing), NET_IO_QUEUE_ENTRIES);
+	net_stream_init(&io->rx, 4096);
+	net_stream_init(&io->tx, 4096);
+
+	if (pthread_create(&io->thread, NULL, net_io_run, io) != 0) {
+		net_io_free(io);
+		return 1;
+	}
+	return 0;
+}
+
+void net_io_thread_stop(struct net_io_thread *io) {
+	assert(io != NULL);
+	__atomic_store_n(&io->stop, 1, __ATOMIC_RELEASE);
+	net_io_thread_wake(io);
+	pthread_join(io->thread, NULL);
+	net_io_free(io);
+}
+
+void net_io_thread_wake(struct net_io_thread *io) {
+	const uint8_t byte = 0;
+	if (write(io->wake_pipe[1], &byte, 1) < 0) {
+		// full, the thread is about to wake up anyway
+	}
+}
+
+//
+// private implementations
+//
+
+static void *net_io_run(void *data) {
+	struct net_io_thread *io = data;
+	struct pollfd fds[2] = {
+		{ .fd = io->socket->fd },
+		{ .fd = io->wake_pipe[0], .events = POLLIN },
+	};
+
+	// the server hung up or errored. what it sent before is still delivered, then we fail.
+	int is_closed = 0;
+
+	while (!__atomic_load_n(&io->stop, __ATOMIC_ACQUIRE)) {
+		if (net_io_deliver(io) != 0 || (!is_closed && net_io_send(io) != 0)) {
+			break;
+		}
+
+		// while the main thread is behind, frames wait in the socket instead of piling up in `rx`.
+		// the socket is left out then, unless we send, a hang up would be reported on every poll.
+		const int is_backed_up = (spsc_write_begin(&io->incoming) == NULL);
+		if (is_closed && !is_backed_up) {
+			break; // everything delivered
+		}
+		const int is_sending = (!is_closed && io->tx.len > 0);
+		fds[0].fd = (is_closed || (is_backed_up && !is_sending)) ? -1 : io->socket->fd;
+		fds[0].events = (is_backed_up ? 0 : POLLIN) | (is_sending ? POLLOUT : 0);
+		if (poll(fds, 2, is_backed_up ? NET_IO_BACKOFF_MS : -1) < 0 && errno != EINTR) {
+			break;
+		}
+
+		if (fds[1].revents & POLLIN) {
+			uint8_t drain[64];
+			while (read(io->wake_pipe[0], drain, sizeof(drain)) > 0) {
+				// wakeups don't carry data
+			}
+		}
+		// hang ups and errors show up as failing reads. while backed up nothing is read,
+		// the socket is only polled when sending then, and can't be sent to anymore.
+		if (is_backed_up) {
+			is_closed |= (fds[0].revents & (POLLHUP | POLLERR)) != 0;
+		} else if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			is_closed |= (net_io_receive(io) != 0);
+		}
+	}
+
+	if (!__atomic_load_n(&io->stop, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n(&io->failed, 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static void net_io_free(struct net_io_thread *io) {
+	close(io->wake_pipe[0]);
+	close(io->wake_pipe[1]);
+	spsc_destroy(&io->incoming);
+	spsc_destroy(&io->outgoing);
+	net_stream_free(&io->rx);
+	net_stream_free(&io->tx);
+}
+
+static int net_io_receive(struct net_io_thread *io) {
+	for (int reads = 0; reads < NET_IO_READS_MAX; ++reads) {
+		size_t available = 0;
+		uint8_t *data = net_stream_write_begin(&io->rx, 512, &available);
+		if (data == NULL) {
+			return 1;
+		}
+		const ptrdiff_t data_len = net_socket_recv(io->socket, data, available);
+		if (data_len < 0) {
+			return 1;
+		}
+		if (data_len == 0) {
+			break;
+		}
+		net_stream_write_end(&io->rx, data_len);
+	}
+	return 0;
+}
+
+// frames and decodes into the incoming queue, as far as it has room. 1 on garbage.
+static int net_io_deliver(struct net_io_thread *io) {
+	struct net_io_incoming *in;
+	while ((in = spsc_write_begin(&io->incoming)) != NULL) {
+		int is_json = 0;
+		const int result = net_stream_next_frame(&io->rx, in->data, &in->len, &is_json);
+		if (result <= 0) {
+			return (result < 0);
+		}
+		// strings point into `in->data`, which stays put until the main thread is done
+		in->is_decoded = !is_json;
+		if (in->is_decoded) {
+			message_decode(in->data, in->len, &in->message);
+		}
+		spsc_write_end(&io->incoming);
+	}
+	return 0;
+}
+
+// everything queued so far goes out in as few writes as the socket allows.
+static int net_io_send(struct net_io_thread *io) {
+	struct net_io_outgoing *out;
+	while ((out = spsc_read_begin(&io->outgoing)) != NULL) {
+		size_t available = 0;
+		uint8_t *data = net_stream_write_begin(&io->tx, out->len, &available);
+		if (data == NULL) {
+			return 1; // the server stopped reading
+		}
+		memcpy(data, out->data, out->len);
+		net_stream_write_end(&io->tx, out->len);
+		spsc_read_end(&io->outgoing);
+	}
+
+	size_t len = 0;
+	const uint8_t *data;
+	while ((data = net_stream_read_begin(&io->tx, &len)) != NULL) {
+		const ptrdiff_t sent = net_socket_send(io->socket, data, len);
+		if (sent < 0) {
+			return 1;
+		}
+		net_stream_read_end(&io->tx, sent);
+		if ((size_t)sent < len) {
+			break;
+		}
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef NET_IO_THREAD_H
+#define NET_IO_THREAD_H
+
+//
+// Receives, frames and decodes on its own thread, native builds only.
+//
+// The thread takes over a connected socket. Decoded messages are handed to
+// the main thread through one queue, frames to send come back through another.
+// Neither side ever blocks on the other or on the socket:
+//
+//     net_io_thread_start(&io, &socket);
+//     while ((in = spsc_read_begin(&io.incoming)) != NULL) { handle(&in->message); spsc_read_end(&io.incoming); }
+//     out = spsc_write_begin(&io.outgoing); out->len = message_encode(msg, out->data, MESSAGE_FRAME_MAX); spsc_write_end(&io.outgoing);
+//     net_io_thread_wake(&io); // once per frame, after queueing
+//
+// Strings of an incoming message point into its entry and stay valid until
+// spsc_read_end(). Json frames are only framed, message_decode() keeps their
+// strings per thread, so they are decoded by the reader.
+//
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "net/message.h"
+#include "net/socket.h"
+#include "net/stream.h"
+#include "util/spsc.h"
+
+#define NET_IO_QUEUE_ENTRIES 256 // per direction
+
+struct net_io_incoming {
+	union message_any message; // decoded if `is_decoded`
+	int is_decoded;
+	size_t len;
+	uint8_t data[MESSAGE_FRAME_MAX];
+};
+
+struct net_io_outgoing {
+	size_t len;
+	uint8_t data[MESSAGE_FRAME_MAX];
+};
+
+struct net_io_thread {
+	struct net_socket *socket; // belongs to the thread while it runs
+	pthread_t thread;
+	int wake_pipe[2];
+	int stop;   // atomic, set by net_io_thread_stop()
+	int failed; // atomic, the connection is gone. the main thread disconnects
+
+	struct spsc_queue incoming; // struct net_io_incoming, to the main thread
+	struct spsc_queue outgoing; // struct net_io_outgoing, from the main thread
+	struct net_stream rx, tx;   // thread only
+};
+
+// returns 0 once the thread runs, 1 if it couldn't be started or on web builds.
+int  net_io_thread_start(struct net_io_thread *, struct net_socket *);
+// joins the thread and hands the socket back, unsent frames are lost.
+void net_io_thread_stop (struct net_io_thread *);
+// the main thread queued frames.
+void net_io_thread_wake (struct net_io_thread *);
+
+#endif
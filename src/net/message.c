@@ -1,63 +1,272 @@
-#define MESSAGE_IMPL
 #include "message.h"
-#undef MESSAGE_IMPL
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <cJSON.h>
+#include "util/arena.h"
+
+//
+// binary codec helpers
+//
+
+struct message_writer {
+	uint8_t *data;
+	size_t len;
+	size_t capacity;
+	int overflow;
+};
+
+struct message_reader {
+	const uint8_t *data;
+	size_t len;
+	size_t pos;
+	int error;
+};
+
+static void write_varint(struct message_writer *w, uint32_t value) {
+	do {
+		if (w->len >= w->capacity) {
+			w->overflow = 1;
+			return;
+		}
+		const uint8_t byte = value & 0x7f;
+		value >>= 7;
+		w->data[w->len++] = byte | (value ? 0x80 : 0);
+	} while (value);
+}
+
+static uint32_t read_varint(struct message_reader *r) {
+	uint32_t value = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (r->pos >= r->len) {
+			r->error = 1;
+			return 0;
+		}
+		const uint8_t byte = r->data[r->pos++];
+		value |= (uint32_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			return value;
+		}
+	}
+	r->error = 1; // longer than 5 bytes
+	return 0;
+}
+
+// zigzag, so small negative numbers stay small
+static void write_int(struct message_writer *w, int value) {
+	write_varint(w, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static int read_int(struct message_reader *r) {
+	const uint32_t value = read_varint(r);
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static void write_string(struct message_writer *w, const char *str) {
+	const size_t str_len = (str != NULL) ? strlen(str) : 0;
+	write_varint(w, str_len);
+	if (w->overflow || w->capacity - w->len < str_len + 1) {
+		w->overflow = 1;
+		return;
+	}
+	memcpy(&w->data[w->len], str, str_len);
+	w->data[w->len + str_len] = '\0';
+	w->len += str_len + 1;
+}
+
+// points into the frame, the encoder wrote the terminator.
+static const char *read_string(struct message_reader *r) {
+	const uint32_t str_len = read_varint(r);
+	if (r->error || r->len - r->pos < (size_t)str_len + 1 || r->data[r->pos + str_len] != '\0') {
+		r->error = 1;
+		return "";
+	}
+	const char *str = (const char *)&r->data[r->pos];
+	r->pos += str_len + 1;
+	return str;
+}
+
+static void write_int_array(struct message_writer *w, const int *values, int values_len, int values_max) {
+	assert(values_len >= 0 && values_len <= values_max);
+	write_varint(w, values_len);
+	for (int i = 0; i < values_len; ++i) {
+		write_int(w, values[i]);
+	}
+}
+
+static int read_int_array(struct message_reader *r, int *values, int values_max) {
+	const uint32_t values_len = read_varint(r);
+	if (values_len > (uint32_t)values_max) {
+		r->error = 1;
+		return 0;
+	}
+	for (uint32_t i = 0; i < values_len; ++i) {
+		values[i] = read_int(r);
+	}
+	return values_len;
+}
+
+static void write_bytes(struct message_writer *w, const uint8_t *bytes, int bytes_len, int bytes_max) {
+	assert(bytes_len >= 0 && bytes_len <= bytes_max);
+	write_varint(w, bytes_len);
+	if (w->overflow || w->capacity - w->len < (size_t)bytes_len) {
+		w->overflow = 1;
+		return;
+	}
+	memcpy(&w->data[w->len], bytes, bytes_len);
+	w->len += bytes_len;
+}
+
+static int read_bytes(struct message_reader *r, uint8_t *bytes, int bytes_max) {
+	const uint32_t bytes_len = read_varint(r);
+	if (r->error || bytes_len > (uint32_t)bytes_max || r->len - r->pos < bytes_len) {
+		r->error = 1;
+		return 0;
+	}
+	memcpy(bytes, &r->data[r->pos], bytes_len);
+	r->pos += bytes_len;
+	return bytes_len;
+}
+
+//
+// json codec helpers
+//
+
+static int json_get_int(cJSON *json, const char *name, struct message_header *msg) {
+	const cJSON *item = cJSON_GetObjectItem(json, name);
+	if (!cJSON_IsNumber(item)) {
+		msg->type = MSG_TYPE_UNKNOWN;
+		return 0;
+	}
+	return item->valueint;
+}
+
+// copied, the tree is usually deleted before the message is handled.
+static const char *json_get_string(cJSON *json, const char *name, struct arena *strings, struct message_header *msg) {
+	const cJSON *item = cJSON_GetObjectItem(json, name);
+	if (!cJSON_IsString(item)) {
+		msg->type = MSG_TYPE_UNKNOWN;
+		return "";
+	}
+	const char *copy = arena_strndup(strings, item->valuestring, strlen(item->valuestring));
+	if (copy == NULL) {
+		msg->type = MSG_TYPE_UNKNOWN;
+		return "";
+	}
+	return copy;
+}
+
+static int json_get_int_array(cJSON *json, const char *name, int *values, int values_max, struct message_header *msg) {
+	const cJSON *array = cJSON_GetObjectItem(json, name);
+	const int values_len = cJSON_GetArraySize(array);
+	if (!cJSON_IsArray(array) || values_len > values_max) {
+		msg->type = MSG_TYPE_UNKNOWN;
+		return 0;
+	}
+	for (int i = 0; i < values_len; ++i) {
+		const cJSON *value = cJSON_GetArrayItem(array, i);
+		values[i] = cJSON_IsNumber(value) ? value->valueint : 0;
+	}
+	return values_len;
+}
+
+static cJSON *json_create_bytes(const uint8_t *bytes, int bytes_len) {
+	cJSON *array = cJSON_CreateArray();
+	for (int i = 0; i < bytes_len; ++i) {
+		cJSON_AddItemToArray(array, cJSON_CreateNumber(bytes[i]));
+	}
+	return array;
+}
+
+static int json_get_bytes(cJSON *json, const char *name, uint8_t *bytes, int bytes_max, struct message_header *msg) {
+	const cJSON *array = cJSON_GetObjectItem(json, name);
+	const int bytes_len = cJSON_GetArraySize(array);
+	if (!cJSON_IsArray(array) || bytes_len > bytes_max) {
+		msg->type = MSG_TYPE_UNKNOWN;
+		return 0;
+	}
+	for (int i = 0; i < bytes_len; ++i) {
+		const cJSON *value = cJSON_GetArrayItem(array, i);
+		bytes[i] = cJSON_IsNumber(value) ? (uint8_t)value->valueint : 0;
+	}
+	return bytes_len;
+}
+
+//
+// generated codecs
+//
+
+#define PACK_INT(_field)             cJSON_AddNumberToObject(json, #_field, msg->_field);
+#define PACK_STRING(_field)          cJSON_AddStringToObject(json, #_field, msg->_field != NULL ? msg->_field : "");
+#define PACK_INT_ARRAY(_field, _max) cJSON_AddItemToObject(json, #_field, cJSON_CreateIntArray(msg->_field, msg->_field##_len));
+#define PACK_BYTES(_field, _max)     cJSON_AddItemToObject(json, #_field, json_create_bytes(msg->_field, msg->_field##_len));
+
+#define UNPACK_INT(_field)             msg->_field = json_get_int(json, #_field, &msg->header);
+#define UNPACK_STRING(_field)          msg->_field = json_get_string(json, #_field, strings, &msg->header);
+#define UNPACK_INT_ARRAY(_field, _max) msg->_field##_len = json_get_int_array(json, #_field, msg->_field, _max, &msg->header);
+#define UNPACK_BYTES(_field, _max)     msg->_field##_len = json_get_bytes(json, #_field, msg->_field, _max, &msg->header);
+
+#define ENCODE_INT(_field)             write_int(w, msg->_field);
+#define ENCODE_STRING(_field)          write_string(w, msg->_field);
+#define ENCODE_INT_ARRAY(_field, _max) write_int_array(w, msg->_field, msg->_field##_len, _max);
+#define ENCODE_BYTES(_field, _max)     write_bytes(w, msg->_field, msg->_field##_len, _max);
+
+#define DECODE_INT(_field)             msg->_field = read_int(r);
+#define DECODE_STRING(_field)          msg->_field = read_string(r);
+#define DECODE_INT_ARRAY(_field, _max) msg->_field##_len = read_int_array(r, msg->_field, _max);
+#define DECODE_BYTES(_field, _max)     msg->_field##_len = read_bytes(r, msg->_field, _max);
+
+#define MESSAGE_CODECS(_type, _name)                                                           \
+	void pack_##_name(const struct _name *msg, cJSON *json) {                                  \
+		assert(msg->header.type == _type);                                                     \
+		pack_message_header(&msg->header, json);                                               \
+		_type##_FIELDS(PACK_INT, PACK_STRING, PACK_INT_ARRAY, PACK_BYTES)                      \
+	}                                                                                          \
+	void unpack_##_name(cJSON *json, struct _name *msg, struct arena *strings) {               \
+		(void)strings; /* messages without strings */                                          \
+		unpack_message_header(json, &msg->header);                                             \
+		assert(msg->header.type == _type);                                                     \
+		_type##_FIELDS(UNPACK_INT, UNPACK_STRING, UNPACK_INT_ARRAY, UNPACK_BYTES)              \
+	}                                                                                          \
+	static void encode_##_name(const struct _name *msg, struct message_writer *w) {            \
+		(void)msg; (void)w; /* messages without fields */                                      \
+		_type##_FIELDS(ENCODE_INT, ENCODE_STRING, ENCODE_INT_ARRAY, ENCODE_BYTES)              \
+	}                                                                                          \
+	static void decode_##_name(struct message_reader *r, struct _name *msg) {                  \
+		(void)msg; (void)r;                                                                    \
+		_type##_FIELDS(DECODE_INT, DECODE_STRING, DECODE_INT_ARRAY, DECODE_BYTES)              \
+	}
+
+MESSAGES(MESSAGE_CODECS)
+
+#define MESSAGE_FUNCTION_INFO(_type, _name)                    \
+	[_type] = {                                                \
+		.name        = #_type,                                 \
+		.pack_fn     = (message_pack_fn)pack_##_name,          \
+		.unpack_fn   = (message_unpack_fn)unpack_##_name,      \
+		.encode_fn   = (message_encode_fn)encode_##_name,      \
+		.decode_fn   = (message_decode_fn)decode_##_name,      \
+		.struct_size = sizeof(struct _name),                   \
+	},
 
 const message_function_info_t message_function_infos[MSG_TYPE_MAX] = {
-	[MSG_TYPE_UNKNOWN] = (message_function_info_t){
+	[MSG_TYPE_UNKNOWN] = {
 		.name="MSG_TYPE_UNKNOWN",
-		.pack_fn=NULL,
-		.unpack_fn=NULL,
-		.struct_size=0,
-	},
-	[WELCOME_RESPONSE] = (message_function_info_t){
-		.name        = "WELCOME_RESPONSE",
-		.pack_fn     = (message_pack_fn)pack_welcome_response,
-		.unpack_fn   = (message_unpack_fn)unpack_welcome_response,
-		.struct_size = sizeof(struct welcome_response),
-	},
-	[LOBBY_CREATE_REQUEST] = (message_function_info_t){
-		.name        = "LOBBY_CREATE_REQUEST",
-		.pack_fn     = (message_pack_fn)pack_lobby_create_request,
-		.unpack_fn   = (message_unpack_fn)unpack_lobby_create_request,
-		.struct_size = sizeof(struct lobby_create_request),
-	},
-	[LOBBY_CREATE_RESPONSE] = (message_function_info_t){
-		.name        = "LOBBY_CREATE_RESPONSE",
-		.pack_fn     = (message_pack_fn)pack_lobby_create_response,
-		.unpack_fn   = (message_unpack_fn)unpack_lobby_create_response,
-		.struct_size = sizeof(struct lobby_create_response),
-	},
-	[LOBBY_JOIN_REQUEST] = (message_function_info_t){
-		.name        = "LOBBY_JOIN_REQUEST",
-		.pack_fn     = (message_pack_fn)pack_lobby_join_request,
-		.unpack_fn   = (message_unpack_fn)unpack_lobby_join_request,
-		.struct_size = sizeof(struct lobby_join_request),
-	},
-	[LOBBY_JOIN_RESPONSE] = (message_function_info_t){
-		.name        = "LOBBY_JOIN_RESPONSE",
-		.pack_fn     = (message_pack_fn)pack_lobby_join_response,
-		.unpack_fn   = (message_unpack_fn)unpack_lobby_join_response,
-		.struct_size = sizeof(struct lobby_join_response),
 	},
-	[LOBBY_LIST_REQUEST] = (message_function_info_t){
-		.name        = "LOBBY_LIST_REQUEST",
-		.pack_fn     = (message_pack_fn)pack_lobby_list_request,
-		.unpack_fn   = (message_unpack_fn)unpack_lobby_list_request,
-		.struct_size = sizeof(struct lobby_list_request),
-	},
-	[LOBBY_LIST_RESPONSE] = (message_function_info_t){
-		.name        = "LOBBY_LIST_RESPONSE",
-		.pack_fn     = (message_pack_fn)pack_lobby_list_response,
-		.unpack_fn   = (message_unpack_fn)unpack_lobby_list_response,
-		.struct_size = sizeof(struct lobby_list_response),
+	MESSAGES(MESSAGE_FUNCTION_INFO)
+	[MSG_DISCONNECTED] = {
+		.name="MSG_DISCONNECTED",
 	},
 };
 
+//
+// api
+//
+
+static enum message_encoding g_encoding = MESSAGE_ENCODING_BINARY;
+
 // Message Header
 const char *message_type_to_name(enum message_type type) {
 	return message_function_infos[type].name;
@@ -67,7 +276,116 @@ void message_header_init(struct message_header *msg, int16_t type) {
 	msg->type = type;
 }
 
-void pack_message_header(struct message_header *msg, cJSON *json) {
+void message_set_encoding(enum message_encoding encoding) {
+	g_encoding = encoding;
+}
+
+enum message_encoding message_get_encoding(void) {
+	return g_encoding;
+}
+
+size_t message_encode(const struct message_header *msg, uint8_t *out, size_t out_capacity) {
+	assert(msg != NULL);
+	assert(msg->type > MSG_TYPE_UNKNOWN && msg->type < MSG_TYPE_MAX);
+	const message_function_info_t *info = &message_function_infos[msg->type];
+	assert(info->encode_fn != NULL);
+
+	// the payload is written behind the largest possible length prefix and moved afterwards
+	const size_t prefix_max = 2; // varint of MESSAGE_FRAME_MAX
+	if (out_capacity <= prefix_max) {
+		return 0;
+	}
+	struct message_writer payload = { .data = out + prefix_max, .capacity = out_capacity - prefix_max };
+	if (out_capacity > MESSAGE_FRAME_MAX) {
+		payload.capacity = MESSAGE_FRAME_MAX - prefix_max;
+	}
+
+	switch (g_encoding) {
+	case MESSAGE_ENCODING_BINARY:
+		write_varint(&payload, msg->type);
+		info->encode_fn(msg, &payload);
+		break;
+	case MESSAGE_ENCODING_JSON: {
+		cJSON *json = pack_message(msg);
+		payload.overflow = !cJSON_PrintPreallocated(json, (char *)payload.data, payload.capacity, 0);
+		payload.len = payload.overflow ? 0 : strlen((char *)payload.data);
+		cJSON_Delete(json);
+		break;
+	}
+	}
+	if (payload.overflow) {
+		return 0;
+	}
+
+	struct message_writer prefix = { .data = out, .capacity = prefix_max };
+	write_varint(&prefix, payload.len);
+	memmove(out + prefix.len, payload.data, payload.len);
+	return prefix.len + payload.len;
+}
+
+ptrdiff_t message_decode(const uint8_t *data, size_t data_len, union message_any *out) {
+	// strings of json payloads are copied out of the parsed tree, and kept until the next call.
+	// they can't be longer than the payload. per thread, the gameserver decodes on several.
+	static __thread uint8_t json_strings_buffer[MESSAGE_FRAME_MAX] __attribute__((aligned(ARENA_ALIGN)));
+	static __thread struct arena json_strings;
+	arena_init_buffer(&json_strings, json_strings_buffer, sizeof(json_strings_buffer));
+
+	// frame
+	int is_json = 0;
+	const ptrdiff_t frame_len = message_frame_len(data, data_len, &is_json);
+	if (frame_len <= 0) {
+		return frame_len;
+	}
+	struct message_reader frame = { .data = data, .len = frame_len };
+	const uint32_t payload_len = read_varint(&frame);
+
+	out->header.type = MSG_TYPE_UNKNOWN;
+	if (payload_len == 0) {
+		return frame_len;
+	}
+
+	const uint8_t *payload = &data[frame.pos];
+	if (is_json) {
+		cJSON *json = cJSON_ParseWithLength((const char *)payload, payload_len);
+		struct message_header header;
+		unpack_message_header(json, &header);
+		if (header.type > MSG_TYPE_UNKNOWN && header.type < MSG_TYPE_MAX && message_function_infos[header.type].unpack_fn != NULL) {
+			message_function_infos[header.type].unpack_fn(json, &out->header, &json_strings);
+		}
+		cJSON_Delete(json);
+		return frame_len;
+	}
+
+	struct message_reader r = { .data = payload, .len = payload_len };
+	const uint32_t type = read_varint(&r);
+	if (r.error || type >= MSG_TYPE_MAX || message_function_infos[type].decode_fn == NULL) {
+		return frame_len;
+	}
+	out->header.type = type;
+	message_function_infos[type].decode_fn(&r, &out->header);
+	if (r.error || r.pos != r.len) {
+		out->header.type = MSG_TYPE_UNKNOWN;
+	}
+	return frame_len;
+}
+
+ptrdiff_t message_frame_len(const uint8_t *data, size_t data_len, int *is_json) {
+	struct message_reader frame = { .data = data, .len = data_len };
+	const uint32_t payload_len = read_varint(&frame);
+	if (frame.error) {
+		return (data_len < 5) ? 0 : -1;
+	}
+	if (payload_len + frame.pos > MESSAGE_FRAME_MAX) {
+		return -1;
+	}
+	if (data_len - frame.pos < payload_len) {
+		return 0;
+	}
+	*is_json = (payload_len > 0 && data[frame.pos] == '{');
+	return frame.pos + payload_len;
+}
+
+void pack_message_header(const struct message_header *msg, cJSON *json) {
 	cJSON *header = cJSON_AddObjectToObject(json, "header");
 	cJSON_AddNumberToObject(header, "type", msg->type);
 }
@@ -86,9 +404,12 @@ void unpack_message_header(cJSON *json, struct message_header *msg) {
 	}
 
 	msg->type = header_type->valueint;
+	if (msg->type >= MSG_TYPE_MAX) {
+		msg->type = MSG_TYPE_UNKNOWN;
+	}
 }
 
-cJSON *pack_message(struct message_header *msg) {
+cJSON *pack_message(const struct message_header *msg) {
 	assert(msg != NULL);
 	assert(msg->type < MSG_TYPE_MAX);
 	if (msg->type == MSG_TYPE_UNKNOWN) {
@@ -104,7 +425,7 @@ cJSON *pack_message(struct message_header *msg) {
 	return json;
 }
 
-struct message_header *unpack_message(cJSON *json) {
+struct message_header *unpack_message(cJSON *json, struct arena *arena) {
 	if (json == NULL) {
 		return NULL;
 	}
@@ -118,148 +439,20 @@ struct message_header *unpack_message(cJSON *json) {
 	const message_function_info_t *info = &message_function_infos[header.type];
 	const message_unpack_fn unpack_fn = info->unpack_fn;
 	const size_t struct_size = info->struct_size;
-	assert(unpack_fn != NULL);
+	if (unpack_fn == NULL) {
+		return NULL;
+	}
 	assert(struct_size > 0);
 
-	struct message_header *msg = malloc(struct_size);
-	unpack_fn(json, msg);
-	assert(msg->type != MSG_TYPE_UNKNOWN);
-	return msg;
-}
-
-void free_message(cJSON *json, struct message_header *msg) {
-	free(msg);
-	cJSON_Delete(json);
-}
-
-// WELCOME_RESPONSE
-void pack_welcome_response(struct welcome_response *msg, cJSON *json) {
-	assert(msg->header.type == WELCOME_RESPONSE);
-	pack_message_header(&msg->header, json);
-
-	cJSON_AddNumberToObject(json, "_dummy", msg->_dummy);
-}
-
-void unpack_welcome_response(cJSON *json, struct welcome_response *msg) {
-	unpack_message_header(json, &msg->header);
-	assert(msg->header.type == WELCOME_RESPONSE);
-
-	msg->_dummy = cJSON_GetObjectItem(json, "_dummy")->valueint;
-}
-
-// LOBBY_CREATE_REQUEST
-void pack_lobby_create_request(struct lobby_create_request *msg, cJSON *json) {
-	assert(msg->header.type == LOBBY_CREATE_REQUEST);
-	pack_message_header(&msg->header, json);
-
-	cJSON_AddNumberToObject(json, "lobby_id", msg->lobby_id);
-	cJSON_AddStringToObject(json, "lobby_name", msg->lobby_name);
-}
-
-void unpack_lobby_create_request(cJSON *json, struct lobby_create_request *msg) {
-	unpack_message_header(json, &msg->header);
-	assert(msg->header.type == LOBBY_CREATE_REQUEST);
-
-	msg->lobby_id = cJSON_GetObjectItem(json, "lobby_id")->valueint;
-	msg->lobby_name = cJSON_GetObjectItem(json, "lobby_name")->valuestring;
-}
-
-
-// LOBBY_CREATE_RESPONSE
-void pack_lobby_create_response(struct lobby_create_response *msg, cJSON *json) {
-	assert(msg->header.type == LOBBY_CREATE_RESPONSE);
-	pack_message_header(&msg->header, json);
-
-	cJSON_AddNumberToObject(json, "lobby_id", msg->lobby_id);
-	cJSON_AddNumberToObject(json, "create_error", msg->create_error);
-}
-
-void unpack_lobby_create_response(cJSON *json, struct lobby_create_response *msg) {
-	unpack_message_header(json, &msg->header);
-	assert(msg->header.type == LOBBY_CREATE_RESPONSE);
-	
-	msg->lobby_id = cJSON_GetObjectItem(json, "lobby_id")->valueint;
-	msg->create_error = cJSON_GetObjectItem(json, "create_error")->valueint;
-}
-
-
-// LOBBY_JOIN_REQUEST
-void pack_lobby_join_request(struct lobby_join_request *msg, cJSON *json) {
-	assert(msg->header.type == LOBBY_JOIN_REQUEST);
-	pack_message_header(&msg->header, json);
-
-	cJSON_AddNumberToObject(json, "lobby_id", msg->lobby_id);
-}
-
-void unpack_lobby_join_request(cJSON *json, struct lobby_join_request *msg) {
-	unpack_message_header(json, &msg->header);
-	assert(msg->header.type == LOBBY_JOIN_REQUEST);
-
-	msg->lobby_id = cJSON_GetObjectItem(json, "lobby_id")->valueint;
-}
-
-
-// LOBBY_JOIN_RESPONSE
-void pack_lobby_join_response(struct lobby_join_response *msg, cJSON *json) {
-	assert(msg->header.type == LOBBY_JOIN_RESPONSE);
-	pack_message_header(&msg->header, json);
-
-	cJSON_AddNumberToObject(json, "lobby_id", msg->lobby_id);
-	cJSON_AddNumberToObject(json, "join_error", msg->join_error);
-	cJSON_AddNumberToObject(json, "is_other_user", msg->is_other_user);
-}
-
-void unpack_lobby_join_response(cJSON *json, struct lobby_join_response *msg) {
-	unpack_message_header(json, &msg->header);
-	assert(msg->header.type == LOBBY_JOIN_RESPONSE);
-
-	msg->lobby_id = cJSON_GetObjectItem(json, "lobby_id")->valueint;
-	msg->join_error = cJSON_GetObjectItem(json, "join_error")->valueint;
-	msg->is_other_user = cJSON_GetObjectItem(json, "is_other_user")->valueint;
-}
-
-// LOBBY_LIST_REQUEST
-void pack_lobby_list_request(struct lobby_list_request *msg, cJSON *json) {
-	assert(msg->header.type == LOBBY_LIST_REQUEST);
-	pack_message_header(&msg->header, json);
-
-	// no fields to store
-}
-
-void unpack_lobby_list_request(cJSON *json, struct lobby_list_request *msg) {
-	unpack_message_header(json, &msg->header);
-	assert(msg->header.type == LOBBY_LIST_REQUEST);
-	
-	// no fields to retrieve
-}
-
-// LOBBY_LIST_RESPONSE
-void pack_lobby_list_response(struct lobby_list_response *msg, cJSON *json) {
-	assert(msg->header.type == LOBBY_LIST_RESPONSE);
-	pack_message_header(&msg->header, json);
-	assert(msg->ids_of_lobbies_len <= 8); // TODO: fix this.
-
-	cJSON *ids = cJSON_CreateIntArray(msg->ids_of_lobbies, msg->ids_of_lobbies_len);
-	cJSON_AddItemToObject(json, "ids_of_lobbies", ids);
-}
-
-void unpack_lobby_list_response(cJSON *json, struct lobby_list_response *msg) {
-	unpack_message_header(json, &msg->header);
-	assert(msg->header.type == LOBBY_LIST_RESPONSE);
-	
-	cJSON *ids = cJSON_GetObjectItem(json, "ids_of_lobbies");
-	if (ids == NULL || !cJSON_IsArray(ids)) {
-		msg->header.type = MSG_TYPE_UNKNOWN;
-		return;
+	// a failed message keeps its memory until the reset, like every other
+	struct message_header *msg = arena_alloc(arena, struct_size);
+	if (msg == NULL) {
+		return NULL;
 	}
-
-	msg->ids_of_lobbies_len = cJSON_GetArraySize(ids);
-	assert(msg->ids_of_lobbies_len <= 8); // TODO: fix this.
-	for (int i = 0; i < msg->ids_of_lobbies_len; ++i) {
-		cJSON *id = cJSON_GetArrayItem(ids, i);
-		assert(id != NULL);
-		assert(cJSON_IsNumber(id));
-		msg->ids_of_lobbies[i] = id->valueint;
+	unpack_fn(json, msg, arena);
+	if (msg->type == MSG_TYPE_UNKNOWN) {
+		return NULL;
 	}
+	return msg;
 }
 
@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <cJSON.h>
 
+struct arena;
+
 enum message_type {
 	MSG_TYPE_UNKNOWN = 0,
 	// connection management
@@ -13,6 +15,8 @@ enum message_type {
 	LOBBY_CREATE_REQUEST, LOBBY_CREATE_RESPONSE,
 	LOBBY_JOIN_REQUEST,   LOBBY_JOIN_RESPONSE,
 	LOBBY_LIST_REQUEST,   LOBBY_LIST_RESPONSE,
+	// battle state sync
+	BATTLE_SNAPSHOT, BATTLE_SNAPSHOT_ACK,
 	// system messages
 	MSG_DISCONNECTED,
 	//
@@ -23,8 +27,115 @@ struct message_header {
 	enum message_type type;
 };
 
-typedef void (*message_pack_fn)(struct message_header *, cJSON *);
-typedef void (*message_unpack_fn)(cJSON *, struct message_header *);
+//
+// Message schemas. Every message is declared once as a list of its fields:
+//
+//     INT(name)            -> int name;
+//     STRING(name)         -> const char *name;
+//     INT_ARRAY(name, max) -> int name_len; int name[max];
+//     BYTES(name, max)     -> int name_len; uint8_t name[max];
+//
+// The structs, the binary codec and the json codec are generated from these.
+// New messages are appended to `enum message_type` and MESSAGES().
+//
+
+#define WELCOME_RESPONSE_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT(_dummy)
+
+#define LOBBY_CREATE_REQUEST_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT(lobby_id) STRING(lobby_name)
+
+#define LOBBY_CREATE_RESPONSE_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT(lobby_id) INT(create_error)
+
+#define LOBBY_JOIN_REQUEST_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT(lobby_id)
+
+#define LOBBY_JOIN_RESPONSE_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT(lobby_id) INT(join_error) INT(is_other_user)
+
+#define LOBBY_LIST_REQUEST_FIELDS(INT, STRING, INT_ARRAY, BYTES)
+
+#define LOBBY_LIST_RESPONSE_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT_ARRAY(ids_of_lobbies, 8)
+
+// `delta` is a bit-packed battle_snapshot, relative to the snapshot `baseline`
+// (0 for none). see game/battle_snapshot.h
+#define BATTLE_SNAPSHOT_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT(sequence) INT(baseline) BYTES(delta, 512)
+
+#define BATTLE_SNAPSHOT_ACK_FIELDS(INT, STRING, INT_ARRAY, BYTES) \
+	INT(sequence)
+
+#define MESSAGES(X)                                      \
+	X(WELCOME_RESPONSE,      welcome_response)      \
+	X(LOBBY_CREATE_REQUEST,  lobby_create_request)  \
+	X(LOBBY_CREATE_RESPONSE, lobby_create_response) \
+	X(LOBBY_JOIN_REQUEST,    lobby_join_request)    \
+	X(LOBBY_JOIN_RESPONSE,   lobby_join_response)   \
+	X(LOBBY_LIST_REQUEST,    lobby_list_request)    \
+	X(LOBBY_LIST_RESPONSE,   lobby_list_response)   \
+	X(BATTLE_SNAPSHOT,       battle_snapshot_msg)   \
+	X(BATTLE_SNAPSHOT_ACK,   battle_snapshot_ack)
+
+#define MESSAGE_STRUCT_INT(_field)             int _field;
+#define MESSAGE_STRUCT_STRING(_field)          const char *_field;
+#define MESSAGE_STRUCT_INT_ARRAY(_field, _max) int _field##_len; int _field[_max];
+#define MESSAGE_STRUCT_BYTES(_field, _max)     int _field##_len; uint8_t _field[_max];
+
+#define MESSAGE_DECLARATION(_type, _name)                                                   \
+	struct _name {                                                                          \
+		struct message_header header;                                                       \
+		_type##_FIELDS(MESSAGE_STRUCT_INT, MESSAGE_STRUCT_STRING, MESSAGE_STRUCT_INT_ARRAY, \
+		               MESSAGE_STRUCT_BYTES)                                                \
+	};                                                                                      \
+	void pack_##_name  (const struct _name *, cJSON *);                                     \
+	void unpack_##_name(cJSON *, struct _name *, struct arena *strings);
+
+MESSAGES(MESSAGE_DECLARATION)
+
+#undef MESSAGE_DECLARATION
+#undef MESSAGE_STRUCT_INT
+#undef MESSAGE_STRUCT_STRING
+#undef MESSAGE_STRUCT_INT_ARRAY
+#undef MESSAGE_STRUCT_BYTES
+
+/* Large enough for any message, used to decode into. */
+union message_any {
+	struct message_header header;
+#define MESSAGE_UNION_MEMBER(_type, _name) struct _name _name;
+	MESSAGES(MESSAGE_UNION_MEMBER)
+#undef MESSAGE_UNION_MEMBER
+};
+
+//
+// Wire format
+//
+// Every message is sent as a frame, `varint(payload length) payload`.
+// The payload is either binary (default) or json (debug, see message_set_encoding()),
+// receivers tell them apart by the first byte:
+//
+//     binary: varint(type) fields...  ints are zigzag varints,
+//                                     strings are varint(length) bytes '\0',
+//                                     int arrays are varint(length) ints,
+//                                     bytes are varint(length) bytes.
+//     json:   {"header":{"type":...},...}  bytes are arrays of numbers.
+//
+
+#define MESSAGE_FRAME_MAX 1024 // bytes, including the length prefix
+
+enum message_encoding {
+	MESSAGE_ENCODING_BINARY,
+	MESSAGE_ENCODING_JSON,
+};
+
+struct message_writer;
+struct message_reader;
+
+typedef void (*message_pack_fn)(const struct message_header *, cJSON *);
+typedef void (*message_unpack_fn)(cJSON *, struct message_header *, struct arena *strings);
+typedef void (*message_encode_fn)(const struct message_header *, struct message_writer *);
+typedef void (*message_decode_fn)(struct message_reader *, struct message_header *);
 
 /** Holds meta information about a message.
  * This way, we can choose at runtime how to (un)pack a message based on its type.
@@ -33,6 +144,8 @@ typedef struct {
 	const char *name;
 	message_pack_fn   pack_fn;
 	message_unpack_fn unpack_fn;
+	message_encode_fn encode_fn;
+	message_decode_fn decode_fn;
 	size_t struct_size;
 } message_function_info_t;
 
@@ -41,68 +154,74 @@ extern const message_function_info_t message_function_infos[MSG_TYPE_MAX];
 const char *message_type_to_name(enum message_type type);
 
 void message_header_init(struct message_header *, int16_t type);
-void pack_message_header(struct message_header *, cJSON *json);
+void pack_message_header(const struct message_header *, cJSON *json);
 void unpack_message_header(cJSON *json, struct message_header *);
 
+/** Sets the payload encoding of outgoing messages, incoming ones are detected. */
+void                  message_set_encoding(enum message_encoding);
+enum message_encoding message_get_encoding(void);
+
+/**
+ * Writes `msg` as a single frame into `out`, without allocating (binary).
+ * @returns The number of bytes written, 0 if `out_capacity` is too small.
+ */
+size_t message_encode(const struct message_header *msg, uint8_t *out, size_t out_capacity);
+
+/**
+ * Decodes the first frame in `data` into `out`.
+ * String fields point into `data` (binary) or into decoder owned memory (json),
+ * both stay valid until the next call.
+ *
+ * Example:
+ *
+ *     union message_any msg;
+ *     ptrdiff_t used;
+ *     while ((used = message_decode(data, data_len, &msg)) > 0) {
+ *       if (msg.header.type == LOBBY_CREATE_REQUEST) {
+ *         printf("Lobby: %s\n", msg.lobby_create_request.lobby_name);
+ *       }
+ *       data += used; data_len -= used;
+ *     }
+ *
+ * @returns The size of the frame. 0 if the frame is incomplete, -1 if `data` is
+ *          no frame at all (the stream can't be recovered). Complete frames
+ *          with an invalid payload are skipped with `out->type == MSG_TYPE_UNKNOWN`.
+ */
+ptrdiff_t message_decode(const uint8_t *data, size_t data_len, union message_any *out);
+
 /**
- * Parses the packed message into the messages respective struct.
- * Returns a pointer to the derived message type.[1]
- * Returns NULL on failure.
+ * The size of the first frame in `data`, like message_decode() but without decoding it.
+ * `is_json` is set for json payloads, their strings are kept per thread by message_decode().
+ */
+ptrdiff_t message_frame_len(const uint8_t *data, size_t data_len, int *is_json);
+
+/**
+ * Parses the packed message into the messages respective struct, allocated from `arena`.
+ * String fields are copied into `arena` too, so `json` can be deleted right away
+ * and the message lives until the arena is reset. Nothing is freed per message.
+ * Returns a pointer to the derived message type.
+ * Returns NULL on failure or if `arena` is full.
  *
  * Example:
  *
  *     cJSON *json = ...;
- *     struct message_header *msg_header = unpack_message(json);
+ *     struct message_header *msg_header = unpack_message(json, &tick_arena);
+ *     cJSON_Delete(json);
  *     assert(msg_header != NULL);
  *
  *     if (msg_header->type == LOBBY_CREATE_REQUEST) {
  *       struct lobby_create_request *msg = msg_header;
- *       printf("Message Data: %d, %d, %d\n", msg->some_data, msg->more_data, ...);
+ *       printf("Lobby: %s\n", msg->lobby_name);
  *     }
- *     free_message(json, msg_header);
+ *     arena_reset(&tick_arena); // once per tick
  */
-struct message_header *unpack_message(cJSON *json);
+struct message_header *unpack_message(cJSON *json, struct arena *arena);
 /**
  * Serializes a message struct and returns it as a cJSON object.
  * @param msg A message struct.
  * @returns The message serialized into a cJSON object. Ne
  *          Needs to be freed using `cJSON_Delete()`!
  */
-cJSON *pack_message(struct message_header *msg);
-void free_message(cJSON *json, struct message_header *);
-
-#define MESSAGE_DECLARATION(_type, _name, _fields) \
-	struct _name {                                 \
-		struct message_header header;              \
-		_fields;                                   \
-	};                                             \
-	void _name##_init   (struct _name *s);         \
-	void _name##_destroy(struct _name *);          \
-	void pack_##_name   (struct _name *, cJSON *); \
-	void unpack_##_name (cJSON *, struct _name *)
-
-MESSAGE_DECLARATION(WELCOME_RESPONSE, welcome_response,
-	int _dummy);
-
-MESSAGE_DECLARATION(LOBBY_CREATE_REQUEST, lobby_create_request,
-	int lobby_id; char *lobby_name);
-
-MESSAGE_DECLARATION(LOBBY_CREATE_RESPONSE, lobby_create_response,
-	int lobby_id; int create_error);
-
-MESSAGE_DECLARATION(LOBBY_JOIN_REQUEST, lobby_join_request,
-	int lobby_id);
-
-MESSAGE_DECLARATION(LOBBY_JOIN_RESPONSE, lobby_join_response,
-	int lobby_id; int join_error; int is_other_user);
-
-MESSAGE_DECLARATION(LOBBY_LIST_REQUEST, lobby_list_request,
-	void);
-
-MESSAGE_DECLARATION(LOBBY_LIST_RESPONSE, lobby_list_response,
-	int ids_of_lobbies_len; int ids_of_lobbies[8]);
-
-#undef MESSAGE_DECLARATION
+cJSON *pack_message(const struct message_header *msg);
 
 #endif
-
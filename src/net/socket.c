@@ -0,0 +1,144 @@
+#include "socket.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef __EMSCRIPTEN__
+
+int net_socket_connect(struct net_socket *sock, const char *host, uint16_t port) {
+	assert(sock != NULL);
+	memset(sock, 0, sizeof(*sock));
+
+	IPaddress ip;
+	if (SDLNet_ResolveHost(&ip, host, port) < 0) {
+		return 1;
+	}
+	sock->tcp = SDLNet_TCP_Open(&ip);
+	if (sock->tcp == NULL) {
+		return 1;
+	}
+	sock->socketset = SDLNet_AllocSocketSet(1);
+	if (SDLNet_TCP_AddSocket(sock->socketset, sock->tcp) < 0) {
+		SDLNet_FreeSocketSet(sock->socketset);
+		SDLNet_TCP_Close(sock->tcp);
+		return 1;
+	}
+
+	sock->is_open = 1;
+	return 0;
+}
+
+void net_socket_close(struct net_socket *sock) {
+	if (!sock->is_open) {
+		return;
+	}
+	SDLNet_TCP_DelSocket(sock->socketset, sock->tcp);
+	SDLNet_FreeSocketSet(sock->socketset);
+	SDLNet_TCP_Close(sock->tcp);
+	memset(sock, 0, sizeof(*sock));
+}
+
+ptrdiff_t net_socket_send(struct net_socket *sock, const void *data, size_t len) {
+	assert(sock->is_open);
+	// the websocket buffers everything, anything short of `len` is an error
+	const int sent = SDLNet_TCP_Send(sock->tcp, data, (int)len);
+	return (sent == (int)len) ? sent : -1;
+}
+
+ptrdiff_t net_socket_recv(struct net_socket *sock, void *buffer, size_t capacity) {
+	assert(sock->is_open);
+	if (SDLNet_CheckSockets(sock->socketset, 0) <= 0 || !SDLNet_SocketReady(sock->tcp)) {
+		return 0;
+	}
+	const int received = SDLNet_TCP_Recv(sock->tcp, buffer, (int)capacity);
+	return (received > 0) ? received : -1;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static int is_would_block(int error) {
+	return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+}
+
+int net_socket_connect(struct net_socket *sock, const char *host, uint16_t port) {
+	assert(sock != NULL);
+	memset(sock, 0, sizeof(*sock));
+	sock->fd = -1;
+
+	char service[8];
+	snprintf(service, sizeof(service), "%u", port);
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+	struct addrinfo *addresses = NULL;
+	if (getaddrinfo(host, service, &hints, &addresses) != 0) {
+		return 1;
+	}
+
+	// the first address accepting us wins, e.g. ipv6 or ipv4 for localhost
+	for (struct addrinfo *address = addresses; address != NULL; address = address->ai_next) {
+		sock->fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (sock->fd < 0) {
+			continue;
+		}
+		if (connect(sock->fd, address->ai_addr, address->ai_addrlen) == 0) {
+			break;
+		}
+		close(sock->fd);
+		sock->fd = -1;
+	}
+	freeaddrinfo(addresses);
+	if (sock->fd < 0) {
+		return 1;
+	}
+
+	// frames are batched already, Nagle would only hold them back
+	const int enabled = 1;
+	setsockopt(sock->fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+	if (fcntl(sock->fd, F_SETFL, fcntl(sock->fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+		close(sock->fd);
+		sock->fd = -1;
+		return 1;
+	}
+
+	sock->is_open = 1;
+	return 0;
+}
+
+void net_socket_close(struct net_socket *sock) {
+	if (!sock->is_open) {
+		return;
+	}
+	close(sock->fd);
+	sock->fd = -1;
+	sock->is_open = 0;
+}
+
+ptrdiff_t net_socket_send(struct net_socket *sock, const void *data, size_t len) {
+	assert(sock->is_open);
+	// MSG_NOSIGNAL, a closed connection is an error and not a SIGPIPE
+	const ssize_t sent = send(sock->fd, data, len, MSG_NOSIGNAL);
+	if (sent < 0) {
+		return is_would_block(errno) ? 0 : -1;
+	}
+	return sent;
+}
+
+ptrdiff_t net_socket_recv(struct net_socket *sock, void *buffer, size_t capacity) {
+	assert(sock->is_open);
+	const ssize_t received = recv(sock->fd, buffer, capacity, 0);
+	if (received < 0) {
+		return is_would_block(errno) ? 0 : -1;
+	}
+	// 0 is an orderly shutdown of the peer
+	return (received > 0) ? received : -1;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+//
+// Client side TCP connection, which never blocks once it is established.
+//
+// Native builds use the socket directly: non-blocking and without Nagle, as
+// writes are already batched per frame. The web build goes through SDL_net,
+// emscripten maps it onto a websocket which doesn't block either.
+//
+//     net_socket_connect(&socket, "localhost", 9124);
+//     sent = net_socket_send(&socket, data, len);      // may take less than `len`
+//     received = net_socket_recv(&socket, buffer, capacity);
+//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __EMSCRIPTEN__
+#include <SDL_net.h>
+#endif
+
+struct net_socket {
+	int is_open;
+#ifdef __EMSCRIPTEN__
+	TCPsocket tcp;
+	SDLNet_SocketSet socketset;
+#else
+	int fd;
+#endif
+};
+
+// blocks until connected, returns 0 on success.
+int  net_socket_connect(struct net_socket *, const char *host, uint16_t port);
+void net_socket_close  (struct net_socket *);
+
+// returns the bytes taken, 0 if the socket can't take any right now and -1 on errors.
+ptrdiff_t net_socket_send(struct net_socket *, const void *data, size_t len);
+// returns the bytes received, 0 if nothing arrived and -1 on errors or once the peer closed.
+ptrdiff_t net_socket_recv(struct net_socket *, void *buffer, size_t capacity);
+
+#endif
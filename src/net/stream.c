@@ -0,0 +1,155 @@
+#include "stream.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t stream_capacity_for(size_t capacity) {
+	size_t result = NET_STREAM_CAPACITY_MIN;
+	while (result < capacity) {
+		result *= 2;
+	}
+	return result;
+}
+
+// moves the unread bytes into a new buffer of `capacity`, starting at index 0.
+static void stream_relocate(struct net_stream *stream, size_t capacity) {
+	assert(capacity >= stream->len);
+	uint8_t *data = malloc(capacity);
+	const size_t first = stream->capacity - stream->head;
+	if (stream->len <= first) {
+		memcpy(data, &stream->data[stream->head], stream->len);
+	} else {
+		memcpy(data, &stream->data[stream->head], first);
+		memcpy(&data[first], stream->data, stream->len - first);
+	}
+	free(stream->data);
+	stream->data = data;
+	stream->head = 0;
+	stream->capacity = capacity;
+}
+
+void net_stream_init(struct net_stream *stream, size_t capacity) {
+	stream->capacity = stream_capacity_for(capacity);
+	stream->data = malloc(stream->capacity);
+	stream->head = 0;
+	stream->len = 0;
+}
+
+void net_stream_free(struct net_stream *stream) {
+	free(stream->data);
+	stream->data = NULL;
+	stream->head = stream->len = stream->capacity = 0;
+}
+
+void net_stream_clear(struct net_stream *stream) {
+	stream->head = 0;
+	stream->len = 0;
+}
+
+uint8_t *net_stream_write_begin(struct net_stream *stream, size_t min, size_t *available) {
+	assert(stream->data != NULL);
+	assert(available != NULL);
+	if (stream->len == 0) {
+		stream->head = 0;
+	}
+
+	// the free space behind the tail is contiguous up to the end or up to the head
+	size_t tail = stream->head + stream->len;
+	size_t contiguous;
+	if (tail < stream->capacity) {
+		contiguous = stream->capacity - tail;
+	} else {
+		tail -= stream->capacity;
+		contiguous = stream->head - tail;
+	}
+
+	if (contiguous < min) {
+		const size_t capacity = stream_capacity_for(stream->len + min);
+		if (capacity > NET_STREAM_CAPACITY_MAX) {
+			*available = 0;
+			return NULL;
+		}
+		stream_relocate(stream, capacity);
+		tail = stream->len;
+		contiguous = stream->capacity - tail;
+	}
+
+	*available = contiguous;
+	return &stream->data[tail];
+}
+
+void net_stream_write_end(struct net_stream *stream, size_t written) {
+	assert(stream->len + written <= stream->capacity);
+	stream->len += written;
+}
+
+const uint8_t *net_stream_read_begin(const struct net_stream *stream, size_t *len) {
+	assert(len != NULL);
+	if (stream->len == 0) {
+		*len = 0;
+		return NULL;
+	}
+	const size_t first = stream->capacity - stream->head;
+	*len = (stream->len < first) ? stream->len : first;
+	return &stream->data[stream->head];
+}
+
+void net_stream_read_end(struct net_stream *stream, size_t read) {
+	assert(read <= stream->len);
+	stream->head = (stream->head + read) & (stream->capacity - 1);
+	stream->len -= read;
+}
+
+int net_stream_next_message(struct net_stream *stream, union message_any *out) {
+	if (stream->len == 0) {
+		return 0;
+	}
+
+	const size_t first = stream->capacity - stream->head;
+	const size_t contiguous = (stream->len < first) ? stream->len : first;
+	ptrdiff_t frame_len = message_decode(&stream->data[stream->head], contiguous, out);
+
+	// the frame wraps around, decode it from a linear copy.
+	// frames are bounded, so this never needs more than the scratch buffer.
+	if (frame_len == 0 && contiguous < stream->len) {
+		const size_t len = (stream->len < sizeof(stream->scratch)) ? stream->len : sizeof(stream->scratch);
+		memcpy(stream->scratch, &stream->data[stream->head], contiguous);
+		memcpy(&stream->scratch[contiguous], stream->data, len - contiguous);
+		frame_len = message_decode(stream->scratch, len, out);
+	}
+
+	if (frame_len <= 0) {
+		return (int)frame_len;
+	}
+
+	stream->head = (stream->head + frame_len) & (stream->capacity - 1);
+	stream->len -= frame_len;
+	return 1;
+}
+
+int net_stream_next_frame(struct net_stream *stream, uint8_t *out, size_t *out_len, int *is_json) {
+	if (stream->len == 0) {
+		return 0;
+	}
+
+	const size_t first = stream->capacity - stream->head;
+	const size_t contiguous = (stream->len < first) ? stream->len : first;
+	ptrdiff_t frame_len = message_frame_len(&stream->data[stream->head], contiguous, is_json);
+	if (frame_len > 0) {
+		memcpy(out, &stream->data[stream->head], frame_len);
+	} else if (frame_len == 0 && contiguous < stream->len) {
+		// the frame wraps around, like in net_stream_next_message()
+		const size_t len = (stream->len < MESSAGE_FRAME_MAX) ? stream->len : MESSAGE_FRAME_MAX;
+		memcpy(out, &stream->data[stream->head], contiguous);
+		memcpy(&out[contiguous], stream->data, len - contiguous);
+		frame_len = message_frame_len(out, len, is_json);
+	}
+	if (frame_len <= 0) {
+		return (int)frame_len;
+	}
+
+	*out_len = frame_len;
+	net_stream_read_end(stream, frame_len);
+	return 1;
+}
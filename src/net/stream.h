@@ -0,0 +1,64 @@
+#ifndef NET_STREAM_H
+#define NET_STREAM_H
+
+//
+// Buffer for a byte stream carrying message frames.
+//
+// A growable ring buffer: reads are written directly behind the unread bytes,
+// complete frames are decoded from the front. Frames may be split across reads
+// or several may arrive in one read, both are handled.
+//
+//     uint8_t *dst = net_stream_write_begin(&stream, 512, &available);
+//     net_stream_write_end(&stream, recv(socket, dst, available));
+//     while (net_stream_next_message(&stream, &message) > 0) { ... }
+//
+// Sending works the other way around, frames are encoded into the stream and
+// the front is written out as far as the socket takes it:
+//
+//     const uint8_t *src = net_stream_read_begin(&stream, &len);
+//     net_stream_read_end(&stream, send(socket, src, len));
+//
+
+#include <stddef.h>
+#include <stdint.h>
+#include "net/message.h"
+
+#define NET_STREAM_CAPACITY_MIN 1024
+#define NET_STREAM_CAPACITY_MAX (1024 * 1024) // a peer this far behind is not worth waiting for
+
+struct net_stream {
+	uint8_t *data;
+	size_t head;     // index of the first unread byte
+	size_t len;      // unread bytes
+	size_t capacity; // power of two
+	// frames wrapping around the end are decoded from here,
+	// decoded strings point into it.
+	uint8_t scratch[MESSAGE_FRAME_MAX];
+};
+
+void net_stream_init(struct net_stream *, size_t capacity);
+void net_stream_free(struct net_stream *);
+void net_stream_clear(struct net_stream *);
+
+// contiguous space to write at least `min` bytes into, grows the buffer if needed.
+// `available` is set to the usable size, which may be larger than `min`.
+// returns NULL if the buffer would exceed NET_STREAM_CAPACITY_MAX.
+uint8_t *net_stream_write_begin(struct net_stream *, size_t min, size_t *available);
+void     net_stream_write_end  (struct net_stream *, size_t written);
+
+// the unread bytes up to the end of the buffer, there may be more from its start.
+// NULL if the stream is empty.
+const uint8_t *net_stream_read_begin(const struct net_stream *, size_t *len);
+void           net_stream_read_end  (struct net_stream *, size_t read);
+
+// decodes the next complete frame into `out`, strings in it stay valid until the next write.
+// returns 1 for a message (type may be MSG_TYPE_UNKNOWN), 0 if there is no complete frame
+// and -1 if the stream is not made of frames.
+int net_stream_next_message(struct net_stream *, union message_any *out);
+
+// copies the next complete frame into `out`, which holds MESSAGE_FRAME_MAX bytes.
+// returns like net_stream_next_message(), `out_len` and `is_json` are set for frames.
+int net_stream_next_frame(struct net_stream *, uint8_t *out, size_t *out_len, int *is_json);
+
+#endif
+
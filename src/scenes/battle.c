@@ -23,12 +23,16 @@
 #include "gl/gbuffer.h"
 #include "gl/camera.h"
 #include "game/background.h"
+#include "game/battle_replay.h"
+#include "game/battle_rules.h"
 #include "game/hexmap.h"
+#include "game/hexmap_renderer.h"
 #include "gui/console.h"
 #include "scenes/menu.h"
 #include "util/fs.h"
 #include "util/util.h"
 #include "util/str.h"
+#include "util/profiler.h"
 
 //
 // structs & enums
@@ -40,48 +44,6 @@ enum card_selection {
 	CS_SELECTED_INITIAL,
 };
 
-enum gamestate_battle {
-	GS_BATTLE_BEGIN           ,
-	GS_ROUND_BEGIN            ,
-	GS_TURN_ENTITY_BEGIN      , GS_TURN_PLAYER_BEGIN,
-	GS_TURN_ENTITY_IN_PROGRESS, GS_TURN_PLAYER_IN_PROGRESS,
-	GS_TURN_ENTITY_END        , GS_TURN_PLAYER_END,
-	GS_ROUND_END              ,
-	GS_BATTLE_END             ,
-};
-
-enum game_event_type {
-	EVENT_PLAY_CARD,
-	EVENT_MOVE_ENTITY,
-	EVENT_ATTACK_ENTITY,
-	EVENT_TYPE_MAX,
-};
-
-struct game_event {
-	enum game_event_type type;
-	union {
-		struct {
-			ecs_entity_t card;
-			ecs_entity_t caused_by;
-		} play_card;
-		struct {
-			ecs_entity_t entity;
-			struct hexcoord goal;
-		} move_entity;
-		struct {
-			ecs_entity_t attacker;
-			ecs_entity_t victim;
-			ecs_entity_t initiated_by_card;
-		} attack_entity;
-	};
-};
-
-enum effect_trigger {
-	TRIGGER_DRAW_CARD,
-	TRIGGER_PLAY_CARD,
-	TRIGGER_DISCARD_CARD,
-};
-
 // components
 
 // pos
@@ -100,21 +62,7 @@ typedef struct {
 } c_velocity;
 
 // general information about a card
-enum card_kind {
-	CARD_KIND_BASIC_ATTACK,
-	CARD_KIND_ACTION,
-};
-typedef struct {
-	char          *name;
-	char          *description;
-	int            image_id;
-	int            icon_ids[8];
-	int            icon_ids_count;
-	enum card_kind kind;
-	struct {
-		int basic;
-	} damage;
-} c_card;
+typedef struct battle_card c_card;
 
 // a cards state when held in hand
 const float HANDCARD_SPACE_DEFAULT = 1.0f;
@@ -127,14 +75,8 @@ typedef struct {
 	float added_at_time;
 } c_handcard;
 
-typedef struct {
-	u16 hp;
-	u16 max_hp;
-} c_health;
-
-typedef struct {
-	u8 _dummy;
-} c_npc;
+// id of a unit or handcard in `g_battle`
+typedef u32 c_battle_id;
 
 typedef struct {
 	struct hexmap_path path;
@@ -156,8 +98,7 @@ ECS_COMPONENT_DECLARE(c_card);
 ECS_COMPONENT_DECLARE(c_handcard);
 ECS_COMPONENT_DECLARE(c_model);
 ECS_COMPONENT_DECLARE(c_velocity);
-ECS_COMPONENT_DECLARE(c_health);
-ECS_COMPONENT_DECLARE(c_npc);
+ECS_COMPONENT_DECLARE(c_battle_id);
 ECS_COMPONENT_DECLARE(c_move_along_path);
 ECS_COMPONENT_DECLARE(c_statuseffect_armor);
 
@@ -171,18 +112,17 @@ static ecs_entity_t find_closest_handcard(float x, float y, float max_distance);
 static int          order_handcards(ecs_entity_t e1, const void *data1, ecs_entity_t e2, const void *data2);
 static void         draw_ui(pipeline_t *pipeline);
 static void         draw_hud(pipeline_t *pipeline);
-static void         on_game_event(struct game_event);
-static void         on_game_event_play_card(struct game_event);
-static int          count_cards(void);
-static int          count_handcards_of_kind(enum card_kind);
-static ecs_entity_t find_any_handcard_of_kind(enum card_kind);
 static void         interact_with_handcards(struct input_drag_s *drag);
 static int          add_cards_to_hand(float dt);
-static ecs_entity_t spawn_random_card(void);
-static int          gamestate_changed(enum gamestate_battle old_state, enum gamestate_battle new_state);
-static void         update_gamestate(enum gamestate_battle state, float dt);
+static void         update_player_turn(float dt);
 static void         highlight_reachable_tiles(struct hexcoord origin, usize distance);
-static void         trigger_card_effect(c_card *, enum effect_trigger);
+
+// battle callbacks
+static void on_state_changed(struct battle *, enum gamestate_battle old_state, enum gamestate_battle new_state);
+static void on_card_drawn   (struct battle *, const struct battle_handcard *);
+static void on_card_removed (struct battle *, u32 handcard_id);
+static void on_unit_moved   (struct battle *, const struct battle_unit *, struct hexmap_path *);
+static void on_message      (struct battle *, enum battle_message, const char *text);
 
 // systems
 static void system_move_cards           (ecs_iter_t *);
@@ -190,7 +130,6 @@ static void system_move_models          (ecs_iter_t *);
 static void system_draw_cards           (ecs_iter_t *);
 static void system_draw_board_entities  (ecs_iter_t *);
 static void system_draw_healthbars      (ecs_iter_t *);
-static void system_enemy_turn           (ecs_iter_t *);
 static void system_move_along_path      (ecs_iter_t *);
 static void observer_on_update_handcards(ecs_iter_t *);
 
@@ -230,14 +169,14 @@ static model_t               g_props_model[4];
 static float                 g_pickup_next_card;
 static struct camera         g_camera;
 static struct camera         g_portrait_camera;
-static struct hexmap         g_hexmap;
-static enum gamestate_battle g_gamestate;
-static enum gamestate_battle g_next_gamestate;
+static struct battle          g_battle;
+static struct battle_replay   g_battle_replay;
+static struct hexmap_renderer g_hexmap_renderer;
+static ecs_entity_t           g_unit_entities[BATTLE_UNITS_MAX + 1]; // by unit id
+static struct { u32 key; ecs_entity_t value; } *g_card_entities; // by handcard id
 static struct { float x, y, w, h; } g_button_end_turn;
-static usize                 g_player_movement_this_turn;
-static usize                 g_turn_count;
-static usize                 g_base_cards_len;
-static c_card               *g_base_cards;
+static usize                  g_base_cards_len;
+static struct battle_card    *g_base_cards;
 
 // debug
 static struct { float x, y, w, h; } g_debug_rect;
@@ -255,14 +194,11 @@ static Mix_Chunk    *g_slide_card_sfx;
 
 static void load(struct scene_battle *battle, struct engine *engine) {
 	g_engine = engine;
-	rng_seed(time(NULL));
 
 	g_handcards_updated = 0;
 	g_selected_card = 0;
 	g_pickup_next_card = 0.0f;
-	g_gamestate = g_next_gamestate = GS_BATTLE_BEGIN;
 	g_debug_draw_pathfinder = 0;
-	g_turn_count = 0;
 
 	g_button_end_turn.x = g_engine->window_width - 150.0f;
 	g_button_end_turn.y = g_engine->window_height - 200.0f;
@@ -295,11 +231,22 @@ static void load(struct scene_battle *battle, struct engine *engine) {
 		assert(load_fun_error == 0);
 	}
 
-	hexmap_init(&g_hexmap, g_engine);
+	// Load base cards & start the battle
+	g_base_cards = battle_cards_load("res/data/cards/base.json", &g_base_cards_len);
+	assert(g_base_cards != NULL);
+	battle_init(&g_battle, g_base_cards, g_base_cards_len, time(NULL), (struct battle_callbacks){
+		.on_state_changed = on_state_changed,
+		.on_card_drawn    = on_card_drawn,
+		.on_card_removed  = on_card_removed,
+		.on_unit_moved    = on_unit_moved,
+		.on_message       = on_message,
+		});
+	battle_replay_begin(&g_battle_replay, &g_battle, BATTLE_REPLAY_CHECKPOINT_TURNS);
+	hexmap_renderer_init(&g_hexmap_renderer, g_engine);
 
 	// initialize camera
 	camera_init_default(&g_camera, engine->window_width, engine->window_height);
-	glm_translate(g_camera.view, (vec3){ -g_hexmap.tile_offsets.x * 3.25f, 0.0f, g_hexmap.tile_offsets.y * -3.0f });
+	glm_translate(g_camera.view, (vec3){ -g_battle.map.tile_offsets.x * 3.25f, 0.0f, g_battle.map.tile_offsets.y * -3.0f });
 	camera_init_default(&g_portrait_camera, engine->window_width, engine->window_height);
 	glm_look((vec3){ 0.0f, 0.0f, 10.0f }, (vec3){ 0.0f, 0.0f, -1.0f }, (vec3){ 0.0f, 1.0f, 0.0f }, (float*)&g_portrait_camera.view);
 
@@ -316,16 +263,14 @@ static void load(struct scene_battle *battle, struct engine *engine) {
 	ECS_COMPONENT_DEFINE(g_world, c_handcard);
 	ECS_COMPONENT_DEFINE(g_world, c_model);
 	ECS_COMPONENT_DEFINE(g_world, c_velocity);
-	ECS_COMPONENT_DEFINE(g_world, c_health);
-	ECS_COMPONENT_DEFINE(g_world, c_npc);
+	ECS_COMPONENT_DEFINE(g_world, c_battle_id);
 	ECS_COMPONENT_DEFINE(g_world, c_move_along_path);
 	ECS_COMPONENT_DEFINE(g_world, c_statuseffect_armor);
 	ECS_SYSTEM_DEFINE(g_world, system_move_cards,          0, c_pos2d, c_handcard);
 	ECS_SYSTEM_DEFINE(g_world, system_move_models,         0, c_pos3d, c_model, c_velocity);
 	ECS_SYSTEM_DEFINE(g_world, system_draw_cards,          0, c_card, ?c_handcard, c_pos2d); _syntax_fix_label:
 	ECS_SYSTEM_DEFINE(g_world, system_draw_board_entities, 0, c_position, c_model, ?c_tile_offset); _syntax_fix_label2:
-	ECS_SYSTEM_DEFINE(g_world, system_draw_healthbars,     0, c_position, c_health, ?c_tile_offset); _syntax_fix_label3:
-	ECS_SYSTEM_DEFINE(g_world, system_enemy_turn,          0, c_position, c_npc);
+	ECS_SYSTEM_DEFINE(g_world, system_draw_healthbars,     0, c_position, c_battle_id, ?c_tile_offset); _syntax_fix_label3:
 	ECS_SYSTEM_DEFINE(g_world, system_move_along_path,     0, c_position, c_tile_offset, c_move_along_path);
 
 	g_ordered_handcards = ecs_query(g_world, {
@@ -342,84 +287,27 @@ static void load(struct scene_battle *battle, struct engine *engine) {
 
 	// Add some entities
 	{
-		ecs_entity_t e;
-		// campfire decoration
-		struct hexcoord campfire_pos = { .x=3, .y=4 };
-		e = ecs_new_id(g_world);
-		ecs_set(g_world, e, c_position, { .x=campfire_pos.x, .y=campfire_pos.y });
+		// campfire decoration, the rules made its tile an obstacle
+		ecs_entity_t e = ecs_new_id(g_world);
+		ecs_set(g_world, e, c_position, { .x=3, .y=4 });
 		ecs_set(g_world, e, c_model,    { .model=&g_props_model[3], .scale=10.0f });
-		hexmap_tile_at(&g_hexmap, campfire_pos)->movement_cost = HEXMAP_MOVEMENT_COST_MAX;
-		// enemy
-		struct hexcoord enemy_pos = { .x=3, .y=3 };
-		e = ecs_new_id(g_world);
-		ecs_set(g_world, e, c_position,  { .x=enemy_pos.x, .y=enemy_pos.y });
-		ecs_set(g_world, e, c_model,     { .model=&g_enemy_model, .scale=1.8f });
-		ecs_set(g_world, e, c_health,    { .hp=8, .max_hp=8 });
-		ecs_set(g_world, e, c_npc,       { ._dummy=1 });
-		hexmap_tile_at(&g_hexmap, enemy_pos)->occupied_by = e;
+		// units
+		for (usize i = 0; i < g_battle.units_len; ++i) {
+			const struct battle_unit *unit = &g_battle.units[i];
+			e = ecs_new_id(g_world);
+			ecs_set(g_world, e, c_position,  { .x=unit->pos.x, .y=unit->pos.y });
+			ecs_set(g_world, e, c_model,     { .model=(unit->is_npc ? &g_enemy_model : &g_player_model), .scale=1.8f });
+			ecs_set(g_world, e, c_battle_id, { unit->id });
+			g_unit_entities[unit->id] = e;
+		}
+		g_player = g_unit_entities[g_battle.player];
 		g_enemy_model.animation_index = 3;
-		// player
-		struct hexcoord player_pos = { .x=2, .y=5 };
-		g_player = ecs_new_id(g_world);
-		ecs_set(g_world, g_player, c_position,  { .x=player_pos.x, .y=player_pos.y });
-		ecs_set(g_world, g_player, c_model,     { .model=&g_player_model, .scale=1.8f });
-		ecs_set(g_world, g_player, c_health,    { .hp=7, .max_hp=10 });
 		g_player_model.animation_index = 72;
-		hexmap_tile_at(&g_hexmap, player_pos)->occupied_by = g_player;
 	}
 
 	// Character Shader
 	shader_init_from_dir(&g_character_model_shader, "res/shader/model/gbuffer_pass/");
 
-	// Load base cards
-	{
-		char *output;
-		isize output_len;
-		assert(FS_OK == fs_readfile("res/data/cards/base.json", &output, &output_len));
-		cJSON *json = cJSON_ParseWithLength(output, output_len);
-		free(output);
-
-		assert(cJSON_IsArray(json));
-		int number_of_cards = cJSON_GetArraySize(json);
-		g_base_cards_len = number_of_cards;
-		g_base_cards = malloc(number_of_cards * sizeof(*g_base_cards));
-		for (usize i = 0; i < g_base_cards_len; ++i) {
-			const cJSON *card             = cJSON_GetArrayItem(json, i);
-			const cJSON *card_name        = cJSON_GetObjectItem(card, "name");
-			const cJSON *card_description = cJSON_GetObjectItem(card, "description");
-			const cJSON *card_face_id     = cJSON_GetObjectItem(card, "face_id");
-			const cJSON *card_kind        = cJSON_GetObjectItem(card, "kind");
-			const cJSON *card_damage      = cJSON_GetObjectItem(card, "damage");
-
-			assert(cJSON_IsObject(card));
-			assert(cJSON_IsString(card_name));
-			assert(cJSON_IsString(card_description));
-			assert(cJSON_IsNumber(card_face_id));
-			assert(cJSON_IsString(card_kind));
-			assert(strcmp(card_kind->valuestring, "basic_attack") == 0 || strcmp(card_kind->valuestring, "action") == 0);
-			assert(cJSON_IsObject(card_damage) || cJSON_IsNull(card_damage));
-			g_base_cards[i].name           = str_copy(card_name->valuestring);
-			g_base_cards[i].description    = str_copy(card_description->valuestring);
-			g_base_cards[i].image_id       = card_face_id->valueint;
-			g_base_cards[i].icon_ids_count = 0;
-			if (strcmp(card_kind->valuestring, "basic_attack") == 0) {
-				g_base_cards[i].kind = CARD_KIND_BASIC_ATTACK;
-			} else if (strcmp(card_kind->valuestring, "action") == 0) {
-				g_base_cards[i].kind = CARD_KIND_ACTION;
-			} else {
-				assert(0 && "unknown card kind encountered!");
-			}
-			g_base_cards[i].damage.basic = 0;
-			if (cJSON_IsObject(card_damage)) {
-				const cJSON *damage_basic = cJSON_GetObjectItem(card_damage, "basic");
-				assert(cJSON_IsNumber(damage_basic));
-				g_base_cards[i].damage.basic = cJSON_GetNumberValue(damage_basic);
-			}
-		}
-
-		cJSON_free(json);
-	}
-
 	// card renderer
 	{
 		struct texture_settings_s settings = TEXTURE_SETTINGS_INIT;
@@ -474,14 +362,13 @@ static void destroy(struct scene_battle *battle, struct engine *engine) {
 
 	background_destroy();
 	// TODO: Destroy remaining paths for all entities with a c_move_along_path component.
-	hexmap_destroy(&g_hexmap);
-	for (usize i = 0; i < g_base_cards_len; ++i) {
-		const c_card card = g_base_cards[i];
-		str_free(card.name);
-		str_free(card.description);
-	}
-	free(g_base_cards);
+	hexmap_renderer_destroy(&g_hexmap_renderer);
+	battle_replay_free(&g_battle_replay);
+	battle_destroy(&g_battle);
+	battle_cards_free(g_base_cards, g_base_cards_len);
+	g_base_cards = NULL;
 	g_base_cards_len = 0;
+	hmfree(g_card_entities);
 
 	texture_destroy(&g_cards_texture);
 	texture_destroy(&g_ui_texture);
@@ -517,21 +404,17 @@ static void update(struct scene_battle *battle, struct engine *engine, float dt)
 		recalculate_handcards();
 	}
 
-	update_gamestate(g_gamestate, dt);
+	update_player_turn(dt);
 
-	ecs_run(g_world, ecs_id(system_move_cards),      g_engine->dt, NULL);
-	ecs_run(g_world, ecs_id(system_move_models),     g_engine->dt, NULL);
-	ecs_run(g_world, ecs_id(system_move_along_path), g_engine->dt, NULL);
+	PROFILER_ECS_RUN(g_world, system_move_cards,      g_engine->dt, NULL);
+	PROFILER_ECS_RUN(g_world, system_move_models,     g_engine->dt, NULL);
+	PROFILER_ECS_RUN(g_world, system_move_along_path, g_engine->dt, NULL);
 
-	if (g_next_gamestate != g_gamestate) {
-		if (gamestate_changed(g_gamestate, g_next_gamestate)) {
-			g_gamestate = g_next_gamestate;
-		}
-	}
+	battle_update(&g_battle);
 }
 
 
-static void draw(struct scene_battle *battle, struct engine *engine) {
+static void draw(struct scene_battle *battle, struct engine *engine, float alpha) {
 	// Draw Scene (Map & Entites)
 	gbuffer_bind(g_gbuffer);
 	gbuffer_clear(g_gbuffer);
@@ -540,10 +423,10 @@ static void draw(struct scene_battle *battle, struct engine *engine) {
 	glEnable(GL_DEPTH_TEST);
 
 	const c_position *player_coord = ecs_get(g_world, g_player, c_position);
-	vec2s player_pos = hexmap_coord_to_world_position(&g_hexmap, *player_coord);
-	hexmap_draw(&g_hexmap, &g_camera, (vec3){player_pos.x, 0.0f, player_pos.y});
+	vec2s player_pos = hexmap_coord_to_world_position(&g_battle.map, *player_coord);
+	hexmap_renderer_draw(&g_hexmap_renderer, &g_battle.map, &g_camera, (vec3){player_pos.x, 0.0f, player_pos.y});
 
-	ecs_run(g_world, ecs_id(system_draw_board_entities), engine->dt, NULL);
+	PROFILER_ECS_RUN(g_world, system_draw_board_entities, engine->dt, NULL);
 
 	glDisable(GL_DEPTH_TEST);
 
@@ -569,7 +452,7 @@ void on_callback(struct scene_battle *battle, struct engine *engine, struct engi
 	case ENGINE_EVENT_KEY:
 		if (event.data.key.type == SDL_KEYDOWN && event.data.key.repeat == 0 && event.data.key.keysym.sym == SDLK_r) {
 			console_log_ex(engine, CONSOLE_MSG_SUCCESS, 0.5f, "3 shaders reloaded.");
-			shader_reload_source(&g_hexmap.tile_shader);
+			shader_reload_source(&g_hexmap_renderer.tile_shader);
 			shader_reload_source(&g_character_model_shader);
 			shader_reload_source(&g_gbuffer.shader);
 		}
@@ -604,184 +487,158 @@ void scene_battle_init(struct scene_battle *scene_battle, struct engine *engine)
 // private implementations
 //
 
-static int gamestate_changed(enum gamestate_battle old_state, enum gamestate_battle new_state) {
+static void update_player_turn(float dt) {
+	// drawn cards slide into the hand one after another, wait for them.
+	const int cards_in_hand = add_cards_to_hand(dt);
+	if (g_battle.state != GS_TURN_PLAYER_IN_PROGRESS || !cards_in_hand) {
+		return;
+	}
+
+	struct input_drag_s *drag = &g_engine->input_drag;
+	int is_on_button_end_turn = drag_in_rect(drag, g_button_end_turn.x, g_button_end_turn.y, g_button_end_turn.w, g_button_end_turn.h);
+	int is_dragging_card = (g_selected_card != 0 && ecs_is_valid(g_world, g_selected_card));
+
+	if (!is_on_button_end_turn && !is_dragging_card && drag->state == INPUT_DRAG_END) {
+		// Highlight & pathfind
+		vec3s p_begin = screen_to_world(g_engine->window_width, g_engine->window_height, g_camera.projection, g_camera.view, g_engine->input_drag.begin_x, g_engine->input_drag.begin_y);
+		vec3s p_end = screen_to_world(g_engine->window_width, g_engine->window_height, g_camera.projection, g_camera.view, g_engine->input_drag.end_x, g_engine->input_drag.end_y);
+		struct hexcoord click_begin_coord = hexmap_world_position_to_coord(&g_battle.map, (vec2s){ .x=p_begin.x, .y=p_begin.z });
+		struct hexcoord click_end_coord = hexmap_world_position_to_coord(&g_battle.map, (vec2s){ .x=p_end.x, .y=p_end.z });
+		if (hexmap_is_valid_coord(&g_battle.map, click_begin_coord) && hexmap_is_valid_coord(&g_battle.map, click_end_coord) && hexcoord_equal(click_begin_coord, click_end_coord)) {
+			u32 occupied_by = hexmap_tile_at(&g_battle.map, click_begin_coord)->occupied_by;
+			if (occupied_by != 0 && occupied_by != g_battle.player) {
+				struct hexmap_path path_to_neighbor;
+				enum hexmap_path_result path_found =
+					hexmap_path_find_ex(&g_battle.map, battle_unit(&g_battle, g_battle.player)->pos, click_begin_coord, PATH_FLAGS_FIND_NEIGHBOR, &path_to_neighbor);
+
+				if (path_found == HEXMAP_PATH_OK) {
+					if (path_to_neighbor.distance_in_tiles == 0) {
+						const int basic_attacks_in_hand = battle_count_handcards_of_kind(&g_battle, CARD_KIND_BASIC_ATTACK);
+						if (basic_attacks_in_hand == 0) {
+							console_log_ex(g_engine, CONSOLE_MSG_ERROR, 2.0f, "No Basic Attacks in Hand!");
+						} else if (basic_attacks_in_hand >= 1) {
+							// TODO: let the player choose a card if multiple basic attacks in hand!
+							console_log_ex(g_engine, CONSOLE_MSG_SUCCESS, 2.0f, "Attacking");
+							u32 card = battle_find_handcard_of_kind(&g_battle, CARD_KIND_BASIC_ATTACK);
+							battle_on_game_event(&g_battle, (struct game_event){ .type=EVENT_ATTACK_ENTITY, .attack_entity={
+								.attacker=g_battle.player, .victim=occupied_by, .initiated_by_card=card } });
+						}
+					} else if (path_to_neighbor.distance_in_tiles <= g_battle.player_movement_this_turn) {
+						console_log_ex(g_engine, CONSOLE_MSG_INFO, 2.0f, "Moving into attack range");
+						battle_on_game_event(&g_battle, (struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=g_battle.player, .goal=path_to_neighbor.goal } });
+						// TODO: Also attack, after moving completed.
+					} else {
+						console_log_ex(g_engine, CONSOLE_MSG_ERROR, 2.0f, "Not enough movement.");
+					}
+				}
+				hexmap_path_destroy(&path_to_neighbor);
+			} else if (occupied_by == 0) {
+				battle_on_game_event(&g_battle, (struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=g_battle.player, .goal=click_end_coord } });
+			}
+		}
+	}
+	interact_with_handcards(&g_engine->input_drag);
+	int clicked_on_button_end_turn = drag_clicked_in_rect(drag, g_button_end_turn.x, g_button_end_turn.y, g_button_end_turn.w, g_button_end_turn.h);
+	if (clicked_on_button_end_turn) {
+		battle_on_game_event(&g_battle, (struct game_event){ .type=EVENT_END_TURN });
+	}
+}
+
+static void on_state_changed(struct battle *battle, enum gamestate_battle old_state, enum gamestate_battle new_state) {
+	const struct battle_unit *player = battle_unit(battle, battle->player);
 	switch (new_state) {
-		case GS_BATTLE_BEGIN:
-			break;
-		case GS_ROUND_BEGIN:
-			break;
 		case GS_TURN_PLAYER_BEGIN:
 			console_log(g_engine, "Your turn!");
-			g_player_movement_this_turn = 2;
 			break;
 		case GS_TURN_PLAYER_IN_PROGRESS:
+			highlight_reachable_tiles(player->pos, battle->player_movement_this_turn);
 			break;
 		case GS_TURN_PLAYER_END:
+			hexmap_set_tile_effect(&battle->map, player->pos, HEXMAP_TILE_EFFECT_NONE);
+			hexmap_clear_tile_effect(&battle->map, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
 			break;
+		case GS_BATTLE_BEGIN:
+		case GS_ROUND_BEGIN:
 		case GS_TURN_ENTITY_BEGIN:
-			ecs_run(g_world, ecs_id(system_enemy_turn), g_engine->dt, NULL);
-			break;
 		case GS_TURN_ENTITY_IN_PROGRESS:
-			break;
 		case GS_TURN_ENTITY_END:
-			break;
 		case GS_ROUND_END:
-			++g_turn_count;
-			break;
 		case GS_BATTLE_END:
 			break;
 	}
+}
 
-	return 1;
+static void on_card_drawn(struct battle *battle, const struct battle_handcard *handcard) {
+	// shows up in the hand with add_cards_to_hand()
+	ecs_entity_t e = ecs_new_id(g_world);
+	ecs_set_ptr(g_world, e, c_card, &battle->cards[handcard->card]);
+	ecs_set(g_world, e, c_battle_id, { handcard->id });
+	hmput(g_card_entities, handcard->id, e);
 }
 
-static void update_gamestate(enum gamestate_battle state, float dt) {
-	c_position *player_coord = ecs_get_mut(g_world, g_player, c_position);
-	switch (state) {
-	case GS_BATTLE_BEGIN:
-		g_next_gamestate = GS_ROUND_BEGIN;
-		break;
-	case GS_ROUND_BEGIN: {
-		const int number_of_cards = count_cards();
-		const int max_cards_to_draw_at_turn_start = 5;
-		for (int i = number_of_cards; i < max_cards_to_draw_at_turn_start; ++i) {
-			spawn_random_card();
-		}
+static void on_card_removed(struct battle *battle, u32 handcard_id) {
+	const isize i = hmgeti(g_card_entities, handcard_id);
+	assert(i >= 0);
+	ecs_entity_t e = g_card_entities[i].value;
+	hmdel(g_card_entities, handcard_id);
+	if (e == g_selected_card) {
+		g_selected_card = 0;
+	}
+	ecs_delete(g_world, e);
+}
 
-		g_next_gamestate = GS_TURN_PLAYER_BEGIN;
-		break;
+static void on_unit_moved(struct battle *battle, const struct battle_unit *unit, struct hexmap_path *path) {
+	ecs_entity_t e = g_unit_entities[unit->id];
+	if (ecs_has(g_world, e, c_move_along_path)) {
+		// still walking the previous path, skip to its end
+		c_move_along_path *previous = ecs_get_mut(g_world, e, c_move_along_path);
+		hexmap_path_destroy(&previous->path);
+		ecs_set(g_world, e, c_position, { .x=path->start.x, .y=path->start.y });
 	}
-	case GS_TURN_PLAYER_BEGIN: {
-		int done = add_cards_to_hand(dt);
-		if (done) {
-			highlight_reachable_tiles(*player_coord, g_player_movement_this_turn);
-			g_next_gamestate = GS_TURN_PLAYER_IN_PROGRESS;
-		}
-		break;
+	ecs_set(g_world, e, c_tile_offset, { .x=0.0f, .y=0.0f, .z=0.0f });
+	ecs_set(g_world, e, c_move_along_path, { .path=*path, .current_tile=0, .duration_per_tile=(unit->is_npc ? 0.5f : 0.35f), .percentage_to_next_tile=0.0f });
+	path->tiles = NULL; // now managed by the animation system
+
+	if (unit->is_npc) {
+		hexmap_set_tile_effect(&battle->map, unit->pos, HEXMAP_TILE_EFFECT_ATTACKABLE);
+		hexmap_set_tile_effect(&battle->map, path->start, HEXMAP_TILE_EFFECT_NONE);
+	} else {
+		highlight_reachable_tiles(unit->pos, battle->player_movement_this_turn);
 	}
-	case GS_TURN_PLAYER_IN_PROGRESS: {
-		(void)add_cards_to_hand(dt); // TODO: we are doing this here and in TURN_PLAYER_BEGIN...
-		struct input_drag_s *drag = &g_engine->input_drag;
-		int is_on_button_end_turn = drag_in_rect(drag, g_button_end_turn.x, g_button_end_turn.y, g_button_end_turn.w, g_button_end_turn.h);
-		int is_dragging_card = (g_selected_card != 0 && ecs_is_valid(g_world, g_selected_card));
-
-		if (!is_on_button_end_turn && !is_dragging_card && drag->state == INPUT_DRAG_END) {
-			// Highlight & pathfind
-			vec3s p_begin = screen_to_world(g_engine->window_width, g_engine->window_height, g_camera.projection, g_camera.view, g_engine->input_drag.begin_x, g_engine->input_drag.begin_y);
-			vec3s p_end = screen_to_world(g_engine->window_width, g_engine->window_height, g_camera.projection, g_camera.view, g_engine->input_drag.end_x, g_engine->input_drag.end_y);
-			struct hexcoord click_begin_coord = hexmap_world_position_to_coord(&g_hexmap, (vec2s){ .x=p_begin.x, .y=p_begin.z });
-			struct hexcoord click_end_coord = hexmap_world_position_to_coord(&g_hexmap, (vec2s){ .x=p_end.x, .y=p_end.z });
-			if (hexmap_is_valid_coord(&g_hexmap, click_begin_coord) && hexmap_is_valid_coord(&g_hexmap, click_end_coord) && hexcoord_equal(click_begin_coord, click_end_coord)) {
-				ecs_entity_t occupied_by = hexmap_tile_at(&g_hexmap, click_begin_coord)->occupied_by;
-				if (occupied_by != 0 && ecs_is_valid(g_world, occupied_by)) {
-					struct hexmap_path path_to_neighbor;
-					enum hexmap_path_result path_found =
-						hexmap_path_find_ex(&g_hexmap, *ecs_get(g_world, g_player, c_position), click_begin_coord, PATH_FLAGS_FIND_NEIGHBOR, &path_to_neighbor);
-
-					if (path_found == HEXMAP_PATH_OK) {
-						if (path_to_neighbor.distance_in_tiles == 0) {
-							const int basic_attacks_in_hand = count_handcards_of_kind(CARD_KIND_BASIC_ATTACK);
-							if (basic_attacks_in_hand == 0) {
-								console_log_ex(g_engine, CONSOLE_MSG_ERROR, 2.0f, "No Basic Attacks in Hand!");
-							} else if (basic_attacks_in_hand >= 1) {
-								// TODO: let the player choose a card if multiple basic attacks in hand!
-								console_log_ex(g_engine, CONSOLE_MSG_SUCCESS, 2.0f, "Attacking");
-								ecs_entity_t card = find_any_handcard_of_kind(CARD_KIND_BASIC_ATTACK);
-								assert(card != 0 && ecs_is_valid(g_world, card));
-								on_game_event((struct game_event){ .type=EVENT_ATTACK_ENTITY, .attack_entity={
-									.attacker=g_player, .victim=occupied_by, .initiated_by_card=card } });
-							}
-						} else if (path_to_neighbor.distance_in_tiles <= g_player_movement_this_turn) {
-							console_log_ex(g_engine, CONSOLE_MSG_INFO, 2.0f, "Moving into attack range");
-							on_game_event((struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=g_player, .goal=path_to_neighbor.goal } });
-							// TODO: Also attack, after moving completed.
-						} else {
-							console_log_ex(g_engine, CONSOLE_MSG_ERROR, 2.0f, "Not enough movement.");
-						}
-					}
-					hexmap_path_destroy(&path_to_neighbor);
-				} else {
-					on_game_event((struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=g_player, .goal=click_end_coord } });
-				}
-			}
-		}
-		interact_with_handcards(&g_engine->input_drag);
-		int clicked_on_button_end_turn = drag_clicked_in_rect(drag, g_button_end_turn.x, g_button_end_turn.y, g_button_end_turn.w, g_button_end_turn.h);
-		if (clicked_on_button_end_turn) {
-			g_next_gamestate = GS_TURN_PLAYER_END;
-		}
-		break;
+}
+
+static void on_message(struct battle *battle, enum battle_message level, const char *text) {
+	switch (level) {
+		case BATTLE_MSG_INFO:
+			console_log_ex(g_engine, CONSOLE_MSG_INFO, 2.0f, "%s", text);
+			break;
+		case BATTLE_MSG_SUCCESS:
+			console_log_ex(g_engine, CONSOLE_MSG_SUCCESS, 1.0f, "%s", text);
+			break;
+		case BATTLE_MSG_ERROR:
+			console_log_ex(g_engine, CONSOLE_MSG_ERROR, 2.0f, "%s", text);
+			break;
 	}
-	case GS_TURN_PLAYER_END:
-		if (hexmap_is_valid_coord(&g_hexmap, *player_coord)) {
-			hexmap_set_tile_effect(&g_hexmap, *player_coord, HEXMAP_TILE_EFFECT_NONE);
-		}
-		hexmap_clear_tile_effect(&g_hexmap, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
-		g_next_gamestate = GS_TURN_ENTITY_BEGIN;
-		break;
-	case GS_TURN_ENTITY_BEGIN:
-		g_next_gamestate = GS_TURN_ENTITY_IN_PROGRESS;
-		break;
-	case GS_TURN_ENTITY_IN_PROGRESS:
-		g_next_gamestate = GS_TURN_ENTITY_END;
-		break;
-	case GS_TURN_ENTITY_END:
-		g_next_gamestate = GS_ROUND_END;
-		break;
-	case GS_ROUND_END:
-		g_next_gamestate = GS_ROUND_BEGIN;
-		break;
-	case GS_BATTLE_END:
-		break;
-	};
 }
 
 static void highlight_reachable_tiles(struct hexcoord origin, usize distance) {
 	// Regenerate flow field
-	usize flowfield[g_hexmap.w * g_hexmap.h];
-	hexmap_generate_flowfield(&g_hexmap, origin, count_of(flowfield), flowfield);
+	usize flowfield[g_battle.map.w * g_battle.map.h];
+	hexmap_generate_flowfield(&g_battle.map, origin, count_of(flowfield), flowfield);
 	// highlight new movement range
-	hexmap_clear_tile_effect(&g_hexmap, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
+	hexmap_clear_tile_effect(&g_battle.map, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
 	if (distance >= 1) {
-		hexmap_set_tile_effect(&g_hexmap, origin, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
+		hexmap_set_tile_effect(&g_battle.map, origin, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
 	}
-	for (usize i = 0; i < (usize)g_hexmap.w * g_hexmap.h; ++i) {
-		struct hexcoord coord = hexmap_index_to_coord(&g_hexmap, i);
-		usize distance_to_reachable = hexmap_flowfield_distance(&g_hexmap, coord, count_of(flowfield), flowfield);
+	for (usize i = 0; i < (usize)g_battle.map.w * g_battle.map.h; ++i) {
+		struct hexcoord coord = hexmap_index_to_coord(&g_battle.map, i);
+		usize distance_to_reachable = hexmap_flowfield_distance(&g_battle.map, coord, count_of(flowfield), flowfield);
 		if (distance_to_reachable >= 1 && distance_to_reachable <= distance) {
-			hexmap_set_tile_effect(&g_hexmap, coord, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
+			hexmap_set_tile_effect(&g_battle.map, coord, HEXMAP_TILE_EFFECT_MOVEABLE_AREA);
 		}
 	}
 }
 
-static void trigger_card_effect(c_card *card, enum effect_trigger trigger) {
-	switch (trigger) {
-		case TRIGGER_DRAW_CARD:
-			break;
-		case TRIGGER_PLAY_CARD: {
-			// TODO: Find a better way to identify cards, image_id is obviously not the answer...
-			if (card->image_id == 1) {
-				c_health *health = ecs_get_mut(g_world, g_player, c_health);
-				int heal_until_max = health->max_hp - health->hp;
-				int heal_for = (heal_until_max > 2 ? 2 : heal_until_max);
-				if (heal_for <= 0) {
-					console_log_ex(g_engine, CONSOLE_MSG_ERROR, 1.0f, "Already at full HP");
-				}
-				health->hp += heal_for;
-				ecs_modified(g_world, g_player, c_health);
-				console_log_ex(g_engine, CONSOLE_MSG_SUCCESS, 1.0f, "Healed for %d HP", heal_for);
-			} else if (card->image_id == 5) {
-				spawn_random_card();
-				spawn_random_card();
-			}
-			break;
-		}
-		case TRIGGER_DISCARD_CARD:
-			console_log(g_engine, "Discarded Card %s", card->name);
-			break;
-	};
-}
-
 static void recalculate_handcards(void) {
 	// count number of cards
 	int cards_count = 0;
@@ -868,14 +725,14 @@ static void draw_ui(pipeline_t *pipeline) {
 	pipeline_reset(pipeline);
 	pipeline_reset(&g_cards_pipeline);
 
-	ecs_run(g_world, ecs_id(system_draw_healthbars), g_engine->dt, NULL);
+	PROFILER_ECS_RUN(g_world, system_draw_healthbars, g_engine->dt, NULL);
 
 	// Draw UI - borders & elements
 	draw_hud(pipeline);
 
 	glDisable(GL_DEPTH_TEST);
 	pipeline_draw_ortho(pipeline, g_engine->window_width, g_engine->window_height);
-	ecs_run(g_world, ecs_id(system_draw_cards), g_engine->dt, NULL);
+	PROFILER_ECS_RUN(g_world, system_draw_cards, g_engine->dt, NULL);
 
 	{ // Draw UI - Portrait
 		// TODO: this doesn't write to gbuffer, but rather renders with no lighting.
@@ -896,7 +753,7 @@ static void draw_ui(pipeline_t *pipeline) {
 		glm_translate(model, (vec3){12, 90, 0});
 		pipeline_set_transform(&g_text_pipeline, model);
 		pipeline_reset(&g_text_pipeline);
-		fontatlas_writef_ex(&g_card_font, &g_text_pipeline, 0, 0, "$1Movement: $B%d", g_player_movement_this_turn);
+		fontatlas_writef_ex(&g_card_font, &g_text_pipeline, 0, 0, "$1Movement: $B%d", g_battle.player_movement_this_turn);
 		pipeline_draw_ortho(&g_text_pipeline, g_engine->window_width, g_engine->window_height);
 	}
 
@@ -959,7 +816,7 @@ static void draw_hud(pipeline_t *pipeline) {
 	drawcmd_set_texture_subrect(&cmd, pipeline->texture, 64, 0, 64, 32);
 	pipeline_emit(pipeline, &cmd);
 	// health
-	const c_health *player_health = ecs_get(g_world, g_player, c_health);
+	const struct battle_unit *player_health = battle_unit(&g_battle, g_battle.player);
 	float player_health_pct = (float)player_health->hp / player_health->max_hp;
 	cmd = DRAWCMD_INIT;
 	cmd.size.x = 36*3 * player_health_pct;
@@ -989,10 +846,10 @@ static void draw_hud(pipeline_t *pipeline) {
 	pipeline_emit(pipeline, &cmd);
 
 	// Draw "End turn" button
-	if (g_gamestate == GS_TURN_PLAYER_IN_PROGRESS) {
+	if (g_battle.state == GS_TURN_PLAYER_IN_PROGRESS) {
 		int is_on_button_end_turn = drag_in_rect(&g_engine->input_drag, g_button_end_turn.x, g_button_end_turn.y, g_button_end_turn.w, g_button_end_turn.h);
 		char button_text[16];
-		snprintf(button_text, 16, "End turn %ld", g_turn_count);
+		snprintf(button_text, 16, "End turn %ld", g_battle.turn_count);
 
 		NVGcontext *vg = g_engine->vg;
 		nvgBeginPath(vg);
@@ -1018,29 +875,29 @@ static void draw_hud(pipeline_t *pipeline) {
 	if (g_debug_draw_pathfinder) {
 		// draw neighbors & edges
 		NVGcontext *vg = g_engine->vg;
-		usize n_tiles = (usize)g_hexmap.w * g_hexmap.h;
+		usize n_tiles = (usize)g_battle.map.w * g_battle.map.h;
 		for (usize i = 0; i < n_tiles; ++i) {
 			int edges_count = 0;
-			while (g_hexmap.edges[i + n_tiles * edges_count] < n_tiles && edges_count < 6) {
+			while (edges_count < HEXMAP_MAX_EDGES && g_battle.map.edges[i + n_tiles * edges_count] < n_tiles) {
 				++edges_count;
 			}
 
-			vec2s wp = hexmap_index_to_world_position(&g_hexmap, i);
+			vec2s wp = hexmap_index_to_world_position(&g_battle.map, i);
 			vec3s p = (vec3s){{ wp.x, 0.0f, wp.y }};
 			vec2s screen_pos = world_to_screen_camera(g_engine, &g_camera, GLM_MAT4_IDENTITY, p);
 
 			// movement cost (center)
-			float movecost_pct = g_hexmap.tiles[i].movement_cost < HEXMAP_MOVEMENT_COST_MAX ? 1.0f : 0.0f;
+			float movecost_pct = g_battle.map.tiles[i].movement_cost < HEXMAP_MOVEMENT_COST_MAX ? 1.0f : 0.0f;
 			nvgBeginPath(vg);
 			nvgFillColor(vg, nvgRGBf(1.0f - movecost_pct, movecost_pct, 0.0f));
 			nvgTextAlign(vg, NVG_ALIGN_CENTER | NVG_ALIGN_MIDDLE);
 			nvgFontSize(vg, 12.0f);
 			char movecost_text[32];
-			if (hexmap_is_tile_obstacle(&g_hexmap, hexmap_index_to_coord(&g_hexmap, i))) {
+			if (hexmap_is_tile_obstacle(&g_battle.map, hexmap_index_to_coord(&g_battle.map, i))) {
 				nvgFillColor(vg, nvgRGB(255, 0, 0));
 				sprintf(movecost_text, "#");
 			} else {
-				sprintf(movecost_text, "%d", g_hexmap.tiles[i].movement_cost);
+				sprintf(movecost_text, "%d", g_battle.map.tiles[i].movement_cost);
 			}
 			nvgText(vg, screen_pos.x, screen_pos.y, movecost_text, NULL);
 
@@ -1070,137 +927,6 @@ static void draw_hud(pipeline_t *pipeline) {
 }
 
 
-static void on_game_event(struct game_event event) {
-	switch (event.type) {
-	case EVENT_PLAY_CARD:
-		on_game_event_play_card(event);
-		break;
-	case EVENT_MOVE_ENTITY: {
-		const c_position start = *ecs_get(g_world, event.move_entity.entity, c_position);
-		struct hexmap_path path;
-		if (HEXMAP_PATH_OK == hexmap_path_find(&g_hexmap, start, event.move_entity.goal, &path)) {
-			if (path.distance_in_tiles >= 1 && path.distance_in_tiles <= g_player_movement_this_turn) {
-				hexmap_tile_at(&g_hexmap, event.move_entity.goal)->occupied_by = g_player;
-				hexmap_tile_at(&g_hexmap, start)->occupied_by = 0;
-				g_player_movement_this_turn -= path.distance_in_tiles;
-				highlight_reachable_tiles(event.move_entity.goal, g_player_movement_this_turn);
-
-				ecs_set(g_world, g_player, c_tile_offset, { .x=0.0f, .y=0.0f, .z=0.0f });
-				ecs_set(g_world, g_player, c_move_along_path, { .path=path, .current_tile=0, .duration_per_tile=0.35f, .percentage_to_next_tile=0.0f });
-				// We don't hexmap_path_destroy(), this is now managed by the animation system
-			} else {
-				hexmap_path_destroy(&path);
-			}
-		}
-		break;
-	}
-	case EVENT_ATTACK_ENTITY: {
-		assert(event.attack_entity.initiated_by_card != 0 && ecs_is_valid(g_world, event.attack_entity.initiated_by_card));
-		const c_card *card = ecs_get(g_world, event.attack_entity.initiated_by_card, c_card);
-		const int deals_damage = card->damage.basic;
-		on_game_event((struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=g_player, .card=event.attack_entity.initiated_by_card } });
-		card = NULL; // gets removed by on_game_event()
-		ecs_entity_t victim = event.attack_entity.victim;
-		c_health *victim_health = ecs_get_mut(g_world, victim, c_health);
-		// Determine attack damage
-		const int victim_hp = (int)victim_health->hp;
-		const int damage_dealt = GLM_MIN(victim_hp, deals_damage);
-		//const int damage_overkill = deals_damage - damage_dealt;
-		victim_health->hp -= damage_dealt;
-		ecs_modified(g_world, victim, c_health);
-		console_log_ex(g_engine, CONSOLE_MSG_ERROR, 1.0f, "Dealt %d damage.", damage_dealt);
-		break;
-	}
-	case EVENT_TYPE_MAX: break;
-	};
-}
-
-
-static void on_game_event_play_card(struct game_event event) {
-	assert(event.type == EVENT_PLAY_CARD);
-	assert(event.play_card.card != 0);
-	assert(ecs_is_valid(g_world, event.play_card.card));
-
-	ecs_entity_t card_entity = event.play_card.card;
-	c_card *card = ecs_get_mut(g_world, card_entity, c_card);
-
-	// TODO: Do something with card
-	trigger_card_effect(card, TRIGGER_PLAY_CARD);
-
-	// Old code, prevent placing card.
-	/*
-	c_handcard *handcard = ecs_get_mut(g_world, card_entity, c_handcard);
-	if (card->image_id == 1) {
-		c_health *health = ecs_get_mut(g_world, g_player, c_health);
-		int heal_until_max = health->max_hp - health->hp;
-		int heal_for = (heal_until_max > 2 ? 2 : heal_until_max);
-		if (heal_for <= 0) {
-			// TODO: Deny placing card, better way?
-			handcard->can_be_placed = 0;
-			handcard->is_selected = CS_NOT_SELECTED;
-			handcard->hand_space = HANDCARD_SPACE_DEFAULT;
-			ecs_modified(g_world, card_entity, c_handcard);
-			g_selected_card = 0;
-
-			console_log_ex(g_engine, CONSOLE_MSG_SUCCESS, 1.0f, "Already at full HP");
-			return;
-		}
-		health->hp += heal_for;
-		ecs_modified(g_world, g_player, c_health);
-		console_log_ex(g_engine, CONSOLE_MSG_SUCCESS, 1.0f, "Healed for %d HP", heal_for);
-	}
-	*/
-
-	// remove card
-	ecs_delete(g_world, event.play_card.card);
-	g_selected_card = 0;
-}
-
-static int count_cards(void) {
-	ecs_filter_t *filter = ecs_filter_init(g_world, &(ecs_filter_desc_t){
-		.terms = {
-			{ .id = ecs_id(c_card) },
-		},
-	});
-	ecs_iter_t it = ecs_filter_iter(g_world, filter);
-	int count = 0;
-	while (ecs_filter_next(&it)) {
-		count += it.count;
-	}
-	ecs_filter_fini(filter);
-	return count;
-}
-
-static int count_handcards_of_kind(enum card_kind kind) {
-	int count = 0;
-	ecs_iter_t it = ecs_query_iter(g_world, g_ordered_handcards);
-	while (ecs_query_next(&it)) {
-		c_card *cards = ecs_field(&it, c_card, 1);
-		// c_handcard *handcards = ecs_field(&it, c_handcard, 2);
-		for (int i = 0; i < it.count; ++i) {
-			if (cards[i].kind == kind) {
-				++count;
-			}
-		}
-	}
-	return count;
-}
-
-static ecs_entity_t find_any_handcard_of_kind(enum card_kind kind) {
-	ecs_iter_t it = ecs_query_iter(g_world, g_ordered_handcards);
-	while (ecs_query_next(&it)) {
-		c_card *cards = ecs_field(&it, c_card, 1);
-		// c_handcard *handcards = ecs_field(&it, c_handcard, 2);
-		for (int i = 0; i < it.count; ++i) {
-			if (cards[i].kind == kind) {
-				while (ecs_query_next(&it)) { /* Exhaust iterator */ };
-				return it.entities[i];
-			}
-		}
-	}
-	return 0;
-}
-
 static void interact_with_handcards(struct input_drag_s *drag) {
 	// pick up card
 	if (drag->state == INPUT_DRAG_BEGIN) {
@@ -1221,8 +947,9 @@ static void interact_with_handcards(struct input_drag_s *drag) {
 		if (g_selected_card != 0 && ecs_is_valid(g_world, g_selected_card)) {
 			c_handcard *hc = ecs_get_mut(g_world, g_selected_card, c_handcard);
 
-			if (hc->can_be_placed) {
-				on_game_event((struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=g_player, .card=g_selected_card } });
+			const c_battle_id *card_id = ecs_get(g_world, g_selected_card, c_battle_id);
+			if (hc->can_be_placed && 0 == battle_on_game_event(&g_battle, (struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=g_battle.player, .card=*card_id } })) {
+				// the card entity is gone, see on_card_removed()
 			} else {
 				hc->hand_space = HANDCARD_SPACE_DEFAULT;
 				hc->is_selected = CS_NOT_SELECTED;
@@ -1250,8 +977,9 @@ static void interact_with_handcards(struct input_drag_s *drag) {
 	}
 }
 
-int add_cards_to_hand(float dt) {
-	int done = 0;
+// moves one drawn card into the hand every now and then.
+// returns 1 once no drawn card is waiting anymore.
+static int add_cards_to_hand(float dt) {
 	ecs_filter_t *filter = ecs_filter_init(g_world, &(ecs_filter_desc_t){
 		.terms = {
 			{ .id = ecs_id(c_card) },
@@ -1259,40 +987,28 @@ int add_cards_to_hand(float dt) {
 			{ .id = ecs_id(c_handcard), .oper = EcsNot },
 		},
 	});
+	ecs_entity_t waiting = 0;
+	ecs_iter_t it = ecs_filter_iter(g_world, filter);
+	while (ecs_filter_next(&it)) {
+		if (it.count > 0 && waiting == 0) {
+			waiting = it.entities[0];
+		}
+	}
+	ecs_filter_fini(filter);
+
+	if (waiting == 0) {
+		return 1;
+	}
 
 	const float card_add_speed = 0.25f;
 	g_pickup_next_card += dt;
 	if (g_pickup_next_card >= card_add_speed) {
 		g_pickup_next_card -= card_add_speed;
-		
-		ecs_iter_t it = ecs_filter_iter(g_world, filter);
-		int has_entity = 0;
-		while (ecs_filter_next(&it)) {
-			if (it.count > 0) {
-				has_entity = 1;
-				ecs_entity_t e = it.entities[0];
-				ecs_set(g_world, e, c_handcard, { .hand_space = HANDCARD_SPACE_DEFAULT, .hand_target_pos = {0}, .is_selected = CS_NOT_SELECTED, .added_at_time=g_engine->time_elapsed });
-				ecs_set(g_world, e, c_pos2d, { .x = g_engine->window_width, .y = g_engine->window_height * 0.9f });
-				Mix_PlayChannel(-1, g_place_card_sfx, 0);
-				trigger_card_effect(ecs_get_mut(g_world, e, c_card), TRIGGER_DRAW_CARD);
-			}
-		}
-		if (!has_entity) {
-			done = 1;
-		}
-		while (ecs_filter_next(&it)); // exhaust iterator. TODO: better way?
+		ecs_set(g_world, waiting, c_handcard, { .hand_space = HANDCARD_SPACE_DEFAULT, .hand_target_pos = {0}, .is_selected = CS_NOT_SELECTED, .added_at_time=g_engine->time_elapsed });
+		ecs_set(g_world, waiting, c_pos2d, { .x = g_engine->window_width, .y = g_engine->window_height * 0.9f });
+		Mix_PlayChannel(-1, g_place_card_sfx, 0);
 	}
-	ecs_filter_fini(filter);
-
-	return done;
-}
-
-static ecs_entity_t spawn_random_card(void) {
-	int n = rng_i() % g_base_cards_len;
-	ecs_entity_t e = ecs_new_id(g_world);
-	c_card random_card = g_base_cards[n];
-	ecs_set_ptr(g_world, e, c_card, &random_card);
-	return e;
+	return 0;
 }
 
 //
@@ -1455,7 +1171,7 @@ static void system_draw_board_entities(ecs_iter_t *it) {
 		c_model *model = &it_models[i];
 		c_tile_offset *tile_offset = (it_offsets == NULL ? NULL : &it_offsets[i]);
 
-		vec2s offset = hexmap_coord_to_world_position(&g_hexmap, pos);
+		vec2s offset = hexmap_coord_to_world_position(&g_battle.map, pos);
 		vec3s world_pos = { .x=offset.x, .y=0.0f, .z=offset.y };
 		if (tile_offset != NULL) {
 			glm_vec3_add(world_pos.raw, tile_offset->raw, world_pos.raw);
@@ -1521,17 +1237,17 @@ static void system_draw_board_entities(ecs_iter_t *it) {
 
 static void system_draw_healthbars(ecs_iter_t *it) {
 	c_position *it_position   = ecs_field(it, c_position, 1);
-	c_health   *it_health     = ecs_field(it, c_health,   2);
+	c_battle_id *it_unit_id   = ecs_field(it, c_battle_id, 2);
 	c_tile_offset *it_offsets = (ecs_field_is_set(it,     3) ? ecs_field(it, c_tile_offset, 3) : NULL);
 	for (int i = 0; i < it->count; ++i) {
 		c_position pos = it_position[i];
-		c_health health = it_health[i];
+		const struct battle_unit *health = battle_unit(&g_battle, it_unit_id[i]);
 		c_tile_offset *tile_offset = (it_offsets == NULL ? NULL : &it_offsets[i]);
 
-		float health_pct = (float)health.hp / health.max_hp;
+		float health_pct = (float)health->hp / health->max_hp;
 
 		// Enemy healthbar
-		vec2s worldpos_xz = hexmap_coord_to_world_position(&g_hexmap, pos);
+		vec2s worldpos_xz = hexmap_coord_to_world_position(&g_battle.map, pos);
 		vec3s worldpos = { .x=worldpos_xz.x, .y=0.0f, .z=worldpos_xz.y};
 		if (tile_offset != NULL) {
 			glm_vec3_add(worldpos.raw, tile_offset->raw, worldpos.raw);
@@ -1558,42 +1274,6 @@ static void system_draw_healthbars(ecs_iter_t *it) {
 	}
 }
 
-static void system_enemy_turn(ecs_iter_t *it) {
-	c_position *it_position = ecs_field(it, c_position,  1);
-	c_npc      *it_npc      = ecs_field(it, c_npc,       2);
-	for (int i = 0; i < it->count; ++i) {
-		ecs_entity_t e = it->entities[i];
-		c_position *pos = &it_position[i];
-		c_npc npc = it_npc[i];
-
-		// Move to a random neighbor
-		struct hexcoord random_neighbor;
-		uint iterations = HEXMAP_MAX_NEIGHBORS;
-		int start = rng_i() % (HEXMAP_N_LAST - HEXMAP_N_FIRST + 1);
-		do {
-			random_neighbor = hexmap_get_neighbor_coord(&g_hexmap, *pos, (start + iterations) % (HEXMAP_N_LAST + 1));
-			if (iterations - 1 == 0) {
-				console_log_ex(g_engine, CONSOLE_MSG_ERROR, 2.0f, "Enemy has 0 valid neighbors?!");
-			}
-		} while (iterations-- > 0 && (!hexmap_is_valid_coord(&g_hexmap, random_neighbor) || hexmap_is_tile_obstacle(&g_hexmap, random_neighbor)));
-
-		if (hexmap_is_valid_coord(&g_hexmap, random_neighbor) && !hexmap_is_tile_obstacle(&g_hexmap, random_neighbor)) {
-			struct hexmap_path path;
-			enum hexmap_path_result result = hexmap_path_find(&g_hexmap, *pos, random_neighbor, &path);
-			assert(result == HEXMAP_PATH_OK);
-			ecs_set(g_world, e, c_tile_offset, { .x=0.0f, .y=0.0f, .z=0.0f });
-			ecs_set(g_world, e, c_move_along_path, { .path=path, .current_tile=0, .duration_per_tile=0.5f, .percentage_to_next_tile=0.0f });
-
-			hexmap_tile_at(&g_hexmap, random_neighbor)->occupied_by = e;
-			hexmap_tile_at(&g_hexmap, *pos)->occupied_by = 0;
-			hexmap_set_tile_effect(&g_hexmap, random_neighbor, HEXMAP_TILE_EFFECT_ATTACKABLE);
-			hexmap_set_tile_effect(&g_hexmap, *pos, HEXMAP_TILE_EFFECT_NONE);
-		} else {
-			console_log_ex(g_engine, CONSOLE_MSG_ERROR, 2.0f, "Did not move?");
-		}
-	}
-}
-
 static void system_move_along_path(ecs_iter_t *it) {
 	c_position        *it_position  = ecs_field(it, c_position,        1);
 	c_tile_offset     *it_offset    = ecs_field(it, c_tile_offset,     2);
@@ -1605,7 +1285,7 @@ static void system_move_along_path(ecs_iter_t *it) {
 		c_move_along_path *move_path = &it_move_path[i];
 
 		usize previous_tile = (move_path->current_tile == 0)
-					? hexmap_coord_to_index(&g_hexmap, move_path->path.start)
+					? hexmap_coord_to_index(&g_battle.map, move_path->path.start)
 					: hexmap_path_at(&move_path->path, move_path->current_tile - 1);
 		usize next_tile = hexmap_path_at(&move_path->path, move_path->current_tile);
 
@@ -1613,13 +1293,13 @@ static void system_move_along_path(ecs_iter_t *it) {
 			++move_path->current_tile;
 			if (move_path->current_tile < move_path->path.distance_in_tiles) {
 				// next node
-				*pos = hexmap_index_to_coord(&g_hexmap, next_tile);
+				*pos = hexmap_index_to_coord(&g_battle.map, next_tile);
 				move_path->percentage_to_next_tile -= move_path->duration_per_tile;
 				ecs_set(g_world, e, c_tile_offset, { .x=0.0f, .y=0.0f, .z=0.0f });
 			} else {
 				// goal reached
 				//*pos = move_path->path.goal;
-				*pos = hexmap_index_to_coord(&g_hexmap, next_tile);
+				*pos = hexmap_index_to_coord(&g_battle.map, next_tile);
 				hexmap_path_destroy(&move_path->path);
 				ecs_remove(g_world, e, c_move_along_path);
 				ecs_remove(g_world, e, c_tile_offset);
@@ -1627,8 +1307,8 @@ static void system_move_along_path(ecs_iter_t *it) {
 			}
 		}
 
-		vec2s previous_tile_pos = hexmap_index_to_world_position(&g_hexmap, previous_tile);
-		vec2s next_tile_pos = hexmap_index_to_world_position(&g_hexmap, next_tile);
+		vec2s previous_tile_pos = hexmap_index_to_world_position(&g_battle.map, previous_tile);
+		vec2s next_tile_pos = hexmap_index_to_world_position(&g_battle.map, next_tile);
 		// calculate movement delta to next tile
 		vec2 to_next;
 		glm_vec2_sub(next_tile_pos.raw, previous_tile_pos.raw, to_next);
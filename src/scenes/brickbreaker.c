@@ -433,18 +433,15 @@ static void destroy(struct scene_brickbreaker_s *scene, struct engine *engine) {
 static void update(struct scene_brickbreaker_s *scene, struct engine *engine, float dt) {
 	wsize = (vec2s){ .x = engine->window_width, .y = engine->window_height };
 
-	const float FIXED_TIME_STEP = (1.0f / 60.0f);
-	static float accumulator = 0.0f;
-	accumulator += dt;
-
-	while (accumulator >= FIXED_TIME_STEP) {
-		switch (G.state) {
-			case GS_SHOP      : update_gs_shop(FIXED_TIME_STEP); break;
-			case GS_FLYING    : update_gs_flying(FIXED_TIME_STEP); break;
-			case GS_MAX       : break;
-		};
-		accumulator -= FIXED_TIME_STEP;
-	}
+	g_time_elapsed += dt;
+}
+
+static void tick(struct scene_brickbreaker_s *scene, struct engine *engine, float dt) {
+	switch (G.state) {
+		case GS_SHOP      : update_gs_shop(dt); break;
+		case GS_FLYING    : update_gs_flying(dt); break;
+		case GS_MAX       : break;
+	};
 
 	// Update particles
 	for (int i = 0; i < G.particles_count; ++i) {
@@ -458,11 +455,9 @@ static void update(struct scene_brickbreaker_s *scene, struct engine *engine, fl
 		glm_vec2_add(p->p.raw, p->v.raw, p->p.raw);
 		glm_vec2_scale(p->v.raw, 0.97f, p->v.raw);
 	}
-
-	g_time_elapsed += dt;
 }
 
-static void draw(struct scene_brickbreaker_s *scene, struct engine *engine) {
+static void draw(struct scene_brickbreaker_s *scene, struct engine *engine, float alpha) {
 	draw_background_stars();
 
 	// Draw Asteroids
@@ -506,6 +501,7 @@ void scene_brickbreaker_init(struct scene_brickbreaker_s *scene, struct engine *
 	scene->base.load    = (scene_load_fn)load;
 	scene->base.destroy = (scene_destroy_fn)destroy;
 	scene->base.update  = (scene_update_fn)update;
+	scene->base.tick    = (scene_tick_fn)tick;
 	scene->base.draw    = (scene_draw_fn)draw;
 }
 
@@ -299,7 +299,7 @@ static void update(struct scene_experiments_s *scene, struct engine *engine, flo
 	camera_pos[1] = engine->window_height * 0.5f;
 }
 
-static void draw(struct scene_experiments_s *scene, struct engine *engine) {
+static void draw(struct scene_experiments_s *scene, struct engine *engine, float alpha) {
 	const float W = engine->window_width;
 	const float H = engine->window_height;
 	NVGcontext *vg = engine->vg;
@@ -38,7 +38,7 @@ static void game_update(struct scene_game_s *game, struct engine *engine, float
 
 }
 
-static void game_draw(struct scene_game_s *game, struct engine *engine) {
+static void game_draw(struct scene_game_s *game, struct engine *engine, float alpha) {
 	terrain_draw(&game->terrain, engine);
 }
 
@@ -47,7 +47,7 @@ static inline float ease_out_expo(float n) {
 	return 1.0 - pow(2.0, -10.0 * n);
 }
 
-static void intro_draw(struct scene_intro_s *scene, struct engine *engine) {
+static void intro_draw(struct scene_intro_s *scene, struct engine *engine, float alpha) {
 	engine_set_clear_color(0.24f, 0.58f, 1.0f);
 	int mx, my;
 	const Uint32 buttons = SDL_GetMouseState(&mx, &my);
@@ -203,7 +203,7 @@ static void update(struct scene_menu *menu, struct engine *engine, float dt) {
 	}
 }
 
-static void draw(struct scene_menu *menu, struct engine *engine) {
+static void draw(struct scene_menu *menu, struct engine *engine, float alpha) {
 	NVGcontext *vg = engine->vg;
 	const float W2 = engine->window_width * 0.5f;
 	const float H2 = engine->window_height * 0.5f;
@@ -528,6 +528,8 @@ static void on_message(struct scene_menu *menu, struct engine *engine, struct me
 		case LOBBY_CREATE_REQUEST:
 		case LOBBY_JOIN_REQUEST:
 		case LOBBY_LIST_REQUEST:
+		case BATTLE_SNAPSHOT:
+		case BATTLE_SNAPSHOT_ACK:
 			fprintf(stderr, "Can't handle message %s...\n", message_type_to_name(msg->type));
 			break;
 	}
@@ -656,7 +658,7 @@ static void on_begin_search_friends(struct engine *engine) {
 	g_search_friends_text = g_search_friends_texts[1];
 
 	// TODO: remove
-	if (engine->gameserver_tcp == NULL) {
+	if (!engine->gameserver_socket.is_open) {
 		// TODO: When deployed connect to "gameserver.xn--schl-noa.com". Maybe different URL depending on native/WASM/...?
 		if (engine_gameserver_connect(engine, "localhost") == 0) {
 			console_log_ex(engine, CONSOLE_MSG_SUCCESS, 4.0f, "Connected to server");
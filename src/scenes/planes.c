@@ -12,6 +12,8 @@
 #include "engine.h"
 #include "gl/texture.h"
 #include "gl/graphics2d.h"
+#include "game/particles.h"
+#include "util/profiler.h"
 
 //
 // structs & enums
@@ -31,6 +33,18 @@
 #define MAPCHUNK_HEIGHT     20
 #define MAPCHUNK_TILESIZE   16
 
+#define COLLISION_CELL_SIZE     64.0f // has to be larger than the hit radius
+#define COLLISION_BUCKETS       1024  // power of two
+#define COLLISION_HIT_RADIUS    25.0f
+
+#define MAPGEN_WORKERS_MAX      4
+#define MAPGEN_IN_FLIGHT_MAX    32   // chunks requested but not yet added to the world
+#define MAPGEN_UPLOADS_PER_TICK 2    // chunk meshes built per update, to spread out GL uploads
+#define MAPGEN_LOOKAHEAD        1.5f // how many chunks ahead of the plane we prefetch
+
+#define PARTICLES_MAX           8192 // smoke & sparks, live outside of the ecs
+#define SPRITES_MAX             2048 // ecs sprites incl. shadows
+
 enum faction {
 	FACTION_NEUTRAL,
 	FACTION_PLAYER,
@@ -71,12 +85,18 @@ typedef struct {
 typedef struct {
 	ivec2s chunk;
 	int *tiles;
+	pipeline_t mesh; // static, built once from `tiles`
 } c_mapchunk;
 
 typedef struct {
 	vec2s p;
 } c_pos;
 
+// c_pos before the last tick, for entities moved in tick(). drawn interpolated.
+typedef struct {
+	vec2s p;
+} c_prev_pos;
+
 typedef struct {
 	vec2s vel;
 	float speed;
@@ -124,7 +144,7 @@ typedef struct {
 typedef struct {
 	float rotation;
 	vec2 vel;
-	float scale_factor;
+	float scale_factor; // per 1/60s
 } c_particle;
 
 typedef struct {
@@ -154,24 +174,46 @@ typedef struct {
 	float turn_strength;
 } c_homing;
 
+// an entry in the collision grid.
+// component pointers stay valid until the next structural change.
+struct collider {
+	ecs_entity_t entity;
+	vec2s p;
+	enum faction faction;
+	c_sprite *sprite;
+	c_healthpoints *health;
+	c_plane *plane;
+	int bucket;
+};
+
 //
 // private functions
 //
 
 static void system_move_plane(ecs_iter_t *);
 static void system_move_bullets(ecs_iter_t *);
+static void system_collide_bullets(ecs_iter_t *);
 static void system_move_particles(ecs_iter_t *);
+static void system_store_prev_pos(ecs_iter_t *);
 static void system_despawn(ecs_iter_t *);
 static void system_unsquish(ecs_iter_t *);
 static void system_spawn_plane_effects(ecs_iter_t *);
 static void system_spawn_enemies(ecs_iter_t *);
-static void system_remove_mapchunks(ecs_iter_t *);
+static void system_cull_mapchunks(ecs_iter_t *);
 static void system_animate_sprites(ecs_iter_t *);
 static void system_draw_sprites(ecs_iter_t *);
 static void system_draw_map(ecs_iter_t *);
 
 static void mapchunk_init(c_mapchunk *, int chunk_x, int chunk_y);
+static void mapchunk_build_mesh(c_mapchunk *);
 static void mapchunk_destroy(c_mapchunk *);
+static void mapchunk_needed_range(ivec2s *min, ivec2s *max);
+
+static void mapgen_start(void);
+static void mapgen_stop(void);
+static void mapgen_request_chunks(void);
+static void mapgen_collect_chunks(void);
+static int  mapgen_worker(void *);
 
 static void show_levelup_rewards(void);
 static void close_levelup_rewards(void);
@@ -183,6 +225,11 @@ static void hit_enemy(ecs_entity_t e_bullet, ecs_entity_t e_enemy, c_bullet *bul
 static void spawn_bulletshot(vec2 p, float angle, enum faction faction, float spread, float dmg, float speed);
 static void spawn_homing_shot(vec2 p, float angle, ecs_entity_t target, enum faction faction, float dmg, float speed);
 
+static void collision_grid_build(void);
+static int  collision_grid_bucket(int cell_x, int cell_y);
+
+static void particle_set_tile(struct particle_desc *, int tile_x, int tile_y, int tile_w, int tile_h);
+
 //
 // vars
 //
@@ -197,11 +244,33 @@ static texture_t g_tiles_tex;
 // rendering
 static shader_t g_planes_shader;
 static pipeline_t g_pipeline;
+static struct particle_pool g_particles;
 
 // state
 static int g_mapgen_seed;
+static struct {
+	// workers
+	SDL_Thread *workers[MAPGEN_WORKERS_MAX];
+	int workers_count;
+	SDL_mutex *mutex;
+	SDL_cond *has_requests;
+	int quit;
+
+	// queues, guarded by `mutex`.
+	ivec2s requests[MAPGEN_IN_FLIGHT_MAX];
+	int requests_count;
+	c_mapchunk results[MAPGEN_IN_FLIGHT_MAX];
+	int results_count;
+	ivec2s in_flight[MAPGEN_IN_FLIGHT_MAX];
+	int in_flight_count;
+
+	// chunks alive in the world, gathered by `system_cull_mapchunks`. main thread only.
+	ivec2s existing[256];
+	int existing_count;
+} g_mapgen;
 static int g_game_started;
 static double g_game_timer;
+static float g_game_speed; // eased slow-motion while picking rewards, scales both update & tick
 static int g_picking_rewards;
 
 static int g_level;
@@ -212,6 +281,14 @@ static reward_t g_levelup_rewards[3];
 static float g_enemy_spawn_rate;
 static float g_enemy_spawn_timer;
 
+// collision broadphase, rebuilt every tick.
+// colliders are sorted by bucket, `bucket_start[b]..bucket_start[b+1]` are the colliders in bucket `b`.
+static struct {
+	struct collider *unsorted;
+	struct collider *colliders;
+	int bucket_start[COLLISION_BUCKETS + 1];
+} g_collision_grid;
+
 // entities
 ecs_world_t *g_ecs;
 ecs_query_t *g_enemies_query;
@@ -291,6 +368,7 @@ static const reward_t g_reward_pool[] = {
 };
 
 ECS_COMPONENT_DECLARE(c_pos);
+ECS_COMPONENT_DECLARE(c_prev_pos);
 ECS_COMPONENT_DECLARE(c_bullet);
 ECS_COMPONENT_DECLARE(c_plane);
 ECS_COMPONENT_DECLARE(c_sprite);
@@ -307,12 +385,14 @@ ECS_COMPONENT_DECLARE(c_homing);
 
 ECS_SYSTEM_DECLARE(system_move_plane);
 ECS_SYSTEM_DECLARE(system_move_bullets);
+ECS_SYSTEM_DECLARE(system_collide_bullets);
 ECS_SYSTEM_DECLARE(system_move_particles);
+ECS_SYSTEM_DECLARE(system_store_prev_pos);
 ECS_SYSTEM_DECLARE(system_despawn);
 ECS_SYSTEM_DECLARE(system_unsquish);
 ECS_SYSTEM_DECLARE(system_spawn_plane_effects);
 ECS_SYSTEM_DECLARE(system_spawn_enemies);
-ECS_SYSTEM_DECLARE(system_remove_mapchunks);
+ECS_SYSTEM_DECLARE(system_cull_mapchunks);
 ECS_SYSTEM_DECLARE(system_animate_sprites);
 ECS_SYSTEM_DECLARE(system_draw_map);
 ECS_SYSTEM_DECLARE(system_draw_sprites);
@@ -331,11 +411,13 @@ static void load(struct scene_planes_s *scene, struct engine *engine) {
 
 	// rendering
 	shader_init_from_dir(&g_planes_shader, "res/shader/sprite/");
-	pipeline_init(&g_pipeline, &g_planes_shader, 2048);
+	pipeline_init(&g_pipeline, &g_planes_shader, SPRITES_MAX + PARTICLES_MAX);
+	particles_init(&g_particles, PARTICLES_MAX);
 
 	// setup state
 	g_game_started      = 0;
 	g_game_timer        = 0.0;
+	g_game_speed        = 1.0f;
 	g_picking_rewards   = 0;
 	g_level             = 0;
 	g_xp                = 0.0f;
@@ -354,6 +436,7 @@ static void load(struct scene_planes_s *scene, struct engine *engine) {
 	g_engine = engine;
 	g_ecs = ecs_init();
 	ECS_COMPONENT_DEFINE(g_ecs, c_pos);
+	ECS_COMPONENT_DEFINE(g_ecs, c_prev_pos);
 	ECS_COMPONENT_DEFINE(g_ecs, c_bullet);
 	ECS_COMPONENT_DEFINE(g_ecs, c_plane);
 	ECS_COMPONENT_DEFINE(g_ecs, c_sprite);
@@ -369,15 +452,17 @@ static void load(struct scene_planes_s *scene, struct engine *engine) {
 	ECS_COMPONENT_DEFINE(g_ecs, c_homing);
 
 	ECS_SYSTEM_DEFINE(g_ecs, system_move_plane,          0, c_pos, c_plane);
-	ECS_SYSTEM_DEFINE(g_ecs, system_move_bullets,        0, c_pos, c_bullet, c_faction, ?c_target, ?c_homing, ?c_sprite);
+	ECS_SYSTEM_DEFINE(g_ecs, system_move_bullets,        0, c_pos, c_bullet, ?c_target, ?c_homing, ?c_sprite);
+	ECS_SYSTEM_DEFINE(g_ecs, system_collide_bullets,     0, c_pos, c_bullet, c_faction);
 	ECS_SYSTEM_DEFINE(g_ecs, system_move_particles,      0, c_pos, c_particle, c_sprite, ?c_shadow); dummy:
+	ECS_SYSTEM_DEFINE(g_ecs, system_store_prev_pos,      0, c_pos, c_prev_pos);
 	ECS_SYSTEM_DEFINE(g_ecs, system_despawn,             0, c_despawn_after);
 	ECS_SYSTEM_DEFINE(g_ecs, system_unsquish,            0, c_sprite);
 	ECS_SYSTEM_DEFINE(g_ecs, system_spawn_plane_effects, 0, c_pos, c_plane);
 	ECS_SYSTEM_DEFINE(g_ecs, system_spawn_enemies,       0, c_pos, c_player);
-	ECS_SYSTEM_DEFINE(g_ecs, system_remove_mapchunks,    0, c_pos, c_mapchunk);
+	ECS_SYSTEM_DEFINE(g_ecs, system_cull_mapchunks,      0, c_pos, c_mapchunk);
 	ECS_SYSTEM_DEFINE(g_ecs, system_animate_sprites,     0, c_sprite, c_animation);
-	ECS_SYSTEM_DEFINE(g_ecs, system_draw_sprites,        0, c_pos, c_sprite, ?c_shadow); dummy2: // fix weird query syyntax problems for my lsp
+	ECS_SYSTEM_DEFINE(g_ecs, system_draw_sprites,        0, c_pos, c_sprite, ?c_shadow, ?c_prev_pos); dummy2: // fix weird query syyntax problems for my lsp
 	ECS_SYSTEM_DEFINE(g_ecs, system_draw_map,            0, c_pos, c_mapchunk);
 
 	g_enemies_query = ecs_query(g_ecs, {
@@ -431,9 +516,11 @@ static void load(struct scene_planes_s *scene, struct engine *engine) {
 			
 			c_mapchunk *chunk = ecs_get_mut(g_ecs, e, c_mapchunk);
 			mapchunk_init(chunk, x, y);
+			mapchunk_build_mesh(chunk);
 			ecs_modified(g_ecs, e, c_mapchunk);
 		}
 	}
+	mapgen_start();
 
 	// enemies
 	for (int i = 0; i < 10; ++i) {
@@ -491,6 +578,8 @@ static void load(struct scene_planes_s *scene, struct engine *engine) {
 }
 
 static void destroy(struct scene_planes_s *scene, struct engine *engine) {
+	mapgen_stop();
+
 	ecs_filter_t *f = ecs_filter(g_ecs, {
 		.terms = {
 			{ ecs_id(c_mapchunk) },
@@ -507,17 +596,30 @@ static void destroy(struct scene_planes_s *scene, struct engine *engine) {
 	}
 
 	ecs_fini(g_ecs);
+	stbds_arrfree(g_collision_grid.unsorted);
+	stbds_arrfree(g_collision_grid.colliders);
 	texture_destroy(&g_plane_tex);
 	texture_destroy(&g_tiles_tex);
 
 	shader_destroy(&g_planes_shader);
 	pipeline_destroy(&g_pipeline);
+	particles_destroy(&g_particles);
 }
 
 static void tick(struct scene_planes_s *scene, struct engine *engine, float dt) {
-	ecs_run(g_ecs, ecs_id(system_animate_sprites),     dt, NULL);
-	ecs_run(g_ecs, ecs_id(system_move_particles),      dt, NULL);
-	ecs_run(g_ecs, ecs_id(system_move_bullets),        dt, NULL);
+	if (!g_game_started) {
+		return;
+	}
+	dt *= g_game_speed;
+
+	PROFILER_ECS_RUN(g_ecs, system_store_prev_pos,      dt, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_animate_sprites,     dt, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_move_particles,      dt, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_move_bullets,        dt, NULL);
+	particles_update(&g_particles, dt);
+
+	collision_grid_build();
+	PROFILER_ECS_RUN(g_ecs, system_collide_bullets,     dt, NULL);
 }
 
 static void update(struct scene_planes_s *scene, struct engine *engine, float dt) {
@@ -531,11 +633,12 @@ static void update(struct scene_planes_s *scene, struct engine *engine, float dt
 	static float gamespeed = 1.0f;
 	if (g_picking_rewards) {
 		gamespeed = glm_max(gamespeed - 0.025f, 0.0f);
-		dt *= glm_ease_quart_in(gamespeed);
+		g_game_speed = glm_ease_quart_in(gamespeed);
 	} else {
 		gamespeed = glm_min(gamespeed + 0.035f, 1.0f);
-		dt *= glm_ease_quad_in(gamespeed);
+		g_game_speed = glm_ease_quad_in(gamespeed);
 	}
+	dt *= g_game_speed;
 
 	g_game_timer += dt;
 
@@ -581,37 +684,38 @@ static void update(struct scene_planes_s *scene, struct engine *engine, float dt
 		}
 	}
 
-	ecs_run(g_ecs, ecs_id(system_move_plane),          dt, NULL);
-	ecs_run(g_ecs, ecs_id(system_despawn),             dt, NULL);
-	ecs_run(g_ecs, ecs_id(system_unsquish),            dt, NULL);
-	ecs_run(g_ecs, ecs_id(system_spawn_plane_effects), dt, NULL);
-	ecs_run(g_ecs, ecs_id(system_remove_mapchunks),    dt, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_move_plane,          dt, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_despawn,             dt, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_unsquish,            dt, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_spawn_plane_effects, dt, NULL);
+
+	// stream the map around the player
+	g_mapgen.existing_count = 0;
+	PROFILER_ECS_RUN(g_ecs, system_cull_mapchunks,      dt, NULL);
+	mapgen_request_chunks();
+	mapgen_collect_chunks();
 
 	g_enemy_spawn_timer += dt;
 	while (g_enemy_spawn_timer >= g_enemy_spawn_rate) {
 		g_enemy_spawn_timer -= g_enemy_spawn_rate;
-		ecs_run(g_ecs, ecs_id(system_spawn_enemies), dt, NULL);
+		PROFILER_ECS_RUN(g_ecs, system_spawn_enemies, dt, NULL);
 	}
-
-	// tick 60x per second
-	const float tick_rate = 1.0f / 60.0f;
-	static float accu = 0.0f;
-	while (accu >= tick_rate) {
-		accu -= tick_rate;
-		tick(scene, engine, tick_rate);
-	}
-	accu += dt;
-	
 }
 
-static void draw(struct scene_planes_s *scene, struct engine *engine) {
+static void draw(struct scene_planes_s *scene, struct engine *engine, float alpha) {
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	ecs_run(g_ecs, ecs_id(system_draw_map), 1.0f, NULL);
-	ecs_run(g_ecs, ecs_id(system_draw_sprites), 1.0f, NULL);
+	PROFILER_ECS_RUN(g_ecs, system_draw_map, 1.0f, NULL);
+
+	// sprites & particles share one pipeline, so they are uploaded and drawn at once
+	pipeline_reset(&g_pipeline);
+	g_pipeline.texture = &g_plane_tex;
+	PROFILER_ECS_RUN(g_ecs, system_draw_sprites, 1.0f, &alpha);
+	particles_draw(&g_particles, &g_pipeline, alpha);
+	pipeline_draw(&g_pipeline, g_engine);
 
 	const float W = engine->window_width;
 	const float H = engine->window_height;
@@ -767,6 +871,7 @@ void scene_planes_init(struct scene_planes_s *scene, struct engine *engine) {
 	scene->base.load    = (scene_load_fn)load;
 	scene->base.destroy = (scene_destroy_fn)destroy;
 	scene->base.update  = (scene_update_fn)update;
+	scene->base.tick    = (scene_tick_fn)tick;
 	scene->base.draw    = (scene_draw_fn)draw;
 }
 
@@ -795,8 +900,36 @@ static int mapchunk_get(c_mapchunk *chunk, int x, int y, int *tx, int *ty) {
 	return id;
 }
 
+// chunks are generated on worker threads, so they can't use the global rng.
+// instead every chunk gets its own rng, seeded from the map seed and its
+// coordinates. this also means a chunk always looks the same, regardless of
+// the order in which chunks are generated.
+static uint32_t mapchunk_rng_seed(int chunk_x, int chunk_y) {
+	uint32_t h = (uint32_t)g_mapgen_seed;
+	h ^= (uint32_t)chunk_x * 73856093u;
+	h ^= (uint32_t)chunk_y * 19349663u;
+	// finalizer from murmurhash3
+	h ^= h >> 16; h *= 0x85ebca6bu;
+	h ^= h >> 13; h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return (h != 0 ? h : 1);
+}
+
+static int mapchunk_rng(uint32_t *state) {
+	// xorshift32
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (int)(x & 0x7FFFFFFF);
+}
+
 static void mapchunk_init(c_mapchunk *chunk, int chunk_x, int chunk_y) {
+	chunk->chunk.x = chunk_x;
+	chunk->chunk.y = chunk_y;
 	chunk->tiles = malloc(MAPCHUNK_WIDTH * MAPCHUNK_HEIGHT * sizeof(chunk->tiles[0]));
+	uint32_t rng = mapchunk_rng_seed(chunk_x, chunk_y);
 
 	for (int y = 0; y < MAPCHUNK_HEIGHT; ++y) {
 		for (int x = 0; x < MAPCHUNK_WIDTH; ++x) {
@@ -821,7 +954,7 @@ static void mapchunk_init(c_mapchunk *chunk, int chunk_x, int chunk_y) {
 				float r = stb_perlin_noise3_seed((float)global_x / 8.0f, (float)global_y / 8.0f, 0.5f, 0, 0, 0, 256 * v);
 
 				if (r > 0.4f) {
-					mapchunk_set(chunk, x, y, 0, 4 + rand() % 2);
+					mapchunk_set(chunk, x, y, 0, 4 + mapchunk_rng(&rng) % 2);
 				}
 
 				// houses
@@ -837,7 +970,7 @@ static void mapchunk_init(c_mapchunk *chunk, int chunk_x, int chunk_y) {
 
 				if (is_land && is_city) {
 					if (is_house) {
-						mapchunk_set(chunk, x, y, 0, 6 + rand() % 2);
+						mapchunk_set(chunk, x, y, 0, 6 + mapchunk_rng(&rng) % 2);
 					} else if (is_field) {
 						mapchunk_set(chunk, x, y, 1, 9);
 					}
@@ -906,15 +1039,218 @@ static void mapchunk_init(c_mapchunk *chunk, int chunk_x, int chunk_y) {
 	}
 }
 
+// tiles never change after generation, so we emit them once into
+// a chunk-owned pipeline. drawing the chunk is then a single draw call.
+// this uploads to the GPU and therefore has to run on the main thread.
+static void mapchunk_build_mesh(c_mapchunk *chunk) {
+	pipeline_init(&chunk->mesh, &g_planes_shader, MAPCHUNK_WIDTH * MAPCHUNK_HEIGHT);
+	chunk->mesh.texture = &g_tiles_tex;
+
+	const float chunk_x = chunk->chunk.x * MAPCHUNK_WIDTH * MAPCHUNK_TILESIZE;
+	const float chunk_y = chunk->chunk.y * MAPCHUNK_HEIGHT * MAPCHUNK_TILESIZE;
+
+	drawcmd_t cmd = DRAWCMD_INIT;
+	cmd.size.x = cmd.size.y = MAPCHUNK_TILESIZE;
+	for (int y = 0; y < MAPCHUNK_HEIGHT; ++y) {
+		for (int x = 0; x < MAPCHUNK_WIDTH; ++x) {
+			int tx, ty;
+			int id = mapchunk_get(chunk, x, y, &tx, &ty);
+			if (id < 0) {
+				continue;
+			}
+
+			cmd.position.x = chunk_x + (x * MAPCHUNK_TILESIZE);
+			cmd.position.y = chunk_y + (y * MAPCHUNK_TILESIZE);
+			drawcmd_set_texture_subrect_tile(&cmd, chunk->mesh.texture, MAPCHUNK_TILESIZE, MAPCHUNK_TILESIZE, tx, ty);
+			pipeline_emit(&chunk->mesh, &cmd);
+		}
+	}
+}
+
 static void mapchunk_destroy(c_mapchunk *chunk) {
 	free(chunk->tiles);
 	chunk->tiles = NULL;
+
+	pipeline_destroy(&chunk->mesh);
+}
+
+// calculates the chunks which need to exist: all chunks overlapping the
+// view, extended by `MAPGEN_LOOKAHEAD` chunks in the players heading.
+static void mapchunk_needed_range(ivec2s *min, ivec2s *max) {
+	const float chunk_w = MAPCHUNK_WIDTH * MAPCHUNK_TILESIZE;
+	const float chunk_h = MAPCHUNK_HEIGHT * MAPCHUNK_TILESIZE;
+
+	float x0 = -g_engine->u_view[3][0];
+	float y0 = -g_engine->u_view[3][1];
+	float x1 = x0 + g_engine->window_width;
+	float y1 = y0 + g_engine->window_height;
+
+	if (ecs_is_alive(g_ecs, g_player)) {
+		const c_plane *plane = ecs_get(g_ecs, g_player, c_plane);
+		const float ahead_x = cosf(plane->angle) * chunk_w * MAPGEN_LOOKAHEAD;
+		const float ahead_y = sinf(plane->angle) * chunk_h * MAPGEN_LOOKAHEAD;
+		x0 = glm_min(x0, x0 + ahead_x);
+		x1 = glm_max(x1, x1 + ahead_x);
+		y0 = glm_min(y0, y0 + ahead_y);
+		y1 = glm_max(y1, y1 + ahead_y);
+	}
+
+	min->x = (int)floorf(x0 / chunk_w);
+	min->y = (int)floorf(y0 / chunk_h);
+	max->x = (int)floorf(x1 / chunk_w);
+	max->y = (int)floorf(y1 / chunk_h);
+}
+
+//
+// map generation
+//
+
+static void mapgen_start(void) {
+	memset(&g_mapgen, 0, sizeof(g_mapgen));
+	g_mapgen.mutex = SDL_CreateMutex();
+	g_mapgen.has_requests = SDL_CreateCond();
+
+	// keep one core for the main thread.
+	int workers_count = SDL_GetCPUCount() - 1;
+	workers_count = (workers_count < 1 ? 1 : workers_count);
+	workers_count = (workers_count > MAPGEN_WORKERS_MAX ? MAPGEN_WORKERS_MAX : workers_count);
+	for (int i = 0; i < workers_count; ++i) {
+		SDL_Thread *worker = SDL_CreateThread(mapgen_worker, "mapgen", NULL);
+		if (worker == NULL) {
+			// no threads (e.g. in the browser). `mapgen_collect_chunks()` falls back to generating on the main thread.
+			break;
+		}
+		g_mapgen.workers[g_mapgen.workers_count++] = worker;
+	}
+}
+
+static void mapgen_stop(void) {
+	SDL_LockMutex(g_mapgen.mutex);
+	g_mapgen.quit = 1;
+	SDL_CondBroadcast(g_mapgen.has_requests);
+	SDL_UnlockMutex(g_mapgen.mutex);
+
+	for (int i = 0; i < g_mapgen.workers_count; ++i) {
+		SDL_WaitThread(g_mapgen.workers[i], NULL);
+	}
+	g_mapgen.workers_count = 0;
+
+	// chunks which never made it into the world. their meshes were not built yet.
+	for (int i = 0; i < g_mapgen.results_count; ++i) {
+		free(g_mapgen.results[i].tiles);
+	}
+	g_mapgen.results_count = 0;
+
+	SDL_DestroyCond(g_mapgen.has_requests);
+	SDL_DestroyMutex(g_mapgen.mutex);
+}
+
+static int mapgen_contains(ivec2s *chunks, int chunks_count, int x, int y) {
+	for (int i = 0; i < chunks_count; ++i) {
+		if (chunks[i].x == x && chunks[i].y == y) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// requests generation of all needed chunks, which neither exist nor are being generated.
+static void mapgen_request_chunks(void) {
+	ivec2s min, max;
+	mapchunk_needed_range(&min, &max);
+
+	SDL_LockMutex(g_mapgen.mutex);
+	for (int y = min.y; y <= max.y; ++y) {
+		for (int x = min.x; x <= max.x; ++x) {
+			if (g_mapgen.in_flight_count >= MAPGEN_IN_FLIGHT_MAX) {
+				break;
+			}
+			if (mapgen_contains(g_mapgen.existing, g_mapgen.existing_count, x, y)
+					|| mapgen_contains(g_mapgen.in_flight, g_mapgen.in_flight_count, x, y)) {
+				continue;
+			}
+
+			g_mapgen.in_flight[g_mapgen.in_flight_count++] = (ivec2s){ .x = x, .y = y };
+			g_mapgen.requests[g_mapgen.requests_count++] = (ivec2s){ .x = x, .y = y };
+			SDL_CondSignal(g_mapgen.has_requests);
+		}
+	}
+	SDL_UnlockMutex(g_mapgen.mutex);
+}
+
+// adds generated chunks to the world.
+static void mapgen_collect_chunks(void) {
+	// without workers, generate a single chunk per update ourselves.
+	if (g_mapgen.workers_count == 0 && g_mapgen.requests_count > 0) {
+		c_mapchunk chunk = {0};
+		const ivec2s coord = g_mapgen.requests[--g_mapgen.requests_count];
+		mapchunk_init(&chunk, coord.x, coord.y);
+		g_mapgen.results[g_mapgen.results_count++] = chunk;
+	}
+
+	c_mapchunk finished[MAPGEN_UPLOADS_PER_TICK];
+	int finished_count = 0;
+
+	SDL_LockMutex(g_mapgen.mutex);
+	while (g_mapgen.results_count > 0 && finished_count < MAPGEN_UPLOADS_PER_TICK) {
+		c_mapchunk *chunk = &g_mapgen.results[--g_mapgen.results_count];
+		finished[finished_count++] = *chunk;
+
+		// no longer in flight, swap-remove
+		for (int i = 0; i < g_mapgen.in_flight_count; ++i) {
+			if (g_mapgen.in_flight[i].x == chunk->chunk.x && g_mapgen.in_flight[i].y == chunk->chunk.y) {
+				g_mapgen.in_flight[i] = g_mapgen.in_flight[--g_mapgen.in_flight_count];
+				break;
+			}
+		}
+	}
+	SDL_UnlockMutex(g_mapgen.mutex);
+
+	for (int i = 0; i < finished_count; ++i) {
+		c_mapchunk *chunk = &finished[i];
+		mapchunk_build_mesh(chunk);
+
+		ecs_entity_t e = ecs_new_id(g_ecs);
+		ecs_set(g_ecs, e, c_pos, {
+			.p.x = chunk->chunk.x * MAPCHUNK_WIDTH * MAPCHUNK_TILESIZE,
+			.p.y = chunk->chunk.y * MAPCHUNK_HEIGHT * MAPCHUNK_TILESIZE,
+		});
+		ecs_set_ptr(g_ecs, e, c_mapchunk, chunk);
+	}
+}
+
+static int mapgen_worker(void *data) {
+	SDL_LockMutex(g_mapgen.mutex);
+	while (1) {
+		while (!g_mapgen.quit && g_mapgen.requests_count == 0) {
+			SDL_CondWait(g_mapgen.has_requests, g_mapgen.mutex);
+		}
+		if (g_mapgen.quit) {
+			break;
+		}
+
+		// oldest request first, those are closest to the view.
+		const ivec2s coord = g_mapgen.requests[0];
+		--g_mapgen.requests_count;
+		memmove(&g_mapgen.requests[0], &g_mapgen.requests[1], g_mapgen.requests_count * sizeof(g_mapgen.requests[0]));
+		SDL_UnlockMutex(g_mapgen.mutex);
+
+		c_mapchunk chunk = {0};
+		mapchunk_init(&chunk, coord.x, coord.y);
+
+		SDL_LockMutex(g_mapgen.mutex);
+		g_mapgen.results[g_mapgen.results_count++] = chunk;
+	}
+	SDL_UnlockMutex(g_mapgen.mutex);
+
+	return 0;
 }
 
 static void spawn_bulletshot(vec2 p, float angle, enum faction faction, float spread, float dmg, float speed) {
 	float rnd_angle = glm_rad((rand() / (float)RAND_MAX) * spread - spread * 0.5f);
 	ecs_entity_t e = ecs_new_id(g_ecs);
 	ecs_set(g_ecs, e, c_pos, { .p.raw = {p[0], p[1]} });
+	ecs_set(g_ecs, e, c_prev_pos, { .p.raw = {p[0], p[1]} });
 	ecs_set(g_ecs, e, c_sprite, {
 			.tile = {10, 0},
 			.tile_size = {16, 16},
@@ -936,6 +1272,7 @@ static void spawn_bulletshot(vec2 p, float angle, enum faction faction, float sp
 static void spawn_homing_shot(vec2 p, float angle, ecs_entity_t target, enum faction faction, float dmg, float speed) {
 	ecs_entity_t e = ecs_new_id(g_ecs);
 	ecs_set(g_ecs, e, c_pos, { .p.raw = {p[0], p[1]} });
+	ecs_set(g_ecs, e, c_prev_pos, { .p.raw = {p[0], p[1]} });
 	ecs_set(g_ecs, e, c_sprite, {
 			.tile = {11, 1},
 			.tile_size = {16, 16},
@@ -956,6 +1293,64 @@ static void spawn_homing_shot(vec2 p, float angle, ecs_entity_t target, enum fac
 	ecs_set(g_ecs, e, c_homing, { .turn_strength=0.1f });
 }
 
+static void particle_set_tile(struct particle_desc *p, int tile_x, int tile_y, int tile_w, int tile_h) {
+	drawcmd_t cmd = DRAWCMD_INIT;
+	drawcmd_set_texture_subrect_tile(&cmd, &g_plane_tex, tile_w, tile_h, tile_x, tile_y);
+	glm_vec4_copy(cmd.texture_subrect, p->texture_subrect);
+	p->size[0] = tile_w;
+	p->size[1] = tile_h;
+}
+
+static int collision_grid_bucket(int cell_x, int cell_y) {
+	const uint32_t h = ((uint32_t)cell_x * 73856093u) ^ ((uint32_t)cell_y * 19349663u);
+	return (int)(h & (COLLISION_BUCKETS - 1));
+}
+
+// sorts all damageable entities into buckets of a uniform grid (counting sort).
+static void collision_grid_build(void) {
+	stbds_arrsetlen(g_collision_grid.unsorted, 0);
+	memset(g_collision_grid.bucket_start, 0, sizeof(g_collision_grid.bucket_start));
+
+	ecs_iter_t it = ecs_query_iter(g_ecs, g_enemies_query);
+	while (ecs_query_next(&it)) {
+		c_pos          *ps = ecs_field(&it, c_pos,          1);
+		c_plane        *pl = ecs_field(&it, c_plane,        2);
+		c_sprite       *sp = ecs_field(&it, c_sprite,       3);
+		c_faction      *fc = ecs_field(&it, c_faction,      4);
+		c_healthpoints *hp = ecs_field(&it, c_healthpoints, 5);
+
+		for (int i = 0; i < it.count; ++i) {
+			const int cell_x = (int)floorf(ps[i].p.x / COLLISION_CELL_SIZE);
+			const int cell_y = (int)floorf(ps[i].p.y / COLLISION_CELL_SIZE);
+			const struct collider c = {
+				.entity  = it.entities[i],
+				.p       = ps[i].p,
+				.faction = fc[i].faction,
+				.sprite  = &sp[i],
+				.health  = &hp[i],
+				.plane   = &pl[i],
+				.bucket  = collision_grid_bucket(cell_x, cell_y),
+			};
+			stbds_arrput(g_collision_grid.unsorted, c);
+			++g_collision_grid.bucket_start[c.bucket];
+		}
+	}
+
+	// prefix sum, so each bucket points to its end.
+	const int count = stbds_arrlen(g_collision_grid.unsorted);
+	for (int b = 1; b < COLLISION_BUCKETS; ++b) {
+		g_collision_grid.bucket_start[b] += g_collision_grid.bucket_start[b - 1];
+	}
+	g_collision_grid.bucket_start[COLLISION_BUCKETS] = count;
+
+	// scatter back to front, afterwards each bucket points to its start.
+	stbds_arrsetlen(g_collision_grid.colliders, count);
+	for (int i = count - 1; i >= 0; --i) {
+		const struct collider *c = &g_collision_grid.unsorted[i];
+		g_collision_grid.colliders[--g_collision_grid.bucket_start[c->bucket]] = *c;
+	}
+}
+
 static void show_levelup_rewards(void) {
 	g_picking_rewards = 1;
 
@@ -1022,21 +1417,18 @@ static void hit_enemy(ecs_entity_t e_bullet, ecs_entity_t e_enemy, c_bullet *bul
 		float bullet_angle = atan2f(-bullet->vel.y, -bullet->vel.x);
 		float angle = bullet_angle + glm_rad( (rand() / (double)RAND_MAX) * 90.0f - 45.0f );
 
-		ecs_entity_t e = ecs_new_id(g_ecs);
-		ecs_set(g_ecs, e, c_pos, { .p.raw = { pos_bullet->p.x, pos_bullet->p.y } });
-		ecs_set(g_ecs, e, c_despawn_after, { .seconds = 0.25f });
-		ecs_set(g_ecs, e, c_sprite, {
-			.tile = {10 + (rand() & 1), 3 + (rand() & 1)},
-			.tile_size = {16, 16},
-			.angle = 0.0f,
-			.scale = 1.5f,
-			.z_layer = ZLAYER_BULLETS,
-		});
-		ecs_set(g_ecs, e, c_particle, {
+		struct particle_desc p = {
+			.position = { pos_bullet->p.x, pos_bullet->p.y },
+			.velocity = { cosf(angle) * 1.0f, sinf(angle) * 1.0f },
+			.angle = GLM_PI * 0.5f,
 			.rotation = 0.1f,
+			.scale = 1.5f,
 			.scale_factor = 0.95f,
-			.vel = { cosf(angle) * 1.0f, sinf(angle) * 1.0f },
-		});
+			.lifetime = 0.25f,
+			.z = ZLAYER_BULLETS,
+		};
+		particle_set_tile(&p, 10 + (rand() & 1), 3 + (rand() & 1), 16, 16);
+		particles_spawn(&g_particles, &p);
 	}
 
 	// no hp left? also destroy plane
@@ -1047,6 +1439,7 @@ static void hit_enemy(ecs_entity_t e_bullet, ecs_entity_t e_enemy, c_bullet *bul
 				.vel={ cosf(pl_enemy->angle) * pl_enemy->speed, sinf(pl_enemy->angle) * pl_enemy->speed },
 				.scale_factor = 0.997f,
 				});
+		ecs_set_ptr(g_ecs, e_enemy, c_prev_pos, ecs_get(g_ecs, e_enemy, c_pos));
 		ecs_remove(g_ecs, e_enemy, c_plane);
 		c_sprite *spr = ecs_get_mut(g_ecs, e_enemy, c_sprite);
 		spr->z_layer = ZLAYER_ABOVE_GROUND;
@@ -1121,19 +1514,18 @@ static void system_move_plane(ecs_iter_t *it) {
 static void system_move_bullets(ecs_iter_t *it_bullet) {
 	c_pos *p_bullets = ecs_field(it_bullet, c_pos, 1);
 	c_bullet *bullets = ecs_field(it_bullet, c_bullet, 2);
-	c_faction *fac_bullets = ecs_field(it_bullet, c_faction, 3);
 	c_target *trg_bullets = NULL;
 	c_homing *homing_bullets = NULL;
 	c_sprite *spr_bullets = NULL;
 
+	if (ecs_field_is_set(it_bullet, 3)) {
+		trg_bullets = ecs_field(it_bullet, c_target, 3);
+	}
 	if (ecs_field_is_set(it_bullet, 4)) {
-		trg_bullets = ecs_field(it_bullet, c_target, 4);
+		homing_bullets = ecs_field(it_bullet, c_homing, 4);
 	}
 	if (ecs_field_is_set(it_bullet, 5)) {
-		homing_bullets = ecs_field(it_bullet, c_homing, 5);
-	}
-	if (ecs_field_is_set(it_bullet, 6)) {
-		spr_bullets = ecs_field(it_bullet, c_sprite, 6);
+		spr_bullets = ecs_field(it_bullet, c_sprite, 5);
 	}
 
 
@@ -1161,32 +1553,44 @@ static void system_move_bullets(ecs_iter_t *it_bullet) {
 		vec2s dir;
 		glm_vec2_scale(bullets[i].vel.raw, bullets[i].speed * it_bullet->delta_time * 60.0f, dir.raw);
 		glm_vec2_add(p_bullets[i].p.raw, dir.raw, p_bullets[i].p.raw);
+	}
 
-		// collide with enemies
-		ecs_iter_t it_enemy = ecs_query_iter(g_ecs, g_enemies_query);
-		while (ecs_query_next(&it_enemy)) {
-			c_pos     *p_planes      = ecs_field(&it_enemy, c_pos,     1);
-			c_plane   *planes        = ecs_field(&it_enemy, c_plane,   2);
-			c_sprite  *spr_planes    = ecs_field(&it_enemy, c_sprite,  3);
-			c_faction *fac_planes    = ecs_field(&it_enemy, c_faction, 4);
-			c_healthpoints  *health_planes = ecs_field(&it_enemy, c_healthpoints,  5);
-
-			for (int j = 0; j < it_enemy.count; ++j) {
-				if (fac_bullets[i].faction == fac_planes[j].faction) {
-					continue;
-				}
+}
 
-				vec2 to_plane;
-				glm_vec2_sub(p_planes[j].p.raw, p_bullets[i].p.raw, to_plane);
+static void system_collide_bullets(ecs_iter_t *it) {
+	c_pos *p_bullets = ecs_field(it, c_pos, 1);
+	c_bullet *bullets = ecs_field(it, c_bullet, 2);
+	c_faction *fac_bullets = ecs_field(it, c_faction, 3);
 
-				// hit!
-				if (glm_vec2_norm2(to_plane) <= 25.0f * 25.0f) {
-					hit_enemy(it_bullet->entities[i], it_enemy.entities[j], &bullets[i], &p_bullets[i], &spr_planes[j], &health_planes[j], &planes[j]);
+	for (int i = 0; i < it->count; ++i) {
+		const int cell_x = (int)floorf(p_bullets[i].p.x / COLLISION_CELL_SIZE);
+		const int cell_y = (int)floorf(p_bullets[i].p.y / COLLISION_CELL_SIZE);
+
+		// the cell size is larger than the hit radius, so checking all neighbors is enough.
+		int has_hit = 0;
+		for (int dy = -1; dy <= 1 && !has_hit; ++dy) {
+			for (int dx = -1; dx <= 1 && !has_hit; ++dx) {
+				const int bucket = collision_grid_bucket(cell_x + dx, cell_y + dy);
+
+				for (int j = g_collision_grid.bucket_start[bucket]; j < g_collision_grid.bucket_start[bucket + 1]; ++j) {
+					struct collider *c = &g_collision_grid.colliders[j];
+					if (fac_bullets[i].faction == c->faction || c->health->hp <= 0.0f) {
+						continue;
+					}
+
+					vec2 to_plane;
+					glm_vec2_sub(c->p.raw, p_bullets[i].p.raw, to_plane);
+
+					// hit! the bullet is destroyed, so stop looking.
+					if (glm_vec2_norm2(to_plane) <= COLLISION_HIT_RADIUS * COLLISION_HIT_RADIUS) {
+						hit_enemy(it->entities[i], c->entity, &bullets[i], &p_bullets[i], c->sprite, c->health, c->plane);
+						has_hit = 1;
+						break;
+					}
 				}
 			}
 		}
 	}
-
 }
 
 static void system_move_particles(ecs_iter_t *it) {
@@ -1209,7 +1613,7 @@ static void system_move_particles(ecs_iter_t *it) {
 		glm_vec2_add(pos[i].p.raw, dir, pos[i].p.raw);
 		
 		// scale
-		sprites[i].scale *= particles[i].scale_factor;
+		sprites[i].scale *= powf(particles[i].scale_factor, 60.0f * it->delta_time);
 
 		if (shadows) {
 			pos[i].p.y += 0.5f * 60.0f * it->delta_time;
@@ -1218,6 +1622,15 @@ static void system_move_particles(ecs_iter_t *it) {
 		}
 	}
 }
+static void system_store_prev_pos(ecs_iter_t *it) {
+	c_pos *pos = ecs_field(it, c_pos, 1);
+	c_prev_pos *prev_pos = ecs_field(it, c_prev_pos, 2);
+
+	for (int i = 0; i < it->count; ++i) {
+		prev_pos[i].p = pos[i].p;
+	}
+}
+
 static void system_despawn(ecs_iter_t *it) {
 	c_despawn_after *ds = ecs_field(it, c_despawn_after, 1);
 
@@ -1255,23 +1668,18 @@ static void system_spawn_plane_effects(ecs_iter_t *it) {
 				vec2 rnd_dir = { cosf(angle) * speed, sinf(angle) * speed };
 				vec2 inv_plane_dir = { -cosf(plane->angle) * 0.04f, -sinf(plane->angle) * 0.04f };
 
-				vec2 dir;
-				glm_vec2_add(rnd_dir, inv_plane_dir, dir);
-
-				ecs_entity_t e = ecs_new_id(g_ecs);
-				ecs_set(g_ecs, e, c_pos, { .p.x = pos->p.x, .p.y = pos->p.y });
-				ecs_set(g_ecs, e, c_despawn_after, { .seconds = 2.0f });
-				ecs_set(g_ecs, e, c_sprite, {
-					.scale = 1.0f,
-					.tile = {4, rand() % 3},
-					.tile_size = {32, 32},
-					.z_layer = ZLAYER_PARTICLES,
-				});
-				ecs_set(g_ecs, e, c_particle, {
+				struct particle_desc p = {
+					.position = { pos->p.x, pos->p.y },
+					.angle = GLM_PI * 0.5f,
 					.rotation = 0.02f,
-					.vel = { dir[0], dir[1] },
+					.scale = 1.0f,
 					.scale_factor = 0.99f,
-				});
+					.lifetime = 2.0f,
+					.z = ZLAYER_PARTICLES,
+				};
+				glm_vec2_add(rnd_dir, inv_plane_dir, p.velocity);
+				particle_set_tile(&p, 4, rand() % 3, 32, 32);
+				particles_spawn(&g_particles, &p);
 			}
 		}
 
@@ -1327,38 +1735,25 @@ static void system_spawn_enemies(ecs_iter_t *it) {
 	}
 }
 
-static void system_remove_mapchunks(ecs_iter_t *it) {
-	if (!ecs_is_alive(g_ecs, g_player)) {
-		return;
-	}
-
-	c_pos *chunk_positions = ecs_field(it, c_pos, 1);
+static void system_cull_mapchunks(ecs_iter_t *it) {
 	c_mapchunk *chunks = ecs_field(it, c_mapchunk, 2);
 
-	float wx = -g_engine->u_view[3][0];
-	float wy = -g_engine->u_view[3][1];
-	float ww = g_engine->window_width;
-	float wh = g_engine->window_height;
-
-	struct { int x, y; } existing_chunks[32];
-	int existing_count = 0;
+	// keep one chunk of slack around the needed range, so prefetched
+	// chunks don't get removed right away when turning around.
+	ivec2s min, max;
+	mapchunk_needed_range(&min, &max);
 
 	for (int i = 0; i < it->count; ++i) {
-		c_pos *chunk_pos = &chunk_positions[i];
 		c_mapchunk *chunk = &chunks[i];
 
-		float x = chunk_pos->p.x;
-		float y = chunk_pos->p.y;
-		float w = MAPCHUNK_WIDTH * MAPCHUNK_TILESIZE;
-		float h = MAPCHUNK_HEIGHT * MAPCHUNK_TILESIZE;
-
-		if (x + w < wx || x > wx + ww || y + h < wy || y > wy + wh) {
+		const int is_outside = (chunk->chunk.x < min.x - 1 || chunk->chunk.x > max.x + 1
+				|| chunk->chunk.y < min.y - 1 || chunk->chunk.y > max.y + 1);
+		const int is_full = (g_mapgen.existing_count >= (int)count_of(g_mapgen.existing));
+		if (is_outside || is_full) {
 			mapchunk_destroy(chunk);
 			ecs_delete(g_ecs, it->entities[i]);
 		} else {
-			existing_chunks[existing_count].x = chunk->chunk.x;
-			existing_chunks[existing_count].y = chunk->chunk.y;
-			++existing_count;
+			g_mapgen.existing[g_mapgen.existing_count++] = chunk->chunk;
 		}
 	}
 }
@@ -1382,18 +1777,25 @@ static void system_animate_sprites(ecs_iter_t *it) {
 }
 
 static void system_draw_sprites(ecs_iter_t *it) {
-	pipeline_reset(&g_pipeline);
-	g_pipeline.texture = &g_plane_tex;
-
-	glDisable(GL_DEPTH_TEST);
 	c_pos *pos = ecs_field(it, c_pos, 1);
 	c_sprite *sprite = ecs_field(it, c_sprite, 2);
 	c_shadow *shadow = NULL;
+	c_prev_pos *prev_pos = NULL;
+	const float alpha = *(const float *)it->param;
 
 	for (int i = 0; i < it->count; ++i) {
 		if (ecs_field_is_set(it, 3)) {
 			shadow = ecs_field(it, c_shadow, 3);
 		}
+		if (ecs_field_is_set(it, 4)) {
+			prev_pos = ecs_field(it, c_prev_pos, 4);
+		}
+
+		// moved in tick(), somewhere between the last two
+		vec2s p = pos[i].p;
+		if (prev_pos != NULL) {
+			glm_vec2_lerp(prev_pos[i].p.raw, pos[i].p.raw, alpha, p.raw);
+		}
 
 		const float w = sprite[i].tile_size[0] * sprite[i].scale;
 		const float h = sprite[i].tile_size[1] * sprite[i].scale;
@@ -1418,8 +1820,8 @@ static void system_draw_sprites(ecs_iter_t *it) {
 			float ox = -shadow[i].distance * 0.25f;
 			float oy = shadow[i].distance;
 
-			cmd.position.x = pos[i].p.x - sqw * 0.5f + ox;
-			cmd.position.y = pos[i].p.y - sqh * 0.5f + oy;
+			cmd.position.x = p.x - sqw * 0.5f + ox;
+			cmd.position.y = p.y - sqh * 0.5f + oy;
 			cmd.position.z = ZLAYER_SHADOW;
 			glm_vec3_zero(cmd.color_mult);
 			cmd.color_mult[3] = 0.25f;
@@ -1427,47 +1829,19 @@ static void system_draw_sprites(ecs_iter_t *it) {
 		}
 
 		// draw plane
-		cmd.position.x = pos[i].p.x - sqw * 0.5f;
-		cmd.position.y = pos[i].p.y - sqh * 0.5f;
+		cmd.position.x = p.x - sqw * 0.5f;
+		cmd.position.y = p.y - sqh * 0.5f;
 		cmd.position.z = sprite[i].z_layer;
 		glm_vec4_one(cmd.color_mult);
 		glm_vec3_fill(cmd.color_add, hurt_color);
 		pipeline_emit(&g_pipeline, &cmd);
 	}
-
-	// test drawing planes
-	glEnable(GL_DEPTH_TEST);
-	pipeline_draw(&g_pipeline, g_engine);
 }
 
 static void system_draw_map(ecs_iter_t *it) {
-	c_pos *ps = ecs_field(it, c_pos, 1);
 	c_mapchunk *cs = ecs_field(it, c_mapchunk, 2);
 	for (int i = 0; i < it->count; ++i) {
-		pipeline_reset(&g_pipeline);
-		g_pipeline.texture = &g_tiles_tex;
-
-		// TODO: store pipeline in c_mapchunk
-		drawcmd_t cmd = DRAWCMD_INIT;
-		for (int y = 0; y < MAPCHUNK_HEIGHT; ++y) {
-			for (int x = 0; x < MAPCHUNK_WIDTH; ++x) {
-				int id = cs[i].tiles[x + y * MAPCHUNK_WIDTH];
-				if (id < 0) {
-					continue;
-				}
-
-				int tx = id % MAPCHUNK_TILESIZE;
-				int ty = (int)(id / MAPCHUNK_TILESIZE);
-
-				cmd.position.x = ps[i].p.x + (x * MAPCHUNK_TILESIZE);
-				cmd.position.y = ps[i].p.y + (y * MAPCHUNK_TILESIZE);
-				cmd.size.x = cmd.size.y = MAPCHUNK_TILESIZE;
-				drawcmd_set_texture_subrect_tile(&cmd, g_pipeline.texture, MAPCHUNK_TILESIZE, MAPCHUNK_TILESIZE, tx, ty);
-				pipeline_emit(&g_pipeline, &cmd);
-			}
-		}
-
-		pipeline_draw(&g_pipeline, g_engine);
+		pipeline_draw(&cs[i].mesh, g_engine);
 	}
 }
 
@@ -5,6 +5,7 @@ void scene_init(struct scene_s *scene, struct engine *engine) {
 	scene->load = NULL;
 	scene->destroy = NULL;
 	scene->update = NULL;
+	scene->tick = NULL;
 	scene->draw = NULL;
 	scene->on_message = NULL;
 	scene->on_callback = NULL;
@@ -28,9 +29,15 @@ void scene_update(struct scene_s *scene, struct engine *engine, float dt) {
 	}
 }
 
-void scene_draw(struct scene_s *scene, struct engine *engine) {
+void scene_tick(struct scene_s *scene, struct engine *engine, float dt) {
+	if (scene != NULL && scene->tick != NULL) {
+		scene->tick(scene, engine, dt);
+	}
+}
+
+void scene_draw(struct scene_s *scene, struct engine *engine, float alpha) {
 	if (scene != NULL && scene->draw != NULL) {
-		scene->draw(scene, engine);
+		scene->draw(scene, engine, alpha);
 	}
 }
 
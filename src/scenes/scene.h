@@ -17,7 +17,8 @@ struct message_header;
 typedef void(*scene_load_fn)(struct scene_s *, struct engine *);
 typedef void(*scene_destroy_fn)(struct scene_s *, struct engine *);
 typedef void(*scene_update_fn)(struct scene_s *, struct engine *, float);
-typedef void(*scene_draw_fn)(struct scene_s *, struct engine *);
+typedef void(*scene_tick_fn)(struct scene_s *, struct engine *, float);
+typedef void(*scene_draw_fn)(struct scene_s *, struct engine *, float);
 typedef void(*scene_on_message_fn)(struct scene_s *, struct engine *, struct message_header *);
 typedef void(*scene_on_callback_fn)(struct scene_s *, struct engine *, struct engine_event);
 
@@ -29,8 +30,9 @@ enum scene_call_result {
 struct scene_s {
 	scene_load_fn        load;
 	scene_destroy_fn     destroy;
-	scene_update_fn      update;
-	scene_draw_fn        draw;
+	scene_update_fn      update; // once per frame, variable dt
+	scene_tick_fn        tick;   // fixed timestep, see engine_set_tick_rate()
+	scene_draw_fn        draw;   // alpha: interpolation between the last two ticks
 	scene_on_message_fn  on_message;
 	scene_on_callback_fn on_callback;
 };
@@ -39,7 +41,8 @@ void                   scene_init       (struct scene_s *scene, struct engine *e
 void                   scene_destroy    (struct scene_s *scene, struct engine *engine);
 void                   scene_load       (struct scene_s *scene, struct engine *engine);
 void                   scene_update     (struct scene_s *scene, struct engine *engine, float dt);
-void                   scene_draw       (struct scene_s *scene, struct engine *engine);
+void                   scene_tick       (struct scene_s *scene, struct engine *engine, float dt);
+void                   scene_draw       (struct scene_s *scene, struct engine *engine, float alpha);
 void                   scene_on_message (struct scene_s *scene, struct engine *engine, struct message_header *);
 enum scene_call_result scene_on_callback(struct scene_s *scene, struct engine *engine, struct engine_event);
 
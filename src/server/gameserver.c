@@ -1,11 +1,15 @@
 #include "gameserver.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <libwebsockets.h>
-#include <cJSON.h>
 #include <stb_ds.h>
 #include "net/message.h"
+#include "server/metrics.h"
+#include "util/slotmap.h"
 
 //
 // private api
@@ -14,10 +18,23 @@
 static int callback_rawtcp(struct lws *, enum lws_callback_reasons, void *, void *, size_t);
 static int callback_ws    (struct lws *, enum lws_callback_reasons, void *, void *, size_t);
 
-static void gameserver_on_connect   (struct gameserver *, struct session *, struct lws *wsi);
+static int  gameserver_on_connect   (struct gameserver_shard *, struct session *, struct lws *wsi);
 static void gameserver_on_disconnect(struct gameserver *, struct session *);
 static void gameserver_on_message   (struct gameserver *, struct session *, void *, size_t);
-static void gameserver_on_writable  (struct gameserver *, struct session *);
+static int  gameserver_on_writable  (struct gameserver *, struct session *);
+static int  gameserver_on_http      (struct gameserver *, struct session *, struct lws *wsi, const char *uri);
+static int  gameserver_on_http_writable(struct session *, struct lws *wsi);
+
+static void gameserver_frame_release(struct gameserver *, struct gameserver_frame *);
+static void gameserver_stats_add(uint64_t *counter, uint64_t value);
+static void gameserver_stats_sub(uint64_t *counter, uint64_t value);
+static void gameserver_shard_deliver(struct gameserver_shard *);
+
+#define GAMESERVER_SERVICE_TIMEOUT_MS 1000 // shutdown and mail wake the loop earlier
+
+// session ids are the shard index above the id of the session in its shard's slot map
+#define SESSION_ID_SHARD(id) ((id) >> SLOTMAP_ID_BITS)
+#define SESSION_ID_SLOT(id)  ((id) & ((1u << SLOTMAP_ID_BITS) - 1))
 
 //
 // private variables
@@ -39,115 +56,452 @@ int filter_everybody        (struct session *o, struct session *t) { return 1; }
 int filter_everybody_exclude(struct session *o, struct session *t) { return (o->id != t->id); }
 
 // initialization
-int gameserver_init(struct gameserver *server, uint16_t port) {
+int gameserver_init(struct gameserver *server, uint16_t port, int threads) {
 	memset(server, 0, sizeof(*server));
 
 	// init libwebsockets
 	lws_set_log_level(0, NULL);
 
-	struct lws_context_creation_info info = {0};
-	info.port = port;
-	info.iface = NULL;
-	info.protocols = protocols;
-	info.gid = -1;
-	info.uid = -1;
-	// TODO: ADOPT_APPLY_LISTEN_ACCEPT_CONFIG fixes raw tcp not connecting immediately
-	// TODO: This works on HTTPS: info.options = LWS_SERVER_OPTION_FALLBACK_TO_RAW;
-	info.options = LWS_SERVER_OPTION_FALLBACK_TO_RAW; // | LWS_SERVER_OPTION_ADOPT_APPLY_LISTEN_ACCEPT_CONFIG
-	info.user = (void *)server;
+	server->send_queue_frames_max = GAMESERVER_SEND_QUEUE_FRAMES;
+	server->send_queue_bytes_max = GAMESERVER_SEND_QUEUE_BYTES;
+	server->send_queue_overflow = GAMESERVER_OVERFLOW_DISCONNECT;
+
+	pthread_mutex_init(&server->groups_lock, NULL);
+	server->group_sizes = NULL;
+
+	server->shards_len = (threads < 1) ? 1 : (threads > GAMESERVER_SHARDS_MAX ? GAMESERVER_SHARDS_MAX : threads);
+	server->shards = calloc(server->shards_len, sizeof(struct gameserver_shard));
+	for (int i = 0; i < server->shards_len; ++i) {
+		struct gameserver_shard *shard = &server->shards[i];
+		shard->server = server;
+		shard->index = i;
+		slotmap_init(&shard->sessions);
+		shard->message_stats = calloc(MSG_TYPE_MAX, sizeof(struct gameserver_message_stats));
+
+		struct lws_context_creation_info info = {0};
+		info.port = port;
+		info.iface = NULL;
+		info.protocols = protocols;
+		info.gid = -1;
+		info.uid = -1;
+		// TODO: ADOPT_APPLY_LISTEN_ACCEPT_CONFIG fixes raw tcp not connecting immediately
+		// TODO: This works on HTTPS: info.options = LWS_SERVER_OPTION_FALLBACK_TO_RAW;
+		info.options = LWS_SERVER_OPTION_FALLBACK_TO_RAW; // | LWS_SERVER_OPTION_ADOPT_APPLY_LISTEN_ACCEPT_CONFIG
+		if (server->shards_len > 1) {
+			// SO_REUSEPORT, the kernel spreads new connections over the shards
+			info.options |= LWS_SERVER_OPTION_ALLOW_LISTEN_SHARE;
+		}
+		info.user = (void *)shard;
+
+		shard->lws = lws_create_context(&info);
+		if (shard->lws == NULL) {
+			// stop listening on the shards created so far, later ones weren't initialized
+			server->shards_len = i + 1;
+			gameserver_destroy(server);
+			return 1;
+		}
+	}
 
-	server->lws = lws_create_context(&info);
-	return (server->lws == NULL);
+	return 0;
 }
 
 void gameserver_destroy(struct gameserver *server) {
-	lws_context_destroy(server->lws);
+	for (int i = 0; i < server->shards_len; ++i) {
+		struct gameserver_shard *shard = &server->shards[i];
+		// closes all connections, which leaves their groups
+		if (shard->lws != NULL) {
+			lws_context_destroy(shard->lws);
+		}
+
+		struct gameserver_mail *mail = shard->mailbox;
+		while (mail != NULL) {
+			struct gameserver_mail *next = mail->next;
+			gameserver_frame_release(server, mail->frame);
+			free(mail);
+			mail = next;
+		}
+		for (int j = 0; j < stbds_hmlen(shard->groups); ++j) {
+			stbds_arrfree(shard->groups[j].members);
+		}
+		stbds_hmfree(shard->groups);
+		slotmap_destroy(&shard->sessions);
+		free(shard->message_stats);
+	}
+	free(server->shards);
+	server->shards = NULL;
+	server->shards_len = 0;
+
+	stbds_hmfree(server->group_sizes);
+	pthread_mutex_destroy(&server->groups_lock);
 }
 
 void gameserver_shutdown(struct gameserver *server) {
 	server->shutdown_requested = 1;
+	for (int i = 0; i < server->shards_len; ++i) {
+		lws_cancel_service(server->shards[i].lws);
+	}
+}
+
+// main loop of a shard
+static void *gameserver_shard_run(void *data) {
+	struct gameserver_shard *shard = data;
+	while (!shard->server->shutdown_requested) {
+		// sleeps until there is network activity, a timeout or mail
+		lws_service(shard->lws, GAMESERVER_SERVICE_TIMEOUT_MS);
+		gameserver_shard_deliver(shard);
+	}
+	return NULL;
 }
 
-// main loop
 void gameserver_listen(struct gameserver *server) {
-	while (!server->shutdown_requested) {
-		lws_service(server->lws, 0);
+	// the first shard runs on the calling thread
+	for (int i = 1; i < server->shards_len; ++i) {
+		pthread_create(&server->shards[i].thread, NULL, gameserver_shard_run, &server->shards[i]);
+	}
+	gameserver_shard_run(&server->shards[0]);
+	for (int i = 1; i < server->shards_len; ++i) {
+		pthread_join(server->shards[i].thread, NULL);
+	}
+}
+
+//
+// frames & queues
+//
+
+static struct gameserver_frame *gameserver_frame_create(struct gameserver *gserver, const uint8_t *data, size_t data_len) {
+	assert(data_len <= GAMESERVER_COALESCE_MAX);
+	struct gameserver_frame *frame = malloc(sizeof(struct gameserver_frame) + LWS_PRE + data_len);
+	__atomic_add_fetch(&gserver->frames_allocated, 1, __ATOMIC_RELAXED);
+	frame->refcount = 1; // the creator's
+	frame->type = MSG_TYPE_UNKNOWN;
+	frame->len = data_len;
+	memcpy(&frame->data[LWS_PRE], data, data_len);
+	return frame;
+}
+
+static struct gameserver_frame *gameserver_frame_encode(struct gameserver *gserver, struct message_header *message) {
+	uint8_t encoded[MESSAGE_FRAME_MAX];
+	const size_t encoded_len = message_encode(message, encoded, sizeof(encoded));
+	assert(encoded_len > 0 && "message exceeds MESSAGE_FRAME_MAX");
+	struct gameserver_frame *frame = gameserver_frame_create(gserver, encoded, encoded_len);
+	frame->type = message->type;
+	return frame;
+}
+
+// frames are shared between shards, so their refcount is atomic.
+static void gameserver_frame_retain(struct gameserver_frame *frame) {
+	__atomic_add_fetch(&frame->refcount, 1, __ATOMIC_RELAXED);
+}
+
+static void gameserver_frame_release(struct gameserver *gserver, struct gameserver_frame *frame) {
+	const int refcount = __atomic_sub_fetch(&frame->refcount, 1, __ATOMIC_ACQ_REL);
+	assert(refcount >= 0);
+	if (refcount == 0) {
+		free(frame);
+		__atomic_add_fetch(&gserver->frames_freed, 1, __ATOMIC_RELAXED);
 	}
 }
 
+// queues the frame for writing, unless the receiver is too far behind.
+static void gameserver_enqueue(struct gameserver *gserver, struct session *receiver, struct gameserver_frame *frame) {
+	struct gameserver_send_queue *queue = &receiver->send_queue;
+	if (receiver->closing) {
+		return;
+	}
+
+	struct gameserver_stats *stats = &receiver->shard->stats;
+	if (queue->len == queue->capacity || queue->bytes + frame->len > gserver->send_queue_bytes_max) {
+		queue->dropped++;
+		gameserver_stats_add(&stats->frames_dropped, 1);
+		if (gserver->send_queue_overflow == GAMESERVER_OVERFLOW_DISCONNECT) {
+			// closed from the service loop, which calls gameserver_on_disconnect()
+			receiver->closing = 1;
+			lws_set_timeout(receiver->wsi, PENDING_TIMEOUT_CLOSE_SEND, LWS_TO_KILL_ASYNC);
+		}
+		return;
+	}
+
+	gameserver_frame_retain(frame);
+	queue->frames[(queue->head + queue->len) % queue->capacity] = frame;
+	queue->len++;
+	queue->bytes += frame->len;
+	gameserver_stats_add(&stats->frames_queued, 1);
+	gameserver_stats_add(&stats->bytes_queued, frame->len);
+	lws_callback_on_writable(receiver->wsi);
+}
+
+static void gameserver_dequeue(struct session *session) {
+	struct gameserver_send_queue *queue = &session->send_queue;
+	struct gameserver_stats *stats = &session->shard->stats;
+	assert(queue->len > 0);
+	struct gameserver_frame *frame = queue->frames[queue->head];
+	queue->head = (queue->head + 1) % queue->capacity;
+	queue->len--;
+	queue->bytes -= frame->len;
+	gameserver_stats_sub(&stats->frames_queued, 1);
+	gameserver_stats_sub(&stats->bytes_queued, frame->len);
+	gameserver_frame_release(session->shard->server, frame);
+}
+
+//
+// shards
+//
+
+// queues the frame for every session on the shard matching the filter. shard thread only.
+static void gameserver_shard_broadcast(struct gameserver_shard *shard, struct gameserver_frame *frame, session_filter_fn filter, struct session *master) {
+	// group filters only need to look at the members.
+	// sessions without a group are not indexed, they share group 0.
+	struct session **candidates = (struct session **)shard->sessions.items;
+	if ((filter == filter_group || filter == filter_group_exclude) && master->group_id != 0) {
+		struct gameserver_group *group = stbds_hmgetp_null(shard->groups, master->group_id);
+		candidates = (group != NULL) ? group->members : NULL;
+	}
+
+	const size_t candidates_len = stbds_arrlen(candidates);
+	for (size_t i = 0; i < candidates_len; ++i) {
+		struct session *tested = candidates[i];
+		if (filter(master, tested)) {
+			gameserver_enqueue(shard->server, tested, frame);
+		}
+	}
+}
+
+// hands a broadcast to another shard's thread. any thread.
+static void gameserver_shard_post(struct gameserver_shard *shard, struct gameserver_frame *frame, session_filter_fn filter, struct session *master) {
+	struct gameserver_mail *mail = malloc(sizeof(struct gameserver_mail));
+	__atomic_add_fetch(&shard->server->mails_allocated, 1, __ATOMIC_RELAXED);
+	gameserver_frame_retain(frame);
+	mail->frame = frame;
+	mail->filter = filter;
+	mail->master_id = master->id;
+	mail->master_group_id = master->group_id;
+
+	// push onto the lock-free stack and wake the shard
+	mail->next = __atomic_load_n(&shard->mailbox, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&shard->mailbox, &mail->next, mail, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+		// `mail->next` was updated to the current head, retry
+	}
+	lws_cancel_service(shard->lws);
+}
+
+// delivers all mail posted to the shard. shard thread only.
+static void gameserver_shard_deliver(struct gameserver_shard *shard) {
+	struct gameserver_mail *mail = __atomic_exchange_n(&shard->mailbox, NULL, __ATOMIC_ACQUIRE);
+
+	// the stack is newest first, deliver in posting order
+	struct gameserver_mail *ordered = NULL;
+	while (mail != NULL) {
+		struct gameserver_mail *next = mail->next;
+		mail->next = ordered;
+		ordered = mail;
+		mail = next;
+	}
+
+	while (ordered != NULL) {
+		struct gameserver_mail *next = ordered->next;
+		struct session master = { .id = ordered->master_id, .group_id = ordered->master_group_id };
+		gameserver_shard_broadcast(shard, ordered->frame, ordered->filter, &master);
+		gameserver_frame_release(shard->server, ordered->frame);
+		free(ordered);
+		ordered = next;
+	}
+}
+
+//
+// sending
+//
+
 // send raw bytes
 void gameserver_send_raw(struct gameserver *gserver, struct session *receiver, uint8_t *data, size_t data_len) {
 	assert(gserver != NULL);
 	assert(data != NULL);
 	assert(data_len > 0);
 
-	// build message for lws
-	uint8_t message[LWS_PRE + data_len];
-	memcpy(&message[LWS_PRE], data, data_len);
-	
-	// if the receiver is NULL, we send to everybody
-	// TODO: use receiver->message_queue and callback_on_writable()
+	struct gameserver_frame *frame = gameserver_frame_create(gserver, data, data_len);
+
+	// if the receiver is NULL, we send to everybody.
+	// this may be called from outside the service threads, so every shard gets mail.
 	if (receiver == NULL) {
-		const size_t sessions_len = stbds_arrlen(gserver->sessions);
-		for (size_t i = 0; i < sessions_len; ++i) {
-			lws_write(gserver->sessions[i]->wsi, &message[LWS_PRE], data_len, LWS_WRITE_TEXT);
+		struct session nobody = { .id = 0, .group_id = 0 };
+		for (int i = 0; i < gserver->shards_len; ++i) {
+			gameserver_shard_post(&gserver->shards[i], frame, filter_everybody, &nobody);
 		}
 	} else {
-		lws_write(receiver->wsi, &message[LWS_PRE], data_len, LWS_WRITE_TEXT);
+		gameserver_enqueue(gserver, receiver, frame);
 	}
+
+	gameserver_frame_release(gserver, frame);
 }
 
 void gameserver_send_to(struct gameserver *gserver, struct message_header *message, struct session *receiver) {
-	// serialize message
-	cJSON *json = pack_message(message);
-	char *json_str = cJSON_PrintUnformatted(json); // TODO: maybe we can implement this directly with LWS_PRE padding?
-	const size_t json_str_len = strlen(json_str);
-	cJSON_Delete(json);
-	
-	// TODO: validation
-	assert(json_str != NULL);
-	assert(json_str_len > 0);
-
-	// build lws message
-	uint8_t *data = malloc(LWS_PRE + json_str_len + 1);
-	memcpy(&data[LWS_PRE], json_str, json_str_len + 1);
-	free(json_str);
-
-	// enqueue message
-	stbds_arrpush(receiver->message_queue, data);
-	lws_callback_on_writable(receiver->wsi);
+	struct gameserver_frame *frame = gameserver_frame_encode(gserver, message);
+	gameserver_enqueue(gserver, receiver, frame);
+	gameserver_frame_release(gserver, frame);
 }
 
 void gameserver_send_filtered(struct gameserver *gserver, struct message_header *message, struct session *master, session_filter_fn filter) {
 	assert(gserver != NULL);
 	assert(message != NULL);
+	assert(master != NULL);
 	assert(filter != NULL);
 
-	// serialize message
-	cJSON *json = pack_message(message);
-	char *json_str = cJSON_PrintUnformatted(json); // TODO: maybe we can implement this directly with LWS_PRE padding?
-	const size_t json_str_len = strlen(json_str);
-	cJSON_Delete(json);
-	
-	// TODO: validation
-	assert(json_str != NULL);
-	assert(json_str_len > 0);
-
-	// build lws message
-	const size_t sessions_len = stbds_arrlen(gserver->sessions);
-	for (size_t i = 0; i < sessions_len; ++i) {
-		struct session *tested = gserver->sessions[i];
-		if (filter(master, tested)) {
-			// TODO: refcount message instead of `malloc`ing for every session
-			unsigned char *data = malloc(LWS_PRE + json_str_len + 1);
-			memcpy(&data[LWS_PRE], json_str, json_str_len + 1);
+	// serialized once, shared by all receivers on all shards
+	struct gameserver_frame *frame = gameserver_frame_encode(gserver, message);
+	struct gameserver_shard *home = master->shard;
+	gameserver_shard_broadcast(home, frame, filter, master);
+
+	// other shards only get mail if the group has members there
+	int is_elsewhere = 1;
+	if ((filter == filter_group || filter == filter_group_exclude) && master->group_id != 0) {
+		struct gameserver_group *group = stbds_hmgetp_null(home->groups, master->group_id);
+		const int members_here = (group != NULL) ? stbds_arrlen(group->members) : 0;
+		is_elsewhere = (gameserver_group_size(gserver, master->group_id) > members_here);
+	}
+	if (is_elsewhere) {
+		for (int i = 0; i < gserver->shards_len; ++i) {
+			if (&gserver->shards[i] != home) {
+				gameserver_shard_post(&gserver->shards[i], frame, filter, master);
+			}
+		}
+	}
+
+	gameserver_frame_release(gserver, frame);
+}
 
-			stbds_arrpush(tested->message_queue, data);
-			lws_callback_on_writable(tested->wsi);
+//
+// groups
+//
+
+// groups_lock must be held
+static int gameserver_group_size_locked(struct gameserver *gserver, uint32_t group_id) {
+	const ptrdiff_t index = stbds_hmgeti(gserver->group_sizes, group_id);
+	return (index >= 0) ? gserver->group_sizes[index].value : 0;
+}
+
+int gameserver_session_set_group(struct gameserver *gserver, struct session *session, uint32_t group_id, int flags) {
+	if (session->group_id == group_id) {
+		return (group_id != 0 && flags == GAMESERVER_GROUP_MUST_BE_NEW);
+	}
+
+	// the sizes decide whether a group exists, check and update them at once
+	pthread_mutex_lock(&gserver->groups_lock);
+	if (group_id != 0 && flags != GAMESERVER_GROUP_ANY) {
+		const int exists = (gameserver_group_size_locked(gserver, group_id) > 0);
+		if ((flags == GAMESERVER_GROUP_MUST_EXIST && !exists) || (flags == GAMESERVER_GROUP_MUST_BE_NEW && exists)) {
+			pthread_mutex_unlock(&gserver->groups_lock);
+			return 1;
+		}
+	}
+	if (session->group_id != 0) {
+		const int size = gameserver_group_size_locked(gserver, session->group_id) - 1;
+		if (size > 0) {
+			stbds_hmput(gserver->group_sizes, session->group_id, size);
+		} else {
+			stbds_hmdel(gserver->group_sizes, session->group_id);
+		}
+	}
+	if (group_id != 0) {
+		// not inline, hmput inserts the key before evaluating the value
+		const int size = gameserver_group_size_locked(gserver, group_id) + 1;
+		stbds_hmput(gserver->group_sizes, group_id, size);
+	}
+	pthread_mutex_unlock(&gserver->groups_lock);
+
+	// the shard's member lists are only touched by its own thread
+	struct gameserver_shard *shard = session->shard;
+
+	// leave, by moving the last member into our slot
+	if (session->group_index >= 0) {
+		struct gameserver_group *group = stbds_hmgetp_null(shard->groups, session->group_id);
+		assert(group != NULL);
+		assert(group->members[session->group_index] == session);
+
+		struct session *last = stbds_arrpop(group->members);
+		if (last != session) {
+			group->members[session->group_index] = last;
+			last->group_index = session->group_index;
+		}
+		if (stbds_arrlen(group->members) == 0) {
+			stbds_arrfree(group->members);
+			stbds_hmdel(shard->groups, session->group_id);
 		}
+		session->group_index = -1;
 	}
 
-	free(json_str);
+	// join
+	session->group_id = group_id;
+	if (group_id != 0) {
+		struct gameserver_group *group = stbds_hmgetp_null(shard->groups, group_id);
+		if (group == NULL) {
+			stbds_hmputs(shard->groups, ((struct gameserver_group){ .key = group_id, .members = NULL }));
+			group = stbds_hmgetp_null(shard->groups, group_id);
+		}
+		session->group_index = stbds_arrlen(group->members);
+		stbds_arrpush(group->members, session);
+	}
+
+	return 0;
+}
+
+int gameserver_group_size(struct gameserver *gserver, uint32_t group_id) {
+	pthread_mutex_lock(&gserver->groups_lock);
+	const int size = gameserver_group_size_locked(gserver, group_id);
+	pthread_mutex_unlock(&gserver->groups_lock);
+	return size;
+}
+
+int gameserver_group_ids(struct gameserver *gserver, uint32_t *ids, int ids_max) {
+	pthread_mutex_lock(&gserver->groups_lock);
+	int ids_len = 0;
+	for (int i = 0; i < stbds_hmlen(gserver->group_sizes) && ids_len < ids_max; ++i) {
+		ids[ids_len++] = gserver->group_sizes[i].key;
+	}
+	pthread_mutex_unlock(&gserver->groups_lock);
+	return ids_len;
+}
+
+void gameserver_get_stats(struct gameserver *gserver, struct gameserver_stats *stats) {
+	memset(stats, 0, sizeof(*stats));
+	for (int i = 0; i < gserver->shards_len; ++i) {
+		const struct gameserver_stats *shard = &gserver->shards[i].stats;
+		stats->messages_received += __atomic_load_n(&shard->messages_received, __ATOMIC_RELAXED);
+		stats->bytes_received    += __atomic_load_n(&shard->bytes_received,    __ATOMIC_RELAXED);
+		stats->messages_sent     += __atomic_load_n(&shard->messages_sent,     __ATOMIC_RELAXED);
+		stats->bytes_sent        += __atomic_load_n(&shard->bytes_sent,        __ATOMIC_RELAXED);
+		stats->frames_queued     += __atomic_load_n(&shard->frames_queued,     __ATOMIC_RELAXED);
+		stats->bytes_queued      += __atomic_load_n(&shard->bytes_queued,      __ATOMIC_RELAXED);
+		stats->frames_dropped    += __atomic_load_n(&shard->frames_dropped,    __ATOMIC_RELAXED);
+	}
+}
+
+void gameserver_get_message_stats(struct gameserver *gserver, struct gameserver_message_stats *stats) {
+	memset(stats, 0, sizeof(*stats) * MSG_TYPE_MAX);
+	for (int i = 0; i < gserver->shards_len; ++i) {
+		for (int type = 0; type < MSG_TYPE_MAX; ++type) {
+			const struct gameserver_message_stats *shard = &gserver->shards[i].message_stats[type];
+			struct gameserver_message_stats *sum = &stats[type];
+			sum->received       += __atomic_load_n(&shard->received,       __ATOMIC_RELAXED);
+			sum->bytes_received += __atomic_load_n(&shard->bytes_received, __ATOMIC_RELAXED);
+			sum->sent           += __atomic_load_n(&shard->sent,           __ATOMIC_RELAXED);
+			sum->bytes_sent     += __atomic_load_n(&shard->bytes_sent,     __ATOMIC_RELAXED);
+			histogram_merge(&sum->handler_ns, &shard->handler_ns);
+		}
+	}
+}
+
+int gameserver_session_count(struct gameserver *gserver) {
+	int count = 0;
+	for (int i = 0; i < gserver->shards_len; ++i) {
+		count += __atomic_load_n(&gserver->shards[i].sessions_len, __ATOMIC_RELAXED);
+	}
+	return count;
+}
+
+struct session *gameserver_session_find(struct gameserver *gserver, uint32_t id) {
+	if (SESSION_ID_SHARD(id) >= (uint32_t)gserver->shards_len) {
+		return NULL;
+	}
+	return slotmap_get(&gserver->shards[SESSION_ID_SHARD(id)].sessions, SESSION_ID_SLOT(id));
 }
 
 //
@@ -168,15 +522,31 @@ char *gameserver_session_connection_type(struct session *s) {
 // private implementation
 //
 
+// the shard thread is the only writer, no read-modify-write needed.
+static void gameserver_stats_add(uint64_t *counter, uint64_t value) {
+	__atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static void gameserver_stats_sub(uint64_t *counter, uint64_t value) {
+	assert(*counter >= value);
+	__atomic_store_n(counter, *counter - value, __ATOMIC_RELAXED);
+}
+
+static uint64_t gameserver_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
 static int callback_ws(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *data, size_t data_len) {
 	struct session *session = user;
-	struct gameserver *server = lws_context_user(lws_get_context(wsi));
+	struct gameserver_shard *shard = lws_context_user(lws_get_context(wsi));
+	struct gameserver *server = shard->server;
 
 	switch ((int)reason) {
 	case LWS_CALLBACK_ESTABLISHED:
 		session->connection_type = CONNECTION_TYPE_WEBSOCKET;
-		gameserver_on_connect(server, session, wsi);
-		break;
+		return gameserver_on_connect(shard, session, wsi);
 	case LWS_CALLBACK_RECEIVE: {
 		gameserver_on_message(server, session, data, data_len);
 		break;
@@ -185,8 +555,7 @@ static int callback_ws(struct lws *wsi, enum lws_callback_reasons reason, void *
 		gameserver_on_disconnect(server, session);
 		break;
 	case LWS_CALLBACK_SERVER_WRITEABLE:
-		gameserver_on_writable(server, session);
-		break;
+		return gameserver_on_writable(server, session);
 	default: break;
 	}
 
@@ -195,18 +564,17 @@ static int callback_ws(struct lws *wsi, enum lws_callback_reasons reason, void *
 
 static int callback_rawtcp(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *data, size_t data_len) {
 	struct session *session = user;
-	struct gameserver *server = lws_context_user(lws_get_context(wsi));
+	struct gameserver_shard *shard = lws_context_user(lws_get_context(wsi));
+	struct gameserver *server = shard->server;
 
 	switch ((int)reason) {
 	case LWS_CALLBACK_RAW_ADOPT:
 		session->connection_type = CONNECTION_TYPE_TCP;
-		gameserver_on_connect(server, session, wsi);
-		break;
+		return gameserver_on_connect(shard, session, wsi);
 
 	case LWS_CALLBACK_ESTABLISHED:
 		session->connection_type = CONNECTION_TYPE_UNKNOWN;
-		gameserver_on_connect(server, session, wsi);
-		break;
+		return gameserver_on_connect(shard, session, wsi);
 
 	case LWS_CALLBACK_RAW_RX:
 	case LWS_CALLBACK_RECEIVE:
@@ -220,7 +588,15 @@ static int callback_rawtcp(struct lws *wsi, enum lws_callback_reasons reason, vo
 
 	case LWS_CALLBACK_SERVER_WRITEABLE:
 	case LWS_CALLBACK_RAW_WRITEABLE:
-		gameserver_on_writable(server, session);
+		return gameserver_on_writable(server, session);
+
+	// plain http, e.g. a metrics scraper
+	case LWS_CALLBACK_HTTP:
+		return gameserver_on_http(server, session, wsi, data);
+	case LWS_CALLBACK_HTTP_WRITEABLE:
+		return gameserver_on_http_writable(session, wsi);
+	case LWS_CALLBACK_CLOSED_HTTP:
+		stbds_arrfree(session->http_response);
 		break;
 
 	default: break;
@@ -229,41 +605,60 @@ static int callback_rawtcp(struct lws *wsi, enum lws_callback_reasons reason, vo
 	return 0;
 }
 
-static void gameserver_on_connect(struct gameserver *server, struct session *session, struct lws *wsi) {
+// returns -1 to refuse the connection, once the shard is full.
+static int gameserver_on_connect(struct gameserver_shard *shard, struct session *session, struct lws *wsi) {
+	struct gameserver *server = shard->server;
 	memset(session, 0, sizeof(*session));
 
+	// store session, the slot is part of the id
+	const uint32_t slot_id = slotmap_insert(&shard->sessions, session);
+	if (slot_id == 0) {
+		return -1;
+	}
+	__atomic_store_n(&shard->sessions_len, (int)slotmap_len(&shard->sessions), __ATOMIC_RELAXED);
+
 	// initialize
 	session->wsi = wsi;
-	session->id = (uint32_t)((rand() / (float)RAND_MAX) * 999999.0f + 100000.0f);
-	session->message_queue = NULL;
+	session->shard = shard;
+	session->id = ((uint32_t)shard->index << SLOTMAP_ID_BITS) | slot_id;
+	session->send_queue.capacity = server->send_queue_frames_max;
+	session->send_queue.frames = malloc(sizeof(struct gameserver_frame *) * session->send_queue.capacity);
+	session->tx_buffer = NULL;
+	session->rx_buffer = NULL;
+	session->closing = 0;
 	session->group_id = 0;
-
-	// store session
-	size_t sessions_count = stbds_arrlen(server->sessions);
-	for (size_t i = 0; i < sessions_count; ++i) {
-		assert(session->id != server->sessions[i]->id);
-	}
-
-	stbds_arrpush(server->sessions, session);
+	session->group_index = -1;
 
 	// propagate
 	if (server->callback_on_connect != NULL) {
 		server->callback_on_connect(server, session);
 	}
+	return 0;
 }
 
 static void gameserver_on_disconnect(struct gameserver *server, struct session *session) {
-	// cleanup
-	stbds_arrfree(session->message_queue);
+	// refused in gameserver_on_connect()
+	if (session->id == 0) {
+		return;
+	}
 
-	// remove from sessions
-	size_t sessions_count = stbds_arrlen(server->sessions);
-	for (size_t i = 0; i < sessions_count; ++i) {
-		if (server->sessions[i]->id == session->id) {
-			stbds_arrdel(server->sessions, i);
-			break;
-		}
+	// cleanup
+	while (session->send_queue.len > 0) {
+		gameserver_dequeue(session);
 	}
+	free(session->send_queue.frames);
+	session->send_queue.frames = NULL;
+	free(session->tx_buffer);
+	session->tx_buffer = NULL;
+	stbds_arrfree(session->rx_buffer);
+
+	// remove from its group and sessions
+	struct gameserver_shard *shard = session->shard;
+	gameserver_session_set_group(server, session, 0, GAMESERVER_GROUP_ANY);
+	struct session *removed = slotmap_remove(&shard->sessions, SESSION_ID_SLOT(session->id));
+	assert(removed == session);
+	(void)removed;
+	__atomic_store_n(&shard->sessions_len, (int)slotmap_len(&shard->sessions), __ATOMIC_RELAXED);
 
 	// propagate
 	if (server->callback_on_disconnect != NULL) {
@@ -275,49 +670,148 @@ static void gameserver_on_message(struct gameserver *server, struct session *ses
 	if (data_len == 0) {
 		return;
 	}
+	struct gameserver_stats *stats = &session->shard->stats;
+	gameserver_stats_add(&stats->bytes_received, data_len);
+
+	// frames can be split across or coalesced into reads.
+	// the common case, only whole frames, is decoded straight from `data`.
+	const uint8_t *buffer = data;
+	size_t buffer_len = data_len;
+	if (stbds_arrlen(session->rx_buffer) > 0) {
+		memcpy(stbds_arraddnptr(session->rx_buffer, data_len), data, data_len);
+		buffer = session->rx_buffer;
+		buffer_len = stbds_arrlen(session->rx_buffer);
+	}
+
+	size_t offset = 0;
+	ptrdiff_t frame_len;
+	union message_any message;
+	while ((frame_len = message_decode(&buffer[offset], buffer_len - offset, &message)) > 0) {
+		offset += frame_len;
+		gameserver_stats_add(&stats->messages_received, 1);
+
+		// invalid messages are counted as MSG_TYPE_UNKNOWN
+		assert((unsigned)message.header.type < MSG_TYPE_MAX);
+		struct gameserver_message_stats *type_stats = &session->shard->message_stats[message.header.type];
+		gameserver_stats_add(&type_stats->received, 1);
+		gameserver_stats_add(&type_stats->bytes_received, frame_len);
+
+		// TODO: this can easily occur, we just ignore invalid messages for now.
+		if (message.header.type == MSG_TYPE_UNKNOWN) {
+			continue;
+		}
 
-	// parse as json
-	// TODO: handle multiple json objects in data. (see engine.c)
-	cJSON *data_json = cJSON_ParseWithLength(data, data_len);
-	if (data_json == NULL) {
+		// propagate
+		if (server->callback_on_message != NULL) {
+			const uint64_t begin = gameserver_now_ns();
+			server->callback_on_message(server, session, &message.header);
+			histogram_record(&type_stats->handler_ns, gameserver_now_ns() - begin);
+		}
+	}
+
+	// not our protocol, nothing after this can be trusted
+	if (frame_len < 0) {
+		stbds_arrsetlen(session->rx_buffer, 0);
 		return;
 	}
 
-	// TODO: this can easily occur, but message.h doesnt validate the data yet.
-	//       we just fail here for visibility, these asserts can be removed later.
-	assert(cJSON_GetObjectItem(data_json, "header") != NULL);
-	assert(cJSON_GetObjectItem(cJSON_GetObjectItem(data_json, "header"), "type") != NULL);
-	assert(cJSON_IsNumber(cJSON_GetObjectItem(cJSON_GetObjectItem(data_json, "header"), "type")));
+	// keep the incomplete rest
+	if (buffer == session->rx_buffer) {
+		stbds_arrdeln(session->rx_buffer, 0, offset);
+	} else if (offset < buffer_len) {
+		memcpy(stbds_arraddnptr(session->rx_buffer, buffer_len - offset), &buffer[offset], buffer_len - offset);
+	}
+}
 
-	// unpack
-	struct message_header *message = unpack_message(data_json);
-	if (message == NULL) {
-		cJSON_Delete(data_json);
-		return;
+static int gameserver_on_writable(struct gameserver *server, struct session *session) {
+	struct gameserver_send_queue *queue = &session->send_queue;
+	if (session->closing) {
+		return -1;
+	}
+	if (queue->len == 0) {
+		return 0;
 	}
 
-	assert(message->type != MSG_TYPE_UNKNOWN);
-	assert(message->type != MSG_TYPE_MAX);
+	// lws allows a single write per writable callback.
+	// frames are copied back to back into one write, receivers split them by their length prefix.
+	// lws writes the websocket header into the headroom, so frames shared with
+	// sessions on other shards can't be written in place.
+	if (session->tx_buffer == NULL) {
+		session->tx_buffer = malloc(LWS_PRE + GAMESERVER_COALESCE_MAX);
+	}
+	uint8_t *out = &session->tx_buffer[LWS_PRE];
+	size_t out_len = 0;
+	int out_frames = 0;
+	while (out_frames < queue->len) {
+		struct gameserver_frame *frame = queue->frames[(queue->head + out_frames) % queue->capacity];
+		if (out_len + frame->len > GAMESERVER_COALESCE_MAX) {
+			break;
+		}
+		memcpy(&out[out_len], &frame->data[LWS_PRE], frame->len);
+		out_len += frame->len;
+		++out_frames;
+	}
 
-	// propagate
-	if (server->callback_on_message != NULL) {
-		server->callback_on_message(server, session, message);
+	// lws buffers what the socket didn't take and holds back the next
+	// writable callback until it is flushed, less than `out_len` is an error.
+	const int written = lws_write(session->wsi, out, out_len, LWS_WRITE_BINARY);
+	const int failed = (written < (int)out_len);
+	for (int i = 0; i < out_frames; ++i) {
+		if (!failed) {
+			const struct gameserver_frame *frame = queue->frames[queue->head];
+			struct gameserver_message_stats *type_stats = &session->shard->message_stats[frame->type];
+			gameserver_stats_add(&type_stats->sent, 1);
+			gameserver_stats_add(&type_stats->bytes_sent, frame->len);
+		}
+		gameserver_dequeue(session);
+	}
+	if (failed) {
+		return -1;
 	}
+	gameserver_stats_add(&session->shard->stats.messages_sent, out_frames);
+	gameserver_stats_add(&session->shard->stats.bytes_sent, out_len);
 
-	free_message(data_json, message);
+	if (queue->len > 0) {
+		lws_callback_on_writable(session->wsi);
+	}
+	return 0;
 }
 
-static void gameserver_on_writable(struct gameserver *server, struct session *session) {
-	// write all queued messages
-	size_t message_queue_len = stbds_arrlen(session->message_queue);
-	for (size_t i = 0; i < message_queue_len; ++i) {
-		char *msg = session->message_queue[i];
+// http shares the game port, the only page is /metrics.
+// these connections never become sessions, only `http_response` is used.
+static int gameserver_on_http(struct gameserver *server, struct session *session, struct lws *wsi, const char *uri) {
+	if (strcmp(uri, "/metrics") != 0) {
+		lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL);
+		return lws_http_transaction_completed(wsi) ? -1 : 0;
+	}
 
-		lws_write(session->wsi, (unsigned char *)&msg[LWS_PRE], strlen(&msg[LWS_PRE]), LWS_WRITE_TEXT);
-		free(msg);
+	// rendered at once, the body goes out with the next writable callback
+	stbds_arrsetlen(session->http_response, LWS_PRE);
+	metrics_write_prometheus(server, &session->http_response);
+	const size_t body_len = stbds_arrlen(session->http_response) - LWS_PRE;
+
+	uint8_t headers[LWS_PRE + 256];
+	uint8_t *start = &headers[LWS_PRE];
+	uint8_t *p = start;
+	uint8_t *end = &headers[sizeof(headers) - 1];
+	if (lws_add_http_common_headers(wsi, HTTP_STATUS_OK, "text/plain; version=0.0.4", body_len, &p, end) != 0
+	    || lws_finalize_write_http_header(wsi, start, &p, end) != 0) {
+		return -1;
 	}
-	stbds_arrfree(session->message_queue);
-	session->message_queue = NULL;
+	lws_callback_on_writable(wsi);
+	return 0;
 }
 
+static int gameserver_on_http_writable(struct session *session, struct lws *wsi) {
+	if (session->http_response == NULL) {
+		return 0;
+	}
 
+	const size_t body_len = stbds_arrlen(session->http_response) - LWS_PRE;
+	const int written = lws_write(wsi, (uint8_t *)&session->http_response[LWS_PRE], body_len, LWS_WRITE_HTTP_FINAL);
+	stbds_arrfree(session->http_response);
+	if (written < (int)body_len) {
+		return -1;
+	}
+	return lws_http_transaction_completed(wsi) ? -1 : 0;
+}
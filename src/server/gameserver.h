@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <pthread.h>
+#include "util/histogram.h"
+#include "util/slotmap.h"
 
 //
 // types
@@ -32,11 +35,95 @@ enum connection_type {
 	CONNECTION_TYPE_TCP,
 };
 
-struct gameserver {
+enum gameserver_overflow {
+	GAMESERVER_OVERFLOW_DISCONNECT, // slow clients are disconnected
+	GAMESERVER_OVERFLOW_DROP,       // new messages are dropped until the client caught up
+};
+
+#define GAMESERVER_SEND_QUEUE_FRAMES 256
+#define GAMESERVER_SEND_QUEUE_BYTES  (64 * 1024)
+#define GAMESERVER_COALESCE_MAX      4096 // bytes per write
+
+#define GAMESERVER_SHARDS_MAX 64 // session ids hold the shard above SLOTMAP_ID_BITS
+
+/* sessions sharing a group id, e.g. a lobby. only non-empty groups exist. */
+struct gameserver_group {
+	uint32_t key;             // group id
+	struct session **members; // stb_ds, unordered
+};
+
+struct gameserver_group_size {
+	uint32_t key;             // group id
+	int value;                // members on all shards
+};
+
+/* a broadcast posted to another shard, delivered by its service thread */
+struct gameserver_mail {
+	struct gameserver_mail *next;
+	struct gameserver_frame *frame; // holds a reference
+	session_filter_fn filter;       // NULL for everybody
+	uint32_t master_id;             // the sender, as seen by `filter`
+	uint32_t master_group_id;
+};
+
+/* traffic of a shard, only its thread writes these */
+struct gameserver_stats {
+	uint64_t messages_received;
+	uint64_t bytes_received;
+	uint64_t messages_sent;
+	uint64_t bytes_sent;
+
+	// send queues of the shard's sessions
+	uint64_t frames_queued;  // gauge
+	uint64_t bytes_queued;   // gauge
+	uint64_t frames_dropped; // did not fit
+};
+
+/* traffic of one message type on a shard, only its thread writes these */
+struct gameserver_message_stats {
+	uint64_t received;
+	uint64_t bytes_received;
+	uint64_t sent;             // per receiver
+	uint64_t bytes_sent;
+	struct histogram handler_ns; // time spent in callback_on_message
+};
+
+/* one service thread with its own lws context, all listening on the same port.
+   sessions stay on the shard which accepted them, only its thread touches them. */
+struct gameserver_shard {
+	struct gameserver *server;
 	struct lws_context *lws;
-	struct session **sessions;
+	pthread_t thread;
+	int index;
 
-	int shutdown_requested;
+	struct slotmap sessions;         // by session id, up to SLOTMAP_CAPACITY
+	struct gameserver_group *groups; // stb_ds hashmap, group id -> members on this shard
+	int sessions_len;                // readable from other threads
+
+	struct gameserver_mail *mailbox; // lock-free stack, pushed by any thread
+	struct gameserver_stats stats;   // readable from other threads
+	struct gameserver_message_stats *message_stats; // MSG_TYPE_MAX, readable from other threads
+};
+
+struct gameserver {
+	struct gameserver_shard *shards;
+	int shards_len;
+
+	// lobbies span shards, their sizes are shared
+	pthread_mutex_t groups_lock;
+	struct gameserver_group_size *group_sizes; // stb_ds hashmap, under `groups_lock`
+
+	volatile int shutdown_requested;
+
+	// allocations by any thread, atomic
+	uint64_t frames_allocated;
+	uint64_t frames_freed;
+	uint64_t mails_allocated;
+
+	// high-water marks of each session's send queue, set after gameserver_init()
+	int    send_queue_frames_max;
+	size_t send_queue_bytes_max;
+	enum gameserver_overflow send_queue_overflow;
 
 	// callbacks
 	on_connect_fn    callback_on_connect;
@@ -44,15 +131,40 @@ struct gameserver {
 	on_message_fn    callback_on_message;
 };
 
+/* an encoded message, shared by all sessions it is queued on.
+   freed when the last of them has written it. */
+struct gameserver_frame {
+	int refcount; // atomic
+	int type;     // enum message_type, MSG_TYPE_UNKNOWN for raw data
+	size_t len;
+	uint8_t data[]; // LWS_PRE bytes of headroom, then `len` bytes
+};
+
+/* bounded ring of frames waiting for the socket to become writable */
+struct gameserver_send_queue {
+	struct gameserver_frame **frames;
+	int head, len, capacity;
+	size_t bytes;   // sum of the queued frame lengths
+	size_t dropped; // frames which did not fit
+};
+
 /* represents the state of a client connection */
 struct session {
 	struct lws *wsi;
-	char **message_queue;
+	struct gameserver_shard *shard;
+	struct gameserver_send_queue send_queue;
+	uint8_t *tx_buffer; // LWS_PRE + GAMESERVER_COALESCE_MAX, for coalesced writes
+	uint8_t *rx_buffer; // stb_ds, incomplete frames
+	int closing;        // overflowed its send queue, waiting to be closed
+	char *http_response; // stb_ds, LWS_PRE then the body. plain http requests only
 	enum connection_type connection_type;
 	
 	// client userdata
-	int id;
-	uint32_t group_id;
+	uint32_t id;       // unique while connected, 0 before. see gameserver_session_find()
+	uint32_t group_id; // see gameserver_session_set_group()
+
+	// position for O(1) removal, maintained by the gameserver
+	int group_index;   // in the shard's group members, -1 without a group
 };
 
 //
@@ -60,7 +172,7 @@ struct session {
 //
 
 // init & destroy
-int  gameserver_init         (struct gameserver *, uint16_t port);
+int  gameserver_init         (struct gameserver *, uint16_t port, int threads);
 void gameserver_destroy      (struct gameserver *);
 void gameserver_shutdown     (struct gameserver *);
 
@@ -68,10 +180,29 @@ void gameserver_shutdown     (struct gameserver *);
 void gameserver_listen       (struct gameserver *);
 
 //   sending                         data
+// sessions may only be passed in from callbacks of their own shard.
+// gameserver_send_raw() to everybody (receiver NULL) works from any thread.
 void gameserver_send_raw     (struct gameserver *, struct session *receiver, uint8_t *data, size_t data_len);
 void gameserver_send_to      (struct gameserver *, struct message_header *message, struct session  *receiver);
 void gameserver_send_filtered(struct gameserver *, struct message_header *message, struct session *master, session_filter_fn filter);
 
+//   groups                          (lobbies), consistent across shards
+#define GAMESERVER_GROUP_ANY         0
+#define GAMESERVER_GROUP_MUST_EXIST  1 // join only
+#define GAMESERVER_GROUP_MUST_BE_NEW 2 // create only
+// moves the session into a group, 0 leaves. returns 1 if `flags` didn't hold.
+int gameserver_session_set_group(struct gameserver *, struct session *, uint32_t group_id, int flags);
+int gameserver_group_size       (struct gameserver *, uint32_t group_id);
+int gameserver_group_ids        (struct gameserver *, uint32_t *ids, int ids_max);
+int gameserver_session_count    (struct gameserver *);
+// sums of all shards since gameserver_init(), any thread.
+void gameserver_get_stats       (struct gameserver *, struct gameserver_stats *);
+// adds up the per message type stats of all shards, `stats` holds MSG_TYPE_MAX. any thread.
+void gameserver_get_message_stats(struct gameserver *, struct gameserver_message_stats *stats);
+// NULL for unknown ids and sessions which disconnected since.
+// only from callbacks of the shard the session is on.
+struct session *gameserver_session_find(struct gameserver *, uint32_t id);
+
 // filters
 int  filter_group            (struct session *o, struct session *t);
 int  filter_group_exclude    (struct session *o, struct session *t);
@@ -0,0 +1,874 @@
+//
+// Load generator for the gameserver.
+//
+// Opens many raw TCP and WebSocket connections to a (local) server and runs a
+// closed loop on each of them: send a request, wait for its response, send the
+// next one from the script. Reports the connection rate, message throughput and
+// round trip times per transport.
+//
+// Build with `make loadgen`, see `loadgen --help` for the options.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <stb_ds.h>
+#include "server/gameserver.h"
+#include "server/errors.h"
+#include "net/message.h"
+
+#define LOADGEN_SCRIPT_MAX     16
+#define LOADGEN_EVENTS_MAX     512
+#define LOADGEN_OPEN_PER_LOOP  64          // don't starve established connections while connecting
+#define LOADGEN_RX_MAX         (64 * 1024) // unparseable data, give up on the connection
+#define LOADGEN_LOBBY_ID_BASE  1000
+
+enum loadgen_step {
+	LOADGEN_STEP_LIST,
+	LOADGEN_STEP_CREATE,
+	LOADGEN_STEP_JOIN,
+	LOADGEN_STEP_LEAVE,
+};
+
+enum loadgen_conn_state {
+	LOADGEN_CONN_CONNECTING,
+	LOADGEN_CONN_HANDSHAKE, // websocket upgrade sent
+	LOADGEN_CONN_READY,
+	LOADGEN_CONN_CLOSED,
+};
+
+struct loadgen_conn {
+	int fd;
+	int index;
+	enum connection_type type;
+	enum loadgen_conn_state state;
+	uint64_t connect_begin_ns;
+
+	char *rx; // stb_ds
+	char *tx; // stb_ds
+	int tx_waiting; // EPOLLOUT registered
+
+	// request in flight
+	int script_pos;
+	enum message_type awaiting; // MSG_TYPE_UNKNOWN if idle
+	int awaiting_lobby_id;
+	uint64_t sent_ns;
+};
+
+struct loadgen_stats {
+	int connections_ready;
+	int connections_failed;
+	int connections_lost;
+	uint64_t requests;
+	uint64_t responses;
+	uint64_t unsolicited; // welcome messages, broadcasts, ...
+	uint64_t timeouts;
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+	float *connect_ms; // stb_ds
+	float *rtt_ms;     // stb_ds
+};
+
+struct loadgen {
+	// config
+	struct sockaddr_in addr;
+	const char *host;
+	int port;
+	int connections;
+	float ws_fraction;
+	int rate; // connections per second, 0 is unlimited
+	float duration;
+	int timeout_ms;
+	enum loadgen_step script[LOADGEN_SCRIPT_MAX];
+	int script_len;
+
+	// state
+	int epoll_fd;
+	struct loadgen_conn *conns;
+	int opened;
+	int in_flight;
+	uint64_t start_ns;
+	uint64_t deadline_ns;
+	uint64_t last_ready_ns;
+
+	// indexed by `enum connection_type`
+	struct loadgen_stats stats[CONNECTION_TYPE_TCP + 1];
+};
+
+static int  loadgen_parse_args(struct loadgen *, int argc, char **argv);
+static int  loadgen_parse_script(struct loadgen *, const char *script);
+static void loadgen_raise_fd_limit(int needed);
+static void loadgen_run(struct loadgen *);
+static void loadgen_report(struct loadgen *);
+
+static void conn_open(struct loadgen *, struct loadgen_conn *);
+static void conn_close(struct loadgen *, struct loadgen_conn *);
+static void conn_fail(struct loadgen *, struct loadgen_conn *);
+static void conn_on_event(struct loadgen *, struct loadgen_conn *, uint32_t events);
+static void conn_on_ready(struct loadgen *, struct loadgen_conn *);
+static void conn_on_message(struct loadgen *, struct loadgen_conn *, struct message_header *);
+static ptrdiff_t conn_decode(struct loadgen *, struct loadgen_conn *, const uint8_t *data, size_t len);
+static void conn_read(struct loadgen *, struct loadgen_conn *);
+static void conn_process_stream(struct loadgen *, struct loadgen_conn *);
+static void conn_process_frames(struct loadgen *, struct loadgen_conn *);
+static void conn_write(struct loadgen *, struct loadgen_conn *, const char *data, size_t len);
+static void conn_write_ws_frame(struct loadgen *, struct loadgen_conn *, int opcode, const char *data, size_t len);
+static void conn_flush(struct loadgen *, struct loadgen_conn *);
+static void conn_send_next(struct loadgen *, struct loadgen_conn *);
+static void conn_complete(struct loadgen *, struct loadgen_conn *);
+
+static uint64_t now_ns(void);
+static float percentile(float *values, float p);
+static int compare_floats(const void *a, const void *b);
+
+int main(int argc, char **argv) {
+	struct loadgen lg;
+	if (loadgen_parse_args(&lg, argc, argv)) {
+		return 1;
+	}
+
+	loadgen_raise_fd_limit(lg.connections + 16);
+
+	lg.epoll_fd = epoll_create1(0);
+	if (lg.epoll_fd < 0) {
+		perror("epoll_create1");
+		return 1;
+	}
+
+	printf("Connecting %d clients (%d websocket) to %s:%d for %.1fs...\n",
+			lg.connections, (int)(lg.connections * lg.ws_fraction), lg.host, lg.port, lg.duration);
+	loadgen_run(&lg);
+	loadgen_report(&lg);
+
+	for (int i = 0; i < lg.opened; ++i) {
+		conn_close(&lg, &lg.conns[i]);
+	}
+	for (int i = 0; i <= CONNECTION_TYPE_TCP; ++i) {
+		stbds_arrfree(lg.stats[i].connect_ms);
+		stbds_arrfree(lg.stats[i].rtt_ms);
+	}
+	free(lg.conns);
+	close(lg.epoll_fd);
+
+	return 0;
+}
+
+//
+// setup
+//
+
+static int loadgen_parse_args(struct loadgen *lg, int argc, char **argv) {
+	memset(lg, 0, sizeof(*lg));
+	lg->host = "127.0.0.1";
+	lg->port = 9124;
+	lg->connections = 1000;
+	lg->ws_fraction = 0.5f;
+	lg->rate = 0;
+	lg->duration = 10.0f;
+	lg->timeout_ms = 5000;
+	loadgen_parse_script(lg, "list,create,join,leave");
+
+	for (int i = 1; i < argc; ++i) {
+		const char *next_arg = (i+1 < argc) ? argv[i+1] : NULL;
+		if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+			printf(" --host           : Server address (default: 127.0.0.1).\n");
+			printf(" --port, -p       : Server port (default: 9124).\n");
+			printf(" --connections, -c: Number of concurrent clients (default: 1000).\n");
+			printf(" --ws             : Fraction of clients using WebSockets, 0..1 (default: 0.5).\n");
+			printf(" --rate           : New connections per second, 0 is unlimited (default: 0).\n");
+			printf(" --duration, -d   : Seconds to run (default: 10).\n");
+			printf(" --timeout        : Milliseconds until a request counts as lost (default: 5000).\n");
+			printf(" --script         : Requests each client repeats, any of list,create,join,leave.\n");
+			printf(" --json           : Send json instead of binary frames.\n");
+			return 1;
+		} else if (strcmp(argv[i], "--json") == 0) {
+			message_set_encoding(MESSAGE_ENCODING_JSON);
+			continue;
+		} else if (next_arg == NULL) {
+			fprintf(stderr, "Missing value for %s, see --help.\n", argv[i]);
+			return 1;
+		} else if (strcmp(argv[i], "--host") == 0) {
+			lg->host = next_arg;
+		} else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--port") == 0) {
+			lg->port = atoi(next_arg);
+		} else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--connections") == 0) {
+			lg->connections = atoi(next_arg);
+		} else if (strcmp(argv[i], "--ws") == 0) {
+			lg->ws_fraction = atof(next_arg);
+		} else if (strcmp(argv[i], "--rate") == 0) {
+			lg->rate = atoi(next_arg);
+		} else if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--duration") == 0) {
+			lg->duration = atof(next_arg);
+		} else if (strcmp(argv[i], "--timeout") == 0) {
+			lg->timeout_ms = atoi(next_arg);
+		} else if (strcmp(argv[i], "--script") == 0) {
+			if (loadgen_parse_script(lg, next_arg)) {
+				return 1;
+			}
+		} else {
+			fprintf(stderr, "Unknown option %s, see --help.\n", argv[i]);
+			return 1;
+		}
+		++i;
+	}
+
+	if (lg->connections <= 0 || lg->duration <= 0.0f || lg->timeout_ms <= 0) {
+		fprintf(stderr, "--connections, --duration and --timeout need to be positive.\n");
+		return 1;
+	}
+	lg->ws_fraction = (lg->ws_fraction < 0.0f) ? 0.0f : (lg->ws_fraction > 1.0f ? 1.0f : lg->ws_fraction);
+
+	lg->addr.sin_family = AF_INET;
+	lg->addr.sin_port = htons(lg->port);
+	if (inet_pton(AF_INET, lg->host, &lg->addr.sin_addr) != 1) {
+		fprintf(stderr, "Invalid IPv4 address '%s'.\n", lg->host);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int loadgen_parse_script(struct loadgen *lg, const char *script) {
+	static const char *names[] = {
+		[LOADGEN_STEP_LIST]   = "list",
+		[LOADGEN_STEP_CREATE] = "create",
+		[LOADGEN_STEP_JOIN]   = "join",
+		[LOADGEN_STEP_LEAVE]  = "leave",
+	};
+
+	lg->script_len = 0;
+	const char *token = script;
+	while (*token != '\0') {
+		const size_t token_len = strcspn(token, ",");
+		int found = 0;
+		for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); ++i) {
+			if (strlen(names[i]) == token_len && strncmp(token, names[i], token_len) == 0) {
+				if (lg->script_len >= LOADGEN_SCRIPT_MAX) {
+					fprintf(stderr, "Script is limited to %d steps.\n", LOADGEN_SCRIPT_MAX);
+					return 1;
+				}
+				lg->script[lg->script_len++] = i;
+				found = 1;
+			}
+		}
+		if (!found) {
+			fprintf(stderr, "Unknown script step '%.*s'.\n", (int)token_len, token);
+			return 1;
+		}
+		token += token_len + (token[token_len] == ',');
+	}
+
+	if (lg->script_len == 0) {
+		fprintf(stderr, "Script is empty.\n");
+		return 1;
+	}
+	return 0;
+}
+
+static void loadgen_raise_fd_limit(int needed) {
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+		return;
+	}
+	if (limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	if (limit.rlim_cur < (rlim_t)needed) {
+		fprintf(stderr, "Warning: only %lu file descriptors available, raise `ulimit -n`.\n", (unsigned long)limit.rlim_cur);
+	}
+}
+
+//
+// main loop
+//
+
+static void loadgen_run(struct loadgen *lg) {
+	struct epoll_event events[LOADGEN_EVENTS_MAX];
+	lg->conns = calloc(lg->connections, sizeof(*lg->conns));
+	lg->start_ns = now_ns();
+	lg->deadline_ns = lg->start_ns + (uint64_t)(lg->duration * 1e9);
+	const uint64_t timeout_ns = (uint64_t)lg->timeout_ms * 1000000ull;
+	uint64_t next_timeout_check_ns = lg->start_ns;
+
+	for (;;) {
+		uint64_t now = now_ns();
+
+		// open new connections
+		if (lg->opened < lg->connections && now < lg->deadline_ns) {
+			int target = lg->connections;
+			if (lg->rate > 0) {
+				const int due = (int)((now - lg->start_ns) / 1e9 * lg->rate) + 1;
+				target = (due < target) ? due : target;
+			}
+			for (int n = 0; lg->opened < target && n < LOADGEN_OPEN_PER_LOOP; ++n) {
+				struct loadgen_conn *conn = &lg->conns[lg->opened];
+				conn->index = lg->opened++;
+				conn->type = (conn->index < lg->connections * lg->ws_fraction) ? CONNECTION_TYPE_WEBSOCKET : CONNECTION_TYPE_TCP;
+				conn_open(lg, conn);
+			}
+		}
+
+		const int events_len = epoll_wait(lg->epoll_fd, events, LOADGEN_EVENTS_MAX, 1);
+		if (events_len < 0 && errno != EINTR) {
+			perror("epoll_wait");
+			return;
+		}
+		for (int i = 0; i < events_len; ++i) {
+			conn_on_event(lg, events[i].data.ptr, events[i].events);
+		}
+
+		// lost requests and stuck handshakes, a full scan is fine 10 times per second
+		now = now_ns();
+		if (now >= next_timeout_check_ns) {
+			next_timeout_check_ns = now + 100000000ull;
+			for (int i = 0; i < lg->opened; ++i) {
+				struct loadgen_conn *conn = &lg->conns[i];
+				switch (conn->state) {
+				case LOADGEN_CONN_CONNECTING:
+				case LOADGEN_CONN_HANDSHAKE:
+					if (now - conn->connect_begin_ns > timeout_ns) {
+						conn_fail(lg, conn);
+					}
+					break;
+				case LOADGEN_CONN_READY:
+					if (conn->awaiting != MSG_TYPE_UNKNOWN && now - conn->sent_ns > timeout_ns) {
+						lg->stats[conn->type].timeouts++;
+						conn->awaiting = MSG_TYPE_UNKNOWN;
+						lg->in_flight--;
+						conn_send_next(lg, conn);
+					}
+					break;
+				case LOADGEN_CONN_CLOSED:
+					break;
+				}
+			}
+		}
+
+		// no new requests after the deadline, wait for the ones in flight
+		if (now >= lg->deadline_ns && (lg->in_flight == 0 || now >= lg->deadline_ns + timeout_ns)) {
+			break;
+		}
+	}
+}
+
+static void loadgen_report(struct loadgen *lg) {
+	const double duration = (now_ns() - lg->start_ns) / 1e9;
+	const double connect_duration = (lg->last_ready_ns > lg->start_ns) ? (lg->last_ready_ns - lg->start_ns) / 1e9 : 0.0;
+
+	// totals
+	struct loadgen_stats total = {0};
+	for (int i = 0; i <= CONNECTION_TYPE_TCP; ++i) {
+		struct loadgen_stats *s = &lg->stats[i];
+		total.connections_ready  += s->connections_ready;
+		total.connections_failed += s->connections_failed;
+		total.connections_lost   += s->connections_lost;
+		total.requests           += s->requests;
+		total.responses          += s->responses;
+		total.unsolicited        += s->unsolicited;
+		total.timeouts           += s->timeouts;
+		total.bytes_sent         += s->bytes_sent;
+		total.bytes_received     += s->bytes_received;
+		for (int j = 0; j < stbds_arrlen(s->connect_ms); ++j) stbds_arrput(total.connect_ms, s->connect_ms[j]);
+		for (int j = 0; j < stbds_arrlen(s->rtt_ms); ++j)     stbds_arrput(total.rtt_ms, s->rtt_ms[j]);
+	}
+
+	printf("\nConnections: %d ready, %d failed, %d lost in %.2fs (%.1f connections/s)\n",
+			total.connections_ready, total.connections_failed, total.connections_lost,
+			connect_duration, (connect_duration > 0.0) ? total.connections_ready / connect_duration : 0.0);
+	printf("Traffic over %.2fs:\n\n", duration);
+
+	printf("%-10s %8s %8s %10s %9s %9s %10s %9s %9s %9s %9s\n",
+			"", "clients", "connect", "requests", "timeouts", "req/s", "rx msg/s", "rx KB/s", "tx KB/s", "rtt p50", "rtt p99");
+	const struct { const char *name; struct loadgen_stats *stats; } rows[] = {
+		{ "tcp",       &lg->stats[CONNECTION_TYPE_TCP] },
+		{ "websocket", &lg->stats[CONNECTION_TYPE_WEBSOCKET] },
+		{ "total",     &total },
+	};
+	for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); ++i) {
+		struct loadgen_stats *s = rows[i].stats;
+		if (s->connections_ready + s->connections_failed == 0) {
+			continue;
+		}
+		printf("%-10s %8d %6.1fms %10lu %9lu %9.0f %10.0f %9.1f %9.1f %7.2fms %7.2fms\n",
+				rows[i].name, s->connections_ready, percentile(s->connect_ms, 0.5f),
+				(unsigned long)s->requests, (unsigned long)s->timeouts,
+				stbds_arrlen(s->rtt_ms) / duration, (s->responses + s->unsolicited) / duration,
+				s->bytes_received / 1024.0 / duration, s->bytes_sent / 1024.0 / duration,
+				percentile(s->rtt_ms, 0.5f), percentile(s->rtt_ms, 0.99f));
+	}
+
+	stbds_arrfree(total.connect_ms);
+	stbds_arrfree(total.rtt_ms);
+}
+
+//
+// connections
+//
+
+static void conn_open(struct loadgen *lg, struct loadgen_conn *conn) {
+	conn->state = LOADGEN_CONN_CONNECTING;
+	conn->connect_begin_ns = now_ns();
+	conn->awaiting = MSG_TYPE_UNKNOWN;
+
+	conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (conn->fd < 0) {
+		conn_fail(lg, conn);
+		return;
+	}
+
+	// requests are tiny, don't wait for more data
+	const int nodelay = 1;
+	setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+	if (connect(conn->fd, (struct sockaddr *)&lg->addr, sizeof(lg->addr)) != 0 && errno != EINPROGRESS) {
+		conn_fail(lg, conn);
+		return;
+	}
+
+	struct epoll_event event = { .events = EPOLLIN | EPOLLOUT, .data.ptr = conn };
+	conn->tx_waiting = 1;
+	if (epoll_ctl(lg->epoll_fd, EPOLL_CTL_ADD, conn->fd, &event) != 0) {
+		conn_fail(lg, conn);
+	}
+}
+
+static void conn_close(struct loadgen *lg, struct loadgen_conn *conn) {
+	if (conn->state == LOADGEN_CONN_CLOSED) {
+		return;
+	}
+	if (conn->awaiting != MSG_TYPE_UNKNOWN) {
+		conn->awaiting = MSG_TYPE_UNKNOWN;
+		lg->in_flight--;
+	}
+	if (conn->fd >= 0) {
+		epoll_ctl(lg->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+		close(conn->fd);
+	}
+	conn->fd = -1;
+	conn->state = LOADGEN_CONN_CLOSED;
+	stbds_arrfree(conn->rx);
+	stbds_arrfree(conn->tx);
+}
+
+static void conn_fail(struct loadgen *lg, struct loadgen_conn *conn) {
+	if (conn->state == LOADGEN_CONN_READY) {
+		lg->stats[conn->type].connections_lost++;
+	} else if (conn->state != LOADGEN_CONN_CLOSED) {
+		lg->stats[conn->type].connections_failed++;
+	}
+	conn_close(lg, conn);
+}
+
+static void conn_on_event(struct loadgen *lg, struct loadgen_conn *conn, uint32_t events) {
+	if (conn->state == LOADGEN_CONN_CONNECTING) {
+		int error = 0;
+		socklen_t error_len = sizeof(error);
+		if ((events & (EPOLLERR | EPOLLHUP)) || getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error != 0) {
+			conn_fail(lg, conn);
+			return;
+		}
+		if (!(events & EPOLLOUT)) {
+			return;
+		}
+
+		if (conn->type == CONNECTION_TYPE_WEBSOCKET) {
+			// the key is the sample nonce from RFC 6455, the server doesn't care.
+			char request[512];
+			const int request_len = snprintf(request, sizeof(request),
+					"GET / HTTP/1.1\r\n"
+					"Host: %s:%d\r\n"
+					"Upgrade: websocket\r\n"
+					"Connection: Upgrade\r\n"
+					"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+					"Sec-WebSocket-Version: 13\r\n"
+					"Sec-WebSocket-Protocol: binary\r\n"
+					"\r\n", lg->host, lg->port);
+			conn->state = LOADGEN_CONN_HANDSHAKE;
+			conn_write(lg, conn, request, request_len);
+		} else {
+			conn_on_ready(lg, conn);
+		}
+	}
+
+	if (conn->state != LOADGEN_CONN_CLOSED && (events & EPOLLIN)) {
+		conn_read(lg, conn);
+	}
+	if (conn->state != LOADGEN_CONN_CLOSED && (events & EPOLLOUT)) {
+		conn_flush(lg, conn);
+	}
+	if (conn->state != LOADGEN_CONN_CLOSED && (events & (EPOLLERR | EPOLLHUP))) {
+		conn_fail(lg, conn);
+	}
+}
+
+static void conn_on_ready(struct loadgen *lg, struct loadgen_conn *conn) {
+	struct loadgen_stats *stats = &lg->stats[conn->type];
+	const uint64_t now = now_ns();
+
+	conn->state = LOADGEN_CONN_READY;
+	stats->connections_ready++;
+	stbds_arrput(stats->connect_ms, (now - conn->connect_begin_ns) / 1e6f);
+	lg->last_ready_ns = now;
+
+	// start at different steps, so not every client creates a lobby at once
+	conn->script_pos = conn->index % lg->script_len;
+	conn_send_next(lg, conn);
+}
+
+static void conn_read(struct loadgen *lg, struct loadgen_conn *conn) {
+	char buffer[16 * 1024];
+	for (;;) {
+		const ssize_t len = recv(conn->fd, buffer, sizeof(buffer), 0);
+		if (len > 0) {
+			memcpy(stbds_arraddnptr(conn->rx, len), buffer, len);
+			lg->stats[conn->type].bytes_received += len;
+			continue;
+		}
+		if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+			conn_fail(lg, conn);
+			return;
+		}
+		if (errno != EINTR) {
+			break;
+		}
+	}
+
+	if (conn->state == LOADGEN_CONN_HANDSHAKE) {
+		const size_t rx_len = stbds_arrlen(conn->rx);
+		size_t header_len = 0;
+		for (size_t i = 3; i < rx_len && header_len == 0; ++i) {
+			if (strncmp(&conn->rx[i - 3], "\r\n\r\n", 4) == 0) {
+				header_len = i + 1;
+			}
+		}
+		if (header_len == 0) {
+			return;
+		}
+		if (strncmp(conn->rx, "HTTP/1.1 101", 12) != 0) {
+			conn_fail(lg, conn);
+			return;
+		}
+		stbds_arrdeln(conn->rx, 0, header_len);
+		conn_on_ready(lg, conn);
+	}
+
+	if (conn->state == LOADGEN_CONN_READY) {
+		if (conn->type == CONNECTION_TYPE_WEBSOCKET) {
+			conn_process_frames(lg, conn);
+		} else {
+			conn_process_stream(lg, conn);
+		}
+	}
+
+	if (conn->state != LOADGEN_CONN_CLOSED && stbds_arrlen(conn->rx) > LOADGEN_RX_MAX) {
+		conn_fail(lg, conn);
+	}
+}
+
+// decodes all complete message frames in `data`.
+// returns the number of bytes consumed or -1 after the connection failed.
+static ptrdiff_t conn_decode(struct loadgen *lg, struct loadgen_conn *conn, const uint8_t *data, size_t len) {
+	size_t offset = 0;
+	while (offset < len && conn->state == LOADGEN_CONN_READY) {
+		union message_any message;
+		const ptrdiff_t frame_len = message_decode(&data[offset], len - offset, &message);
+		if (frame_len == 0) {
+			break; // incomplete
+		} else if (frame_len < 0) {
+			conn_fail(lg, conn);
+			return -1;
+		}
+		offset += frame_len;
+		conn_on_message(lg, conn, &message.header);
+	}
+	return offset;
+}
+
+// raw tcp is a plain stream of message frames.
+static void conn_process_stream(struct loadgen *lg, struct loadgen_conn *conn) {
+	const ptrdiff_t offset = conn_decode(lg, conn, (uint8_t *)conn->rx, stbds_arrlen(conn->rx));
+	if (offset > 0 && conn->state == LOADGEN_CONN_READY) {
+		stbds_arrdeln(conn->rx, 0, offset);
+	}
+}
+
+static void conn_process_frames(struct loadgen *lg, struct loadgen_conn *conn) {
+	size_t offset = 0;
+	while (conn->state == LOADGEN_CONN_READY) {
+		const unsigned char *frame = (unsigned char *)&conn->rx[offset];
+		const size_t len = stbds_arrlen(conn->rx) - offset;
+		if (len < 2) {
+			break;
+		}
+
+		const int opcode = frame[0] & 0x0f;
+		const int masked = frame[1] & 0x80;
+		uint64_t payload_len = frame[1] & 0x7f;
+		size_t header_len = 2;
+		if (payload_len == 126) {
+			header_len = 4;
+			payload_len = (len < header_len) ? 0 : ((uint64_t)frame[2] << 8) | frame[3];
+		} else if (payload_len == 127) {
+			header_len = 10;
+			payload_len = 0;
+			for (int i = 0; i < 8 && len >= header_len; ++i) {
+				payload_len = (payload_len << 8) | frame[2 + i];
+			}
+		}
+		const size_t mask_offset = header_len;
+		header_len += masked ? 4 : 0;
+		if (len < header_len || len - header_len < payload_len) {
+			break; // incomplete
+		}
+
+		char *payload = &conn->rx[offset + header_len];
+		if (masked) {
+			for (uint64_t i = 0; i < payload_len; ++i) {
+				payload[i] ^= frame[mask_offset + (i & 3)];
+			}
+		}
+		offset += header_len + payload_len;
+
+		switch (opcode) {
+		case 0x0: // continuation, the server doesn't fragment its small messages
+		case 0x1: // text
+		case 0x2: // binary
+			// every websocket message carries whole frames
+			if (conn_decode(lg, conn, (uint8_t *)payload, payload_len) != (ptrdiff_t)payload_len) {
+				if (conn->state == LOADGEN_CONN_READY) {
+					conn_fail(lg, conn);
+				}
+				return;
+			}
+			break;
+		case 0x8: // close
+			conn_fail(lg, conn);
+			return;
+		case 0x9: // ping
+			conn_write_ws_frame(lg, conn, 0xA, payload, payload_len);
+			break;
+		default:
+			break;
+		}
+	}
+	if (conn->state == LOADGEN_CONN_READY) {
+		stbds_arrdeln(conn->rx, 0, offset);
+	}
+}
+
+static void conn_on_message(struct loadgen *lg, struct loadgen_conn *conn, struct message_header *message) {
+	struct loadgen_stats *stats = &lg->stats[conn->type];
+	if (message->type == MSG_TYPE_UNKNOWN) {
+		stats->unsolicited++;
+		return;
+	}
+
+	int is_response = 0;
+	if (message->type == conn->awaiting) {
+		switch (message->type) {
+		case LOBBY_CREATE_RESPONSE: {
+			// other clients' lobbies are broadcast to everybody
+			struct lobby_create_response *res = (struct lobby_create_response *)message;
+			if (res->lobby_id == conn->awaiting_lobby_id) {
+				if (res->create_error == SERVER_NO_ERROR) {
+					// the creator joins the lobby, wait for that as well
+					conn->awaiting = LOBBY_JOIN_RESPONSE;
+					stats->responses++;
+				} else {
+					is_response = 1;
+				}
+			}
+			break;
+		}
+		case LOBBY_JOIN_RESPONSE:
+			is_response = (((struct lobby_join_response *)message)->is_other_user == 0);
+			break;
+		case LOBBY_LIST_RESPONSE:
+			is_response = 1;
+			break;
+		case MSG_TYPE_UNKNOWN:
+		case WELCOME_RESPONSE:
+		case LOBBY_CREATE_REQUEST:
+		case LOBBY_JOIN_REQUEST:
+		case LOBBY_LIST_REQUEST:
+		case BATTLE_SNAPSHOT:
+		case BATTLE_SNAPSHOT_ACK:
+		case MSG_DISCONNECTED:
+		case MSG_TYPE_MAX:
+			break;
+		}
+	}
+
+	if (is_response) {
+		conn_complete(lg, conn);
+	} else if (message->type != LOBBY_CREATE_RESPONSE || conn->awaiting != LOBBY_JOIN_RESPONSE) {
+		stats->unsolicited++;
+	}
+}
+
+static void conn_complete(struct loadgen *lg, struct loadgen_conn *conn) {
+	struct loadgen_stats *stats = &lg->stats[conn->type];
+	stats->responses++;
+	stbds_arrput(stats->rtt_ms, (now_ns() - conn->sent_ns) / 1e6f);
+	conn->awaiting = MSG_TYPE_UNKNOWN;
+	lg->in_flight--;
+	conn_send_next(lg, conn);
+}
+
+static void conn_send_next(struct loadgen *lg, struct loadgen_conn *conn) {
+	const uint64_t now = now_ns();
+	if (now >= lg->deadline_ns || conn->state != LOADGEN_CONN_READY) {
+		return;
+	}
+
+	union {
+		struct message_header header;
+		struct lobby_create_request create;
+		struct lobby_join_request join;
+		struct lobby_list_request list;
+	} req;
+
+	const enum loadgen_step step = lg->script[conn->script_pos++ % lg->script_len];
+	switch (step) {
+	case LOADGEN_STEP_LIST:
+		message_header_init(&req.header, LOBBY_LIST_REQUEST);
+		conn->awaiting = LOBBY_LIST_RESPONSE;
+		conn->awaiting_lobby_id = 0;
+		break;
+	case LOADGEN_STEP_CREATE:
+		message_header_init(&req.header, LOBBY_CREATE_REQUEST);
+		req.create.lobby_id = LOADGEN_LOBBY_ID_BASE + conn->index;
+		req.create.lobby_name = "loadgen";
+		conn->awaiting = LOBBY_CREATE_RESPONSE;
+		conn->awaiting_lobby_id = req.create.lobby_id;
+		break;
+	case LOADGEN_STEP_JOIN:
+		// the lobby of the neighbor, which may or may not exist right now
+		message_header_init(&req.header, LOBBY_JOIN_REQUEST);
+		req.join.lobby_id = LOADGEN_LOBBY_ID_BASE + (conn->index + 1) % lg->connections;
+		conn->awaiting = LOBBY_JOIN_RESPONSE;
+		conn->awaiting_lobby_id = 0;
+		break;
+	case LOADGEN_STEP_LEAVE:
+		message_header_init(&req.header, LOBBY_JOIN_REQUEST);
+		req.join.lobby_id = 0;
+		conn->awaiting = LOBBY_JOIN_RESPONSE;
+		conn->awaiting_lobby_id = 0;
+		break;
+	}
+
+	uint8_t frame[MESSAGE_FRAME_MAX];
+	const size_t frame_len = message_encode(&req.header, frame, sizeof(frame));
+
+	conn->sent_ns = now;
+	lg->stats[conn->type].requests++;
+	lg->in_flight++;
+	if (conn->type == CONNECTION_TYPE_WEBSOCKET) {
+		conn_write_ws_frame(lg, conn, 0x2, (const char *)frame, frame_len);
+	} else {
+		conn_write(lg, conn, (const char *)frame, frame_len);
+	}
+}
+
+static void conn_write(struct loadgen *lg, struct loadgen_conn *conn, const char *data, size_t len) {
+	memcpy(stbds_arraddnptr(conn->tx, len), data, len);
+	conn_flush(lg, conn);
+}
+
+// client frames have to be masked.
+static void conn_write_ws_frame(struct loadgen *lg, struct loadgen_conn *conn, int opcode, const char *data, size_t len) {
+	unsigned char header[14];
+	size_t header_len = 0;
+	header[header_len++] = 0x80 | opcode;
+	if (len < 126) {
+		header[header_len++] = 0x80 | len;
+	} else if (len <= 0xffff) {
+		header[header_len++] = 0x80 | 126;
+		header[header_len++] = (len >> 8) & 0xff;
+		header[header_len++] = len & 0xff;
+	} else {
+		header[header_len++] = 0x80 | 127;
+		for (int i = 7; i >= 0; --i) {
+			header[header_len++] = ((uint64_t)len >> (i * 8)) & 0xff;
+		}
+	}
+	const uint32_t mask = (uint32_t)rand();
+	const unsigned char *mask_bytes = &header[header_len];
+	memcpy(&header[header_len], &mask, 4);
+	header_len += 4;
+
+	char *frame = stbds_arraddnptr(conn->tx, header_len + len);
+	memcpy(frame, header, header_len);
+	for (size_t i = 0; i < len; ++i) {
+		frame[header_len + i] = data[i] ^ mask_bytes[i & 3];
+	}
+	conn_flush(lg, conn);
+}
+
+static void conn_flush(struct loadgen *lg, struct loadgen_conn *conn) {
+	size_t sent_total = 0;
+	const size_t tx_len = stbds_arrlen(conn->tx);
+	while (sent_total < tx_len) {
+		const ssize_t sent = send(conn->fd, &conn->tx[sent_total], tx_len - sent_total, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				conn_fail(lg, conn);
+				return;
+			}
+			break;
+		}
+		sent_total += sent;
+	}
+	lg->stats[conn->type].bytes_sent += sent_total;
+	stbds_arrdeln(conn->tx, 0, sent_total);
+
+	// only wait for EPOLLOUT while there is something left to send
+	const int tx_waiting = (stbds_arrlen(conn->tx) > 0 || conn->state == LOADGEN_CONN_CONNECTING);
+	if (tx_waiting != conn->tx_waiting) {
+		struct epoll_event event = { .events = EPOLLIN | (tx_waiting ? EPOLLOUT : 0), .data.ptr = conn };
+		epoll_ctl(lg->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+		conn->tx_waiting = tx_waiting;
+	}
+}
+
+//
+// utils
+//
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// sorts `values` in place, nearest rank.
+static float percentile(float *values, float p) {
+	const int count = stbds_arrlen(values);
+	if (count == 0) {
+		return 0.0f;
+	}
+	qsort(values, count, sizeof(*values), compare_floats);
+	int rank = (int)(p * count + 0.999999f);
+	rank = (rank < 1) ? 1 : (rank > count ? count : rank);
+	return values[rank - 1];
+}
+
+static int compare_floats(const void *a, const void *b) {
+	const float fa = *(const float *)a;
+	const float fb = *(const float *)b;
+	return (fa > fb) - (fa < fb);
+}
+
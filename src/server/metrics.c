@@ -0,0 +1,102 @@
+#include "server/metrics.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stb_ds.h>
+#include "net/message.h"
+#include "server/gameserver.h"
+
+#define HANDLER_BUCKET_FIRST 10 // 2^10 ns, about a microsecond
+#define HANDLER_BUCKET_LAST  30 // 2^30 ns, about a second
+
+static void append(char **out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void append_metric(char **out, const char *name, const char *type, const char *help);
+
+void metrics_write_prometheus(struct gameserver *gserver, char **out) {
+	struct gameserver_stats stats;
+	gameserver_get_stats(gserver, &stats);
+	struct gameserver_message_stats *types = malloc(sizeof(struct gameserver_message_stats) * MSG_TYPE_MAX);
+	gameserver_get_message_stats(gserver, types);
+
+	append_metric(out, "gameserver_sessions", "gauge", "Connected sessions.");
+	append(out, "gameserver_sessions %d\n", gameserver_session_count(gserver));
+
+	// per message type
+	append_metric(out, "gameserver_messages_received_total", "counter", "Messages received, invalid ones as MSG_TYPE_UNKNOWN.");
+	for (int type = 0; type < MSG_TYPE_MAX; ++type) {
+		append(out, "gameserver_messages_received_total{type=\"%s\"} %" PRIu64 "\n", message_type_to_name(type), types[type].received);
+	}
+	append_metric(out, "gameserver_message_bytes_received_total", "counter", "Bytes of the messages received.");
+	for (int type = 0; type < MSG_TYPE_MAX; ++type) {
+		append(out, "gameserver_message_bytes_received_total{type=\"%s\"} %" PRIu64 "\n", message_type_to_name(type), types[type].bytes_received);
+	}
+	append_metric(out, "gameserver_messages_sent_total", "counter", "Messages written, once per receiver. Raw data as MSG_TYPE_UNKNOWN.");
+	for (int type = 0; type < MSG_TYPE_MAX; ++type) {
+		append(out, "gameserver_messages_sent_total{type=\"%s\"} %" PRIu64 "\n", message_type_to_name(type), types[type].sent);
+	}
+	append_metric(out, "gameserver_message_bytes_sent_total", "counter", "Bytes of the messages written.");
+	for (int type = 0; type < MSG_TYPE_MAX; ++type) {
+		append(out, "gameserver_message_bytes_sent_total{type=\"%s\"} %" PRIu64 "\n", message_type_to_name(type), types[type].bytes_sent);
+	}
+
+	// a bucket holds the values up to its end, exclusive. the 1 ns difference to `le` doesn't matter.
+	append_metric(out, "gameserver_handler_seconds", "histogram", "Time spent handling a message.");
+	for (int type = 0; type < MSG_TYPE_MAX; ++type) {
+		const struct histogram *handler = &types[type].handler_ns;
+		if (handler->count == 0) {
+			continue;
+		}
+		const char *name = message_type_to_name(type);
+		for (int i = HANDLER_BUCKET_FIRST; i <= HANDLER_BUCKET_LAST; ++i) {
+			append(out, "gameserver_handler_seconds_bucket{type=\"%s\",le=\"%.9g\"} %" PRIu64 "\n",
+				name, (double)(1ull << i) / 1e9, histogram_count_below(handler, 1ull << i));
+		}
+		const uint64_t count = histogram_count_below(handler, UINT64_MAX);
+		append(out, "gameserver_handler_seconds_bucket{type=\"%s\",le=\"+Inf\"} %" PRIu64 "\n", name, count);
+		append(out, "gameserver_handler_seconds_sum{type=\"%s\"} %.9f\n", name, handler->sum / 1e9);
+		append(out, "gameserver_handler_seconds_count{type=\"%s\"} %" PRIu64 "\n", name, count);
+	}
+
+	// queues & allocations
+	append_metric(out, "gameserver_send_queue_frames", "gauge", "Frames waiting in the send queues.");
+	append(out, "gameserver_send_queue_frames %" PRIu64 "\n", stats.frames_queued);
+	append_metric(out, "gameserver_send_queue_bytes", "gauge", "Bytes waiting in the send queues.");
+	append(out, "gameserver_send_queue_bytes %" PRIu64 "\n", stats.bytes_queued);
+	append_metric(out, "gameserver_send_queue_dropped_total", "counter", "Frames which did not fit into a send queue.");
+	append(out, "gameserver_send_queue_dropped_total %" PRIu64 "\n", stats.frames_dropped);
+
+	const uint64_t frames_allocated = __atomic_load_n(&gserver->frames_allocated, __ATOMIC_RELAXED);
+	const uint64_t frames_freed = __atomic_load_n(&gserver->frames_freed, __ATOMIC_RELAXED);
+	append_metric(out, "gameserver_frames_allocated_total", "counter", "Encoded frames allocated.");
+	append(out, "gameserver_frames_allocated_total %" PRIu64 "\n", frames_allocated);
+	append_metric(out, "gameserver_frames_live", "gauge", "Encoded frames not freed yet.");
+	append(out, "gameserver_frames_live %" PRIu64 "\n", frames_allocated - frames_freed);
+	append_metric(out, "gameserver_mails_allocated_total", "counter", "Broadcasts posted to other shards.");
+	append(out, "gameserver_mails_allocated_total %" PRIu64 "\n", __atomic_load_n(&gserver->mails_allocated, __ATOMIC_RELAXED));
+
+	free(types);
+}
+
+//
+// private implementations
+//
+
+static void append(char **out, const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	const int len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	// vsnprintf writes a terminator, which is dropped again
+	char *dest = stbds_arraddnptr(*out, len + 1);
+	va_start(args, fmt);
+	vsnprintf(dest, len + 1, fmt, args);
+	va_end(args);
+	stbds_arrsetlen(*out, stbds_arrlen(*out) - 1);
+}
+
+static void append_metric(char **out, const char *name, const char *type, const char *help) {
+	append(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
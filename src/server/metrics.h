@@ -0,0 +1,20 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+//
+// Server metrics in the prometheus text format, served as GET /metrics on
+// the game port:
+//
+//     gameserver_messages_received_total{type="LOBBY_CREATE_REQUEST"} 12
+//     gameserver_handler_seconds_bucket{type="LOBBY_CREATE_REQUEST",le="1.024e-06"} 3
+//
+// Handler times are exported in power-of-two buckets from about a microsecond
+// to a second, the shards record them with finer sub-buckets.
+//
+
+struct gameserver;
+
+// appends the exposition to `out`, a stb_ds array. any thread.
+void metrics_write_prometheus(struct gameserver *, char **out);
+
+#endif
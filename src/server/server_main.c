@@ -4,14 +4,23 @@
 #include <assert.h>
 #include <ncurses.h>
 #include <unistd.h>
+#include <poll.h>
 #include <pthread.h>
 #include <arpa/inet.h>
 #include <stb_ds.h>
+#include <cJSON.h>
 #include "gameserver.h"
 #include "net/message.h"
 #include "services/services.h"
+#include "util/logring.h"
 
 #define MAX_INPUT_BYTES 4096  // How many bytes the admin can write into the input box.
+#define SERVER_LOG_ENTRIES 4096 // log lines the ui thread may fall behind, before they are dropped
+
+// formatted later by the ui thread, so these don't slow down the service threads.
+#define console_log(...)   logring_write(&server_log, LOGRING_INFO,  __VA_ARGS__)
+#define console_debug(...) logring_write(&server_log, LOGRING_DEBUG, __VA_ARGS__)
+#define console_error(...) logring_write(&server_log, LOGRING_ERROR, __VA_ARGS__)
 
 //
 // logic
@@ -33,17 +42,30 @@ static WINDOW *create_input_window(void);
 static const char *fmt_time(time_t time);
 static const char *fmt_date(time_t rawtime);
 
-static void console_log(char *fmt, ...);
+static void serverui_drain_logs(WINDOW *win_messages);
+static void serverui_sample_metrics(void);
+static void print_log_entry(enum logring_level, const struct timespec *, const char *message, void *userdata);
 
 //
 // vars
 //
 
-static pthread_mutex_t messagequeue_mutex = PTHREAD_MUTEX_INITIALIZER;
-const size_t messagequeue_max = 128;
-static char *messagequeue[128];
-static size_t messagequeue_len = 0;
+static struct logring server_log;
+static enum logring_level log_level = LOGRING_INFO;
+static int use_tui = 1; // json lines on stdout otherwise
 static struct gameserver gserver;
+static int gserver_running = 0; // atomic, gserver may be used from the ui thread
+
+// traffic per second, sampled by the ui thread
+static struct {
+	struct gameserver_stats last;
+	time_t last_time;
+	double messages_received, bytes_received;
+	double messages_sent, bytes_sent;
+} metrics;
+static int server_threads = 1;
+static size_t send_queue_kb = GAMESERVER_SEND_QUEUE_BYTES / 1024;
+static enum gameserver_overflow send_queue_overflow = GAMESERVER_OVERFLOW_DISCONNECT;
 
 int main(int argc, char **argv) {
 	int server_port = 9124;
@@ -54,26 +76,61 @@ int main(int argc, char **argv) {
 		if ((strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)) {
 			printf(" --help, -h  : Print this message.\n");
 			printf(" --port, -p  : Specify the server port.\n");
+			printf(" --json      : Send json instead of binary messages, for debugging.\n");
+			printf(" --send-queue: KB queued per client before it counts as slow (default: %d).\n", GAMESERVER_SEND_QUEUE_BYTES / 1024);
+			printf(" --drop-slow : Drop messages to slow clients instead of disconnecting them.\n");
+			printf(" --threads   : Service threads sharing the port, 0 for one per core (default: 1).\n");
+			printf(" --no-tui    : Log json lines to stdout and read commands from stdin.\n");
+			printf(" --log-level : debug, info, warn or error (default: info).\n");
 			return 0;
 		} else if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--port") == 0) && next_arg != NULL) {
 			server_port = atoi(next_arg);
 			++i;
+		} else if (strcmp(argv[i], "--json") == 0) {
+			message_set_encoding(MESSAGE_ENCODING_JSON);
+		} else if (strcmp(argv[i], "--send-queue") == 0 && next_arg != NULL) {
+			send_queue_kb = strtoul(next_arg, NULL, 10);
+			++i;
+		} else if (strcmp(argv[i], "--drop-slow") == 0) {
+			send_queue_overflow = GAMESERVER_OVERFLOW_DROP;
+		} else if (strcmp(argv[i], "--threads") == 0 && next_arg != NULL) {
+			server_threads = atoi(next_arg);
+			if (server_threads <= 0) {
+				server_threads = sysconf(_SC_NPROCESSORS_ONLN);
+			}
+			++i;
+		} else if (strcmp(argv[i], "--no-tui") == 0) {
+			use_tui = 0;
+		} else if (strcmp(argv[i], "--log-level") == 0 && next_arg != NULL) {
+			for (enum logring_level level = LOGRING_DEBUG; level <= LOGRING_ERROR; ++level) {
+				if (strcmp(next_arg, logring_level_name(level)) == 0) {
+					log_level = level;
+				}
+			}
+			++i;
 		}
 	}
 
-	// UI setup.
-	initscr();
-	cbreak();
-	noecho();
-	//keypad(stdscr, TRUE);
-
-	WINDOW *win_messages = create_messages_window();
-	WINDOW *win_input = create_input_window();
-
-	wtimeout(win_input, 100);
-	//nodelay(stdscr, TRUE);
-	//wtimeout(win_messages, 100);
-	wmove(win_messages, 0, 0);
+	logring_init(&server_log, SERVER_LOG_ENTRIES);
+	server_log.level = log_level;
+
+	WINDOW *win_messages = NULL;
+	WINDOW *win_input = NULL;
+	if (use_tui) {
+		// UI setup.
+		initscr();
+		cbreak();
+		noecho();
+		//keypad(stdscr, TRUE);
+
+		win_messages = create_messages_window();
+		win_input = create_input_window();
+
+		wtimeout(win_input, 100);
+		//nodelay(stdscr, TRUE);
+		//wtimeout(win_messages, 100);
+		wmove(win_messages, 0, 0);
+	}
 	console_log("Server started with PID %ld at %s. Press Ctrl-c to exit.", (long)getpid(), fmt_date(time(NULL)));
 
 	// start bg services
@@ -81,23 +138,41 @@ int main(int argc, char **argv) {
 	pthread_create(&gameserver_thread, NULL, thread_run_gameserver, (void *)&server_port);
 
 	int running = 1;
+	int stdin_open = 1;
 	while (running) {
 		static char in_command[256] = {0};
 		static size_t in_command_i = 0;
 
 		// logic
-		{
-			pthread_mutex_lock(&messagequeue_mutex);
-
-			size_t i = 0;
-			while (i < messagequeue_len) {
-				wprintw(win_messages, "%s\n", messagequeue[i]);
-				free(messagequeue[i]);
-				++i;
+		serverui_drain_logs(win_messages);
+		serverui_sample_metrics();
+
+		if (!use_tui) {
+			// commands come in as lines on stdin, until it is closed
+			struct pollfd in = { .fd = STDIN_FILENO, .events = POLLIN };
+			if (!stdin_open || poll(&in, 1, 100) <= 0) {
+				if (!stdin_open) {
+					usleep(100 * 1000);
+				}
+				continue;
 			}
-			messagequeue_len = 0;
-
-			pthread_mutex_unlock(&messagequeue_mutex);
+			const ssize_t read_len = read(STDIN_FILENO, &in_command[in_command_i], sizeof(in_command) - in_command_i);
+			if (read_len <= 0) {
+				stdin_open = 0;
+				continue;
+			}
+			in_command_i += read_len;
+			char *line_end;
+			while ((line_end = memchr(in_command, '\n', in_command_i)) != NULL) {
+				const size_t line_len = line_end - in_command;
+				serverui_on_input(in_command, line_len);
+				in_command_i -= line_len + 1;
+				memmove(in_command, line_end + 1, in_command_i);
+			}
+			if (in_command_i == sizeof(in_command)) {
+				in_command_i = 0; // too long for a command
+			}
+			continue;
 		}
 
 		// draw
@@ -129,17 +204,20 @@ int main(int argc, char **argv) {
 			serverui_on_input(in_command, in_command_i);
 			werase(win_input);
 			in_command_i = 0;
-		} else if (in_char != ERR) {
+		} else if (in_char != ERR && in_command_i < sizeof(in_command)) {
 			in_command[in_command_i++] = in_char;
 		}
 	}
 
 	pthread_join(gameserver_thread, NULL);
-	pthread_mutex_destroy(&messagequeue_mutex);
+	serverui_drain_logs(win_messages);
 
-	delwin(win_messages);
-	delwin(win_input);
-	endwin();
+	if (use_tui) {
+		delwin(win_messages);
+		delwin(win_input);
+		endwin();
+	}
+	logring_destroy(&server_log);
 
 	return 0;
 }
@@ -149,7 +227,7 @@ int main(int argc, char **argv) {
 //
 
 static void server_on_connect(struct gameserver *gs, struct session *session) {
-	console_log("%s Client %d connected.", gameserver_session_connection_type(session), session->id);
+	console_log("%s Client %u connected.", gameserver_session_connection_type(session), session->id);
 
 	// send a welcome message
 	struct welcome_response res;
@@ -159,11 +237,11 @@ static void server_on_connect(struct gameserver *gs, struct session *session) {
 }
 
 static void server_on_disconnect(struct gameserver *gs, struct session *session) {
-	console_log("Client %d disconnected.", session->id);
+	console_log("Client %u disconnected.", session->id);
 }
 
 static void server_on_message(struct gameserver *gs, struct session *session, struct message_header *message) {
-	console_log("Received %s from #%06d", message_type_to_name(message->type), session->id);
+	console_debug("Received %s from #%08x", message_type_to_name(message->type), session->id);
 	services_dispatcher(gs, message, session);
 }
 
@@ -184,16 +262,21 @@ static void serverui_on_input(const char *cmd, size_t cmd_len) {
 		if (serverui_is_input_command(input, "help")) {
 			console_log("- /help [cmd]    :  Get help for a specific command.");
 			console_log("- /status        :  Display server status info.");
+			console_log("- /metrics       :  Display sessions and traffic per second.");
 			console_log("- /clear         :  Clear the screen, same as <C-l>.");
 			console_log("- /logs [on/off] :  Enable or disable writing logs to disk.");
 		} else if (serverui_is_input_command(input, "status")) {
 			console_log("Status: OK");
 			console_log("PID: %d", getpid());
-			console_log("Clients: %d", stbds_arrlen(gserver.sessions));
-			for (int i = 0; i < stbds_arrlen(gserver.sessions); ++i) {
-				struct session *s = gserver.sessions[i];
-				console_log(" - %d (Group #%d) <%s>", s->id, s->group_id, gameserver_session_connection_type(s));
+			// sessions belong to their service threads, only the counts can be read from here
+			console_log("Clients: %d", gameserver_session_count(&gserver));
+			for (int i = 0; i < gserver.shards_len; ++i) {
+				console_log(" - Thread #%d: %d clients", i, __atomic_load_n(&gserver.shards[i].sessions_len, __ATOMIC_RELAXED));
 			}
+		} else if (serverui_is_input_command(input, "metrics")) {
+			console_log("Sessions: %d", gameserver_session_count(&gserver));
+			console_log("Received: %.0f msgs/s, %.0f bytes/s", metrics.messages_received, metrics.bytes_received);
+			console_log("Sent:     %.0f msgs/s, %.0f bytes/s", metrics.messages_sent, metrics.bytes_sent);
 		} else if (serverui_is_input_command(input, "clear")) {
 			console_log("Not implemented :(");
 		} else {
@@ -225,10 +308,9 @@ static void serverui_on_input(const char *cmd, size_t cmd_len) {
 		*/
 
 	} else {
+		// clients only understand message frames, plain text is not sent to them
 		if (input_len > 1) {
-			// TODO: remove. just sends the raw input for debugging purposes.
-			gameserver_send_raw(&gserver, NULL, (uint8_t *)input, input_len);
-			console_log("%s", input);
+			console_log("%s: not a command, see /help", input);
 		}
 	}
 }
@@ -267,8 +349,6 @@ static WINDOW *create_input_window(void) {
 }
 
 static const char *fmt_time(time_t rawtime) {
-	// Get current time
-	time(&rawtime);
 	struct tm *timeinfo = localtime(&rawtime);
 
 	static char buffer[9]; // HH:MM:SS\0
@@ -286,32 +366,65 @@ static const char *fmt_date(time_t rawtime) {
 	return buffer;
 }
 
-static void console_log(char *fmt, ...) {
-	va_list args;
+// prints everything logged so far, ui thread only.
+static void serverui_drain_logs(WINDOW *win_messages) {
+	logring_drain(&server_log, print_log_entry, win_messages);
 
-	// determine message size
-	va_start(args, fmt);
-	int message_len = vsnprintf(NULL, 0, fmt, args);
-	char *message = malloc((message_len + 1) * sizeof(char));
-	message[message_len] = '\0';
-	va_end(args);
+	const size_t dropped = logring_dropped(&server_log);
+	if (dropped > 0) {
+		// the ui thread can't keep up, e.g. under load
+		logring_write(&server_log, LOGRING_WARN, "(%zu messages dropped)", dropped);
+	}
+}
 
-	va_start(args, fmt);
-	vsnprintf(message, message_len + 1, fmt, args);
-	va_end(args);
+static void print_log_entry(enum logring_level level, const struct timespec *time, const char *message, void *userdata) {
+	WINDOW *win_messages = userdata;
+	if (win_messages != NULL) {
+		if (level >= LOGRING_WARN) {
+			wprintw(win_messages, "[%s]  %s: %s\n", fmt_time(time->tv_sec), logring_level_name(level), message);
+		} else {
+			wprintw(win_messages, "[%s]  %s\n", fmt_time(time->tv_sec), message);
+		}
+		return;
+	}
 
-	char *full_fmt = "[%s]  %s";
-	int full_message_len = snprintf(NULL, 0, full_fmt, fmt_time(time(NULL)), message);
-	char *full_message = malloc((full_message_len + 1) * sizeof(char));
-	snprintf(full_message, full_message_len + 1, full_fmt, fmt_time(time(NULL)), message);
-	full_message[full_message_len] = '\0';
+	char timestamp[32];
+	struct tm timeinfo;
+	gmtime_r(&time->tv_sec, &timeinfo);
+	const size_t timestamp_len = strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &timeinfo);
+	snprintf(&timestamp[timestamp_len], sizeof(timestamp) - timestamp_len, ".%03ldZ", time->tv_nsec / 1000000);
+
+	cJSON *line = cJSON_CreateObject();
+	cJSON_AddStringToObject(line, "time", timestamp);
+	cJSON_AddStringToObject(line, "level", logring_level_name(level));
+	cJSON_AddStringToObject(line, "msg", message);
+	char *printed = cJSON_PrintUnformatted(line);
+	puts(printed);
+	fflush(stdout);
+	cJSON_free(printed);
+	cJSON_Delete(line);
+}
 
-	// write to queue
-	pthread_mutex_lock(&messagequeue_mutex);
-	assert(messagequeue_len < messagequeue_max);
-	messagequeue[messagequeue_len++] = full_message;
-	pthread_mutex_unlock(&messagequeue_mutex);
+// once per second, ui thread only.
+static void serverui_sample_metrics(void) {
+	const time_t now = time(NULL);
+	if (now == metrics.last_time) {
+		return;
+	}
 
+	struct gameserver_stats stats = {0};
+	if (__atomic_load_n(&gserver_running, __ATOMIC_ACQUIRE)) {
+		gameserver_get_stats(&gserver, &stats);
+	}
+	if (metrics.last_time != 0) {
+		const double seconds = difftime(now, metrics.last_time);
+		metrics.messages_received = (stats.messages_received - metrics.last.messages_received) / seconds;
+		metrics.bytes_received    = (stats.bytes_received    - metrics.last.bytes_received)    / seconds;
+		metrics.messages_sent     = (stats.messages_sent     - metrics.last.messages_sent)     / seconds;
+		metrics.bytes_sent        = (stats.bytes_sent        - metrics.last.bytes_sent)        / seconds;
+	}
+	metrics.last = stats;
+	metrics.last_time = now;
 }
 
 //
@@ -323,21 +436,28 @@ static void *thread_run_gameserver(void *data) {
 	const int port = *(int *)data;
 
 	// init server
-	if (gameserver_init(&gserver, port)) {
-		console_log("Failed starting Websocket server!");
+	if (gameserver_init(&gserver, port, server_threads)) {
+		console_error("Failed starting Websocket server!");
 		return (void *)1;
 	}
 
+	// slow clients
+	gserver.send_queue_bytes_max = send_queue_kb * 1024;
+	gserver.send_queue_overflow = send_queue_overflow;
+
 	// register callbacks
 	gserver.callback_on_connect = server_on_connect;
 	gserver.callback_on_disconnect = server_on_disconnect;
 	gserver.callback_on_message = server_on_message;
 
 	// run
-	console_log("Websocket server on :%d...", port);
+	console_log("Websocket server on :%d with %d threads...", port, gserver.shards_len);
+	console_log("Metrics on http://localhost:%d/metrics", port);
+	__atomic_store_n(&gserver_running, 1, __ATOMIC_RELEASE);
 	gameserver_listen(&gserver);
 
 	// destroy
+	__atomic_store_n(&gserver_running, 0, __ATOMIC_RELEASE);
 	gameserver_destroy(&gserver);
 
 	return (void *)0;
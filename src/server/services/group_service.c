@@ -27,19 +27,15 @@ void group_service_create_lobby(struct gameserver *gserver, struct lobby_create_
 		return;
 	}
 
-	// Check if lobby already exists.
-	for (int i = 0; i < stbds_arrlen(gserver->sessions); ++i) {
-		struct session *s = gserver->sessions[i];
-		if ((uint32_t)msg->lobby_id == s->group_id) {
-			response.create_error = SERVER_ERROR_LOBBY_ALREADY_EXISTS;
-			gameserver_send_to(gserver, &response.header, requested_by);
-
-			return;
-		}
+	// Create it, unless the lobby already exists.
+	if (gameserver_session_set_group(gserver, requested_by, msg->lobby_id, GAMESERVER_GROUP_MUST_BE_NEW)) {
+		response.create_error = SERVER_ERROR_LOBBY_ALREADY_EXISTS;
+		gameserver_send_to(gserver, &response.header, requested_by);
+
+		return;
 	}
 
 	response.create_error = 0;
-	requested_by->group_id = msg->lobby_id;
 	//messagequeue_add("#%06d created, and joined lobby %d!", requested_by->id, requested_by->group_id);
 
 	gameserver_send_to(gserver, &response.header, requested_by);
@@ -77,17 +73,8 @@ void group_service_join_lobby(struct gameserver *gserver, struct lobby_join_requ
 	}
 
 	// check if the lobby exists.
-	int lobby_exists = (msg->lobby_id == 0); // "0" is indicates a leave and always "exists".
-	if (lobby_exists == 0) {
-		const size_t sessions_len = stbds_arrlen(gserver->sessions);
-		for (size_t i = 0; i < sessions_len; ++i) {
-			struct session *s = gserver->sessions[i];
-			if (msg->lobby_id == s->group_id) {
-				lobby_exists = 1;
-				break;
-			}
-		}
-	}
+	// "0" is indicates a leave and always "exists".
+	const int lobby_exists = (msg->lobby_id == 0) || (gameserver_group_size(gserver, msg->lobby_id) > 0);
 
 	// lobby doesnt exist? then we cant join.
 	if (lobby_exists == 0) {
@@ -103,8 +90,11 @@ void group_service_join_lobby(struct gameserver *gserver, struct lobby_join_requ
 		goto send_response;
 	}
 
-	if (msg->lobby_id != 0) {
-		requested_by->group_id = msg->lobby_id;
+	// the last member may have left meanwhile
+	if (msg->lobby_id != 0 && gameserver_session_set_group(gserver, requested_by, msg->lobby_id, GAMESERVER_GROUP_MUST_EXIST)) {
+		join.join_error = SERVER_ERROR_LOBBY_DOES_NOT_EXIST;
+		join.lobby_id = msg->lobby_id;
+		goto send_response;
 	}
 
 	// lobby_id can be 0 to indicate a leave
@@ -121,7 +111,7 @@ send_response:
 	}
 
 	if (msg->lobby_id == 0) {
-		requested_by->group_id = msg->lobby_id;
+		gameserver_session_set_group(gserver, requested_by, 0, GAMESERVER_GROUP_ANY);
 	}
 }
 
@@ -130,26 +120,14 @@ send_response:
  * @param requested_by The client who requested the list.
  */
 void group_service_list_lobbies(struct gameserver *gserver, struct lobby_list_request *msg, struct session *requested_by) {
-	int sessions_len = stbds_arrlen(gserver->sessions);
-	if (sessions_len > 8) sessions_len = 8;
-
 	struct lobby_list_response res;
 	message_header_init(&res.header, LOBBY_LIST_RESPONSE);
-	res.ids_of_lobbies_len = 0;
-	for (int i = 0; i < sessions_len; ++i) {
-		int lobby_id = gserver->sessions[i]->group_id;
-		
-		// check if we already added lobby_id to list.
-		for (int j = 0; j < res.ids_of_lobbies_len; ++j) {
-			if (lobby_id == res.ids_of_lobbies[j]) {
-				lobby_id = 0; // already exists
-			}
-		}
-
-		if (lobby_id > 0) {
-			res.ids_of_lobbies[res.ids_of_lobbies_len] = lobby_id;
-			++res.ids_of_lobbies_len;
-		}
+	uint32_t ids[sizeof(res.ids_of_lobbies) / sizeof(res.ids_of_lobbies[0])];
+
+	// every group is a lobby with at least one member
+	res.ids_of_lobbies_len = gameserver_group_ids(gserver, ids, sizeof(ids) / sizeof(ids[0]));
+	for (int i = 0; i < res.ids_of_lobbies_len; ++i) {
+		res.ids_of_lobbies[i] = ids[i];
 	}
 	gameserver_send_to(gserver, &res.header, requested_by);
 }
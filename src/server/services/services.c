@@ -25,7 +25,10 @@ void services_dispatcher(struct gameserver *gs, struct message_header *message,
 		case LOBBY_CREATE_RESPONSE:
 		case LOBBY_JOIN_RESPONSE:
 		case LOBBY_LIST_RESPONSE:
+		case BATTLE_SNAPSHOT:
 			// these messages we cant handle
+		case BATTLE_SNAPSHOT_ACK:
+			// no battles are run on the server yet
 		case MSG_TYPE_UNKNOWN:
 		case MSG_TYPE_MAX:
 			// these messages are invalid
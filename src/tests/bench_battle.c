@@ -0,0 +1,58 @@
+#include "framework/benchmark.h"
+
+#include <stb_ds.h>
+#include "game/battle_replay.h"
+#include "game/battle_rules.h"
+
+static struct battle_card bench_cards[] = {
+	{ .name="Strike", .description="", .kind=CARD_KIND_BASIC_ATTACK, .damage={ .basic=3 } },
+	{ .name="Heal",   .description="", .kind=CARD_KIND_ACTION },
+};
+
+enum { BENCH_REPLAY_ROUNDS = 1000 };
+
+static void record(struct battle *battle, struct battle_replay *replay) {
+	battle_init(battle, bench_cards, count_of(bench_cards), 99, (struct battle_callbacks){0});
+	battle_replay_begin(replay, battle, BATTLE_REPLAY_CHECKPOINT_TURNS);
+	while (battle->turn_count < BENCH_REPLAY_ROUNDS) {
+		if (battle->state == GS_TURN_PLAYER_IN_PROGRESS) {
+			battle_on_game_event(battle, (struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=battle->player, .card=battle->hand[0].id } });
+			battle_on_game_event(battle, (struct game_event){ .type=EVENT_END_TURN });
+		}
+		battle_update(battle);
+	}
+}
+
+// seeking to the last turn only replays from the closest checkpoint.
+BENCH(battle_replay_seek_1000_turns) {
+	struct battle battle;
+	struct battle_replay replay;
+	record(&battle, &replay);
+
+	BENCH_LOOP {
+		struct battle copy;
+		battle_init(&copy, bench_cards, count_of(bench_cards), replay.seed, (struct battle_callbacks){0});
+		BENCH_KEEP(battle_replay_seek(&replay, &copy, BENCH_REPLAY_ROUNDS - 1));
+		battle_destroy(&copy);
+	}
+
+	battle_replay_free(&replay);
+	battle_destroy(&battle);
+}
+
+// for comparison, replays everything.
+BENCH(battle_replay_verify_1000_turns) {
+	struct battle battle;
+	struct battle_replay replay;
+	record(&battle, &replay);
+
+	BENCH_LOOP {
+		struct battle copy;
+		battle_init(&copy, bench_cards, count_of(bench_cards), replay.seed, (struct battle_callbacks){0});
+		BENCH_KEEP(battle_replay_verify(&replay, &copy));
+		battle_destroy(&copy);
+	}
+
+	battle_replay_free(&replay);
+	battle_destroy(&battle);
+}
@@ -0,0 +1,32 @@
+#include "framework/benchmark.h"
+
+#include <stdlib.h>
+#include "gl/graphics2d.h"
+
+#define DRAWCMDS_COUNT 1024
+#define FLOATS_PER_DRAWCMD ((3 + 2 + 4 + 4) * 6)
+
+BENCH(drawcmd_write_vertices_1024) {
+	drawcmd_t *cmds = malloc(DRAWCMDS_COUNT * sizeof(*cmds));
+	float *vertices = malloc(DRAWCMDS_COUNT * FLOATS_PER_DRAWCMD * sizeof(*vertices));
+	for (int i = 0; i < DRAWCMDS_COUNT; ++i) {
+		cmds[i] = DRAWCMD_INIT;
+		cmds[i].position.x = (i % 32) * 16.0f;
+		cmds[i].position.y = (i / 32) * 16.0f;
+		cmds[i].size.x = 16.0f;
+		cmds[i].size.y = 16.0f;
+		cmds[i].angle = i * 0.01f;
+	}
+
+	BENCH_LOOP {
+		unsigned int bytes = 0;
+		for (int i = 0; i < DRAWCMDS_COUNT; ++i) {
+			bytes += drawcmd_write_vertices(&cmds[i], vertices + i * FLOATS_PER_DRAWCMD);
+		}
+		BENCH_KEEP(bytes);
+	}
+
+	free(vertices);
+	free(cmds);
+}
+
@@ -0,0 +1,85 @@
+#include "framework/benchmark.h"
+
+#include <stdlib.h>
+#include "net/message.h"
+#include "util/arena.h"
+
+// the debug encoding: struct -> json -> string -> json -> struct.
+// one iteration is one tick, its messages live in `arena`.
+static void roundtrip(struct message_header *msg, struct arena *arena) {
+	cJSON *json = pack_message(msg);
+	char *str = cJSON_PrintUnformatted(json);
+	cJSON_Delete(json);
+
+	cJSON *parsed = cJSON_Parse(str);
+	struct message_header *unpacked = unpack_message(parsed, arena);
+	cJSON_Delete(parsed);
+	BENCH_KEEP(unpacked->type);
+	arena_reset(arena);
+	free(str);
+}
+
+// same path as the client and server: struct -> frame -> struct.
+static void roundtrip_frame(struct message_header *msg) {
+	uint8_t frame[MESSAGE_FRAME_MAX];
+	const size_t frame_len = message_encode(msg, frame, sizeof(frame));
+
+	union message_any decoded;
+	BENCH_KEEP(message_decode(frame, frame_len, &decoded));
+	BENCH_KEEP(decoded.header.type);
+}
+
+BENCH(message_roundtrip_lobby_create_request) {
+	struct lobby_create_request msg;
+	message_header_init(&msg.header, LOBBY_CREATE_REQUEST);
+	msg.lobby_id = 42;
+	msg.lobby_name = "benchmark lobby";
+
+	struct arena arena;
+	arena_init(&arena, MESSAGE_FRAME_MAX);
+	BENCH_LOOP {
+		roundtrip(&msg.header, &arena);
+	}
+	arena_destroy(&arena);
+}
+
+BENCH(message_roundtrip_lobby_list_response) {
+	struct lobby_list_response msg;
+	message_header_init(&msg.header, LOBBY_LIST_RESPONSE);
+	msg.ids_of_lobbies_len = 8;
+	for (int i = 0; i < msg.ids_of_lobbies_len; ++i) {
+		msg.ids_of_lobbies[i] = 1000 + i;
+	}
+
+	struct arena arena;
+	arena_init(&arena, MESSAGE_FRAME_MAX);
+	BENCH_LOOP {
+		roundtrip(&msg.header, &arena);
+	}
+	arena_destroy(&arena);
+}
+
+
+BENCH(message_frame_lobby_create_request) {
+	struct lobby_create_request msg;
+	message_header_init(&msg.header, LOBBY_CREATE_REQUEST);
+	msg.lobby_id = 42;
+	msg.lobby_name = "benchmark lobby";
+
+	BENCH_LOOP {
+		roundtrip_frame(&msg.header);
+	}
+}
+
+BENCH(message_frame_lobby_list_response) {
+	struct lobby_list_response msg;
+	message_header_init(&msg.header, LOBBY_LIST_RESPONSE);
+	msg.ids_of_lobbies_len = 8;
+	for (int i = 0; i < msg.ids_of_lobbies_len; ++i) {
+		msg.ids_of_lobbies[i] = 1000 + i;
+	}
+
+	BENCH_LOOP {
+		roundtrip_frame(&msg.header);
+	}
+}
@@ -0,0 +1,27 @@
+#include "framework/benchmark.h"
+
+#include <stdlib.h>
+#include "game/hexmap.h"
+
+// open map without obstacles, path from one corner to the opposite one.
+BENCH(hexmap_path_find_64x64) {
+	struct hexmap map = { .w = 64, .h = 64, .tilesize = 2.0f };
+	map.edges = malloc(map.w * map.h * sizeof(*map.edges) * HEXMAP_MAX_EDGES);
+	map.tiles = calloc(map.w * map.h, sizeof(*map.tiles));
+	for (int i = 0; i < map.w * map.h; ++i) {
+		map.tiles[i].movement_cost = 1;
+	}
+	hexmap_generate_edges(&map);
+
+	const struct hexcoord start = { 0, 0 };
+	const struct hexcoord goal = { map.w - 1, map.h - 1 };
+	BENCH_LOOP {
+		struct hexmap_path path;
+		BENCH_KEEP(hexmap_path_find(&map, start, goal, &path));
+		hexmap_path_destroy(&path);
+	}
+
+	free(map.edges);
+	free(map.tiles);
+}
+
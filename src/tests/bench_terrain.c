@@ -0,0 +1,27 @@
+#include "framework/benchmark.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <stb_ds.h>
+#include "game/terrain.h"
+
+// terrain_init() seeds from time(), so the density is generated here.
+BENCH(terrain_polygonize_128x128) {
+	struct terrain_s terrain = { .isovalue = 127, .width = 128, .height = 128 };
+	terrain.density = malloc(terrain.width * terrain.height * sizeof(*terrain.density));
+	for (int y = 0; y < terrain.height; ++y) {
+		for (int x = 0; x < terrain.width; ++x) {
+			const float d = 0.5f + 0.25f * sinf(x * 0.21f) + 0.25f * cosf(y * 0.13f + x * 0.05f);
+			*terrain_density_at(&terrain, x, y) = 255 * d;
+		}
+	}
+
+	BENCH_LOOP {
+		stbds_arrsetlen(terrain.polygon_edges, 0);
+		terrain_polygonize(&terrain);
+		BENCH_KEEP(stbds_arrlen(terrain.polygon_edges));
+	}
+
+	terrain_destroy(&terrain);
+}
+
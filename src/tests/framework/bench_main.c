@@ -0,0 +1,29 @@
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// usage: run_bench [--json=results.json] [--baseline=baseline.json] [--threshold=0.1]
+int main(int argc, char **argv) {
+	const char *json_output = NULL;
+	const char *json_baseline = NULL;
+	double threshold = 0.1;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], "--json=", 7) == 0) {
+			json_output = argv[i] + 7;
+		} else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+			json_baseline = argv[i] + 11;
+		} else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+			threshold = atof(argv[i] + 12);
+		} else {
+			fprintf(stderr, "usage: %s [--json=results.json] [--baseline=baseline.json] [--threshold=0.1]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const int regressions = benchmark_run_all(json_output, json_baseline, threshold);
+	return (regressions != 0);
+}
+
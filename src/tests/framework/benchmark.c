@@ -0,0 +1,229 @@
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cJSON.h>
+
+struct benchmark benchmarks[MAX_BENCHMARKS];
+int BENCHMARK_COUNT = 0;
+
+static uint64_t get_time_in_nanoseconds(void);
+static int compare_doubles(const void *a, const void *b);
+static double percentile(const double *sorted, int count, double p);
+static void benchmark_finish(struct benchmark *);
+static cJSON *benchmarks_to_json(void);
+static int benchmarks_compare(const cJSON *baseline, double threshold);
+
+void benchmark_loop_begin(struct benchmark *b) {
+	b->phase = BENCHMARK_PHASE_WARMUP;
+	b->remaining = 0;
+	b->iterations = 1;
+	b->has_sample = 0;
+	b->samples_count = 0;
+	b->warmup_begin_ns = get_time_in_nanoseconds();
+}
+
+int benchmark_loop_next(struct benchmark *b) {
+	const uint64_t now = get_time_in_nanoseconds();
+
+	// a sample of `iterations` just finished
+	if (b->has_sample) {
+		const uint64_t elapsed = now - b->sample_begin_ns;
+
+		switch (b->phase) {
+		case BENCHMARK_PHASE_WARMUP:
+			if (now - b->warmup_begin_ns >= BENCHMARK_WARMUP_NS) {
+				b->phase = BENCHMARK_PHASE_CALIBRATE;
+			} else if (elapsed < BENCHMARK_SAMPLE_MIN_NS) {
+				b->iterations *= 2;
+			}
+			break;
+		case BENCHMARK_PHASE_CALIBRATE:
+			if (elapsed < BENCHMARK_SAMPLE_MIN_NS) {
+				b->iterations *= 2;
+			} else {
+				b->phase = BENCHMARK_PHASE_MEASURE;
+			}
+			break;
+		case BENCHMARK_PHASE_MEASURE:
+			b->samples[b->samples_count++] = elapsed / (double)b->iterations;
+			if (b->samples_count >= BENCHMARK_SAMPLES) {
+				b->phase = BENCHMARK_PHASE_DONE;
+				benchmark_finish(b);
+				return 0;
+			}
+			break;
+		case BENCHMARK_PHASE_DONE:
+			return 0;
+		}
+	}
+
+	// start the next sample, this call already accounts for its first iteration
+	b->has_sample = 1;
+	b->remaining = b->iterations - 1;
+	b->sample_begin_ns = get_time_in_nanoseconds();
+	return 1;
+}
+
+int benchmark_run_all(const char *json_output, const char *json_baseline, double threshold) {
+	fprintf(stderr, "Running %d benchmarks...\n", BENCHMARK_COUNT);
+	fprintf(stderr, "%-32s %12s %12s %12s %12s\n", "", "median ns", "p90 ns", "p99 ns", "iterations");
+	fprintf(stderr, "-----------------------------------------------------------------------------------\n");
+
+	for (int i = 0; i < BENCHMARK_COUNT; ++i) {
+		struct benchmark *b = &benchmarks[i];
+		b->phase = BENCHMARK_PHASE_DONE;
+		b->samples_count = 0;
+		b->run(b);
+
+		if (b->samples_count == 0) {
+			fprintf(stderr, "%-32s \x1b[31mno samples, missing BENCH_LOOP?\x1b[0m\n", b->name);
+			continue;
+		}
+		fprintf(stderr, "%-32s %12.1f %12.1f %12.1f %12lu\n",
+				b->name, b->median, b->p90, b->p99, (unsigned long)b->iterations);
+	}
+
+	// results
+	if (json_output != NULL) {
+		cJSON *json = benchmarks_to_json();
+		char *str = cJSON_Print(json);
+		FILE *f = fopen(json_output, "w");
+		if (f == NULL) {
+			fprintf(stderr, "failed writing %s\n", json_output);
+			free(str);
+			cJSON_Delete(json);
+			return -1;
+		}
+		fprintf(f, "%s\n", str);
+		fclose(f);
+		free(str);
+		cJSON_Delete(json);
+		fprintf(stderr, "\nWrote results to %s\n", json_output);
+	}
+
+	// compare against the baseline
+	if (json_baseline == NULL) {
+		return 0;
+	}
+
+	FILE *f = fopen(json_baseline, "r");
+	if (f == NULL) {
+		fprintf(stderr, "failed reading baseline %s\n", json_baseline);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	const long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char *data = malloc(size + 1);
+	const size_t read = fread(data, 1, size, f);
+	data[read] = '\0';
+	fclose(f);
+
+	cJSON *baseline = cJSON_Parse(data);
+	free(data);
+	if (baseline == NULL) {
+		fprintf(stderr, "failed parsing baseline %s\n", json_baseline);
+		return -1;
+	}
+
+	fprintf(stderr, "\nComparing against %s (threshold %+.0f%%)\n", json_baseline, threshold * 100.0);
+	const int regressions = benchmarks_compare(baseline, threshold);
+	cJSON_Delete(baseline);
+
+	fprintf(stderr, "\x1b[%dm", (regressions ? 31 : 32));
+	fprintf(stderr, "%d regression%s.\n", regressions, (regressions == 1 ? "" : "s"));
+	fprintf(stderr, "\x1b[0m");
+	return regressions;
+}
+
+static void benchmark_finish(struct benchmark *b) {
+	double sorted[BENCHMARK_SAMPLES];
+	memcpy(sorted, b->samples, b->samples_count * sizeof(*sorted));
+	qsort(sorted, b->samples_count, sizeof(*sorted), compare_doubles);
+
+	b->min = sorted[0];
+	b->max = sorted[b->samples_count - 1];
+	b->median = percentile(sorted, b->samples_count, 0.5);
+	b->p90 = percentile(sorted, b->samples_count, 0.9);
+	b->p99 = percentile(sorted, b->samples_count, 0.99);
+}
+
+static cJSON *benchmarks_to_json(void) {
+	cJSON *json = cJSON_CreateObject();
+	cJSON *list = cJSON_AddArrayToObject(json, "benchmarks");
+	for (int i = 0; i < BENCHMARK_COUNT; ++i) {
+		const struct benchmark *b = &benchmarks[i];
+		if (b->samples_count == 0) {
+			continue;
+		}
+
+		cJSON *entry = cJSON_CreateObject();
+		cJSON_AddStringToObject(entry, "name", b->name);
+		cJSON_AddNumberToObject(entry, "iterations", b->iterations);
+		cJSON_AddNumberToObject(entry, "samples", b->samples_count);
+		cJSON *ns = cJSON_AddObjectToObject(entry, "ns_per_op");
+		cJSON_AddNumberToObject(ns, "median", b->median);
+		cJSON_AddNumberToObject(ns, "p90", b->p90);
+		cJSON_AddNumberToObject(ns, "p99", b->p99);
+		cJSON_AddNumberToObject(ns, "min", b->min);
+		cJSON_AddNumberToObject(ns, "max", b->max);
+		cJSON_AddItemToArray(list, entry);
+	}
+	return json;
+}
+
+// medians are compared, they are less noisy than the tail.
+static int benchmarks_compare(const cJSON *baseline, double threshold) {
+	const cJSON *list = cJSON_GetObjectItem(baseline, "benchmarks");
+	int regressions = 0;
+
+	for (int i = 0; i < BENCHMARK_COUNT; ++i) {
+		const struct benchmark *b = &benchmarks[i];
+		if (b->samples_count == 0) {
+			continue;
+		}
+
+		const cJSON *entry = NULL;
+		cJSON_ArrayForEach(entry, list) {
+			const cJSON *name = cJSON_GetObjectItem(entry, "name");
+			if (cJSON_IsString(name) && strcmp(name->valuestring, b->name) == 0) {
+				break;
+			}
+		}
+		const cJSON *median = cJSON_GetObjectItem(cJSON_GetObjectItem(entry, "ns_per_op"), "median");
+		if (!cJSON_IsNumber(median)) {
+			fprintf(stderr, "%-32s %12.1f   (new)\n", b->name, b->median);
+			continue;
+		}
+
+		const double change = (b->median - median->valuedouble) / median->valuedouble;
+		const int is_regression = (change > threshold);
+		regressions += is_regression;
+		fprintf(stderr, "%-32s %12.1f vs %12.1f  \x1b[%dm%+6.1f%%\x1b[0m\n",
+				b->name, b->median, median->valuedouble, (is_regression ? 31 : (change < -threshold ? 32 : 0)), change * 100.0);
+	}
+	return regressions;
+}
+
+static double percentile(const double *sorted, int count, double p) {
+	// nearest rank
+	int rank = (int)(p * count + 0.999999);
+	rank = (rank < 1) ? 1 : (rank > count ? count : rank);
+	return sorted[rank - 1];
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	const double da = *(const double *)a;
+	const double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+static uint64_t get_time_in_nanoseconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
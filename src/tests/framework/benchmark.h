@@ -0,0 +1,87 @@
+#ifndef CENGINE_BENCHMARK_H
+#define CENGINE_BENCHMARK_H
+
+#include <stdint.h>
+
+//
+// Microbenchmarks, registered like tests:
+//
+//     BENCH(my_function) {
+//         // setup
+//         BENCH_LOOP {
+//             BENCH_KEEP(my_function(42));
+//         }
+//         // teardown
+//     }
+//
+// The loop body is warmed up first, then the iteration count per sample is
+// doubled until a sample takes at least BENCHMARK_SAMPLE_MIN_NS. Finally
+// BENCHMARK_SAMPLES samples are timed and reported as ns/op.
+//
+
+#define MAX_BENCHMARKS          128
+#define BENCHMARK_SAMPLES       31
+#define BENCHMARK_WARMUP_NS     20000000 // 20ms
+#define BENCHMARK_SAMPLE_MIN_NS 1000000  // 1ms
+
+enum benchmark_phase {
+	BENCHMARK_PHASE_WARMUP,
+	BENCHMARK_PHASE_CALIBRATE,
+	BENCHMARK_PHASE_MEASURE,
+	BENCHMARK_PHASE_DONE,
+};
+
+struct benchmark;
+typedef void (*benchmark_fn)(struct benchmark *);
+
+struct benchmark {
+	const char *name;
+	benchmark_fn run;
+
+	// loop state
+	enum benchmark_phase phase;
+	uint64_t remaining;
+	uint64_t iterations; // per sample
+	uint64_t sample_begin_ns;
+	uint64_t warmup_begin_ns;
+	int has_sample;
+
+	// results, ns per operation
+	double samples[BENCHMARK_SAMPLES];
+	int samples_count;
+	double median, p90, p99, min, max;
+};
+
+extern struct benchmark benchmarks[MAX_BENCHMARKS];
+extern int BENCHMARK_COUNT;
+
+#define BENCH(BENCHNAME)                                      \
+	void bench_run_##BENCHNAME(struct benchmark *);           \
+	__attribute__((constructor))                              \
+	void bench_register_##BENCHNAME(void) {                   \
+		benchmarks[BENCHMARK_COUNT++] = (struct benchmark) {  \
+			.run = bench_run_##BENCHNAME,                     \
+			.name = #BENCHNAME,                               \
+		};                                                    \
+	}                                                         \
+	void bench_run_##BENCHNAME(struct benchmark *_bench)
+
+// only calls into the harness between samples
+#define BENCH_LOOP                                                   \
+	for (benchmark_loop_begin(_bench);                               \
+	     _bench->remaining > 0                                       \
+	         ? (--_bench->remaining, 1)                              \
+	         : benchmark_loop_next(_bench); )
+
+// keeps the compiler from optimizing away a result
+#define BENCH_KEEP(value) \
+	do { __typeof__(value) _bench_value = (value); __asm__ volatile("" : : "g"(&_bench_value) : "memory"); } while (0)
+
+void benchmark_loop_begin(struct benchmark *);
+int  benchmark_loop_next(struct benchmark *);
+
+// returns the number of regressions against the baseline, or -1 on error.
+int benchmark_run_all(const char *json_output, const char *json_baseline, double threshold);
+
+#endif
+
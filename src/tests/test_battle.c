@@ -0,0 +1,192 @@
+#include "framework/testing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stb_ds.h>
+#include "game/battle_replay.h"
+#include "game/battle_rules.h"
+
+static struct battle_card test_cards[] = {
+	{ .name="Strike", .description="", .image_id=0, .kind=CARD_KIND_BASIC_ATTACK, .damage={ .basic=3 } },
+	{ .name="Heal",   .description="", .image_id=1, .kind=CARD_KIND_ACTION },
+};
+
+static void run_until(struct battle *battle, enum gamestate_battle state) {
+	for (int i = 0; i < 32 && battle->state != state; ++i) {
+		battle_update(battle);
+	}
+}
+
+TEST(battle_turns_headless) {
+	struct battle battle;
+	battle_init(&battle, test_cards, count_of(test_cards), 42, (struct battle_callbacks){0});
+
+	run_until(&battle, GS_TURN_PLAYER_IN_PROGRESS);
+	TEST_ASSERT(battle.state == GS_TURN_PLAYER_IN_PROGRESS);
+	TEST_ASSERT(battle.hand_len == BATTLE_HAND_DRAW);
+	TEST_ASSERT(battle.player_movement_this_turn == BATTLE_MOVEMENT);
+
+	// stays in the players turn until it is ended
+	battle_update(&battle);
+	TEST_ASSERT(battle.state == GS_TURN_PLAYER_IN_PROGRESS);
+
+	// move one tile
+	struct battle_unit *player = battle_unit(&battle, battle.player);
+	const struct hexcoord start = player->pos;
+	struct hexcoord goal = start;
+	for (enum hexmap_neighbor n = HEXMAP_N_FIRST; n <= HEXMAP_N_LAST; ++n) {
+		goal = hexmap_get_neighbor_coord(&battle.map, start, n);
+		if (hexmap_is_valid_coord(&battle.map, goal) && !hexmap_is_tile_obstacle(&battle.map, goal)) {
+			break;
+		}
+	}
+	TEST_ASSERT(0 == battle_on_game_event(&battle, (struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=battle.player, .goal=goal } }));
+	TEST_ASSERT(hexcoord_equal(player->pos, goal));
+	TEST_ASSERT(hexmap_tile_at(&battle.map, goal)->occupied_by == battle.player);
+	TEST_ASSERT(hexmap_tile_at(&battle.map, start)->occupied_by == 0);
+	TEST_ASSERT(battle.player_movement_this_turn == BATTLE_MOVEMENT - 1);
+
+	// can't walk into a unit or move someone else
+	const u32 enemy = (battle.player == 1) ? 2 : 1;
+	TEST_ASSERT(1 == battle_on_game_event(&battle, (struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=battle.player, .goal=battle_unit(&battle, enemy)->pos } }));
+	TEST_ASSERT(1 == battle_on_game_event(&battle, (struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=enemy, .goal=start } }));
+	// unknown cards are rejected
+	TEST_ASSERT(1 == battle_on_game_event(&battle, (struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=battle.player, .card=1000 } }));
+
+	const u32 card = battle.hand[0].id;
+	TEST_ASSERT(0 == battle_on_game_event(&battle, (struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=battle.player, .card=card } }));
+	TEST_ASSERT(battle.hand_len == BATTLE_HAND_DRAW - 1);
+	TEST_ASSERT(battle_handcard(&battle, card) == NULL);
+
+	// the enemies take their turn, then the next round starts
+	TEST_ASSERT(0 == battle_on_game_event(&battle, (struct game_event){ .type=EVENT_END_TURN }));
+	TEST_ASSERT(1 == battle_on_game_event(&battle, (struct game_event){ .type=EVENT_END_TURN }));
+	battle_update(&battle);
+	TEST_ASSERT(battle.state == GS_TURN_PLAYER_END);
+	run_until(&battle, GS_TURN_PLAYER_IN_PROGRESS);
+	TEST_ASSERT(battle.turn_count == 1);
+	TEST_ASSERT(battle.hand_len == BATTLE_HAND_DRAW);
+	TEST_ASSERT(battle.player_movement_this_turn == BATTLE_MOVEMENT);
+
+	battle_destroy(&battle);
+	TEST_SUCCESS;
+}
+
+TEST(battle_same_seed_same_battle) {
+	struct battle a, b;
+	battle_init(&a, test_cards, count_of(test_cards), 1234, (struct battle_callbacks){0});
+	battle_init(&b, test_cards, count_of(test_cards), 1234, (struct battle_callbacks){0});
+
+	for (int round = 0; round < 8; ++round) {
+		run_until(&a, GS_TURN_PLAYER_IN_PROGRESS);
+		run_until(&b, GS_TURN_PLAYER_IN_PROGRESS);
+		TEST_ASSERT(a.hand_len == b.hand_len);
+		for (usize i = 0; i < a.hand_len; ++i) {
+			TEST_ASSERT(a.hand[i].card == b.hand[i].card);
+		}
+		for (usize i = 0; i < a.units_len; ++i) {
+			TEST_ASSERT(hexcoord_equal(a.units[i].pos, b.units[i].pos));
+		}
+		battle_on_game_event(&a, (struct game_event){ .type=EVENT_END_TURN });
+		battle_on_game_event(&b, (struct game_event){ .type=EVENT_END_TURN });
+		battle_update(&a);
+		battle_update(&b);
+	}
+
+	battle_destroy(&a);
+	battle_destroy(&b);
+	TEST_SUCCESS;
+}
+
+// plays `rounds` rounds, moving and playing a card whenever it can.
+static void play_rounds(struct battle *battle, int rounds, uint64_t *hashes) {
+	for (int round = 0; round < rounds; ++round) {
+		run_until(battle, GS_ROUND_BEGIN);
+		if (hashes) {
+			hashes[round] = battle_replay_hash(battle);
+		}
+		run_until(battle, GS_TURN_PLAYER_IN_PROGRESS);
+
+		const struct battle_unit *player = battle_unit(battle, battle->player);
+		const enum hexmap_neighbor n = HEXMAP_N_FIRST + (round % (HEXMAP_N_LAST - HEXMAP_N_FIRST + 1));
+		const struct hexcoord goal = hexmap_get_neighbor_coord(&battle->map, player->pos, n);
+		battle_on_game_event(battle, (struct game_event){ .type=EVENT_MOVE_ENTITY, .move_entity={ .entity=battle->player, .goal=goal } });
+		battle_on_game_event(battle, (struct game_event){ .type=EVENT_PLAY_CARD, .play_card={ .caused_by=battle->player, .card=battle->hand[0].id } });
+		battle_on_game_event(battle, (struct game_event){ .type=EVENT_END_TURN });
+		battle_update(battle);
+	}
+}
+
+TEST(battle_replay_seek_and_verify) {
+	enum { ROUNDS = 40 };
+	uint64_t hashes[ROUNDS];
+
+	struct battle battle;
+	struct battle_replay replay;
+	battle_init(&battle, test_cards, count_of(test_cards), 77, (struct battle_callbacks){0});
+	battle_replay_begin(&replay, &battle, 8);
+	play_rounds(&battle, ROUNDS, hashes);
+	TEST_ASSERT(arrlenu(replay.checkpoints) == ROUNDS / 8);
+
+	struct battle copy;
+	battle_init(&copy, test_cards, count_of(test_cards), replay.seed, (struct battle_callbacks){0});
+	TEST_ASSERT(battle_replay_verify(&replay, &copy) == BATTLE_REPLAY_OK);
+	TEST_ASSERT(battle_replay_hash(&copy) == battle_replay_hash(&battle));
+	battle_destroy(&copy);
+
+	const usize turns[] = { 0, 3, 8, 21, ROUNDS - 1 };
+	for (usize i = 0; i < count_of(turns); ++i) {
+		battle_init(&copy, test_cards, count_of(test_cards), replay.seed, (struct battle_callbacks){0});
+		TEST_ASSERT(battle_replay_seek(&replay, &copy, turns[i]) == BATTLE_REPLAY_OK);
+		TEST_ASSERT(copy.turn_count == turns[i]);
+		TEST_ASSERT(battle_replay_hash(&copy) == hashes[turns[i]]);
+		battle_destroy(&copy);
+	}
+	battle_init(&copy, test_cards, count_of(test_cards), replay.seed, (struct battle_callbacks){0});
+	TEST_ASSERT(battle_replay_seek(&replay, &copy, ROUNDS + 10) == BATTLE_REPLAY_END);
+	battle_destroy(&copy);
+
+	// a different seed deals other cards
+	battle_init(&copy, test_cards, count_of(test_cards), replay.seed + 1, (struct battle_callbacks){0});
+	TEST_ASSERT(battle_replay_verify(&replay, &copy) != BATTLE_REPLAY_OK);
+	battle_destroy(&copy);
+
+	battle_replay_free(&replay);
+	battle_destroy(&battle);
+	TEST_SUCCESS;
+}
+
+TEST(battle_replay_flush_and_load) {
+	struct battle battle;
+	struct battle_replay replay;
+	battle_init(&battle, test_cards, count_of(test_cards), 5, (struct battle_callbacks){0});
+	battle_replay_begin(&replay, &battle, 4);
+
+	char path[] = "/tmp/battle_replay_XXXXXX";
+	const int fd = mkstemp(path);
+	TEST_ASSERT(fd >= 0);
+	FILE *file = fdopen(fd, "wb");
+	for (int i = 0; i < 3; ++i) {
+		play_rounds(&battle, 5, NULL);
+		TEST_ASSERT(battle_replay_flush(&replay, file) == 0);
+	}
+	fclose(file);
+
+	struct battle_replay loaded;
+	TEST_ASSERT(battle_replay_load(&loaded, path) == BATTLE_REPLAY_OK);
+	remove(path);
+	TEST_ASSERT(arrlenu(loaded.log) == arrlenu(replay.log));
+	TEST_ASSERT(arrlenu(loaded.checkpoints) == arrlenu(replay.checkpoints));
+	TEST_ASSERT(loaded.seed == replay.seed);
+
+	struct battle copy;
+	battle_init(&copy, test_cards, count_of(test_cards), loaded.seed, (struct battle_callbacks){0});
+	TEST_ASSERT(battle_replay_verify(&loaded, &copy) == BATTLE_REPLAY_OK);
+	TEST_ASSERT(battle_replay_hash(&copy) == battle_replay_hash(&battle));
+	battle_destroy(&copy);
+
+	battle_replay_free(&loaded);
+	battle_replay_free(&replay);
+	battle_destroy(&battle);
+	TEST_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include "framework/testing.h"
+
+#include <string.h>
+#include "game/battle_rules.h"
+#include "game/battle_snapshot.h"
+
+static struct battle_card test_cards[] = {
+	{ .name="Strike", .description="", .image_id=0, .kind=CARD_KIND_BASIC_ATTACK, .damage={ .basic=3 } },
+};
+
+static int snapshot_equal(const struct battle_snapshot *a, const struct battle_snapshot *b) {
+	if (a->state != b->state || a->turn_count != b->turn_count || a->player_movement != b->player_movement
+		|| a->player != b->player || a->units_len != b->units_len) {
+		return 0;
+	}
+	for (usize i = 0; i < a->units_len; ++i) {
+		if (memcmp(&a->units[i], &b->units[i], sizeof(a->units[i])) != 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+TEST(battle_snapshot_delta_roundtrip) {
+	struct battle battle;
+	battle_init(&battle, test_cards, count_of(test_cards), 3, (struct battle_callbacks){0});
+
+	struct battle_snapshot full, delta, decoded;
+	uint8_t data[BATTLE_SNAPSHOT_BYTES_MAX];
+	battle_snapshot_capture(&battle, &full);
+	usize len = battle_snapshot_write_delta(NULL, &full, data, sizeof(data));
+	TEST_ASSERT(len > 0);
+	TEST_ASSERT(battle_snapshot_read_delta(NULL, data, len, &decoded) == 0);
+	TEST_ASSERT(snapshot_equal(&full, &decoded));
+	TEST_ASSERT(battle_snapshot_read_delta(NULL, data, len - 1, &decoded) == 1);
+
+	// nothing changed, one bit per field and unit
+	len = battle_snapshot_write_delta(&full, &full, data, sizeof(data));
+	TEST_ASSERT(len == 1);
+
+	battle_unit(&battle, battle.player)->hp -= 2;
+	battle_snapshot_capture(&battle, &delta);
+	len = battle_snapshot_write_delta(&full, &delta, data, sizeof(data));
+	TEST_ASSERT(len > 0 && len <= 4);
+	TEST_ASSERT(battle_snapshot_read_delta(&full, data, len, &decoded) == 0);
+	TEST_ASSERT(snapshot_equal(&delta, &decoded));
+	TEST_ASSERT(decoded.units[battle.player - 1].hp == battle_unit(&battle, battle.player)->hp);
+
+	// the largest snapshot fits
+	struct battle_snapshot largest = { .state=GS_BATTLE_END, .turn_count=UINT32_MAX, .player_movement=15, .player=255, .units_len=BATTLE_UNITS_MAX };
+	for (usize i = 0; i < BATTLE_UNITS_MAX; ++i) {
+		largest.units[i] = (struct battle_snapshot_unit){ .id=255, .x=255, .y=255, .hp=UINT16_MAX, .max_hp=UINT16_MAX };
+	}
+	TEST_ASSERT(battle_snapshot_write_delta(NULL, &largest, data, sizeof(data)) > 0);
+
+	battle_destroy(&battle);
+	TEST_SUCCESS;
+}
+
+TEST(battle_snapshot_sync_acks) {
+	struct battle battle, mirror;
+	battle_init(&battle, test_cards, count_of(test_cards), 3, (struct battle_callbacks){0});
+	battle_init(&mirror, test_cards, count_of(test_cards), 4, (struct battle_callbacks){0});
+
+	static struct battle_sync server, client;
+	battle_sync_init(&server);
+	battle_sync_init(&client);
+
+	uint8_t data[BATTLE_SNAPSHOT_BYTES_MAX];
+	uint32_t sequence, baseline;
+	struct battle_snapshot snapshot;
+
+	// nothing acknowledged yet, full snapshots
+	usize len = battle_sync_write(&server, &battle, &sequence, &baseline, data, sizeof(data));
+	TEST_ASSERT(sequence == 1 && baseline == 0);
+	TEST_ASSERT(battle_sync_read(&client, sequence, baseline, data, len, &snapshot) == 0);
+	battle_snapshot_apply(&snapshot, &mirror);
+	battle_sync_ack(&server, sequence);
+	const usize full_len = len;
+
+	// acknowledged, only the changes
+	battle_unit(&battle, battle.player)->hp -= 1;
+	len = battle_sync_write(&server, &battle, &sequence, &baseline, data, sizeof(data));
+	TEST_ASSERT(sequence == 2 && baseline == 1);
+	TEST_ASSERT(len < full_len);
+	TEST_ASSERT(battle_sync_read(&client, sequence, baseline, data, len, &snapshot) == 0);
+	TEST_ASSERT(battle_sync_read(&client, sequence, baseline, data, len, &snapshot) == 1); // stale
+	battle_snapshot_apply(&snapshot, &mirror);
+	TEST_ASSERT(battle_unit(&mirror, battle.player)->hp == battle_unit(&battle, battle.player)->hp);
+
+	// acks get lost, deltas stay relative to the last one until it is too old
+	for (int i = 0; i < BATTLE_SNAPSHOT_HISTORY + 2; ++i) {
+		len = battle_sync_write(&server, &battle, &sequence, &baseline, data, sizeof(data));
+		TEST_ASSERT(len > 0);
+		TEST_ASSERT(baseline == 0 || baseline == 1);
+		TEST_ASSERT(battle_sync_read(&client, sequence, baseline, data, len, &snapshot) == 0);
+	}
+	TEST_ASSERT(baseline == 0);
+	battle_sync_ack(&server, sequence);
+	battle_sync_ack(&server, 1); // late
+	TEST_ASSERT(server.acked == sequence);
+
+	battle_snapshot_apply(&snapshot, &mirror);
+	for (usize i = 0; i < battle.units_len; ++i) {
+		TEST_ASSERT(hexcoord_equal(mirror.units[i].pos, battle.units[i].pos));
+		TEST_ASSERT(hexmap_tile_at(&mirror.map, mirror.units[i].pos)->occupied_by == mirror.units[i].id);
+	}
+
+	battle_destroy(&battle);
+	battle_destroy(&mirror);
+	TEST_SUCCESS;
+}
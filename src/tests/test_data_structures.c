@@ -1,4 +1,8 @@
 #include "framework/testing.h"
+#include <pthread.h>
+#include "util/histogram.h"
+#include "util/slotmap.h"
+#include "util/spsc.h"
 #include "util/util.h"
 
 TEST(ringbuffer) {
@@ -137,3 +141,144 @@ TEST(ringbuffer_many_writes) {
 
 	TEST_SUCCESS;
 }
+
+TEST(slotmap_ids) {
+	struct slotmap map;
+	slotmap_init(&map);
+	int values[3] = { 10, 20, 30 };
+
+	const uint32_t a = slotmap_insert(&map, &values[0]);
+	const uint32_t b = slotmap_insert(&map, &values[1]);
+	const uint32_t c = slotmap_insert(&map, &values[2]);
+	TEST_ASSERT(a != 0 && b != 0 && c != 0);
+	TEST_ASSERT(a != b && b != c);
+	TEST_ASSERT(3 == slotmap_len(&map));
+	TEST_ASSERT(&values[1] == slotmap_get(&map, b));
+	TEST_ASSERT(NULL == slotmap_get(&map, 0));
+	TEST_ASSERT(NULL == slotmap_get(&map, c | (1u << SLOTMAP_ID_BITS)));
+
+	// the last item fills the gap
+	TEST_ASSERT(&values[0] == slotmap_remove(&map, a));
+	TEST_ASSERT(NULL == slotmap_remove(&map, a));
+	TEST_ASSERT(NULL == slotmap_get(&map, a));
+	TEST_ASSERT(2 == slotmap_len(&map));
+	TEST_ASSERT(&values[2] == map.items[0]);
+	TEST_ASSERT(&values[2] == slotmap_get(&map, c));
+
+	// the slot is reused with a new generation
+	const uint32_t d = slotmap_insert(&map, &values[0]);
+	TEST_ASSERT(d != a);
+	TEST_ASSERT(NULL == slotmap_get(&map, a));
+	TEST_ASSERT(&values[0] == slotmap_get(&map, d));
+
+	slotmap_destroy(&map);
+	TEST_SUCCESS;
+}
+
+TEST(slotmap_full) {
+	struct slotmap map;
+	slotmap_init(&map);
+	int value = 0;
+
+	uint32_t last = 0;
+	for (uint32_t i = 0; i < SLOTMAP_CAPACITY; ++i) {
+		last = slotmap_insert(&map, &value);
+		TEST_ASSERT(last != 0);
+	}
+	TEST_ASSERT(0 == slotmap_insert(&map, &value));
+	slotmap_remove(&map, last);
+	TEST_ASSERT(0 != slotmap_insert(&map, &value));
+
+	slotmap_destroy(&map);
+	TEST_SUCCESS;
+}
+
+TEST(histogram_buckets) {
+	// small values are exact, above every power of two has 4 buckets
+	TEST_ASSERT(0 == histogram_bucket_of(0));
+	TEST_ASSERT(3 == histogram_bucket_of(3));
+	TEST_ASSERT(7 == histogram_bucket_of(7));
+	TEST_ASSERT(histogram_bucket_of(1000) == histogram_bucket_of(1023));
+	TEST_ASSERT(histogram_bucket_of(1023) + 1 == histogram_bucket_of(1024));
+	TEST_ASSERT(HISTOGRAM_BUCKETS - 1 == histogram_bucket_of(UINT64_MAX));
+
+	// every value lies below the end of its bucket and at or above the previous end
+	const uint64_t values[] = { 1, 4, 5, 100, 1024, 1279, 1280, 123456789, 1ull << 63 };
+	for (usize i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+		const int bucket = histogram_bucket_of(values[i]);
+		TEST_ASSERT(values[i] < histogram_bucket_end(bucket));
+		TEST_ASSERT(values[i] >= histogram_bucket_end(bucket - 1));
+	}
+	TEST_ASSERT(UINT64_MAX == histogram_bucket_end(HISTOGRAM_BUCKETS - 1));
+	TEST_SUCCESS;
+}
+
+TEST(histogram_quantiles) {
+	struct histogram histogram = { 0 };
+	TEST_ASSERT(0 == histogram_quantile(&histogram, 0.5));
+
+	for (uint64_t i = 1; i <= 1000; ++i) {
+		histogram_record(&histogram, i * 1000);
+	}
+	TEST_ASSERT(1000 == histogram.count);
+	TEST_ASSERT(1000000 == histogram.max);
+
+	// within the 25% of a bucket
+	const uint64_t median = histogram_quantile(&histogram, 0.5);
+	TEST_ASSERT(median >= 500000 && median < 625000);
+	TEST_ASSERT(1000000 == histogram_quantile(&histogram, 1));
+	TEST_ASSERT(1000 == histogram_count_below(&histogram, 1 << 20));
+	TEST_ASSERT(524 == histogram_count_below(&histogram, 1 << 19)); // exact at powers of two
+
+	struct histogram sum = { 0 };
+	histogram_merge(&sum, &histogram);
+	histogram_merge(&sum, &histogram);
+	TEST_ASSERT(2000 == sum.count);
+	TEST_ASSERT(2 * histogram_count_below(&histogram, 1 << 19) == histogram_count_below(&sum, 1 << 19));
+	TEST_SUCCESS;
+}
+
+static void *spsc_produce(void *data) {
+	struct spsc_queue *queue = data;
+	for (int i = 0; i < 100000; ++i) {
+		int *item;
+		while ((item = spsc_write_begin(queue)) == NULL) {
+			// full, the consumer catches up
+		}
+		*item = i;
+		spsc_write_end(queue);
+	}
+	return NULL;
+}
+
+TEST(spsc_threads) {
+	struct spsc_queue queue;
+	spsc_init(&queue, sizeof(int), 16);
+	TEST_ASSERT(NULL == spsc_read_begin(&queue));
+
+	// every item arrives once and in order, however the threads interleave
+	pthread_t producer;
+	pthread_create(&producer, NULL, spsc_produce, &queue);
+	int expected = 0;
+	while (expected < 100000) {
+		const int *item = spsc_read_begin(&queue);
+		if (item != NULL) {
+			TEST_ASSERT(expected == *item);
+			spsc_read_end(&queue);
+			++expected;
+		}
+	}
+	pthread_join(producer, NULL);
+	TEST_ASSERT(0 == spsc_len(&queue));
+
+	// full
+	for (int i = 0; i < 16; ++i) {
+		TEST_ASSERT(NULL != spsc_write_begin(&queue));
+		spsc_write_end(&queue);
+	}
+	TEST_ASSERT(NULL == spsc_write_begin(&queue));
+	TEST_ASSERT(16 == spsc_len(&queue));
+
+	spsc_destroy(&queue);
+	TEST_SUCCESS;
+}
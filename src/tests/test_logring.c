@@ -0,0 +1,68 @@
+#include "framework/testing.h"
+
+#include <string.h>
+#include "util/logring.h"
+
+struct captured {
+	char messages[8][LOGRING_MESSAGE_MAX];
+	enum logring_level levels[8];
+	int len;
+};
+
+static void capture(enum logring_level level, const struct timespec *time, const char *message, void *userdata) {
+	struct captured *captured = userdata;
+	if (captured->len < 8) {
+		captured->levels[captured->len] = level;
+		strcpy(captured->messages[captured->len++], message);
+	}
+}
+
+TEST(logring_deferred_formatting) {
+	struct logring ring;
+	logring_init(&ring, 8);
+
+	char name[] = "alice";
+	logring_write(&ring, LOGRING_INFO, "plain");
+	logring_write(&ring, LOGRING_WARN, "%s has %d/%u hp, %5.2f%% %c", name, -3, 10u, 12.5, 'x');
+	logring_write(&ring, LOGRING_ERROR, "%zu %ld %lld %hhd %08x %%", (size_t)7, -8L, 9LL, (signed char)-1, 0xbeefu);
+	// strings are copied, not referenced
+	strcpy(name, "bob");
+
+	struct captured captured = {0};
+	TEST_ASSERT(3 == logring_drain(&ring, capture, &captured));
+	TEST_ASSERT(0 == logring_drain(&ring, capture, &captured));
+	TEST_ASSERT(3 == captured.len);
+	TEST_ASSERT_STR("plain", captured.messages[0]);
+	TEST_ASSERT_STR("alice has -3/10 hp, 12.50% x", captured.messages[1]);
+	TEST_ASSERT_STR("7 -8 9 -1 0000beef %", captured.messages[2]);
+	TEST_ASSERT(LOGRING_WARN == captured.levels[1]);
+
+	logring_destroy(&ring);
+	TEST_SUCCESS;
+}
+
+TEST(logring_drops_when_full) {
+	struct logring ring;
+	logring_init(&ring, 4);
+	ring.level = LOGRING_INFO;
+
+	logring_write(&ring, LOGRING_DEBUG, "ignored");
+	for (int i = 0; i < 6; ++i) {
+		logring_write(&ring, LOGRING_INFO, "entry %d", i);
+	}
+	TEST_ASSERT(2 == logring_dropped(&ring));
+	TEST_ASSERT(0 == logring_dropped(&ring));
+
+	struct captured captured = {0};
+	TEST_ASSERT(4 == logring_drain(&ring, capture, &captured));
+	TEST_ASSERT_STR("entry 0", captured.messages[0]);
+	TEST_ASSERT_STR("entry 3", captured.messages[3]);
+
+	// entries are reused after draining
+	TEST_ASSERT(0 == logring_write(&ring, LOGRING_INFO, "again"));
+	TEST_ASSERT(1 == logring_drain(&ring, capture, &captured));
+	TEST_ASSERT_STR("again", captured.messages[4]);
+
+	logring_destroy(&ring);
+	TEST_SUCCESS;
+}
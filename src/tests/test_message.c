@@ -0,0 +1,361 @@
+#include "framework/testing.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "net/io_thread.h"
+#include "net/message.h"
+#include "net/stream.h"
+#include "util/arena.h"
+
+TEST(message_binary_roundtrip) {
+	struct lobby_create_request req;
+	message_header_init(&req.header, LOBBY_CREATE_REQUEST);
+	req.lobby_id = -1234;
+	req.lobby_name = "My Test Lobby";
+
+	uint8_t frame[MESSAGE_FRAME_MAX];
+	const size_t frame_len = message_encode(&req.header, frame, sizeof(frame));
+	TEST_ASSERT(frame_len > 0);
+	TEST_ASSERT(frame_len < 24);
+
+	union message_any msg;
+	TEST_ASSERT(message_decode(frame, frame_len - 1, &msg) == 0); // incomplete
+	TEST_ASSERT(message_decode(frame, frame_len, &msg) == (ptrdiff_t)frame_len);
+	TEST_ASSERT(msg.header.type == LOBBY_CREATE_REQUEST);
+	TEST_ASSERT(msg.lobby_create_request.lobby_id == -1234);
+	TEST_ASSERT_STR("My Test Lobby", msg.lobby_create_request.lobby_name);
+
+	TEST_SUCCESS;
+}
+
+TEST(message_coalesced_frames) {
+	struct lobby_list_response res;
+	message_header_init(&res.header, LOBBY_LIST_RESPONSE);
+	res.ids_of_lobbies_len = 3;
+	res.ids_of_lobbies[0] = 1;
+	res.ids_of_lobbies[1] = 300;
+	res.ids_of_lobbies[2] = 70000;
+	struct lobby_join_request join;
+	message_header_init(&join.header, LOBBY_JOIN_REQUEST);
+	join.lobby_id = 42;
+
+	uint8_t data[2 * MESSAGE_FRAME_MAX];
+	size_t data_len = message_encode(&res.header, data, sizeof(data));
+	message_set_encoding(MESSAGE_ENCODING_JSON);
+	data_len += message_encode(&join.header, data + data_len, sizeof(data) - data_len);
+	message_set_encoding(MESSAGE_ENCODING_BINARY);
+
+	union message_any msg;
+	const ptrdiff_t first = message_decode(data, data_len, &msg);
+	TEST_ASSERT(first > 0);
+	TEST_ASSERT(msg.header.type == LOBBY_LIST_RESPONSE);
+	TEST_ASSERT(msg.lobby_list_response.ids_of_lobbies_len == 3);
+	TEST_ASSERT(msg.lobby_list_response.ids_of_lobbies[2] == 70000);
+
+	const ptrdiff_t second = message_decode(data + first, data_len - first, &msg);
+	TEST_ASSERT(first + second == (ptrdiff_t)data_len);
+	TEST_ASSERT(msg.header.type == LOBBY_JOIN_REQUEST);
+	TEST_ASSERT(msg.lobby_join_request.lobby_id == 42);
+
+	// garbage in a complete frame is skipped, not a broken stream
+	const uint8_t garbage[] = { 3, 0x7f, 0xff, 0xff };
+	TEST_ASSERT(message_decode(garbage, sizeof(garbage), &msg) == sizeof(garbage));
+	TEST_ASSERT(msg.header.type == MSG_TYPE_UNKNOWN);
+
+	TEST_SUCCESS;
+}
+
+
+static void stream_write(struct net_stream *stream, const uint8_t *data, size_t len) {
+	size_t available = 0;
+	uint8_t *dst = net_stream_write_begin(stream, len, &available);
+	memcpy(dst, data, len);
+	net_stream_write_end(stream, len);
+}
+
+TEST(message_stream_partial_frames) {
+	struct net_stream stream;
+	net_stream_init(&stream, 0);
+
+	struct lobby_create_request req;
+	message_header_init(&req.header, LOBBY_CREATE_REQUEST);
+	req.lobby_name = "Lobby";
+
+	// frames split into small reads, wrapping around the ring several times
+	int expected_id = 0;
+	for (int i = 0; i < 300; ++i) {
+		uint8_t frame[MESSAGE_FRAME_MAX];
+		req.lobby_id = i;
+		const size_t frame_len = message_encode(&req.header, frame, sizeof(frame));
+		for (size_t offset = 0; offset < frame_len; offset += 7) {
+			stream_write(&stream, &frame[offset], (frame_len - offset < 7) ? frame_len - offset : 7);
+
+			union message_any msg;
+			while (net_stream_next_message(&stream, &msg) > 0) {
+				TEST_ASSERT(msg.header.type == LOBBY_CREATE_REQUEST);
+				TEST_ASSERT(msg.lobby_create_request.lobby_id == expected_id);
+				TEST_ASSERT_STR("Lobby", msg.lobby_create_request.lobby_name);
+				++expected_id;
+			}
+		}
+	}
+	TEST_ASSERT(expected_id == 300);
+	TEST_ASSERT(stream.capacity == NET_STREAM_CAPACITY_MIN);
+
+	// a burst larger than the buffer grows it
+	for (int i = 0; i < 500; ++i) {
+		uint8_t frame[MESSAGE_FRAME_MAX];
+		req.lobby_id = i;
+		stream_write(&stream, frame, message_encode(&req.header, frame, sizeof(frame)));
+	}
+	TEST_ASSERT(stream.capacity > NET_STREAM_CAPACITY_MIN);
+	union message_any msg;
+	int received = 0;
+	while (net_stream_next_message(&stream, &msg) > 0) {
+		TEST_ASSERT(msg.lobby_create_request.lobby_id == received);
+		++received;
+	}
+	TEST_ASSERT(received == 500);
+	TEST_ASSERT(stream.len == 0);
+
+	net_stream_free(&stream);
+	TEST_SUCCESS;
+}
+
+TEST(message_stream_send_queue) {
+	struct net_stream tx, rx;
+	net_stream_init(&tx, 0);
+	net_stream_init(&rx, 0);
+
+	struct lobby_create_request req;
+	message_header_init(&req.header, LOBBY_CREATE_REQUEST);
+	req.lobby_name = "Lobby";
+
+	// frames are encoded in place, a socket taking 5 bytes per write drains them
+	int expected_id = 0;
+	for (int i = 0; i < 300; ++i) {
+		size_t available = 0;
+		uint8_t *dst = net_stream_write_begin(&tx, MESSAGE_FRAME_MAX, &available);
+		TEST_ASSERT(available >= MESSAGE_FRAME_MAX);
+		req.lobby_id = i;
+		net_stream_write_end(&tx, message_encode(&req.header, dst, MESSAGE_FRAME_MAX));
+
+		// a few frames queue up before each flush
+		if (i % 3 != 2) {
+			continue;
+		}
+		size_t len = 0;
+		const uint8_t *src;
+		while ((src = net_stream_read_begin(&tx, &len)) != NULL) {
+			const size_t sent = (len < 5) ? len : 5;
+			stream_write(&rx, src, sent);
+			net_stream_read_end(&tx, sent);
+		}
+
+		union message_any msg;
+		while (net_stream_next_message(&rx, &msg) > 0) {
+			TEST_ASSERT(msg.lobby_create_request.lobby_id == expected_id);
+			++expected_id;
+		}
+	}
+	TEST_ASSERT(expected_id == 300);
+	TEST_ASSERT(tx.len == 0 && rx.len == 0);
+
+	net_stream_free(&tx);
+	net_stream_free(&rx);
+	TEST_SUCCESS;
+}
+
+TEST(message_bytes_field) {
+	struct battle_snapshot_msg snapshot;
+	message_header_init(&snapshot.header, BATTLE_SNAPSHOT);
+	snapshot.sequence = 7;
+	snapshot.baseline = 5;
+	snapshot.delta_len = 3;
+	snapshot.delta[0] = 0x00;
+	snapshot.delta[1] = 0xff;
+	snapshot.delta[2] = 0x80;
+
+	const enum message_encoding encodings[] = { MESSAGE_ENCODING_BINARY, MESSAGE_ENCODING_JSON };
+	for (size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); ++i) {
+		message_set_encoding(encodings[i]);
+		uint8_t frame[MESSAGE_FRAME_MAX];
+		const size_t frame_len = message_encode(&snapshot.header, frame, sizeof(frame));
+		TEST_ASSERT(frame_len > 0);
+
+		union message_any msg;
+		TEST_ASSERT(message_decode(frame, frame_len, &msg) == (ptrdiff_t)frame_len);
+		TEST_ASSERT(msg.header.type == BATTLE_SNAPSHOT);
+		TEST_ASSERT(msg.battle_snapshot_msg.sequence == 7);
+		TEST_ASSERT(msg.battle_snapshot_msg.baseline == 5);
+		TEST_ASSERT(msg.battle_snapshot_msg.delta_len == 3);
+		TEST_ASSERT(memcmp(msg.battle_snapshot_msg.delta, snapshot.delta, 3) == 0);
+	}
+	message_set_encoding(MESSAGE_ENCODING_BINARY);
+
+	TEST_SUCCESS;
+}
+
+TEST(message_unpack_arena) {
+	struct lobby_create_request req;
+	message_header_init(&req.header, LOBBY_CREATE_REQUEST);
+	req.lobby_id = 3;
+	req.lobby_name = "Arena Lobby";
+
+	// only room for one message per tick
+	uint8_t buffer[sizeof(req) + 16] __attribute__((aligned(ARENA_ALIGN)));
+	struct arena arena;
+	arena_init_buffer(&arena, buffer, sizeof(buffer));
+
+	for (int tick = 0; tick < 3; ++tick) {
+		cJSON *json = pack_message(&req.header);
+		struct message_header *msg = unpack_message(json, &arena);
+		TEST_ASSERT(unpack_message(json, &arena) == NULL); // full
+		cJSON_Delete(json); // strings were copied
+		TEST_ASSERT(msg != NULL && msg->type == LOBBY_CREATE_REQUEST);
+		TEST_ASSERT((uint8_t *)msg == buffer);
+		TEST_ASSERT(((struct lobby_create_request *)msg)->lobby_id == 3);
+		TEST_ASSERT_STR("Arena Lobby", ((struct lobby_create_request *)msg)->lobby_name);
+		arena_reset(&arena);
+	}
+
+	// decoded json strings outlive the tree too
+	message_set_encoding(MESSAGE_ENCODING_JSON);
+	uint8_t frame[MESSAGE_FRAME_MAX];
+	const size_t frame_len = message_encode(&req.header, frame, sizeof(frame));
+	message_set_encoding(MESSAGE_ENCODING_BINARY);
+	union message_any msg;
+	TEST_ASSERT(message_decode(frame, frame_len, &msg) == (ptrdiff_t)frame_len);
+	TEST_ASSERT(msg.header.type == LOBBY_CREATE_REQUEST);
+	TEST_ASSERT_STR("Arena Lobby", msg.lobby_create_request.lobby_name);
+
+	arena_destroy(&arena);
+	TEST_SUCCESS;
+}
+
+TEST(message_io_thread) {
+	int pair[2];
+	TEST_ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+	fcntl(pair[0], F_SETFL, O_NONBLOCK); // like net_socket_connect()
+	struct net_socket sock = { .is_open = 1, .fd = pair[0] };
+	struct net_io_thread io;
+	TEST_ASSERT(0 == net_io_thread_start(&io, &sock));
+
+	// frames from the server arrive decoded, split across writes or not
+	struct lobby_create_request req;
+	message_header_init(&req.header, LOBBY_CREATE_REQUEST);
+	req.lobby_name = "Lobby";
+	for (int i = 0; i < 100; ++i) {
+		uint8_t frame[MESSAGE_FRAME_MAX];
+		req.lobby_id = i;
+		const size_t frame_len = message_encode(&req.header, frame, sizeof(frame));
+		const size_t split = (i % 2) ? frame_len / 2 : frame_len;
+		TEST_ASSERT((ssize_t)split == write(pair[1], frame, split));
+		TEST_ASSERT((ssize_t)(frame_len - split) == write(pair[1], &frame[split], frame_len - split));
+	}
+	int received = 0;
+	while (received < 100) {
+		struct net_io_incoming *in = spsc_read_begin(&io.incoming);
+		if (in == NULL) {
+			usleep(100);
+			continue;
+		}
+		TEST_ASSERT(in->is_decoded);
+		TEST_ASSERT(LOBBY_CREATE_REQUEST == in->message.header.type);
+		TEST_ASSERT(received == in->message.lobby_create_request.lobby_id);
+		TEST_ASSERT_STR("Lobby", in->message.lobby_create_request.lobby_name);
+		spsc_read_end(&io.incoming);
+		++received;
+	}
+
+	// queued frames go out once woken
+	for (int i = 0; i < 3; ++i) {
+		struct net_io_outgoing *out = spsc_write_begin(&io.outgoing);
+		req.lobby_id = 1000 + i;
+		out->len = message_encode(&req.header, out->data, MESSAGE_FRAME_MAX);
+		spsc_write_end(&io.outgoing);
+	}
+	net_io_thread_wake(&io);
+	struct net_stream rx;
+	net_stream_init(&rx, 0);
+	union message_any msg;
+	int sent = 0;
+	while (sent < 3) {
+		size_t available = 0;
+		uint8_t *dst = net_stream_write_begin(&rx, 512, &available);
+		const ssize_t len = read(pair[1], dst, available);
+		TEST_ASSERT(len > 0);
+		net_stream_write_end(&rx, len);
+		while (net_stream_next_message(&rx, &msg) > 0) {
+			TEST_ASSERT(1000 + sent == msg.lobby_create_request.lobby_id);
+			++sent;
+		}
+	}
+	net_stream_free(&rx);
+
+	// a hang up is reported, the main thread disconnects
+	close(pair[1]);
+	while (!__atomic_load_n(&io.failed, __ATOMIC_ACQUIRE)) {
+		usleep(100);
+	}
+	net_io_thread_stop(&io);
+	close(pair[0]);
+	TEST_SUCCESS;
+}
+
+TEST(message_io_thread_backed_up) {
+	int pair[2];
+	TEST_ASSERT(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+	fcntl(pair[0], F_SETFL, O_NONBLOCK);
+	struct net_socket sock = { .is_open = 1, .fd = pair[0] };
+	struct net_io_thread io;
+	TEST_ASSERT(0 == net_io_thread_start(&io, &sock));
+
+	// more than fit into the queue, then the server hangs up
+	const int frames = NET_IO_QUEUE_ENTRIES + 10;
+	struct lobby_join_request req;
+	message_header_init(&req.header, LOBBY_JOIN_REQUEST);
+	for (int i = 0; i < frames; ++i) {
+		uint8_t frame[MESSAGE_FRAME_MAX];
+		req.lobby_id = i;
+		const size_t frame_len = message_encode(&req.header, frame, sizeof(frame));
+		TEST_ASSERT((ssize_t)frame_len == write(pair[1], frame, frame_len));
+	}
+	close(pair[1]);
+	while (spsc_len(&io.incoming) < NET_IO_QUEUE_ENTRIES) {
+		usleep(100);
+	}
+
+	// the thread waits for the main thread instead of spinning on the hang up
+	clockid_t clock;
+	TEST_ASSERT(0 == pthread_getcpuclockid(io.thread, &clock));
+	struct timespec before, after;
+	clock_gettime(clock, &before);
+	usleep(100 * 1000);
+	clock_gettime(clock, &after);
+	const double busy_ms = (after.tv_sec - before.tv_sec) * 1e3 + (after.tv_nsec - before.tv_nsec) / 1e6;
+	TEST_ASSERT(busy_ms < 20.0);
+	TEST_ASSERT(!__atomic_load_n(&io.failed, __ATOMIC_ACQUIRE));
+
+	// every frame sent before the hang up still arrives
+	int received = 0;
+	while (received < frames) {
+		struct net_io_incoming *in = spsc_read_begin(&io.incoming);
+		if (in == NULL) {
+			usleep(100);
+			continue;
+		}
+		TEST_ASSERT(received == in->message.lobby_join_request.lobby_id);
+		spsc_read_end(&io.incoming);
+		++received;
+	}
+	while (!__atomic_load_n(&io.failed, __ATOMIC_ACQUIRE)) {
+		usleep(100);
+	}
+	net_io_thread_stop(&io);
+	close(pair[0]);
+	TEST_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "util/arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void arena_init(struct arena *arena, usize capacity) {
+	assert(arena != NULL);
+	arena_init_buffer(arena, malloc(capacity), capacity);
+	arena->owned = 1;
+}
+
+void arena_init_buffer(struct arena *arena, void *buffer, usize capacity) {
+	assert(arena != NULL);
+	assert(buffer != NULL || capacity == 0);
+	assert(((uintptr_t)buffer & (ARENA_ALIGN - 1)) == 0 && "has to be aligned to ARENA_ALIGN");
+	arena->data = buffer;
+	arena->len = 0;
+	arena->capacity = capacity;
+	arena->owned = 0;
+}
+
+void arena_destroy(struct arena *arena) {
+	assert(arena != NULL);
+	if (arena->owned) {
+		free(arena->data);
+	}
+	arena->data = NULL;
+	arena->len = arena->capacity = 0;
+}
+
+static void *alloc(struct arena *arena, usize size, usize align) {
+	assert(arena != NULL);
+	const usize begin = (arena->len + align - 1) & ~(align - 1);
+	if (begin > arena->capacity || arena->capacity - begin < size) {
+		return NULL;
+	}
+	arena->len = begin + size;
+	return &arena->data[begin];
+}
+
+void *arena_alloc(struct arena *arena, usize size) {
+	return alloc(arena, size, ARENA_ALIGN);
+}
+
+// chars need no alignment, strings are packed.
+char *arena_strndup(struct arena *arena, const char *str, usize len) {
+	assert(str != NULL || len == 0);
+	char *copy = alloc(arena, len + 1, 1);
+	if (copy == NULL) {
+		return NULL;
+	}
+	if (len > 0) {
+		memcpy(copy, str, len);
+	}
+	copy[len] = '\0';
+	return copy;
+}
+
+void arena_reset(struct arena *arena) {
+	assert(arena != NULL);
+	arena->len = 0;
+}
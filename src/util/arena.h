@@ -0,0 +1,38 @@
+#ifndef UTIL_ARENA_H
+#define UTIL_ARENA_H
+
+//
+// Bump allocator for memory with a common lifetime, like one tick.
+//
+// Allocating moves a pointer through one fixed block, everything is released
+// at once by resetting it. There is no per-allocation free and no growing:
+//
+//     struct lobby_create_request *msg = arena_alloc(&tick_arena, sizeof(*msg));
+//     msg->lobby_name = arena_strndup(&tick_arena, name, name_len);
+//     ...
+//     arena_reset(&tick_arena); // once per tick, all pointers are invalid now
+//
+
+#include "util/base.h"
+
+#define ARENA_ALIGN 16 // of arena_alloc(), strings are packed
+
+struct arena {
+	uchar *data;
+	usize len;
+	usize capacity;
+	int owned; // `data` was allocated by arena_init()
+};
+
+void  arena_init(struct arena *, usize capacity);
+// allocates from `buffer` instead, which has to outlive the arena.
+void  arena_init_buffer(struct arena *, void *buffer, usize capacity);
+void  arena_destroy(struct arena *);
+
+// NULL if the arena is full.
+void *arena_alloc(struct arena *, usize size);
+// copies `len` bytes of `str` and terminates them. NULL if the arena is full.
+char *arena_strndup(struct arena *, const char *str, usize len);
+void  arena_reset(struct arena *);
+
+#endif
@@ -0,0 +1,96 @@
+#include "util/histogram.h"
+
+#include <assert.h>
+
+// the recording thread is the only writer, no read-modify-write needed.
+static void add(uint64_t *counter, uint64_t value) {
+	__atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static uint64_t load(const uint64_t *counter) {
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void histogram_record(struct histogram *histogram, uint64_t value) {
+	assert(histogram != NULL);
+	add(&histogram->buckets[histogram_bucket_of(value)], 1);
+	add(&histogram->count, 1);
+	add(&histogram->sum, value);
+	if (value > histogram->max) {
+		__atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+	}
+}
+
+void histogram_merge(struct histogram *into, const struct histogram *from) {
+	assert(into != NULL);
+	assert(from != NULL);
+	for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		into->buckets[i] += load(&from->buckets[i]);
+	}
+	into->count += load(&from->count);
+	into->sum += load(&from->sum);
+	const uint64_t max = load(&from->max);
+	if (max > into->max) {
+		into->max = max;
+	}
+}
+
+// values below HISTOGRAM_SUB_BUCKETS get a bucket each. above, the highest
+// bit picks the power of two and the bits below it the sub-bucket.
+int histogram_bucket_of(uint64_t value) {
+	if (value < HISTOGRAM_SUB_BUCKETS) {
+		return (int)value;
+	}
+	const int magnitude = 63 - __builtin_clzll(value);
+	const int sub = (value >> (magnitude - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+	return ((magnitude - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS) + sub;
+}
+
+uint64_t histogram_bucket_end(int bucket) {
+	assert(bucket >= 0 && bucket < HISTOGRAM_BUCKETS);
+	if (bucket < HISTOGRAM_SUB_BUCKETS) {
+		return (uint64_t)bucket + 1;
+	}
+	if (bucket == HISTOGRAM_BUCKETS - 1) {
+		return UINT64_MAX;
+	}
+	const int magnitude = (bucket >> HISTOGRAM_SUB_BITS) + HISTOGRAM_SUB_BITS - 1;
+	const uint64_t sub = bucket & (HISTOGRAM_SUB_BUCKETS - 1);
+	const uint64_t width = 1ull << (magnitude - HISTOGRAM_SUB_BITS);
+	return (1ull << magnitude) + (sub + 1) * width;
+}
+
+uint64_t histogram_count_below(const struct histogram *histogram, uint64_t end) {
+	assert(histogram != NULL);
+	uint64_t count = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS && histogram_bucket_end(i) <= end; ++i) {
+		count += load(&histogram->buckets[i]);
+	}
+	return count;
+}
+
+uint64_t histogram_quantile(const struct histogram *histogram, double q) {
+	assert(histogram != NULL);
+	assert(q >= 0 && q <= 1);
+
+	// `count` may be ahead of the buckets, use what they hold
+	uint64_t count = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		count += load(&histogram->buckets[i]);
+	}
+	if (count == 0) {
+		return 0;
+	}
+
+	const uint64_t rank = (q * count < 1) ? 1 : (uint64_t)(q * count + 0.5);
+	const uint64_t max = load(&histogram->max);
+	uint64_t seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		seen += load(&histogram->buckets[i]);
+		if (seen >= rank) {
+			const uint64_t last = histogram_bucket_end(i) - 1;
+			return (last < max) ? last : max;
+		}
+	}
+	return max;
+}
@@ -0,0 +1,45 @@
+#ifndef UTIL_HISTOGRAM_H
+#define UTIL_HISTOGRAM_H
+
+//
+// Log-linear histogram of unsigned values, HDR style.
+//
+// Every power of two is split into HISTOGRAM_SUB_BUCKETS equal buckets, so
+// any recorded value is known within 1/HISTOGRAM_SUB_BUCKETS of itself, from
+// nanoseconds to hours, in a fixed 2 KiB without allocating.
+//
+//     histogram_record(&handler_ns, end - begin); // the owning thread
+//     histogram_quantile(&handler_ns, 0.99);      // any thread
+//
+// One thread records, others may read at any time. Reads are not a consistent
+// snapshot, a concurrent record may be seen in `count` but not in `buckets`.
+//
+
+#include <stdint.h>
+#include "util/base.h"
+
+#define HISTOGRAM_SUB_BITS    2
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS     ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct histogram {
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t sum; // wraps, like a prometheus counter
+	uint64_t max;
+};
+
+// the owning thread only.
+void     histogram_record(struct histogram *, uint64_t value);
+// adds a histogram written by another thread.
+void     histogram_merge(struct histogram *into, const struct histogram *from);
+
+int      histogram_bucket_of(uint64_t value);
+// the smallest value of the next bucket, UINT64_MAX for the last one.
+uint64_t histogram_bucket_end(int bucket);
+// values recorded below `end`, which should be a bucket end.
+uint64_t histogram_count_below(const struct histogram *, uint64_t end);
+// an upper bound of the value at quantile `q` in [0, 1], 0 if empty.
+uint64_t histogram_quantile(const struct histogram *, double q);
+
+#endif
@@ -0,0 +1,316 @@
+#include "util/logring.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a bounded queue with a sequence number per entry: writers claim entries by
+// moving `head`, the reader may take an entry once its writer published it.
+
+enum length {
+	LENGTH_NONE,
+	LENGTH_HH, LENGTH_H,
+	LENGTH_L, LENGTH_LL,
+	LENGTH_Z, LENGTH_J, LENGTH_T,
+	LENGTH_LONG_DOUBLE,
+};
+
+struct spec {
+	const char *begin;
+	usize len;         // of the whole spec, including '%'
+	enum length length;
+	char conversion;   // '\0' for incomplete specs
+};
+
+static const char *parse_spec(const char *p, struct spec *spec);
+
+void logring_init(struct logring *ring, usize capacity) {
+	assert(ring != NULL);
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "has to be a power of two");
+	memset(ring, 0, sizeof(*ring));
+	ring->entries = malloc(sizeof(struct logring_entry) * capacity);
+	ring->capacity = capacity;
+	ring->level = LOGRING_DEBUG;
+	for (usize i = 0; i < capacity; ++i) {
+		ring->entries[i].sequence = i;
+	}
+}
+
+void logring_destroy(struct logring *ring) {
+	assert(ring != NULL);
+	free(ring->entries);
+	ring->entries = NULL;
+	ring->capacity = 0;
+}
+
+int logring_write(struct logring *ring, enum logring_level level, const char *fmt, ...) {
+	assert(ring != NULL);
+	assert(fmt != NULL);
+	if (level < __atomic_load_n(&ring->level, __ATOMIC_RELAXED)) {
+		return 0;
+	}
+
+	// claim an entry
+	struct logring_entry *entry;
+	usize pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	for (;;) {
+		entry = &ring->entries[pos & (ring->capacity - 1)];
+		const usize sequence = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+		const isize diff = (isize)sequence - (isize)pos;
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+			// `pos` was updated to the current head, retry
+		} else if (diff < 0) {
+			// the reader hasn't freed this entry yet, the ring is full
+			__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return 1;
+		} else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	// capture the arguments, the reader formats them
+	entry->level = level;
+	entry->fmt = fmt;
+	clock_gettime(CLOCK_REALTIME, &entry->time);
+
+	va_list args;
+	va_start(args, fmt);
+	usize args_len = 0;
+	usize strings_len = 0;
+	const char *p = fmt;
+	while (*p != '\0' && args_len < LOGRING_ARGS_MAX) {
+		if (*p != '%') {
+			++p;
+			continue;
+		}
+		struct spec spec;
+		p = parse_spec(p, &spec);
+
+		union logring_arg *arg = &entry->args[args_len];
+		switch (spec.conversion) {
+		case 'd': case 'i':
+			switch (spec.length) {
+			case LENGTH_L:  arg->u = (uint64_t)va_arg(args, long); break;
+			case LENGTH_LL: arg->u = (uint64_t)va_arg(args, long long); break;
+			case LENGTH_Z:  arg->u = (uint64_t)va_arg(args, size_t); break;
+			case LENGTH_J:  arg->u = (uint64_t)va_arg(args, intmax_t); break;
+			case LENGTH_T:  arg->u = (uint64_t)va_arg(args, ptrdiff_t); break;
+			case LENGTH_NONE: case LENGTH_HH: case LENGTH_H: case LENGTH_LONG_DOUBLE:
+				arg->u = (uint64_t)va_arg(args, int); break;
+			}
+			++args_len;
+			break;
+		case 'u': case 'o': case 'x': case 'X': case 'c':
+			switch (spec.length) {
+			case LENGTH_L:  arg->u = va_arg(args, unsigned long); break;
+			case LENGTH_LL: arg->u = va_arg(args, unsigned long long); break;
+			case LENGTH_Z:  arg->u = va_arg(args, size_t); break;
+			case LENGTH_J:  arg->u = va_arg(args, uintmax_t); break;
+			case LENGTH_T:  arg->u = (uint64_t)va_arg(args, ptrdiff_t); break;
+			case LENGTH_NONE: case LENGTH_HH: case LENGTH_H: case LENGTH_LONG_DOUBLE:
+				arg->u = va_arg(args, unsigned int); break;
+			}
+			++args_len;
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			arg->f = (spec.length == LENGTH_LONG_DOUBLE) ? (double)va_arg(args, long double) : va_arg(args, double);
+			++args_len;
+			break;
+		case 'p':
+			arg->p = va_arg(args, void *);
+			++args_len;
+			break;
+		case 's': {
+			const char *str = va_arg(args, const char *);
+			if (str == NULL) {
+				str = "(null)";
+			}
+			// cut to what is left, every string keeps its terminator
+			const usize left = LOGRING_STRINGS_MAX - strings_len;
+			const usize str_len = left > 0 ? strnlen(str, left - 1) : 0;
+			arg->s = (left > 0) ? strings_len : LOGRING_STRINGS_MAX - 1;
+			if (left > 0) {
+				memcpy(&entry->strings[strings_len], str, str_len);
+				entry->strings[strings_len + str_len] = '\0';
+				strings_len += str_len + 1;
+			}
+			++args_len;
+			break;
+		}
+		default:
+			// "%%" and specs we don't know, the reader copies those
+			break;
+		}
+	}
+	va_end(args);
+
+	// publish
+	__atomic_store_n(&entry->sequence, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+// every spec is formatted on its own, with the argument type it was captured as.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+usize logring_drain(struct logring *ring, logring_sink_fn sink, void *userdata) {
+	assert(ring != NULL);
+	assert(sink != NULL);
+
+	usize drained = 0;
+	for (;;) {
+		struct logring_entry *entry = &ring->entries[ring->tail & (ring->capacity - 1)];
+		const usize sequence = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+		if (sequence != ring->tail + 1) {
+			return drained; // empty, or the writer isn't done yet
+		}
+
+		char message[LOGRING_MESSAGE_MAX];
+		usize message_len = 0;
+		usize args_len = 0;
+		const char *p = entry->fmt;
+		while (*p != '\0' && message_len < sizeof(message) - 1) {
+			const char *literal = p;
+			while (*p != '\0' && *p != '%') {
+				++p;
+			}
+			if (p > literal) {
+				int written = snprintf(&message[message_len], sizeof(message) - message_len, "%.*s", (int)(p - literal), literal);
+				message_len += (usize)written;
+				continue;
+			}
+
+			struct spec spec;
+			p = parse_spec(p, &spec);
+			char spec_fmt[32];
+			snprintf(spec_fmt, sizeof(spec_fmt), "%.*s", (int)spec.len, spec.begin);
+			char *out = &message[message_len];
+			const usize out_len = sizeof(message) - message_len;
+			const union logring_arg *arg = &entry->args[args_len];
+			int written = 0;
+
+			// same order and conditions as in logring_write(), specs past the last captured argument are copied
+			const int has_arg = (args_len < LOGRING_ARGS_MAX || spec.conversion == '%');
+			switch (has_arg ? spec.conversion : '\0') {
+			case 'd': case 'i':
+				switch (spec.length) {
+				case LENGTH_L:  written = snprintf(out, out_len, spec_fmt, (long)arg->u); break;
+				case LENGTH_LL: written = snprintf(out, out_len, spec_fmt, (long long)arg->u); break;
+				case LENGTH_Z:  written = snprintf(out, out_len, spec_fmt, (size_t)arg->u); break;
+				case LENGTH_J:  written = snprintf(out, out_len, spec_fmt, (intmax_t)arg->u); break;
+				case LENGTH_T:  written = snprintf(out, out_len, spec_fmt, (ptrdiff_t)arg->u); break;
+				case LENGTH_NONE: case LENGTH_HH: case LENGTH_H: case LENGTH_LONG_DOUBLE:
+					written = snprintf(out, out_len, spec_fmt, (int)arg->u); break;
+				}
+				++args_len;
+				break;
+			case 'u': case 'o': case 'x': case 'X': case 'c':
+				switch (spec.length) {
+				case LENGTH_L:  written = snprintf(out, out_len, spec_fmt, (unsigned long)arg->u); break;
+				case LENGTH_LL: written = snprintf(out, out_len, spec_fmt, (unsigned long long)arg->u); break;
+				case LENGTH_Z:  written = snprintf(out, out_len, spec_fmt, (size_t)arg->u); break;
+				case LENGTH_J:  written = snprintf(out, out_len, spec_fmt, (uintmax_t)arg->u); break;
+				case LENGTH_T:  written = snprintf(out, out_len, spec_fmt, (ptrdiff_t)arg->u); break;
+				case LENGTH_NONE: case LENGTH_HH: case LENGTH_H: case LENGTH_LONG_DOUBLE:
+					written = snprintf(out, out_len, spec_fmt, (unsigned int)arg->u); break;
+				}
+				++args_len;
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+				if (spec.length == LENGTH_LONG_DOUBLE) {
+					written = snprintf(out, out_len, spec_fmt, (long double)arg->f);
+				} else {
+					written = snprintf(out, out_len, spec_fmt, arg->f);
+				}
+				++args_len;
+				break;
+			case 'p':
+				written = snprintf(out, out_len, spec_fmt, arg->p);
+				++args_len;
+				break;
+			case 's':
+				written = snprintf(out, out_len, spec_fmt, &entry->strings[arg->s]);
+				++args_len;
+				break;
+			case '%':
+				written = snprintf(out, out_len, "%%");
+				break;
+			default:
+				written = snprintf(out, out_len, "%s", spec_fmt);
+				break;
+			}
+			message_len += (written > 0) ? (usize)written : 0;
+		}
+		if (message_len >= sizeof(message)) {
+			message_len = sizeof(message) - 1;
+		}
+		message[message_len] = '\0';
+
+		const enum logring_level level = entry->level;
+		const struct timespec time = entry->time;
+		// free the entry before the sink runs, writers can use it again
+		__atomic_store_n(&entry->sequence, ring->tail + ring->capacity, __ATOMIC_RELEASE);
+		++ring->tail;
+		++drained;
+
+		sink(level, &time, message, userdata);
+	}
+}
+#pragma GCC diagnostic pop
+
+usize logring_dropped(struct logring *ring) {
+	assert(ring != NULL);
+	return __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+}
+
+const char *logring_level_name(enum logring_level level) {
+	switch (level) {
+	case LOGRING_DEBUG: return "debug";
+	case LOGRING_INFO:  return "info";
+	case LOGRING_WARN:  return "warn";
+	case LOGRING_ERROR: return "error";
+	}
+	return "unknown";
+}
+
+//
+// private implementations
+//
+
+static const char *parse_spec(const char *p, struct spec *spec) {
+	assert(*p == '%');
+	spec->begin = p++;
+	spec->length = LENGTH_NONE;
+	spec->conversion = '\0';
+
+	// flags, width and precision
+	while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) {
+		++p;
+	}
+
+	switch (*p) {
+	case 'h': spec->length = (p[1] == 'h') ? LENGTH_HH : LENGTH_H; p += (p[1] == 'h') ? 2 : 1; break;
+	case 'l': spec->length = (p[1] == 'l') ? LENGTH_LL : LENGTH_L; p += (p[1] == 'l') ? 2 : 1; break;
+	case 'z': spec->length = LENGTH_Z; ++p; break;
+	case 'j': spec->length = LENGTH_J; ++p; break;
+	case 't': spec->length = LENGTH_T; ++p; break;
+	case 'L': spec->length = LENGTH_LONG_DOUBLE; ++p; break;
+	default: break;
+	}
+
+	if (*p != '\0' && strchr("diuoxXcfFeEgGaAps%", *p) != NULL) {
+		spec->conversion = *p++;
+	} else if (*p != '\0') {
+		++p; // unsupported, e.g. '*' or 'n'
+	}
+	spec->len = p - spec->begin;
+	if (spec->len >= 32) {
+		spec->conversion = '\0';
+	}
+	return p;
+}
@@ -0,0 +1,73 @@
+#ifndef UTIL_LOGRING_H
+#define UTIL_LOGRING_H
+
+//
+// Lock-free log for many writer threads and one reader.
+//
+// Writers only capture the format string and its arguments, formatting
+// happens on the reader when it drains the ring. Writing never blocks or
+// allocates: when the reader falls behind, new entries are dropped and counted.
+//
+//     logring_write(&ring, LOGRING_INFO, "client %u sent %zu bytes", id, len); // any thread
+//     logring_drain(&ring, print_entry, NULL);                                 // one thread
+//
+// The format string has to outlive the entry, use literals. %s arguments are
+// copied, up to LOGRING_STRINGS_MAX bytes per entry. Supported are the printf
+// conversions with flags, width, precision and length modifiers, but no `*`.
+//
+
+#include <stdint.h>
+#include <time.h>
+#include "util/base.h"
+
+#define LOGRING_ARGS_MAX    8
+#define LOGRING_STRINGS_MAX 128
+#define LOGRING_MESSAGE_MAX 512 // formatted, longer messages are cut
+
+enum logring_level {
+	LOGRING_DEBUG,
+	LOGRING_INFO,
+	LOGRING_WARN,
+	LOGRING_ERROR,
+};
+
+union logring_arg {
+	uint64_t u;
+	double f;
+	const void *p;
+	uint16_t s; // offset of a copied string in `strings`
+};
+
+struct logring_entry {
+	usize sequence; // ring protocol
+	enum logring_level level;
+	struct timespec time;
+	const char *fmt;
+	union logring_arg args[LOGRING_ARGS_MAX];
+	char strings[LOGRING_STRINGS_MAX];
+};
+
+struct logring {
+	struct logring_entry *entries;
+	usize capacity; // power of two
+	usize head;     // next entry to write, shared by the writers
+	usize tail;     // next entry to read, reader only
+	usize dropped;  // entries which didn't fit, read with logring_dropped()
+	enum logring_level level; // entries below are ignored
+};
+
+typedef void (*logring_sink_fn)(enum logring_level, const struct timespec *time, const char *message, void *userdata);
+
+void logring_init(struct logring *, usize capacity);
+void logring_destroy(struct logring *);
+
+// any thread. returns 1 if the entry was dropped.
+int  logring_write(struct logring *, enum logring_level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+// the reader thread. formats and hands every entry written so far to `sink`, returns how many.
+usize logring_drain(struct logring *, logring_sink_fn sink, void *userdata);
+// entries dropped since the last call.
+usize logring_dropped(struct logring *);
+
+const char *logring_level_name(enum logring_level);
+
+#endif
@@ -0,0 +1,333 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <SDL.h>
+#include <nanovg.h>
+#include "engine.h"
+
+//
+// private functions
+//
+
+static double ticks_to_ms(Uint64 ticks);
+static struct profiler_stats *profiler_stats_find(const char *name);
+static struct profiler_stats *profiler_stats_get(const char *name);
+static void profiler_update_stats(const struct profiler_frame *frame, int frame_index);
+static NVGcolor color_for_name(const char *name);
+
+//
+// vars
+//
+
+static struct {
+	int enabled;
+	double ms_per_tick;
+
+	// frames ring buffer, `current` is being recorded
+	struct profiler_frame frames[PROFILER_FRAMES_MAX];
+	int current;
+	int recorded;
+	int is_recording;
+
+	// open scopes, -1 for scopes which were dropped because the frame was full
+	int stack[PROFILER_DEPTH_MAX];
+	int stack_len;
+
+	struct profiler_stats stats[PROFILER_NAMES_MAX];
+	int stats_count;
+} g_profiler;
+
+//
+// public api
+//
+
+void profiler_set_enabled(int enabled) {
+	if (enabled && !g_profiler.enabled) {
+		// start over, so we don't mix old and new frames
+		g_profiler.current = 0;
+		g_profiler.recorded = 0;
+		g_profiler.is_recording = 0;
+		g_profiler.stack_len = 0;
+		g_profiler.stats_count = 0;
+		g_profiler.ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+	}
+	g_profiler.enabled = enabled;
+}
+
+int profiler_is_enabled(void) {
+	return g_profiler.enabled;
+}
+
+void profiler_frame_begin(void) {
+	if (!g_profiler.enabled) {
+		return;
+	}
+
+	struct profiler_frame *frame = &g_profiler.frames[g_profiler.current];
+	frame->begin = frame->end = SDL_GetPerformanceCounter();
+	frame->scopes_count = 0;
+	g_profiler.stack_len = 0;
+	g_profiler.is_recording = 1;
+}
+
+void profiler_frame_end(void) {
+	if (!g_profiler.enabled || !g_profiler.is_recording) {
+		return;
+	}
+
+	struct profiler_frame *frame = &g_profiler.frames[g_profiler.current];
+	frame->end = SDL_GetPerformanceCounter();
+
+	// close scopes which were left open
+	while (g_profiler.stack_len > 0) {
+		const int i = g_profiler.stack[--g_profiler.stack_len];
+		if (i >= 0) {
+			frame->scopes[i].end = frame->end;
+		}
+	}
+
+	profiler_update_stats(frame, g_profiler.current);
+
+	g_profiler.current = (g_profiler.current + 1) % PROFILER_FRAMES_MAX;
+	if (g_profiler.recorded < PROFILER_FRAMES_MAX) {
+		++g_profiler.recorded;
+	}
+	g_profiler.is_recording = 0;
+}
+
+void profiler_scope_begin(const char *name) {
+	if (!g_profiler.enabled || !g_profiler.is_recording) {
+		return;
+	}
+	if (g_profiler.stack_len >= PROFILER_DEPTH_MAX) {
+		assert(0 && "profiler scopes nested too deep, missing profiler_scope_end()?");
+		return;
+	}
+
+	struct profiler_frame *frame = &g_profiler.frames[g_profiler.current];
+	int index = -1;
+	if (frame->scopes_count < PROFILER_SCOPES_MAX) {
+		index = frame->scopes_count++;
+		frame->scopes[index] = (struct profiler_scope) {
+			.name = name,
+			.begin = SDL_GetPerformanceCounter(),
+			.end = 0,
+			.depth = g_profiler.stack_len,
+		};
+	}
+	g_profiler.stack[g_profiler.stack_len++] = index;
+}
+
+void profiler_scope_end(void) {
+	if (!g_profiler.enabled || !g_profiler.is_recording || g_profiler.stack_len == 0) {
+		return;
+	}
+
+	const int index = g_profiler.stack[--g_profiler.stack_len];
+	if (index >= 0) {
+		g_profiler.frames[g_profiler.current].scopes[index].end = SDL_GetPerformanceCounter();
+	}
+}
+
+const struct profiler_frame *profiler_last_frame(void) {
+	if (g_profiler.recorded == 0) {
+		return NULL;
+	}
+	return &g_profiler.frames[(g_profiler.current + PROFILER_FRAMES_MAX - 1) % PROFILER_FRAMES_MAX];
+}
+
+const struct profiler_stats *profiler_find_stats(const char *name) {
+	return profiler_stats_find(name);
+}
+
+void profiler_draw(struct engine *engine) {
+	const struct profiler_frame *frame = profiler_last_frame();
+	if (!g_profiler.enabled || frame == NULL) {
+		return;
+	}
+
+	NVGcontext *vg = engine->vg;
+	const float pad = 6.0f;
+	const float x = pad;
+	const float w = engine->window_width - pad * 2.0f;
+	const float graph_h = 40.0f;
+	const float row_h = 14.0f;
+	const float line_h = 12.0f;
+
+	int depth_max = 0;
+	for (int i = 0; i < frame->scopes_count; ++i) {
+		depth_max = glm_max(depth_max, frame->scopes[i].depth);
+	}
+	const float flame_h = (depth_max + 1) * row_h;
+	const float panel_h = pad + graph_h + pad + flame_h + pad + (g_profiler.stats_count + 1) * line_h + pad;
+
+	nvgSave(vg);
+	nvgFontFaceId(vg, engine->font_monospace);
+	nvgFontBlur(vg, 0.0f);
+	nvgFontSize(vg, 10.0f);
+	nvgTextLetterSpacing(vg, 0.0f);
+	nvgTextAlign(vg, NVG_ALIGN_TOP | NVG_ALIGN_LEFT);
+
+	// background
+	nvgBeginPath(vg);
+	nvgRect(vg, 0.0f, 0.0f, engine->window_width, panel_h);
+	nvgFillColor(vg, nvgRGBAf(0.0f, 0.0f, 0.0f, 0.75f));
+	nvgFill(vg);
+
+	// frame times, oldest to newest. full height is 33.3ms, the line marks 60 fps.
+	float y = pad;
+	const float bar_w = w / PROFILER_FRAMES_MAX;
+	const int oldest = (g_profiler.recorded < PROFILER_FRAMES_MAX) ? 0 : g_profiler.current;
+	for (int i = 0; i < g_profiler.recorded; ++i) {
+		const struct profiler_frame *f = &g_profiler.frames[(oldest + i) % PROFILER_FRAMES_MAX];
+		const float ms = ticks_to_ms(f->end - f->begin);
+		const float h = glm_min(ms / 33.3f, 1.0f) * graph_h;
+
+		nvgBeginPath(vg);
+		nvgRect(vg, x + i * bar_w, y + graph_h - h, glm_max(bar_w - 1.0f, 1.0f), h);
+		nvgFillColor(vg, ms <= 16.7f ? nvgRGBf(0.3f, 0.8f, 0.3f) : nvgRGBf(0.9f, 0.3f, 0.2f));
+		nvgFill(vg);
+	}
+	nvgBeginPath(vg);
+	nvgMoveTo(vg, x, y + graph_h * 0.5f);
+	nvgLineTo(vg, x + w, y + graph_h * 0.5f);
+	nvgStrokeColor(vg, nvgRGBAf(1.0f, 1.0f, 1.0f, 0.5f));
+	nvgStrokeWidth(vg, 1.0f);
+	nvgStroke(vg);
+
+	// flame graph of the last frame
+	y += graph_h + pad;
+	const float frame_ms = glm_max(ticks_to_ms(frame->end - frame->begin), 0.001f);
+	const float px_per_ms = w / frame_ms;
+	for (int i = 0; i < frame->scopes_count; ++i) {
+		const struct profiler_scope *s = &frame->scopes[i];
+		const float bx = x + ticks_to_ms(s->begin - frame->begin) * px_per_ms;
+		const float bw = glm_max(ticks_to_ms(s->end - s->begin) * px_per_ms, 1.0f);
+		const float by = y + s->depth * row_h;
+
+		nvgBeginPath(vg);
+		nvgRect(vg, bx, by, bw, row_h - 1.0f);
+		nvgFillColor(vg, color_for_name(s->name));
+		nvgFill(vg);
+
+		if (bw > 24.0f) {
+			nvgScissor(vg, bx, by, bw, row_h);
+			nvgFillColor(vg, nvgRGBf(0.0f, 0.0f, 0.0f));
+			nvgText(vg, bx + 2.0f, by + 2.0f, s->name, NULL);
+			nvgResetScissor(vg);
+		}
+	}
+
+	// per scope statistics over the recorded frames
+	y += flame_h + pad;
+	char line[128];
+	nvgFillColor(vg, nvgRGBf(1.0f, 1.0f, 0.0f));
+	snprintf(line, sizeof(line), "%-32s %8s %8s %8s   (frame %.2fms)", "scope", "avg", "min", "max", frame_ms);
+	nvgText(vg, x, y, line, NULL);
+	nvgFillColor(vg, nvgRGBf(1.0f, 1.0f, 1.0f));
+	for (int i = 0; i < g_profiler.stats_count; ++i) {
+		const struct profiler_stats *s = &g_profiler.stats[i];
+		y += line_h;
+		snprintf(line, sizeof(line), "%-32.32s %8.3f %8.3f %8.3f", s->name, s->avg, s->min, s->max);
+		nvgText(vg, x, y, line, NULL);
+	}
+
+	nvgRestore(vg);
+}
+
+int profiler_export_chrome_trace(const char *filename) {
+	FILE *f = fopen(filename, "w");
+	if (f == NULL) {
+		return 1;
+	}
+
+	// timestamps are in microseconds, relative to the oldest recorded frame
+	const int oldest = (g_profiler.recorded < PROFILER_FRAMES_MAX) ? 0 : g_profiler.current;
+	const Uint64 t0 = g_profiler.frames[oldest].begin;
+	const char *separator = "";
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (int i = 0; i < g_profiler.recorded; ++i) {
+		const struct profiler_frame *frame = &g_profiler.frames[(oldest + i) % PROFILER_FRAMES_MAX];
+		fprintf(f, "%s\n{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+				separator, ticks_to_ms(frame->begin - t0) * 1000.0, ticks_to_ms(frame->end - frame->begin) * 1000.0);
+		separator = ",";
+
+		for (int j = 0; j < frame->scopes_count; ++j) {
+			const struct profiler_scope *s = &frame->scopes[j];
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+					s->name, ticks_to_ms(s->begin - t0) * 1000.0, ticks_to_ms(s->end - s->begin) * 1000.0);
+		}
+	}
+	fprintf(f, "\n]}\n");
+
+	return (fclose(f) == 0) ? 0 : 1;
+}
+
+//
+// private implementations
+//
+
+static double ticks_to_ms(Uint64 ticks) {
+	return ticks * g_profiler.ms_per_tick;
+}
+
+static struct profiler_stats *profiler_stats_find(const char *name) {
+	for (int i = 0; i < g_profiler.stats_count; ++i) {
+		if (g_profiler.stats[i].name == name || strcmp(g_profiler.stats[i].name, name) == 0) {
+			return &g_profiler.stats[i];
+		}
+	}
+	return NULL;
+}
+
+static struct profiler_stats *profiler_stats_get(const char *name) {
+	struct profiler_stats *stats = profiler_stats_find(name);
+	if (stats == NULL && g_profiler.stats_count < PROFILER_NAMES_MAX) {
+		stats = &g_profiler.stats[g_profiler.stats_count++];
+		memset(stats, 0, sizeof(*stats));
+		stats->name = name;
+	}
+	return stats;
+}
+
+static void profiler_update_stats(const struct profiler_frame *frame, int frame_index) {
+	for (int i = 0; i < g_profiler.stats_count; ++i) {
+		g_profiler.stats[i].ms[frame_index] = 0.0f;
+	}
+
+	// sum up the time per name. nested scopes of the same name are counted twice.
+	for (int i = 0; i < frame->scopes_count; ++i) {
+		const struct profiler_scope *s = &frame->scopes[i];
+		struct profiler_stats *stats = profiler_stats_get(s->name);
+		if (stats != NULL) {
+			stats->ms[frame_index] += ticks_to_ms(s->end - s->begin);
+		}
+	}
+
+	// frames fill the ring buffer from index 0, so these are all valid
+	const int frames_count = glm_min(g_profiler.recorded + 1, PROFILER_FRAMES_MAX);
+	for (int i = 0; i < g_profiler.stats_count; ++i) {
+		struct profiler_stats *stats = &g_profiler.stats[i];
+		stats->min = stats->max = stats->ms[0];
+		float sum = 0.0f;
+		for (int j = 0; j < frames_count; ++j) {
+			stats->min = glm_min(stats->min, stats->ms[j]);
+			stats->max = glm_max(stats->max, stats->ms[j]);
+			sum += stats->ms[j];
+		}
+		stats->avg = sum / frames_count;
+	}
+}
+
+static NVGcolor color_for_name(const char *name) {
+	// FNV-1a, so a scope keeps its color across frames
+	uint32_t h = 2166136261u;
+	for (const char *c = name; *c != '\0'; ++c) {
+		h = (h ^ (uint8_t)*c) * 16777619u;
+	}
+	return nvgHSL((h % 360) / 360.0f, 0.55f, 0.6f);
+}
+
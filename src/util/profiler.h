@@ -0,0 +1,76 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <SDL.h>
+
+//
+// Hierarchical frame profiler.
+//
+// Scopes are recorded per frame into a ring buffer of the last
+// PROFILER_FRAMES_MAX frames. Per scope name, the time spent each frame is
+// tracked to show min/avg/max in the overlay. Main thread only.
+//
+// usage:
+//   profiler_scope_begin("physics");
+//   ...
+//   profiler_scope_end();
+//
+// or for a block, which must not be left through return/break/goto:
+//   PROFILER_SCOPE("physics") {
+//       ...
+//   }
+//
+// Names are not copied, they have to outlive the profiler (string literals).
+// Toggle with F3 in-game, F4 writes a Chrome trace (chrome://tracing, Perfetto).
+//
+
+#define PROFILER_FRAMES_MAX 120
+#define PROFILER_SCOPES_MAX 256 // per frame
+#define PROFILER_DEPTH_MAX  16
+#define PROFILER_NAMES_MAX  64  // distinct scope names with statistics
+
+#define PROFILER_SCOPE(name) \
+	for (int __profiler_once = (profiler_scope_begin(name), 1); __profiler_once; __profiler_once = 0, profiler_scope_end())
+
+// ecs_run() inside a scope named after the system
+#define PROFILER_ECS_RUN(world, system, dt, param) \
+	do { profiler_scope_begin(#system); ecs_run(world, ecs_id(system), dt, param); profiler_scope_end(); } while (0)
+
+struct engine;
+
+struct profiler_scope {
+	const char *name;
+	Uint64 begin, end;
+	int depth;
+};
+
+struct profiler_frame {
+	Uint64 begin, end;
+	int scopes_count;
+	struct profiler_scope scopes[PROFILER_SCOPES_MAX];
+};
+
+struct profiler_stats {
+	const char *name;
+	float ms[PROFILER_FRAMES_MAX]; // total per frame, same index as the frames
+	float min, avg, max;
+};
+
+void profiler_set_enabled(int enabled);
+int  profiler_is_enabled(void);
+
+void profiler_frame_begin(void);
+void profiler_frame_end(void);
+
+void profiler_scope_begin(const char *name);
+void profiler_scope_end(void);
+
+// last completed frame, NULL if none was recorded yet.
+const struct profiler_frame *profiler_last_frame(void);
+const struct profiler_stats *profiler_find_stats(const char *name);
+
+void profiler_draw(struct engine *);
+int  profiler_export_chrome_trace(const char *filename);
+
+#endif
+
@@ -0,0 +1,77 @@
+#include "rng.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+static struct rng_state rng_state = {
+	.s0 = 1234567890987654321ULL,
+	.s1 = 9876543210123456789ULL,
+};
+
+static uint64_t splitmix64(uint64_t *x) {
+	uint64_t z = (*x += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+static uint64_t xorshift128plus(struct rng_state *state) {
+	uint64_t x = state->s0;
+	uint64_t y = state->s1;
+	state->s0 = y;
+	x ^= x << 23;
+	state->s1 = x ^ y ^ (x >> 17) ^ (y >> 26);
+	return state->s1 + y;
+}
+
+/**
+ * Generate a random float in range [0..1]
+ */
+float rng_f(void) {
+	return rng_state_f(&rng_state);
+}
+
+int rng_i(void) {
+	return rng_state_i(&rng_state);
+}
+
+/**
+ * Generate a random float in range [0..1] using
+ * an approximated normal/gaussian distribution.
+ */
+float rng_fnd(void) {
+	const int iters = 12;
+	float sum = 0.0f;
+	for (int i = 0; i < iters; ++i) {
+		sum += rng_f();
+	}
+	return (sum / iters);
+}
+
+void rng_seed(uint64_t seed) {
+	rng_state_seed(&rng_state, seed);
+}
+
+void rng_save_state(struct rng_state *state) {
+	assert(state != NULL);
+	*state = rng_state;
+}
+
+void rng_restore_state(struct rng_state *state) {
+	rng_state = *state;
+}
+
+void rng_state_seed(struct rng_state *state, uint64_t seed) {
+	assert(state != NULL);
+	state->s0 = seed;
+	state->s1 = splitmix64(&state->s0);
+	state->s0 = splitmix64(&state->s0);
+}
+
+int rng_state_i(struct rng_state *state) {
+	return (int)(xorshift128plus(state) & 0x7FFFFFFF);
+}
+
+float rng_state_f(struct rng_state *state) {
+	return (float)((xorshift128plus(state) >> 11) * (1.0 / 9007199254740992.0));
+}
@@ -0,0 +1,28 @@
+#ifndef UTIL_RNG_H
+#define UTIL_RNG_H
+
+#include <stdint.h>
+
+// random numbers
+
+struct rng_state {
+	uint64_t s0;
+	uint64_t s1;
+};
+
+// global generator, main thread only.
+int   rng_i(void);
+float rng_f(void);
+float rng_fnd(void);
+void  rng_seed(uint64_t seed);
+
+void  rng_save_state(struct rng_state *);
+void  rng_restore_state(struct rng_state *);
+
+// explicit state, for code running on other threads
+// or anything that has to be reproducible on its own.
+void  rng_state_seed(struct rng_state *, uint64_t seed);
+int   rng_state_i(struct rng_state *);
+float rng_state_f(struct rng_state *);
+
+#endif
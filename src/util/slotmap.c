@@ -0,0 +1,92 @@
+#include "util/slotmap.h"
+
+#include <assert.h>
+#include <string.h>
+#include <stb_ds.h>
+
+#define SLOT_MASK       (SLOTMAP_CAPACITY - 1)
+#define GENERATION_MASK ((1u << SLOTMAP_GENERATION_BITS) - 1)
+
+static uint32_t make_id(uint32_t slot, uint32_t generation) {
+	return (generation << SLOTMAP_SLOT_BITS) | slot;
+}
+
+void slotmap_init(struct slotmap *map) {
+	assert(map != NULL);
+	memset(map, 0, sizeof(*map));
+	map->free_slot = SLOTMAP_CAPACITY;
+}
+
+void slotmap_destroy(struct slotmap *map) {
+	assert(map != NULL);
+	arrfree(map->items);
+	arrfree(map->item_ids);
+	arrfree(map->slots);
+	map->free_slot = SLOTMAP_CAPACITY;
+}
+
+uint32_t slotmap_insert(struct slotmap *map, void *item) {
+	assert(map != NULL);
+	assert(item != NULL);
+
+	uint32_t slot = map->free_slot;
+	if (slot != SLOTMAP_CAPACITY) {
+		map->free_slot = map->slots[slot].index;
+	} else if (arrlenu(map->slots) < SLOTMAP_CAPACITY) {
+		slot = arrlenu(map->slots);
+		// generation 0 is skipped, so no id is 0
+		arrput(map->slots, ((struct slotmap_slot){ .generation = 1 }));
+	} else {
+		return 0;
+	}
+
+	const uint32_t id = make_id(slot, map->slots[slot].generation);
+	map->slots[slot].index = arrlenu(map->items);
+	arrput(map->items, item);
+	arrput(map->item_ids, id);
+	return id;
+}
+
+void *slotmap_get(const struct slotmap *map, uint32_t id) {
+	assert(map != NULL);
+	const uint32_t slot = id & SLOT_MASK;
+	const uint32_t generation = (id >> SLOTMAP_SLOT_BITS) & GENERATION_MASK;
+	if (slot >= arrlenu(map->slots) || map->slots[slot].generation != generation) {
+		return NULL;
+	}
+	// free slots hold the next free slot instead
+	const uint32_t index = map->slots[slot].index;
+	if (index >= arrlenu(map->items) || map->item_ids[index] != id) {
+		return NULL;
+	}
+	return map->items[index];
+}
+
+void *slotmap_remove(struct slotmap *map, uint32_t id) {
+	void *item = slotmap_get(map, id);
+	if (item == NULL) {
+		return NULL;
+	}
+
+	// the last item moves into the gap
+	const uint32_t slot = id & SLOT_MASK;
+	const uint32_t index = map->slots[slot].index;
+	const uint32_t last_id = arrpop(map->item_ids);
+	void *last = arrpop(map->items);
+	if (index < arrlenu(map->items)) {
+		map->items[index] = last;
+		map->item_ids[index] = last_id;
+		map->slots[last_id & SLOT_MASK].index = index;
+	}
+
+	uint32_t generation = (map->slots[slot].generation + 1) & GENERATION_MASK;
+	map->slots[slot].generation = (generation != 0) ? generation : 1;
+	map->slots[slot].index = map->free_slot;
+	map->free_slot = slot;
+	return item;
+}
+
+usize slotmap_len(const struct slotmap *map) {
+	assert(map != NULL);
+	return arrlenu(map->items);
+}
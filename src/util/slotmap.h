@@ -0,0 +1,51 @@
+#ifndef UTIL_SLOTMAP_H
+#define UTIL_SLOTMAP_H
+
+//
+// Generational slot map of pointers.
+//
+// Insert, lookup and removal are O(1). Items are kept dense in insertion
+// order until something is removed, the last item then takes its place:
+//
+//     for (usize i = 0; i < slotmap_len(&map); ++i) {
+//         do_something(map.items[i]);
+//     }
+//
+// Ids are a slot and the generation of that slot. Reusing a slot bumps its
+// generation, so ids of removed items don't find their successors.
+// They fit into SLOTMAP_ID_BITS, the bits above are free for the caller.
+// 0 is never an id.
+//
+
+#include <stdint.h>
+#include "util/base.h"
+
+#define SLOTMAP_SLOT_BITS       16
+#define SLOTMAP_GENERATION_BITS 10
+#define SLOTMAP_ID_BITS         (SLOTMAP_SLOT_BITS + SLOTMAP_GENERATION_BITS)
+#define SLOTMAP_CAPACITY        (1u << SLOTMAP_SLOT_BITS)
+
+struct slotmap_slot {
+	uint32_t generation;
+	uint32_t index; // in `items` while used, next free slot otherwise
+};
+
+struct slotmap {
+	void **items;        // stb_ds, dense
+	uint32_t *item_ids;  // stb_ds, the id of each item
+	struct slotmap_slot *slots; // stb_ds
+	uint32_t free_slot;  // head of the free list, SLOTMAP_CAPACITY if empty
+};
+
+void slotmap_init(struct slotmap *);
+void slotmap_destroy(struct slotmap *);
+
+// returns the new id, 0 if the map is full.
+uint32_t slotmap_insert(struct slotmap *, void *item);
+// returns NULL for unknown or removed ids.
+void    *slotmap_get(const struct slotmap *, uint32_t id);
+// returns the removed item, NULL for unknown ids.
+void    *slotmap_remove(struct slotmap *, uint32_t id);
+usize    slotmap_len(const struct slotmap *);
+
+#endif
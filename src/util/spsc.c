@@ -0,0 +1,57 @@
+#include "util/spsc.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// head and tail only grow, their difference is the number of queued items.
+// publishing an item is a release store of head, taking one an acquire load.
+
+void spsc_init(struct spsc_queue *queue, usize item_size, usize capacity) {
+	assert(queue != NULL);
+	assert(item_size > 0);
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "has to be a power of two");
+	memset(queue, 0, sizeof(*queue));
+	queue->items = malloc(item_size * capacity);
+	queue->item_size = item_size;
+	queue->capacity = capacity;
+}
+
+void spsc_destroy(struct spsc_queue *queue) {
+	assert(queue != NULL);
+	free(queue->items);
+	queue->items = NULL;
+}
+
+void *spsc_write_begin(struct spsc_queue *queue) {
+	const usize head = queue->head;
+	const usize tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	if (head - tail == queue->capacity) {
+		return NULL;
+	}
+	return &queue->items[(head & (queue->capacity - 1)) * queue->item_size];
+}
+
+void spsc_write_end(struct spsc_queue *queue) {
+	assert(queue->head - __atomic_load_n(&queue->tail, __ATOMIC_RELAXED) < queue->capacity);
+	__atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+void *spsc_read_begin(struct spsc_queue *queue) {
+	const usize tail = queue->tail;
+	const usize head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+	if (head == tail) {
+		return NULL;
+	}
+	return &queue->items[(tail & (queue->capacity - 1)) * queue->item_size];
+}
+
+void spsc_read_end(struct spsc_queue *queue) {
+	assert(queue->tail != __atomic_load_n(&queue->head, __ATOMIC_RELAXED));
+	__atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_RELEASE);
+}
+
+usize spsc_len(const struct spsc_queue *queue) {
+	const usize tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) - tail;
+}
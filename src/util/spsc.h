@@ -0,0 +1,43 @@
+#ifndef UTIL_SPSC_H
+#define UTIL_SPSC_H
+
+//
+// Lock-free queue between exactly one producer and one consumer thread.
+//
+// Items have a fixed size and are filled and read in place, nothing is copied:
+//
+//     struct job *job = spsc_write_begin(&queue); // producer, NULL if full
+//     job->... = ...;
+//     spsc_write_end(&queue);
+//
+//     struct job *job = spsc_read_begin(&queue);  // consumer, NULL if empty
+//     run(job);
+//     spsc_read_end(&queue);                      // the slot may be reused now
+//
+
+#include "util/base.h"
+
+#define SPSC_CACHE_LINE 64
+
+struct spsc_queue {
+	unsigned char *items;
+	usize item_size;
+	usize capacity; // power of two
+
+	// each side only writes its own index, a cache line apart
+	usize head; // next item to write
+	unsigned char _padding[SPSC_CACHE_LINE];
+	usize tail; // next item to read
+};
+
+void  spsc_init(struct spsc_queue *, usize item_size, usize capacity);
+void  spsc_destroy(struct spsc_queue *);
+
+void *spsc_write_begin(struct spsc_queue *);
+void  spsc_write_end(struct spsc_queue *);
+void *spsc_read_begin(struct spsc_queue *);
+void  spsc_read_end(struct spsc_queue *);
+// either side, may be outdated by the time it returns.
+usize spsc_len(const struct spsc_queue *);
+
+#endif
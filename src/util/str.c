@@ -5,7 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
-#include "util/util.h"
+#include "util/base.h"
 
 void str_free(char *c_string) {
 	free(c_string);
@@ -198,6 +198,21 @@ int is_argv_set(int argc, char **argv, char *arg_to_check) {
 	return 0;
 }
 
+const char *argv_value(int argc, char **argv, char *arg_to_check) {
+	if (arg_to_check[0] == '-') ++arg_to_check;
+	if (arg_to_check[0] == '-') ++arg_to_check;
+
+	int arg_to_check_len = strnlen(arg_to_check, 64);
+	for (int i = 1; i < argc; ++i) {
+		char *arg = argv[i];
+		int is_dashed_arg = (arg[0] == '-' && arg[1] == '-');
+		if (is_dashed_arg && strncmp(arg + 2, arg_to_check, arg_to_check_len) == 0 && arg[2 + arg_to_check_len] == '=') {
+			return arg + 2 + arg_to_check_len + 1;
+		}
+	}
+	return NULL;
+}
+
 
 // measure performance
 
@@ -212,66 +227,3 @@ double profile_end_ms(Uint64 begin) {
 	return seconds_elapsed * 1000.0;
 }
 
-
-// random numbers
-
-static struct rng_state rng_state = {
-	.s0 = 1234567890987654321ULL,
-	.s1 = 9876543210123456789ULL,
-};
-
-static uint64_t splitmix64(uint64_t *x) {
-	uint64_t z = (*x += 0x9e3779b97f4a7c15);
-	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
-	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
-	return z ^ (z >> 31);
-}
-
-static uint64_t xorshift128plus(void) {
-	uint64_t x = rng_state.s0;
-	uint64_t y = rng_state.s1;
-	rng_state.s0 = y;
-	x ^= x << 23;
-	rng_state.s1 = x ^ y ^ (x >> 17) ^ (y >> 26);
-	return rng_state.s1 + y;
-}
-
-/**
- * Generate a random float in range [0..1]
- */
-float rng_f(void) {
-	return (float)((xorshift128plus() >> 11) * (1.0 / 9007199254740992.0));
-}
-
-int rng_i(void) {
-	return (int)(xorshift128plus() & 0x7FFFFFFF);
-}
-
-/**
- * Generate a random float in range [0..1] using
- * an approximated normal/gaussian distribution.
- */
-float rng_fnd(void) {
-	const int iters = 12;
-	float sum = 0.0f;
-	for (int i = 0; i < iters; ++i) {
-		sum += rng_f();
-	}
-	return (sum / iters);
-}
-
-void rng_seed(uint64_t seed) {
-	rng_state.s0 = seed;
-	rng_state.s1 = splitmix64(&rng_state.s0);
-	rng_state.s0 = splitmix64(&rng_state.s0);
-}
-
-void rng_save_state(struct rng_state *state) {
-	assert(state != NULL);
-	*state = rng_state;
-}
-
-void rng_restore_state(struct rng_state *state) {
-	rng_state = *state;
-}
-
@@ -6,28 +6,13 @@
 #include <stddef.h>
 #include <cglm/types-struct.h>
 #include "input.h"
-
-// Int types, TODO: check if "fast" is just a meme.
-typedef uint_fast8_t   u8;
-typedef  int_fast8_t   i8;
-typedef uint_fast16_t u16;
-typedef  int_fast16_t i16;
-typedef uint_fast32_t u32;
-typedef  int_fast32_t i32;
-typedef uint_fast64_t u64;
-typedef  int_fast64_t i64;
-
-typedef unsigned char uchar;
-typedef unsigned int uint;
-typedef size_t usize;
-typedef i64 isize;
+#include "util/base.h"
+#include "util/rng.h"
 
 struct engine;
 struct camera;
 
 // defines
-#define UTIL_FOR(_i, max) for (size_t _i = 0; _i < max; ++_i)
-#define count_of(arr) (sizeof(arr) / sizeof(arr[0]))
 #define GL_CHECK_ERROR() gl_check_error(__FILE__, __LINE__)
 #define GL_CHECK_FRAMEBUFFER() gl_check_framebuffer(__FILE__, __LINE__)
 
@@ -37,32 +22,6 @@ struct camera;
 	 || (filter) == GL_LINEAR_MIPMAP_NEAREST  \
 	 || (filter) == GL_LINEAR_MIPMAP_LINEAR)
 
-// Data Structures
-
-#define RINGBUFFER(TYPE, NAME, CAPACITY) \
-	TYPE __buffer_##NAME[CAPACITY];                              \
-	struct { usize head, len, capacity; TYPE *items; } NAME = {  \
-		.head=0, .len=0, .capacity=CAPACITY, .items = (TYPE *)__buffer_##NAME };
-
-#define STATIC_RINGBUFFER(TYPE, NAME, CAPACITY) \
-	static TYPE __buffer_##NAME[CAPACITY];                              \
-	static struct { usize head, len, capacity; TYPE *items; } NAME = {  \
-		.head=0, .len=0, .capacity=CAPACITY, .items = (TYPE *)__buffer_##NAME };
-
-#define RINGBUFFER_APPEND(NAME, VALUE) \
-	do {                                                              \
-		NAME.items[(NAME.head + NAME.len) % NAME.capacity] = (VALUE); \
-		if (NAME.len < NAME.capacity) ++NAME.len;                     \
-	} while (0);
-
-#define RINGBUFFER_CONSUME(NAME) \
-	NAME.items[NAME.head];                           \
-	do {                                             \
-		NAME.items[NAME.head] = 0;                   \
-		NAME.head = (NAME.head + 1) % NAME.capacity; \
-		--NAME.len;                                  \
-	} while (0)
-
 // math
 int point_in_rect(float px, float py, float x, float y, float w, float h);
 int drag_in_rect(struct input_drag_s *, float x, float y, float w, float h);
@@ -85,6 +44,8 @@ int gl_check_framebuffer(const char *file, int line);
 
 // arg parsing
 int is_argv_set(int argc, char **argv, char *arg_to_check);
+// value of `--arg=value`, NULL if not set.
+const char *argv_value(int argc, char **argv, char *arg_to_check);
 
 // measure performance
 Uint64 profile_begin(void);
@@ -96,20 +57,5 @@ double profile_end_ms(Uint64 begin);
 #define PROFILE
 #endif
 
-// random numbers
-
-struct rng_state {
-	uint64_t s0;
-	uint64_t s1;
-};
-
-int   rng_i(void);
-float rng_f(void);
-float rng_fnd(void);
-void  rng_seed(uint64_t seed);
-
-void  rng_save_state(struct rng_state *);
-void  rng_restore_state(struct rng_state *);
-
 #endif
 